@@ -168,10 +168,24 @@ enum sr_packettype {
 	SR_DF_FRAME_END,
 	/** Payload is struct sr_datafeed_analog. */
 	SR_DF_ANALOG,
+	/** Payload is struct sr_datafeed_logic_rle. */
+	SR_DF_LOGIC_RLE,
+	/** Payload is struct sr_datafeed_logic_planar. */
+	SR_DF_LOGIC_PLANAR,
 
 	/* Update datafeed_dump() (session.c) upon changes! */
 };
 
+/** What to do when the asynchronous datafeed dispatch queue is full. */
+enum sr_dispatch_policy {
+	/** Wait until the dispatch thread made room in the queue. */
+	SR_DISPATCH_BLOCK = 10000,
+	/** Drop logic and analog packets which don't fit into the queue. */
+	SR_DISPATCH_DROP,
+	/** Drop the packet and stop the session. */
+	SR_DISPATCH_ABORT,
+};
+
 /** Measured quantity, sr_analog_meaning.mq. */
 enum sr_mq {
 	SR_MQ_VOLTAGE = 10000,
@@ -467,6 +481,16 @@ struct sr_context;
  */
 struct sr_session;
 
+/**
+ * @struct sr_buffer
+ * Opaque structure representing a reference counted sample data buffer.
+ *
+ * None of the fields of this structure are meant to be accessed directly.
+ *
+ * @see sr_buffer_new(), sr_buffer_unref(), sr_packet_retain().
+ */
+struct sr_buffer;
+
 struct sr_rational {
 	/** Numerator of the rational number. */
 	int64_t p;
@@ -498,6 +522,47 @@ struct sr_datafeed_logic {
 	void *data;
 };
 
+/**
+ * Run-length compressed logic datafeed payload for type SR_DF_LOGIC_RLE.
+ *
+ * The samples are the values[i] repeated lengths[i] times, for all runs
+ * in order. Values are stored like the samples of sr_datafeed_logic.
+ */
+struct sr_datafeed_logic_rle {
+	/** Number of runs. */
+	uint64_t num_runs;
+	/** Size of a sample value in bytes. */
+	uint16_t unitsize;
+	/** Sample values, num_runs * unitsize bytes. */
+	void *values;
+	/** Number of samples in each run. */
+	uint64_t *lengths;
+};
+
+/**
+ * Channel-planar logic datafeed payload for type SR_DF_LOGIC_PLANAR.
+ *
+ * Each plane holds the samples of one channel as a bit array: sample s
+ * is bit (s % 8) of byte (s / 8) of the plane. Plane i starts at byte
+ * i * stride of data and carries the channel at bit channels[i] of the
+ * equivalent sr_datafeed_logic samples. Channels without a plane read
+ * as low.
+ */
+struct sr_datafeed_logic_planar {
+	/** Number of samples. */
+	uint64_t num_samples;
+	/** Size of a sample in the equivalent sr_datafeed_logic data. */
+	uint16_t unitsize;
+	/** Number of planes. */
+	uint32_t num_planes;
+	/** Channel (bit index within a sample) of each plane. */
+	uint32_t *channels;
+	/** Distance between planes in bytes, at least (num_samples + 7) / 8. */
+	uint64_t stride;
+	/** The planes. */
+	void *data;
+};
+
 /** Analog datafeed payload for type SR_DF_ANALOG. */
 struct sr_datafeed_analog {
 	void *data;
@@ -577,11 +642,22 @@ struct sr_resource {
 enum sr_output_flag {
 	/** If set, this output module writes the output itself. */
 	SR_OUTPUT_INTERNAL_IO_HANDLING = 0x01,
+	/** If set, this output module takes SR_DF_LOGIC_RLE packets. */
+	SR_OUTPUT_LOGIC_RLE = 0x02,
+	/** If set, this output module takes SR_DF_LOGIC_PLANAR packets. */
+	SR_OUTPUT_LOGIC_PLANAR = 0x04,
+};
+
+/** A piece of output, as passed to an output sink callback. */
+struct sr_output_chunk {
+	const void *data;
+	size_t len;
 };
 
 struct sr_input;
 struct sr_input_module;
 struct sr_output;
+struct sr_output_sink;
 struct sr_output_module;
 struct sr_transform;
 struct sr_transform_module;
@@ -1098,6 +1174,12 @@ enum sr_configkey {
 	/** Self test mode. */
 	SR_CONF_TEST_MODE,
 
+	/**
+	 * The device supports starting the acquisition at a sample offset
+	 * (e.g. when replaying a capture), skipping all earlier samples.
+	 */
+	SR_CONF_SAMPLE_OFFSET,
+
 	/* Update sr_key_info_config[] (hwdriver.c) upon changes! */
 };
 
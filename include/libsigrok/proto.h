@@ -45,11 +45,20 @@ SR_API int sr_rational_div(struct sr_rational *res, const struct sr_rational *nu
 
 SR_API int sr_init(struct sr_context **ctx);
 SR_API int sr_exit(struct sr_context *ctx);
+SR_API int sr_usb_thread_set(struct sr_context *ctx, gboolean enable);
 
 SR_API GSList *sr_buildinfo_libs_get(void);
 SR_API char *sr_buildinfo_host_get(void);
 SR_API char *sr_buildinfo_scpi_backends_get(void);
 
+/*--- buffer.c --------------------------------------------------------------*/
+
+SR_API struct sr_buffer *sr_buffer_new(size_t size);
+SR_API struct sr_buffer *sr_buffer_ref(struct sr_buffer *buf);
+SR_API void sr_buffer_unref(struct sr_buffer *buf);
+SR_API void *sr_buffer_data(const struct sr_buffer *buf);
+SR_API size_t sr_buffer_size(const struct sr_buffer *buf);
+
 /*--- conversion.c ----------------------------------------------------------*/
 
 SR_API int sr_a2l_threshold(const struct sr_datafeed_analog *analog,
@@ -57,6 +66,35 @@ SR_API int sr_a2l_threshold(const struct sr_datafeed_analog *analog,
 SR_API int sr_a2l_schmitt_trigger(const struct sr_datafeed_analog *analog,
 		float lo_thr, float hi_thr, uint8_t *state, uint8_t *output,
 		uint64_t count);
+SR_API int sr_a2l_threshold_logic(const struct sr_datafeed_analog **analog,
+		const float *thresholds, unsigned int num_channels,
+		struct sr_datafeed_logic *logic);
+SR_API int sr_a2l_schmitt_trigger_logic(const struct sr_datafeed_analog **analog,
+		const float *lo_thr, const float *hi_thr, uint8_t *states,
+		unsigned int num_channels, struct sr_datafeed_logic *logic);
+SR_API void sr_transpose_8x8(const uint8_t *in, uint8_t *out, size_t count);
+SR_API void sr_transpose_16x16(const uint16_t *in, uint16_t *out, size_t count);
+SR_API void sr_transpose_32x32(const uint32_t *in, uint32_t *out, size_t count);
+SR_API void sr_transpose_64x64(const uint64_t *in, uint64_t *out, size_t count);
+SR_API int sr_logic_from_planar(const uint8_t *planar, size_t num_blocks,
+		unsigned int block_bits, gboolean msb_first, uint16_t channel_mask,
+		uint8_t *logic);
+
+/*--- logic_rle.c ---------------------------------------------------------*/
+
+SR_API uint64_t sr_logic_rle_num_samples(const struct sr_datafeed_logic_rle *rle);
+SR_API int sr_logic_rle_densify(const struct sr_datafeed_logic_rle *rle,
+		struct sr_datafeed_logic *logic);
+
+/*--- logic_planar.c ------------------------------------------------------*/
+
+SR_API const uint8_t *sr_logic_planar_channel(
+		const struct sr_datafeed_logic_planar *planar, uint32_t channel);
+SR_API int sr_logic_planar_densify(const struct sr_datafeed_logic_planar *planar,
+		struct sr_datafeed_logic *logic);
+SR_API int sr_logic_planar_split(const struct sr_datafeed_logic *logic,
+		uint32_t *channels, uint32_t num_planes,
+		struct sr_datafeed_logic_planar *planar);
 
 /*--- log.c -----------------------------------------------------------------*/
 
@@ -93,6 +131,9 @@ SR_API const char *sr_dev_inst_sernum_get(const struct sr_dev_inst *sdi);
 SR_API const char *sr_dev_inst_connid_get(const struct sr_dev_inst *sdi);
 SR_API GSList *sr_dev_inst_channels_get(const struct sr_dev_inst *sdi);
 SR_API GSList *sr_dev_inst_channel_groups_get(const struct sr_dev_inst *sdi);
+SR_API int sr_dev_inst_usb_stats_get(const struct sr_dev_inst *sdi,
+		unsigned int *transfers, unsigned int *in_flight,
+		uint64_t *late, uint64_t *empty);
 
 SR_API struct sr_dev_inst *sr_dev_inst_user_new(const char *vendor,
 		const char *model, const char *version);
@@ -145,6 +186,10 @@ SR_API int sr_session_trigger_set(struct sr_session *session, struct sr_trigger
 SR_API int sr_session_datafeed_callback_remove_all(struct sr_session *session);
 SR_API int sr_session_datafeed_callback_add(struct sr_session *session,
 		sr_datafeed_callback cb, void *cb_data);
+SR_API int sr_session_datafeed_rle_callback_add(struct sr_session *session,
+		sr_datafeed_callback cb, void *cb_data);
+SR_API int sr_session_datafeed_planar_callback_add(struct sr_session *session,
+		sr_datafeed_callback cb, void *cb_data);
 
 /* Session control */
 SR_API int sr_session_start(struct sr_session *session);
@@ -153,9 +198,15 @@ SR_API int sr_session_stop(struct sr_session *session);
 SR_API int sr_session_is_running(struct sr_session *session);
 SR_API int sr_session_stopped_callback_set(struct sr_session *session,
 		sr_session_stopped_callback cb, void *cb_data);
+SR_API int sr_session_dispatch_set(struct sr_session *session,
+		unsigned int depth, enum sr_dispatch_policy policy);
+SR_API int sr_session_dispatch_stats_get(struct sr_session *session,
+		unsigned int *high_water, uint64_t *dropped);
 
 SR_API int sr_packet_copy(const struct sr_datafeed_packet *packet,
 		struct sr_datafeed_packet **copy);
+SR_API int sr_packet_retain(const struct sr_datafeed_packet *packet,
+		struct sr_datafeed_packet **copy);
 SR_API void sr_packet_free(struct sr_datafeed_packet *packet);
 
 /*--- input/input.c ---------------------------------------------------------*/
@@ -176,6 +227,8 @@ SR_API int sr_input_scan_file(const char *filename, const struct sr_input **in);
 SR_API const struct sr_input_module *sr_input_module_get(const struct sr_input *in);
 SR_API struct sr_dev_inst *sr_input_dev_inst_get(const struct sr_input *in);
 SR_API int sr_input_send(const struct sr_input *in, GString *buf);
+SR_API int sr_input_load_file(const struct sr_input *in,
+		const char *filename);
 SR_API int sr_input_end(const struct sr_input *in);
 SR_API int sr_input_reset(const struct sr_input *in);
 SR_API void sr_input_free(const struct sr_input *in);
@@ -196,8 +249,18 @@ SR_API const struct sr_output *sr_output_new(const struct sr_output_module *omod
 		const char *filename);
 SR_API gboolean sr_output_test_flag(const struct sr_output_module *omod,
 		uint64_t flag);
+typedef int (*sr_output_sink_callback)(const struct sr_output_chunk *chunks,
+		unsigned int num_chunks, void *cb_data);
+
 SR_API int sr_output_send(const struct sr_output *o,
 		const struct sr_datafeed_packet *packet, GString **out);
+SR_API int sr_output_sink_fd_set(const struct sr_output *o, int fd);
+SR_API int sr_output_sink_file_set(const struct sr_output *o, FILE *file);
+SR_API int sr_output_sink_callback_set(const struct sr_output *o,
+		sr_output_sink_callback cb, void *cb_data);
+SR_API int sr_output_write(const struct sr_output *o,
+		const struct sr_datafeed_packet *packet);
+SR_API int sr_output_flush(const struct sr_output *o);
 SR_API int sr_output_free(const struct sr_output *o);
 
 /*--- transform/transform.c -------------------------------------------------*/
@@ -260,6 +323,8 @@ SR_API int sr_snprintf_ascii(char *buf, size_t buf_size,
 SR_API int sr_vsnprintf_ascii(char *buf, size_t buf_size,
 		const char *format, va_list args);
 SR_API int sr_parse_rational(const char *str, struct sr_rational *ret);
+SR_API int sr_parse_float_list(const char *str, float *values, size_t size,
+		size_t *count);
 
 /*--- version.c -------------------------------------------------------------*/
 
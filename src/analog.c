@@ -25,6 +25,12 @@
 #include <math.h>
 #include <libsigrok/libsigrok.h>
 #include "libsigrok-internal.h"
+#ifdef SR_SIMD_X86
+#include <immintrin.h>
+#endif
+#ifdef SR_SIMD_ARM_NEON
+#include <arm_neon.h>
+#endif
 
 /** @cond PRIVATE */
 #define LOG_PREFIX "analog"
@@ -154,12 +160,462 @@ SR_PRIV int sr_analog_init(struct sr_datafeed_analog *analog,
 	return SR_OK;
 }
 
+/*
+ * Sample encodings which sr_analog_to_float() has dedicated conversion
+ * kernels for. The names reflect the byte order of the data, not the
+ * byte order of the host.
+ */
+enum analog_conv {
+	CONV_S8,
+	CONV_U8,
+	CONV_S16LE,
+	CONV_U16LE,
+	CONV_S16BE,
+	CONV_U16BE,
+	CONV_S32LE,
+	CONV_U32LE,
+	CONV_S32BE,
+	CONV_U32BE,
+	CONV_F32LE,
+	CONV_F32BE,
+};
+
+/* Size of one sample in the input data. */
+static size_t analog_conv_size(enum analog_conv conv)
+{
+	switch (conv) {
+	case CONV_S8:
+	case CONV_U8:
+		return 1;
+	case CONV_S16LE:
+	case CONV_U16LE:
+	case CONV_S16BE:
+	case CONV_U16BE:
+		return 2;
+	default:
+		return 4;
+	}
+}
+
+/*
+ * All kernels compute "scale * value + offset" as two separately rounded
+ * operations (no fused multiply-add), so that the vectorized code paths
+ * yield the very same results as the portable implementation.
+ */
+
+static void analog_conv_scalar(enum analog_conv conv, float *out,
+		const uint8_t *in, size_t count, float scale, float offset)
+{
+	size_t i;
+
+	switch (conv) {
+	case CONV_S8:
+		for (i = 0; i < count; i++)
+			out[i] = scale * (int8_t)in[i] + offset;
+		break;
+	case CONV_U8:
+		for (i = 0; i < count; i++)
+			out[i] = scale * in[i] + offset;
+		break;
+	case CONV_S16LE:
+		for (i = 0; i < count; i++)
+			out[i] = scale * RL16S(&in[2 * i]) + offset;
+		break;
+	case CONV_U16LE:
+		for (i = 0; i < count; i++)
+			out[i] = scale * RL16(&in[2 * i]) + offset;
+		break;
+	case CONV_S16BE:
+		for (i = 0; i < count; i++)
+			out[i] = scale * RB16S(&in[2 * i]) + offset;
+		break;
+	case CONV_U16BE:
+		for (i = 0; i < count; i++)
+			out[i] = scale * RB16(&in[2 * i]) + offset;
+		break;
+	case CONV_S32LE:
+		for (i = 0; i < count; i++)
+			out[i] = scale * RL32S(&in[4 * i]) + offset;
+		break;
+	case CONV_U32LE:
+		for (i = 0; i < count; i++)
+			out[i] = scale * RL32(&in[4 * i]) + offset;
+		break;
+	case CONV_S32BE:
+		for (i = 0; i < count; i++)
+			out[i] = scale * RB32S(&in[4 * i]) + offset;
+		break;
+	case CONV_U32BE:
+		for (i = 0; i < count; i++)
+			out[i] = scale * RB32(&in[4 * i]) + offset;
+		break;
+	case CONV_F32LE:
+		for (i = 0; i < count; i++)
+			out[i] = scale * RLFL(&in[4 * i]) + offset;
+		break;
+	case CONV_F32BE:
+		for (i = 0; i < count; i++)
+			out[i] = scale * RBFL(&in[4 * i]) + offset;
+		break;
+	}
+}
+
+#ifdef SR_SIMD_X86
+
+/* Unsigned 32bit to float, SSE2 and AVX2 only convert signed values. */
+static inline SR_SIMD_TARGET_SSE2 __m128 sse2_cvtepu32_ps(__m128i v)
+{
+	__m128 hi, lo;
+
+	/* Both halves convert exactly, the sum rounds once. */
+	hi = _mm_cvtepi32_ps(_mm_srli_epi32(v, 16));
+	lo = _mm_cvtepi32_ps(_mm_and_si128(v, _mm_set1_epi32(0xffff)));
+
+	return _mm_add_ps(_mm_mul_ps(hi, _mm_set1_ps(65536.0f)), lo);
+}
+
+static inline SR_SIMD_TARGET_SSE2 __m128i sse2_bswap32(__m128i v)
+{
+	__m128i outer, inner;
+
+	outer = _mm_or_si128(_mm_slli_epi32(v, 24), _mm_srli_epi32(v, 24));
+	inner = _mm_or_si128(
+		_mm_and_si128(_mm_slli_epi32(v, 8), _mm_set1_epi32(0x00ff0000)),
+		_mm_and_si128(_mm_srli_epi32(v, 8), _mm_set1_epi32(0x0000ff00)));
+
+	return _mm_or_si128(outer, inner);
+}
+
+static inline SR_SIMD_TARGET_SSE2 void sse2_store(float *out, __m128 v,
+		__m128 scale, __m128 offset)
+{
+	_mm_storeu_ps(out, _mm_add_ps(_mm_mul_ps(v, scale), offset));
+}
+
+/* Returns the number of samples that were converted. */
+static SR_SIMD_TARGET_SSE2 size_t analog_conv_sse2(enum analog_conv conv,
+		float *out, const uint8_t *in, size_t count, float scale, float offset)
+{
+	__m128 vscale, voffset;
+	__m128i v, w, zero;
+	size_t i, step;
+
+	vscale = _mm_set1_ps(scale);
+	voffset = _mm_set1_ps(offset);
+	zero = _mm_setzero_si128();
+
+	/* Consume 16 bytes of input per iteration. */
+	step = 16 / analog_conv_size(conv);
+
+	for (i = 0; i + step <= count; i += step) {
+		switch (conv) {
+		case CONV_S8:
+			v = _mm_loadu_si128((const __m128i *)&in[i]);
+			w = _mm_srai_epi16(_mm_unpacklo_epi8(v, v), 8);
+			sse2_store(&out[i], _mm_cvtepi32_ps(_mm_srai_epi32(
+				_mm_unpacklo_epi16(w, w), 16)), vscale, voffset);
+			sse2_store(&out[i + 4], _mm_cvtepi32_ps(_mm_srai_epi32(
+				_mm_unpackhi_epi16(w, w), 16)), vscale, voffset);
+			w = _mm_srai_epi16(_mm_unpackhi_epi8(v, v), 8);
+			sse2_store(&out[i + 8], _mm_cvtepi32_ps(_mm_srai_epi32(
+				_mm_unpacklo_epi16(w, w), 16)), vscale, voffset);
+			sse2_store(&out[i + 12], _mm_cvtepi32_ps(_mm_srai_epi32(
+				_mm_unpackhi_epi16(w, w), 16)), vscale, voffset);
+			break;
+		case CONV_U8:
+			v = _mm_loadu_si128((const __m128i *)&in[i]);
+			w = _mm_unpacklo_epi8(v, zero);
+			sse2_store(&out[i], _mm_cvtepi32_ps(
+				_mm_unpacklo_epi16(w, zero)), vscale, voffset);
+			sse2_store(&out[i + 4], _mm_cvtepi32_ps(
+				_mm_unpackhi_epi16(w, zero)), vscale, voffset);
+			w = _mm_unpackhi_epi8(v, zero);
+			sse2_store(&out[i + 8], _mm_cvtepi32_ps(
+				_mm_unpacklo_epi16(w, zero)), vscale, voffset);
+			sse2_store(&out[i + 12], _mm_cvtepi32_ps(
+				_mm_unpackhi_epi16(w, zero)), vscale, voffset);
+			break;
+		case CONV_S16LE:
+		case CONV_S16BE:
+			v = _mm_loadu_si128((const __m128i *)&in[2 * i]);
+			if (conv == CONV_S16BE)
+				v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+			sse2_store(&out[i], _mm_cvtepi32_ps(_mm_srai_epi32(
+				_mm_unpacklo_epi16(v, v), 16)), vscale, voffset);
+			sse2_store(&out[i + 4], _mm_cvtepi32_ps(_mm_srai_epi32(
+				_mm_unpackhi_epi16(v, v), 16)), vscale, voffset);
+			break;
+		case CONV_U16LE:
+		case CONV_U16BE:
+			v = _mm_loadu_si128((const __m128i *)&in[2 * i]);
+			if (conv == CONV_U16BE)
+				v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+			sse2_store(&out[i], _mm_cvtepi32_ps(
+				_mm_unpacklo_epi16(v, zero)), vscale, voffset);
+			sse2_store(&out[i + 4], _mm_cvtepi32_ps(
+				_mm_unpackhi_epi16(v, zero)), vscale, voffset);
+			break;
+		case CONV_S32LE:
+		case CONV_S32BE:
+			v = _mm_loadu_si128((const __m128i *)&in[4 * i]);
+			if (conv == CONV_S32BE)
+				v = sse2_bswap32(v);
+			sse2_store(&out[i], _mm_cvtepi32_ps(v), vscale, voffset);
+			break;
+		case CONV_U32LE:
+		case CONV_U32BE:
+			v = _mm_loadu_si128((const __m128i *)&in[4 * i]);
+			if (conv == CONV_U32BE)
+				v = sse2_bswap32(v);
+			sse2_store(&out[i], sse2_cvtepu32_ps(v), vscale, voffset);
+			break;
+		case CONV_F32LE:
+			sse2_store(&out[i], _mm_loadu_ps((const float *)&in[4 * i]),
+				vscale, voffset);
+			break;
+		case CONV_F32BE:
+			v = sse2_bswap32(_mm_loadu_si128((const __m128i *)&in[4 * i]));
+			sse2_store(&out[i], _mm_castsi128_ps(v), vscale, voffset);
+			break;
+		}
+	}
+
+	return i;
+}
+
+static inline SR_SIMD_TARGET_AVX2 __m256 avx2_cvtepu32_ps(__m256i v)
+{
+	__m256 hi, lo;
+
+	hi = _mm256_cvtepi32_ps(_mm256_srli_epi32(v, 16));
+	lo = _mm256_cvtepi32_ps(_mm256_and_si256(v, _mm256_set1_epi32(0xffff)));
+
+	return _mm256_add_ps(_mm256_mul_ps(hi, _mm256_set1_ps(65536.0f)), lo);
+}
+
+static inline SR_SIMD_TARGET_AVX2 void avx2_store(float *out, __m256 v,
+		__m256 scale, __m256 offset)
+{
+	_mm256_storeu_ps(out, _mm256_add_ps(_mm256_mul_ps(v, scale), offset));
+}
+
+/* Returns the number of samples that were converted. */
+static SR_SIMD_TARGET_AVX2 size_t analog_conv_avx2(enum analog_conv conv,
+		float *out, const uint8_t *in, size_t count, float scale, float offset)
+{
+	__m256 vscale, voffset;
+	__m256i swap32;
+	__m128i v, swap16;
+	__m256i w;
+	size_t i, step;
+
+	vscale = _mm256_set1_ps(scale);
+	voffset = _mm256_set1_ps(offset);
+	swap16 = _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6,
+		9, 8, 11, 10, 13, 12, 15, 14);
+	swap32 = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4,
+		11, 10, 9, 8, 15, 14, 13, 12,
+		3, 2, 1, 0, 7, 6, 5, 4,
+		11, 10, 9, 8, 15, 14, 13, 12);
+
+	step = (conv == CONV_S8 || conv == CONV_U8) ? 16 : 8;
+
+	for (i = 0; i + step <= count; i += step) {
+		switch (conv) {
+		case CONV_S8:
+			v = _mm_loadu_si128((const __m128i *)&in[i]);
+			avx2_store(&out[i], _mm256_cvtepi32_ps(
+				_mm256_cvtepi8_epi32(v)), vscale, voffset);
+			avx2_store(&out[i + 8], _mm256_cvtepi32_ps(
+				_mm256_cvtepi8_epi32(_mm_srli_si128(v, 8))),
+				vscale, voffset);
+			break;
+		case CONV_U8:
+			v = _mm_loadu_si128((const __m128i *)&in[i]);
+			avx2_store(&out[i], _mm256_cvtepi32_ps(
+				_mm256_cvtepu8_epi32(v)), vscale, voffset);
+			avx2_store(&out[i + 8], _mm256_cvtepi32_ps(
+				_mm256_cvtepu8_epi32(_mm_srli_si128(v, 8))),
+				vscale, voffset);
+			break;
+		case CONV_S16LE:
+		case CONV_S16BE:
+			v = _mm_loadu_si128((const __m128i *)&in[2 * i]);
+			if (conv == CONV_S16BE)
+				v = _mm_shuffle_epi8(v, swap16);
+			avx2_store(&out[i], _mm256_cvtepi32_ps(
+				_mm256_cvtepi16_epi32(v)), vscale, voffset);
+			break;
+		case CONV_U16LE:
+		case CONV_U16BE:
+			v = _mm_loadu_si128((const __m128i *)&in[2 * i]);
+			if (conv == CONV_U16BE)
+				v = _mm_shuffle_epi8(v, swap16);
+			avx2_store(&out[i], _mm256_cvtepi32_ps(
+				_mm256_cvtepu16_epi32(v)), vscale, voffset);
+			break;
+		case CONV_S32LE:
+		case CONV_S32BE:
+			w = _mm256_loadu_si256((const __m256i *)&in[4 * i]);
+			if (conv == CONV_S32BE)
+				w = _mm256_shuffle_epi8(w, swap32);
+			avx2_store(&out[i], _mm256_cvtepi32_ps(w), vscale, voffset);
+			break;
+		case CONV_U32LE:
+		case CONV_U32BE:
+			w = _mm256_loadu_si256((const __m256i *)&in[4 * i]);
+			if (conv == CONV_U32BE)
+				w = _mm256_shuffle_epi8(w, swap32);
+			avx2_store(&out[i], avx2_cvtepu32_ps(w), vscale, voffset);
+			break;
+		case CONV_F32LE:
+			avx2_store(&out[i], _mm256_loadu_ps((const float *)&in[4 * i]),
+				vscale, voffset);
+			break;
+		case CONV_F32BE:
+			w = _mm256_loadu_si256((const __m256i *)&in[4 * i]);
+			w = _mm256_shuffle_epi8(w, swap32);
+			avx2_store(&out[i], _mm256_castsi256_ps(w), vscale, voffset);
+			break;
+		}
+	}
+
+	return i;
+}
+
+#endif
+
+#ifdef SR_SIMD_ARM_NEON
+
+static inline void neon_store(float *out, float32x4_t v,
+		float32x4_t scale, float32x4_t offset)
+{
+	vst1q_f32(out, vaddq_f32(vmulq_f32(v, scale), offset));
+}
+
+static inline void neon_store_s16(float *out, int16x8_t v,
+		float32x4_t scale, float32x4_t offset)
+{
+	neon_store(out, vcvtq_f32_s32(vmovl_s16(vget_low_s16(v))),
+		scale, offset);
+	neon_store(out + 4, vcvtq_f32_s32(vmovl_s16(vget_high_s16(v))),
+		scale, offset);
+}
+
+static inline void neon_store_u16(float *out, uint16x8_t v,
+		float32x4_t scale, float32x4_t offset)
+{
+	neon_store(out, vcvtq_f32_u32(vmovl_u16(vget_low_u16(v))),
+		scale, offset);
+	neon_store(out + 4, vcvtq_f32_u32(vmovl_u16(vget_high_u16(v))),
+		scale, offset);
+}
+
+/* Returns the number of samples that were converted. */
+static size_t analog_conv_neon(enum analog_conv conv, float *out,
+		const uint8_t *in, size_t count, float scale, float offset)
+{
+	float32x4_t vscale, voffset;
+	size_t i, step;
+
+	vscale = vdupq_n_f32(scale);
+	voffset = vdupq_n_f32(offset);
+	step = (analog_conv_size(conv) == 4) ? 4 : 8;
+
+	for (i = 0; i + step <= count; i += step) {
+		switch (conv) {
+		case CONV_S8:
+			neon_store_s16(&out[i], vmovl_s8(vld1_s8((const int8_t *)&in[i])),
+				vscale, voffset);
+			break;
+		case CONV_U8:
+			neon_store_u16(&out[i], vmovl_u8(vld1_u8(&in[i])),
+				vscale, voffset);
+			break;
+		case CONV_S16LE:
+			neon_store_s16(&out[i], vreinterpretq_s16_u8(
+				vld1q_u8(&in[2 * i])), vscale, voffset);
+			break;
+		case CONV_S16BE:
+			neon_store_s16(&out[i], vreinterpretq_s16_u8(
+				vrev16q_u8(vld1q_u8(&in[2 * i]))), vscale, voffset);
+			break;
+		case CONV_U16LE:
+			neon_store_u16(&out[i], vreinterpretq_u16_u8(
+				vld1q_u8(&in[2 * i])), vscale, voffset);
+			break;
+		case CONV_U16BE:
+			neon_store_u16(&out[i], vreinterpretq_u16_u8(
+				vrev16q_u8(vld1q_u8(&in[2 * i]))), vscale, voffset);
+			break;
+		case CONV_S32LE:
+			neon_store(&out[i], vcvtq_f32_s32(vreinterpretq_s32_u8(
+				vld1q_u8(&in[4 * i]))), vscale, voffset);
+			break;
+		case CONV_S32BE:
+			neon_store(&out[i], vcvtq_f32_s32(vreinterpretq_s32_u8(
+				vrev32q_u8(vld1q_u8(&in[4 * i])))), vscale, voffset);
+			break;
+		case CONV_U32LE:
+			neon_store(&out[i], vcvtq_f32_u32(vreinterpretq_u32_u8(
+				vld1q_u8(&in[4 * i]))), vscale, voffset);
+			break;
+		case CONV_U32BE:
+			neon_store(&out[i], vcvtq_f32_u32(vreinterpretq_u32_u8(
+				vrev32q_u8(vld1q_u8(&in[4 * i])))), vscale, voffset);
+			break;
+		case CONV_F32LE:
+			neon_store(&out[i], vreinterpretq_f32_u8(
+				vld1q_u8(&in[4 * i])), vscale, voffset);
+			break;
+		case CONV_F32BE:
+			neon_store(&out[i], vreinterpretq_f32_u8(
+				vrev32q_u8(vld1q_u8(&in[4 * i]))), vscale, voffset);
+			break;
+		}
+	}
+
+	return i;
+}
+
+#endif
+
+/* Convert with the best kernel for this machine, then finish the tail. */
+static void analog_conv(enum analog_conv conv, float *out,
+		const uint8_t *in, size_t count, float scale, float offset)
+{
+	unsigned int features;
+	size_t done;
+
+	features = sr_simd_features();
+	done = 0;
+#ifdef SR_SIMD_X86
+	if (features & SR_SIMD_AVX2)
+		done = analog_conv_avx2(conv, out, in, count, scale, offset);
+	else if (features & SR_SIMD_SSE2)
+		done = analog_conv_sse2(conv, out, in, count, scale, offset);
+#endif
+#ifdef SR_SIMD_ARM_NEON
+	if (features & SR_SIMD_NEON)
+		done = analog_conv_neon(conv, out, in, count, scale, offset);
+#endif
+	(void)features;
+
+	if (done < count) {
+		analog_conv_scalar(conv, out + done,
+			in + done * analog_conv_size(conv),
+			count - done, scale, offset);
+	}
+}
+
 /**
  * Convert an analog datafeed payload to an array of floats.
  *
  * Sufficient memory for outbuf must have been pre-allocated by the caller,
  * who is also responsible for freeing it when no longer needed.
  *
+ * Vectorized conversion kernels get used when the machine supports them.
+ *
  * @param[in] analog The analog payload to convert. Must not be NULL.
  *                   analog->data, analog->meaning, and analog->encoding
  *                   must not be NULL.
@@ -174,13 +630,17 @@ SR_PRIV int sr_analog_init(struct sr_datafeed_analog *analog,
 SR_API int sr_analog_to_float(const struct sr_datafeed_analog *analog,
 		float *outbuf)
 {
-	unsigned int b, count;
+	const struct sr_analog_encoding *enc;
+	enum analog_conv conv;
+	unsigned int count;
+	float scale, offset;
 	gboolean bigendian;
 
 	if (!analog || !(analog->data) || !(analog->meaning)
 			|| !(analog->encoding) || !outbuf)
 		return SR_ERR_ARG;
 
+	enc = analog->encoding;
 	count = analog->num_samples * g_slist_length(analog->meaning->channels);
 
 #ifdef WORDS_BIGENDIAN
@@ -189,108 +649,40 @@ SR_API int sr_analog_to_float(const struct sr_datafeed_analog *analog,
 	bigendian = FALSE;
 #endif
 
-	if (!analog->encoding->is_float) {
-		float offset = analog->encoding->offset.p / (float)analog->encoding->offset.q;
-		float scale = analog->encoding->scale.p / (float)analog->encoding->scale.q;
-		gboolean is_signed = analog->encoding->is_signed;
-		gboolean is_bigendian = analog->encoding->is_bigendian;
-		int8_t *data8 = (int8_t *)(analog->data);
-		int16_t *data16 = (int16_t *)(analog->data);
-		int32_t *data32 = (int32_t *)(analog->data);
-
-		switch (analog->encoding->unitsize) {
-		case 1:
-			if (is_signed) {
-				for (unsigned int i = 0; i < count; i++) {
-					outbuf[i] = scale * data8[i];
-					outbuf[i] += offset;
-				}
-			} else {
-				for (unsigned int i = 0; i < count; i++) {
-					outbuf[i] = scale * R8(data8 + i);
-					outbuf[i] += offset;
-				}
-			}
-			break;
-		case 2:
-			if (is_signed && is_bigendian) {
-				for (unsigned int i = 0; i < count; i++) {
-					outbuf[i] = scale * RB16S(&data16[i]);
-					outbuf[i] += offset;
-				}
-			} else if (is_bigendian) {
-				for (unsigned int i = 0; i < count; i++) {
-					outbuf[i] = scale * RB16(&data16[i]);
-					outbuf[i] += offset;
-				}
-			} else if (is_signed) {
-				for (unsigned int i = 0; i < count; i++) {
-					outbuf[i] = scale * RL16S(&data16[i]);
-					outbuf[i] += offset;
-				}
-			} else {
-				for (unsigned int i = 0; i < count; i++) {
-					outbuf[i] = scale * RL16(&data16[i]);
-					outbuf[i] += offset;
-				}
-			}
-			break;
-		case 4:
-			if (is_signed && is_bigendian) {
-				for (unsigned int i = 0; i < count; i++) {
-					outbuf[i] = scale * RB32S(&data32[i]);
-					outbuf[i] += offset;
-				}
-			} else if (is_bigendian) {
-				for (unsigned int i = 0; i < count; i++) {
-					outbuf[i] = scale * RB32(&data32[i]);
-					outbuf[i] += offset;
-				}
-			} else if (is_signed) {
-				for (unsigned int i = 0; i < count; i++) {
-					outbuf[i] = scale * RL32S(&data32[i]);
-					outbuf[i] += offset;
-				}
-			} else {
-				for (unsigned int i = 0; i < count; i++) {
-					outbuf[i] = scale * RL32(&data32[i]);
-					outbuf[i] += offset;
-				}
-			}
-			break;
-		default:
-			sr_err("Unsupported unit size '%d' for analog-to-float"
-			       " conversion.", analog->encoding->unitsize);
-			return SR_ERR;
-		}
+	if (enc->is_float && enc->unitsize == sizeof(float)
+			&& enc->is_bigendian == bigendian
+			&& enc->scale.p == 1
+			&& enc->scale.q == 1
+			&& enc->offset.p / (float)enc->offset.q == 0) {
+		/* The data is already in the right format. */
+		memcpy(outbuf, analog->data, count * sizeof(float));
 		return SR_OK;
 	}
 
-	if (analog->encoding->unitsize == sizeof(float)
-			&& analog->encoding->is_bigendian == bigendian
-			&& analog->encoding->scale.p == 1
-			&& analog->encoding->scale.q == 1
-			&& analog->encoding->offset.p / (float)analog->encoding->offset.q == 0) {
-		/* The data is already in the right format. */
-		memcpy(outbuf, analog->data, count * sizeof(float));
+	if (enc->is_float && enc->unitsize == sizeof(float)) {
+		conv = enc->is_bigendian ? CONV_F32BE : CONV_F32LE;
+	} else if (!enc->is_float && enc->unitsize == 1) {
+		conv = enc->is_signed ? CONV_S8 : CONV_U8;
+	} else if (!enc->is_float && enc->unitsize == 2) {
+		if (enc->is_bigendian)
+			conv = enc->is_signed ? CONV_S16BE : CONV_U16BE;
+		else
+			conv = enc->is_signed ? CONV_S16LE : CONV_U16LE;
+	} else if (!enc->is_float && enc->unitsize == 4) {
+		if (enc->is_bigendian)
+			conv = enc->is_signed ? CONV_S32BE : CONV_U32BE;
+		else
+			conv = enc->is_signed ? CONV_S32LE : CONV_U32LE;
 	} else {
-		for (unsigned int i = 0; i < count; i += analog->encoding->unitsize) {
-			for (b = 0; b < analog->encoding->unitsize; b++) {
-				if (analog->encoding->is_bigendian == bigendian)
-					((uint8_t *)outbuf)[i + b] =
-						((uint8_t *)analog->data)[i * analog->encoding->unitsize + b];
-				else
-					((uint8_t *)outbuf)[i + (analog->encoding->unitsize - b)] =
-						((uint8_t *)analog->data)[i * analog->encoding->unitsize + b];
-			}
-			if (analog->encoding->scale.p != 1
-					|| analog->encoding->scale.q != 1)
-				outbuf[i] = (outbuf[i] * analog->encoding->scale.p) / analog->encoding->scale.q;
-			float offset = ((float)analog->encoding->offset.p / (float)analog->encoding->offset.q);
-			outbuf[i] += offset;
-		}
+		sr_err("Unsupported unit size '%d' for analog-to-float"
+		       " conversion.", enc->unitsize);
+		return SR_ERR;
 	}
 
+	scale = enc->scale.p / (float)enc->scale.q;
+	offset = enc->offset.p / (float)enc->offset.q;
+	analog_conv(conv, outbuf, analog->data, count, scale, offset);
+
 	return SR_OK;
 }
 
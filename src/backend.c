@@ -601,6 +601,7 @@ SR_API int sr_init(struct sr_context **ctx)
 		ret = SR_ERR;
 		goto done;
 	}
+	context->usb_thread_enabled = g_getenv("SIGROK_USB_THREAD") != NULL;
 #endif
 #ifdef HAVE_LIBHIDAPI
 	/*
@@ -663,4 +664,42 @@ SR_API int sr_exit(struct sr_context *ctx)
 	return SR_OK;
 }
 
+/**
+ * Enable or disable the libusb event thread.
+ *
+ * Streaming USB drivers normally handle libusb events from the session's
+ * main loop, so a busy main loop delays the resubmission of transfers,
+ * and the device may run out of buffer space. With the event thread,
+ * transfers get resubmitted right when they complete, and the received
+ * data is passed on to the session through a queue. Drivers which don't
+ * support this keep handling events from the main loop.
+ *
+ * The setting takes effect when the next acquisition starts. Setting
+ * the environment variable SIGROK_USB_THREAD enables the thread by default.
+ *
+ * @param ctx libsigrok context. Must not be NULL.
+ * @param enable TRUE to use the event thread, FALSE otherwise.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ * @retval SR_ERR_NA libsigrok was built without libusb support.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_usb_thread_set(struct sr_context *ctx, gboolean enable)
+{
+	if (!ctx)
+		return SR_ERR_ARG;
+
+#ifdef HAVE_LIBUSB_1_0
+	ctx->usb_thread_enabled = enable;
+
+	return SR_OK;
+#else
+	(void)enable;
+
+	return SR_ERR_NA;
+#endif
+}
+
 /** @} */
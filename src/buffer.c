@@ -0,0 +1,343 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2026 The sigrok developers
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <string.h>
+#include <glib.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+
+/** @cond PRIVATE */
+#define LOG_PREFIX "buffer"
+/** @endcond */
+
+/**
+ * @file
+ *
+ * Reference counted sample data buffers.
+ */
+
+/**
+ * @defgroup grp_buffer Buffers
+ *
+ * Reference counted sample data buffers.
+ *
+ * Drivers which place logic or analog payloads into an sr_buffer and
+ * send them with sr_session_send_buffer() allow datafeed callbacks to
+ * keep the packet beyond the callback with sr_packet_retain(), which
+ * takes a reference on the buffer instead of duplicating the samples.
+ *
+ * @{
+ */
+
+struct sr_buffer {
+	uint8_t *data;
+	size_t size;
+	gint refcount;
+	/* Pool the buffer returns to when released, or NULL. */
+	struct sr_buffer_pool *pool;
+};
+
+struct sr_buffer_pool {
+	GMutex mutex;
+	size_t size;
+	/* Maximum number of idle buffers kept for reuse. */
+	unsigned int max_free;
+	unsigned int num_free;
+	GSList *free_list;
+	/* Buffers handed out and not yet released. */
+	unsigned int outstanding;
+	/* Set once the owner dropped its handle on the pool. */
+	gboolean released;
+};
+
+static struct sr_buffer *buffer_alloc(size_t size)
+{
+	struct sr_buffer *buf;
+
+	buf = g_malloc0(sizeof(*buf));
+	if (size && !(buf->data = g_try_malloc(size))) {
+		sr_err("Buffer malloc of %zu bytes failed.", size);
+		g_free(buf);
+		return NULL;
+	}
+	buf->size = size;
+	buf->refcount = 1;
+
+	return buf;
+}
+
+static void buffer_destroy(struct sr_buffer *buf)
+{
+	g_free(buf->data);
+	g_free(buf);
+}
+
+static void pool_destroy(struct sr_buffer_pool *pool)
+{
+	g_slist_free_full(pool->free_list, (GDestroyNotify)buffer_destroy);
+	g_mutex_clear(&pool->mutex);
+	g_free(pool);
+}
+
+static void pool_release(struct sr_buffer_pool *pool, struct sr_buffer *buf)
+{
+	gboolean destroy;
+
+	g_mutex_lock(&pool->mutex);
+	if (!pool->released && pool->num_free < pool->max_free) {
+		pool->free_list = g_slist_prepend(pool->free_list, buf);
+		pool->num_free++;
+		buf = NULL;
+	}
+	pool->outstanding--;
+	destroy = pool->released && !pool->outstanding;
+	g_mutex_unlock(&pool->mutex);
+
+	if (buf)
+		buffer_destroy(buf);
+	if (destroy)
+		pool_destroy(pool);
+}
+
+/**
+ * Allocate a new reference counted buffer.
+ *
+ * @param size The size of the buffer in bytes.
+ *
+ * @return The new buffer with a reference count of 1, or NULL if the
+ *         data could not be allocated. Release with sr_buffer_unref().
+ *
+ * @since 0.6.0
+ */
+SR_API struct sr_buffer *sr_buffer_new(size_t size)
+{
+	return buffer_alloc(size);
+}
+
+/**
+ * Take a reference on a buffer.
+ *
+ * @param buf The buffer. Must not be NULL.
+ *
+ * @return The buffer.
+ *
+ * @since 0.6.0
+ */
+SR_API struct sr_buffer *sr_buffer_ref(struct sr_buffer *buf)
+{
+	g_atomic_int_inc(&buf->refcount);
+
+	return buf;
+}
+
+/**
+ * Drop a reference on a buffer.
+ *
+ * When the last reference is dropped, the buffer is returned to the pool
+ * it was taken from, or freed.
+ *
+ * @param buf The buffer. NULL is silently ignored.
+ *
+ * @since 0.6.0
+ */
+SR_API void sr_buffer_unref(struct sr_buffer *buf)
+{
+	if (!buf)
+		return;
+
+	if (!g_atomic_int_dec_and_test(&buf->refcount))
+		return;
+
+	if (buf->pool)
+		pool_release(buf->pool, buf);
+	else
+		buffer_destroy(buf);
+}
+
+/**
+ * Get the data area of a buffer.
+ *
+ * @param buf The buffer. Must not be NULL.
+ *
+ * @return Pointer to the first byte of the buffer's data.
+ *
+ * @since 0.6.0
+ */
+SR_API void *sr_buffer_data(const struct sr_buffer *buf)
+{
+	return buf->data;
+}
+
+/**
+ * Get the size of a buffer's data area.
+ *
+ * @param buf The buffer. Must not be NULL.
+ *
+ * @return The size in bytes.
+ *
+ * @since 0.6.0
+ */
+SR_API size_t sr_buffer_size(const struct sr_buffer *buf)
+{
+	return buf->size;
+}
+
+/**
+ * Check whether a buffer is referenced by someone else.
+ *
+ * Producers which reuse their buffers (e.g. USB transfer buffers) must
+ * not overwrite a buffer while a consumer still holds a reference to it.
+ *
+ * @param buf The buffer. Must not be NULL.
+ *
+ * @return TRUE if more than one reference exists, FALSE otherwise.
+ *
+ * @private
+ */
+SR_PRIV gboolean sr_buffer_is_shared(const struct sr_buffer *buf)
+{
+	return g_atomic_int_get(&buf->refcount) > 1;
+}
+
+/**
+ * Check whether a memory range lies within a buffer's data area.
+ *
+ * @param buf The buffer. May be NULL.
+ * @param data Start of the range.
+ * @param len Length of the range in bytes.
+ *
+ * @return TRUE if the range is contained in the buffer, FALSE otherwise.
+ *
+ * @private
+ */
+SR_PRIV gboolean sr_buffer_contains(const struct sr_buffer *buf,
+		const void *data, size_t len)
+{
+	const uint8_t *p;
+
+	if (!buf || !data)
+		return FALSE;
+
+	p = data;
+	if (p < buf->data || p > buf->data + buf->size)
+		return FALSE;
+
+	return len <= (size_t)(buf->data + buf->size - p);
+}
+
+/**
+ * Create a pool of equally sized buffers.
+ *
+ * Buffers taken from the pool return to it when their last reference is
+ * dropped, so a producer that keeps a steady number of buffers in flight
+ * does not allocate memory once the pool has warmed up.
+ *
+ * @param size The size of each buffer in bytes.
+ * @param max_free The maximum number of idle buffers to keep around.
+ *
+ * @return The new pool. Release with sr_buffer_pool_free().
+ *
+ * @private
+ */
+SR_PRIV struct sr_buffer_pool *sr_buffer_pool_new(size_t size,
+		unsigned int max_free)
+{
+	struct sr_buffer_pool *pool;
+
+	pool = g_malloc0(sizeof(*pool));
+	g_mutex_init(&pool->mutex);
+	pool->size = size;
+	pool->max_free = max_free;
+
+	return pool;
+}
+
+/**
+ * Take a buffer from a pool.
+ *
+ * An idle buffer is reused if available, otherwise a new one is allocated.
+ *
+ * @param pool The pool. Must not be NULL.
+ *
+ * @return A buffer with a reference count of 1, or NULL on allocation
+ *         failure. Release with sr_buffer_unref().
+ *
+ * @private
+ */
+SR_PRIV struct sr_buffer *sr_buffer_pool_get(struct sr_buffer_pool *pool)
+{
+	struct sr_buffer *buf;
+
+	buf = NULL;
+	g_mutex_lock(&pool->mutex);
+	if (pool->free_list) {
+		buf = pool->free_list->data;
+		pool->free_list = g_slist_delete_link(pool->free_list,
+				pool->free_list);
+		pool->num_free--;
+	}
+	g_mutex_unlock(&pool->mutex);
+
+	if (buf)
+		buf->refcount = 1;
+	else if (!(buf = buffer_alloc(pool->size)))
+		return NULL;
+
+	g_mutex_lock(&pool->mutex);
+	buf->pool = pool;
+	pool->outstanding++;
+	g_mutex_unlock(&pool->mutex);
+
+	return buf;
+}
+
+/**
+ * Release a buffer pool.
+ *
+ * Idle buffers are freed immediately. Buffers that are still referenced
+ * stay valid and are freed when their last reference is dropped; the pool
+ * itself goes away together with the last of them.
+ *
+ * @param pool The pool. NULL is silently ignored.
+ *
+ * @private
+ */
+SR_PRIV void sr_buffer_pool_free(struct sr_buffer_pool *pool)
+{
+	GSList *free_list;
+	gboolean destroy;
+
+	if (!pool)
+		return;
+
+	g_mutex_lock(&pool->mutex);
+	pool->released = TRUE;
+	free_list = pool->free_list;
+	pool->free_list = NULL;
+	pool->num_free = 0;
+	destroy = !pool->outstanding;
+	g_mutex_unlock(&pool->mutex);
+
+	g_slist_free_full(free_list, (GDestroyNotify)buffer_destroy);
+	if (destroy)
+		pool_destroy(pool);
+}
+
+/** @} */
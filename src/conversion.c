@@ -22,44 +22,684 @@
  *
  * Conversion helper functions.
  */
-
+#include <config.h>
+#include <string.h>
 #include <libsigrok/libsigrok.h>
 #include "libsigrok-internal.h"
+#ifdef SR_SIMD_X86
+#include <immintrin.h>
+#endif
+#ifdef SR_SIMD_ARM_NEON
+#include <arm_neon.h>
+#endif
 
 /** @cond PRIVATE */
 #define LOG_PREFIX "conv"
 /** @endcond */
 
+/*
+ * The converters never compute float values for integer encodings.
+ * Scaling is monotonic, so a threshold on the scaled value corresponds
+ * to a limit on the raw value, which gets determined once per call.
+ * Comparisons then yield one bit per sample, which gets collected in
+ * 64bit masks, one block of A2L_BLOCK samples at a time. All buffers
+ * live on the stack.
+ */
+#define A2L_BLOCK 512
+
+/* How a scaled sample value gets compared against the threshold. */
+enum a2l_op {
+	A2L_GE,
+	A2L_GT,
+	A2L_LT,
+};
+
+struct a2l_src {
+	const uint8_t *data;
+	unsigned int unitsize;
+	gboolean is_signed;
+	gboolean is_float;
+	gboolean is_bigendian;
+	float scale;
+	float offset;
+};
+
+struct a2l_level {
+	/* Float encodings: the bit is set if (value <op> thr). */
+	enum a2l_op op;
+	float thr;
+	/* Integer encodings: the bit is set if ((raw > lim) != invert). */
+	int64_t lim;
+	gboolean invert;
+	/* All samples yield the same bit, namely invert. */
+	gboolean fixed;
+};
+
+struct a2l_channel {
+	struct a2l_src src;
+	/* The threshold, or the Schmitt-trigger's high threshold. */
+	struct a2l_level hi;
+	struct a2l_level lo;
+	/* Schmitt-trigger state, NULL for a fixed threshold. */
+	uint8_t *state;
+};
+
+static int a2l_src_init(struct a2l_src *src,
+		const struct sr_datafeed_analog *analog)
+{
+	const struct sr_analog_encoding *enc;
+
+	if (!analog || !analog->data || !analog->encoding)
+		return SR_ERR_ARG;
+
+	enc = analog->encoding;
+	if ((enc->is_float && enc->unitsize != sizeof(float))
+			|| (!enc->is_float && enc->unitsize != 1
+				&& enc->unitsize != 2 && enc->unitsize != 4)) {
+		sr_err("Unsupported unit size '%d' for analog-to-logic"
+		       " conversion.", enc->unitsize);
+		return SR_ERR;
+	}
+
+	src->data = analog->data;
+	src->unitsize = enc->unitsize;
+	src->is_signed = enc->is_signed;
+	src->is_float = enc->is_float;
+	src->is_bigendian = enc->is_bigendian;
+	src->scale = enc->scale.p / (float)enc->scale.q;
+	src->offset = enc->offset.p / (float)enc->offset.q;
+
+	return SR_OK;
+}
+
+static gboolean a2l_cmp(float value, float thr, enum a2l_op op)
+{
+	switch (op) {
+	case A2L_GE:
+		return value >= thr;
+	case A2L_GT:
+		return value > thr;
+	default:
+		return value < thr;
+	}
+}
+
+static int64_t a2l_raw(const struct a2l_src *src, const uint8_t *p)
+{
+	switch (src->unitsize) {
+	case 1:
+		return src->is_signed ? (int8_t)p[0] : p[0];
+	case 2:
+		if (src->is_signed)
+			return src->is_bigendian ? RB16S(p) : RL16S(p);
+		return src->is_bigendian ? RB16(p) : RL16(p);
+	default:
+		if (src->is_signed)
+			return src->is_bigendian ? RB32S(p) : RL32S(p);
+		return src->is_bigendian ? RB32(p) : RL32(p);
+	}
+}
+
+/* Same arithmetics as sr_analog_to_float(), for identical results. */
+static float a2l_value(const struct a2l_src *src, const uint8_t *p)
+{
+	return src->scale * (src->is_bigendian ? RBFL(p) : RLFL(p))
+		+ src->offset;
+}
+
+static void a2l_level_init(struct a2l_level *lvl, const struct a2l_src *src,
+		float thr, enum a2l_op op)
+{
+	int64_t tmin, tmax, lo, hi, mid;
+	gboolean first;
+	int bits;
+
+	memset(lvl, 0, sizeof(*lvl));
+	lvl->op = op;
+	lvl->thr = thr;
+	if (src->is_float)
+		return;
+
+	bits = 8 * src->unitsize;
+	tmin = src->is_signed ? -((int64_t)1 << (bits - 1)) : 0;
+	tmax = src->is_signed ? ((int64_t)1 << (bits - 1)) - 1
+		: ((int64_t)1 << bits) - 1;
+
+	/*
+	 * The comparison result is monotonic in the raw value. Search for
+	 * the first raw value where it differs from the one at tmin.
+	 */
+	first = a2l_cmp(src->scale * (float)tmin + src->offset, thr, op);
+	if (first == a2l_cmp(src->scale * (float)tmax + src->offset, thr, op)) {
+		lvl->lim = tmax;
+		lvl->invert = first;
+		lvl->fixed = TRUE;
+		return;
+	}
+	lo = tmin;
+	hi = tmax;
+	while (hi - lo > 1) {
+		mid = lo + (hi - lo) / 2;
+		if (a2l_cmp(src->scale * (float)mid + src->offset, thr, op) == first)
+			lo = mid;
+		else
+			hi = mid;
+	}
+	lvl->lim = lo;
+	lvl->invert = first;
+}
+
+static gboolean a2l_bit(const struct a2l_src *src,
+		const struct a2l_level *lvl, const uint8_t *p)
+{
+	if (src->is_float)
+		return a2l_cmp(a2l_value(src, p), lvl->thr, lvl->op);
+
+	return (a2l_raw(src, p) > lvl->lim) != lvl->invert;
+}
+
+#ifdef SR_SIMD_X86
+
+static inline SR_SIMD_TARGET_SSE2 __m128i sse2_bswap32(__m128i v)
+{
+	__m128i outer, inner;
+
+	outer = _mm_or_si128(_mm_slli_epi32(v, 24), _mm_srli_epi32(v, 24));
+	inner = _mm_or_si128(
+		_mm_and_si128(_mm_slli_epi32(v, 8), _mm_set1_epi32(0x00ff0000)),
+		_mm_and_si128(_mm_srli_epi32(v, 8), _mm_set1_epi32(0x0000ff00)));
+
+	return _mm_or_si128(outer, inner);
+}
+
+static inline SR_SIMD_TARGET_SSE2 __m128i sse2_cmp_ps(__m128 v, __m128 thr,
+		enum a2l_op op)
+{
+	switch (op) {
+	case A2L_GE:
+		return _mm_castps_si128(_mm_cmpge_ps(v, thr));
+	case A2L_GT:
+		return _mm_castps_si128(_mm_cmpgt_ps(v, thr));
+	default:
+		return _mm_castps_si128(_mm_cmplt_ps(v, thr));
+	}
+}
+
+/*
+ * Unsigned values get their sign bit flipped, and are compared against
+ * the likewise flipped limit, as SSE2 only has signed comparisons.
+ * Returns the number of samples that were converted.
+ */
+static SR_SIMD_TARGET_SSE2 size_t a2l_mask_sse2(const struct a2l_src *src,
+		const struct a2l_level *lvl, const uint8_t *in, size_t count,
+		uint64_t *mask)
+{
+	__m128i v[4], c[4], vlim, bias, m;
+	__m128 scale, offset, thr;
+	unsigned int flip, k;
+	int64_t lim;
+	size_t i;
+
+	lim = lvl->lim;
+	if (!src->is_signed)
+		lim -= (int64_t)1 << (8 * src->unitsize - 1);
+	switch (src->unitsize) {
+	case 1:
+		vlim = _mm_set1_epi8(lim);
+		bias = _mm_set1_epi8(src->is_signed ? 0 : 0x80);
+		break;
+	case 2:
+		vlim = _mm_set1_epi16(lim);
+		bias = _mm_set1_epi16(src->is_signed ? 0 : 0x8000);
+		break;
+	default:
+		vlim = _mm_set1_epi32(lim);
+		bias = _mm_set1_epi32(src->is_signed || src->is_float ?
+			0 : 0x80000000);
+		break;
+	}
+	scale = _mm_set1_ps(src->scale);
+	offset = _mm_set1_ps(src->offset);
+	thr = _mm_set1_ps(lvl->thr);
+	flip = lvl->invert ? 0xffff : 0;
+
+	/* Sixteen samples per iteration. */
+	for (i = 0; i + 16 <= count; i += 16) {
+		for (k = 0; k < src->unitsize; k++) {
+			v[k] = _mm_loadu_si128((const __m128i *)
+				&in[src->unitsize * i + 16 * k]);
+			if (src->is_bigendian && src->unitsize == 2)
+				v[k] = _mm_or_si128(_mm_slli_epi16(v[k], 8),
+					_mm_srli_epi16(v[k], 8));
+			else if (src->is_bigendian && src->unitsize == 4)
+				v[k] = sse2_bswap32(v[k]);
+			v[k] = _mm_xor_si128(v[k], bias);
+		}
+		switch (src->unitsize) {
+		case 1:
+			m = _mm_cmpgt_epi8(v[0], vlim);
+			break;
+		case 2:
+			m = _mm_packs_epi16(_mm_cmpgt_epi16(v[0], vlim),
+				_mm_cmpgt_epi16(v[1], vlim));
+			break;
+		default:
+			for (k = 0; k < 4; k++) {
+				if (src->is_float)
+					c[k] = sse2_cmp_ps(_mm_add_ps(_mm_mul_ps(
+						_mm_castsi128_ps(v[k]), scale), offset),
+						thr, lvl->op);
+				else
+					c[k] = _mm_cmpgt_epi32(v[k], vlim);
+			}
+			m = _mm_packs_epi16(_mm_packs_epi32(c[0], c[1]),
+				_mm_packs_epi32(c[2], c[3]));
+			break;
+		}
+		mask[i / 64] |= (uint64_t)(_mm_movemask_epi8(m) ^ flip) << (i % 64);
+	}
+
+	return i;
+}
+
+/* 8bit and 16bit integers only, returns the number of samples converted. */
+static SR_SIMD_TARGET_AVX2 size_t a2l_mask_avx2(const struct a2l_src *src,
+		const struct a2l_level *lvl, const uint8_t *in, size_t count,
+		uint64_t *mask)
+{
+	__m256i v, w, vlim, bias, swap16, m;
+	uint32_t flip;
+	int64_t lim;
+	size_t i;
+
+	if (src->is_float || src->unitsize > 2)
+		return 0;
+
+	lim = lvl->lim;
+	if (!src->is_signed)
+		lim -= (int64_t)1 << (8 * src->unitsize - 1);
+	if (src->unitsize == 1) {
+		vlim = _mm256_set1_epi8(lim);
+		bias = _mm256_set1_epi8(src->is_signed ? 0 : 0x80);
+	} else {
+		vlim = _mm256_set1_epi16(lim);
+		bias = _mm256_set1_epi16(src->is_signed ? 0 : 0x8000);
+	}
+	swap16 = _mm256_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6,
+		9, 8, 11, 10, 13, 12, 15, 14,
+		1, 0, 3, 2, 5, 4, 7, 6,
+		9, 8, 11, 10, 13, 12, 15, 14);
+	flip = lvl->invert ? 0xffffffff : 0;
+
+	/* 32 samples per iteration. */
+	for (i = 0; i + 32 <= count; i += 32) {
+		if (src->unitsize == 1) {
+			v = _mm256_loadu_si256((const __m256i *)&in[i]);
+			m = _mm256_cmpgt_epi8(_mm256_xor_si256(v, bias), vlim);
+		} else {
+			v = _mm256_loadu_si256((const __m256i *)&in[2 * i]);
+			w = _mm256_loadu_si256((const __m256i *)&in[2 * i + 32]);
+			if (src->is_bigendian) {
+				v = _mm256_shuffle_epi8(v, swap16);
+				w = _mm256_shuffle_epi8(w, swap16);
+			}
+			v = _mm256_cmpgt_epi16(_mm256_xor_si256(v, bias), vlim);
+			w = _mm256_cmpgt_epi16(_mm256_xor_si256(w, bias), vlim);
+			/* Packing works per 128bit lane, restore the order. */
+			m = _mm256_permute4x64_epi64(_mm256_packs_epi16(v, w),
+				_MM_SHUFFLE(3, 1, 2, 0));
+		}
+		mask[i / 64] |= (uint64_t)((uint32_t)_mm256_movemask_epi8(m)
+			^ flip) << (i % 64);
+	}
+
+	return i;
+}
+
+#endif
+
+#ifdef SR_SIMD_ARM_NEON
+
+/* One bit per byte of a comparison result, like SSE2's movemask. */
+static inline uint16_t neon_movemask(uint8x16_t v)
+{
+	static const uint8_t weights[16] = {
+		1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128,
+	};
+	uint8x8_t p;
+
+	v = vandq_u8(v, vld1q_u8(weights));
+	p = vpadd_u8(vget_low_u8(v), vget_high_u8(v));
+	p = vpadd_u8(p, p);
+	p = vpadd_u8(p, p);
+
+	return vget_lane_u8(p, 0) | (vget_lane_u8(p, 1) << 8);
+}
+
+static inline uint32x4_t neon_cmp_f32(float32x4_t v, float32x4_t thr,
+		enum a2l_op op)
+{
+	switch (op) {
+	case A2L_GE:
+		return vcgeq_f32(v, thr);
+	case A2L_GT:
+		return vcgtq_f32(v, thr);
+	default:
+		return vcltq_f32(v, thr);
+	}
+}
+
+static inline uint32x4_t neon_cmp_32(const struct a2l_src *src,
+		uint8x16_t v, int64_t lim, float32x4_t scale, float32x4_t offset,
+		float32x4_t thr, enum a2l_op op)
+{
+	if (src->is_bigendian)
+		v = vrev32q_u8(v);
+	if (src->is_float)
+		return neon_cmp_f32(vaddq_f32(vmulq_f32(
+			vreinterpretq_f32_u8(v), scale), offset), thr, op);
+	if (src->is_signed)
+		return vcgtq_s32(vreinterpretq_s32_u8(v), vdupq_n_s32(lim));
+	return vcgtq_u32(vreinterpretq_u32_u8(v), vdupq_n_u32(lim));
+}
+
+static inline uint16x8_t neon_cmp_16(const struct a2l_src *src,
+		uint8x16_t v, int64_t lim)
+{
+	if (src->is_bigendian)
+		v = vrev16q_u8(v);
+	if (src->is_signed)
+		return vcgtq_s16(vreinterpretq_s16_u8(v), vdupq_n_s16(lim));
+	return vcgtq_u16(vreinterpretq_u16_u8(v), vdupq_n_u16(lim));
+}
+
+/* Returns the number of samples that were converted. */
+static size_t a2l_mask_neon(const struct a2l_src *src,
+		const struct a2l_level *lvl, const uint8_t *in, size_t count,
+		uint64_t *mask)
+{
+	float32x4_t scale, offset, thr;
+	uint16x8_t lo, hi;
+	uint8x16_t m;
+	unsigned int flip;
+	const uint8_t *p;
+	size_t i;
+
+	scale = vdupq_n_f32(src->scale);
+	offset = vdupq_n_f32(src->offset);
+	thr = vdupq_n_f32(lvl->thr);
+	flip = lvl->invert ? 0xffff : 0;
+
+	/* Sixteen samples per iteration. */
+	for (i = 0; i + 16 <= count; i += 16) {
+		p = &in[src->unitsize * i];
+		switch (src->unitsize) {
+		case 1:
+			if (src->is_signed)
+				m = vcgtq_s8(vreinterpretq_s8_u8(vld1q_u8(p)),
+					vdupq_n_s8(lvl->lim));
+			else
+				m = vcgtq_u8(vld1q_u8(p), vdupq_n_u8(lvl->lim));
+			break;
+		case 2:
+			m = vcombine_u8(
+				vmovn_u16(neon_cmp_16(src, vld1q_u8(p), lvl->lim)),
+				vmovn_u16(neon_cmp_16(src, vld1q_u8(p + 16), lvl->lim)));
+			break;
+		default:
+			lo = vcombine_u16(
+				vmovn_u32(neon_cmp_32(src, vld1q_u8(p), lvl->lim,
+					scale, offset, thr, lvl->op)),
+				vmovn_u32(neon_cmp_32(src, vld1q_u8(p + 16), lvl->lim,
+					scale, offset, thr, lvl->op)));
+			hi = vcombine_u16(
+				vmovn_u32(neon_cmp_32(src, vld1q_u8(p + 32), lvl->lim,
+					scale, offset, thr, lvl->op)),
+				vmovn_u32(neon_cmp_32(src, vld1q_u8(p + 48), lvl->lim,
+					scale, offset, thr, lvl->op)));
+			m = vcombine_u8(vmovn_u16(lo), vmovn_u16(hi));
+			break;
+		}
+		mask[i / 64] |= (uint64_t)(neon_movemask(m) ^ flip) << (i % 64);
+	}
+
+	return i;
+}
+
+#endif
+
+/* Set the bits of count samples, starting at the given sample. */
+static void a2l_mask(const struct a2l_src *src, const struct a2l_level *lvl,
+		size_t start, size_t count, uint64_t *mask)
+{
+	const uint8_t *in;
+	unsigned int features;
+	size_t i, done;
+
+	memset(mask, lvl->fixed && lvl->invert ? 0xff : 0,
+		(count + 63) / 64 * sizeof(*mask));
+	if (lvl->fixed)
+		return;
+
+	in = src->data + start * src->unitsize;
+	features = sr_simd_features();
+	done = 0;
+#ifdef SR_SIMD_X86
+	if (features & SR_SIMD_AVX2)
+		done = a2l_mask_avx2(src, lvl, in, count, mask);
+	if (!done && (features & SR_SIMD_SSE2))
+		done = a2l_mask_sse2(src, lvl, in, count, mask);
+#endif
+#ifdef SR_SIMD_ARM_NEON
+	if (features & SR_SIMD_NEON)
+		done = a2l_mask_neon(src, lvl, in, count, mask);
+#endif
+	(void)features;
+
+	for (i = done; i < count; i++) {
+		if (a2l_bit(src, lvl, in + i * src->unitsize))
+			mask[i / 64] |= (uint64_t)1 << (i % 64);
+	}
+}
+
+/*
+ * Resolve the Schmitt-trigger state. Samples in hi set it, samples in
+ * lo clear it, all others keep the previous sample's state. Per word,
+ * that's a prefix computation which takes six steps.
+ */
+static void a2l_schmitt(uint64_t *hi, const uint64_t *lo, size_t count,
+		uint8_t *state)
+{
+	uint64_t g, p;
+	size_t w, n;
+	unsigned int d;
+
+	for (w = 0; w < (count + 63) / 64; w++) {
+		p = ~lo[w];
+		g = (hi[w] & p) | (*state ? p & 1 : 0);
+		for (d = 1; d < 64; d *= 2) {
+			g |= (g << d) & p;
+			p &= p << d;
+		}
+		hi[w] = g;
+		n = MIN(count - 64 * w, 64);
+		*state = (g >> (n - 1)) & 1;
+	}
+}
+
+/*
+ * Transpose an 8x8 bit matrix: bit c of byte r moves to bit r of
+ * byte c. Turns eight channels' worth of mask bytes into eight logic
+ * samples. See sr_transpose_8x8() for batches and larger matrices.
+ */
+static uint64_t transpose8(uint64_t x)
+{
+	uint64_t t;
+
+	t = (x ^ (x >> 7)) & 0x00aa00aa00aa00aaULL;
+	x ^= t ^ (t << 7);
+	t = (x ^ (x >> 14)) & 0x0000cccc0000ccccULL;
+	x ^= t ^ (t << 14);
+	t = (x ^ (x >> 28)) & 0x00000000f0f0f0f0ULL;
+	x ^= t ^ (t << 28);
+
+	return x;
+}
+
+static int a2l_channel_init(struct a2l_channel *ch,
+		const struct sr_datafeed_analog *analog,
+		float lo_thr, float hi_thr, uint8_t *state)
+{
+	int ret;
+
+	if ((ret = a2l_src_init(&ch->src, analog)) != SR_OK)
+		return ret;
+
+	ch->state = state;
+	if (state) {
+		a2l_level_init(&ch->hi, &ch->src, hi_thr, A2L_GT);
+		a2l_level_init(&ch->lo, &ch->src, lo_thr, A2L_LT);
+	} else {
+		a2l_level_init(&ch->hi, &ch->src, hi_thr, A2L_GE);
+	}
+
+	return SR_OK;
+}
+
+/* Convert up to A2L_BLOCK samples. */
+static void a2l_channel_convert(struct a2l_channel *ch, size_t start,
+		size_t count, uint64_t *mask)
+{
+	uint64_t lo[A2L_BLOCK / 64];
+
+	a2l_mask(&ch->src, &ch->hi, start, count, mask);
+	if (!ch->state)
+		return;
+
+	a2l_mask(&ch->src, &ch->lo, start, count, lo);
+	a2l_schmitt(mask, lo, count, ch->state);
+}
+
+/* Write eight samples (or less at the end) which are packed into x. */
+static void a2l_write8(uint8_t *out, size_t stride, uint64_t x, size_t n)
+{
+	size_t i;
+
+	if (stride == 1 && n >= 8) {
+		WL32(out, x);
+		WL32(out + 4, x >> 32);
+		return;
+	}
+	for (i = 0; i < MIN(n, 8); i++)
+		out[i * stride] = x >> (8 * i);
+}
+
+/* One byte per sample, either 0 or 1. */
+static void a2l_bytes(struct a2l_channel *ch, uint8_t *output, uint64_t count)
+{
+	uint64_t mask[A2L_BLOCK / 64], x;
+	size_t start, n, k;
+
+	for (start = 0; start < count; start += n) {
+		n = MIN(count - start, A2L_BLOCK);
+		a2l_channel_convert(ch, start, n, mask);
+		for (k = 0; k < n; k += 8) {
+			x = transpose8((mask[k / 64] >> (k % 64)) & 0xff);
+			a2l_write8(output + start + k, 1, x, n - k);
+		}
+	}
+}
+
+/* Channel i ends up in bit i of the logic samples. */
+static int a2l_logic(const struct sr_datafeed_analog **analog,
+		const float *lo_thr, const float *hi_thr, uint8_t *states,
+		unsigned int num_channels, struct sr_datafeed_logic *logic)
+{
+	struct a2l_channel ch[8];
+	uint64_t mask[8][A2L_BLOCK / 64], x, count;
+	unsigned int c, lane, lanes, group;
+	size_t unitsize, start, n, k;
+	uint8_t *out;
+	int ret;
+
+	if (!analog || !hi_thr || !logic || !logic->data || !num_channels
+			|| logic->unitsize * 8 < num_channels)
+		return SR_ERR_ARG;
+
+	count = analog[0] ? analog[0]->num_samples : 0;
+	for (c = 0; c < num_channels; c++) {
+		ret = a2l_channel_init(&ch[0], analog[c],
+			lo_thr ? lo_thr[c] : 0, hi_thr[c],
+			states ? &states[c] : NULL);
+		if (ret != SR_OK)
+			return ret;
+		if (analog[c]->num_samples != count) {
+			sr_err("Analog channels differ in their number of samples.");
+			return SR_ERR_ARG;
+		}
+	}
+
+	unitsize = logic->unitsize;
+	lanes = (num_channels + 7) / 8;
+	if (lanes < unitsize)
+		memset(logic->data, 0, count * unitsize);
+
+	/* Eight channels at a time, which make up one byte of each sample. */
+	for (lane = 0; lane < lanes; lane++) {
+		group = MIN(num_channels - 8 * lane, 8);
+		for (c = 0; c < group; c++) {
+			a2l_channel_init(&ch[c], analog[8 * lane + c],
+				lo_thr ? lo_thr[8 * lane + c] : 0,
+				hi_thr[8 * lane + c],
+				states ? &states[8 * lane + c] : NULL);
+		}
+		for (start = 0; start < count; start += n) {
+			n = MIN(count - start, A2L_BLOCK);
+			for (c = 0; c < group; c++)
+				a2l_channel_convert(&ch[c], start, n, mask[c]);
+			for (k = 0; k < n; k += 8) {
+				x = 0;
+				for (c = 0; c < group; c++)
+					x |= ((mask[c][k / 64] >> (k % 64)) & 0xff) << (8 * c);
+				out = (uint8_t *)logic->data + (start + k) * unitsize + lane;
+				a2l_write8(out, unitsize, transpose8(x), n - k);
+			}
+		}
+	}
+	logic->length = count * unitsize;
+
+	return SR_OK;
+}
+
 /**
  * Convert analog values to logic values by using a fixed threshold.
  *
+ * Integer encodings get compared in their raw form, against a limit
+ * which is derived from the threshold. Results are the same as for
+ * thresholding the output of sr_analog_to_float().
+ *
  * @param[in] analog The analog input values.
  * @param[in] threshold The threshold to use.
  * @param[out] output The converted output values; either 0 or 1. Must provide
  *                    space for count bytes.
  * @param[in] count The number of samples to process.
  *
- * @return SR_OK on success or SR_ERR on failure.
+ * @retval SR_OK Success.
+ * @retval SR_ERR Unsupported encoding.
+ * @retval SR_ERR_ARG Invalid argument.
  */
 SR_API int sr_a2l_threshold(const struct sr_datafeed_analog *analog,
 		float threshold, uint8_t *output, uint64_t count)
 {
-	float *input;
-
-	if (!analog->encoding->is_float) {
-		input = g_try_malloc(sizeof(float) * count);
-		if (!input)
-			return SR_ERR;
+	struct a2l_channel ch;
+	int ret;
 
-		sr_analog_to_float(analog, input);
-	} else
-		input = analog->data;
+	if (!output)
+		return SR_ERR_ARG;
+	if ((ret = a2l_channel_init(&ch, analog, 0, threshold, NULL)) != SR_OK)
+		return ret;
 
-	for (uint64_t i = 0; i < count; i++)
-		output[i] = (input[i] >= threshold) ? 1 : 0;
-
-	if (!analog->encoding->is_float)
-		g_free(input);
+	a2l_bytes(&ch, output, count);
 
 	return SR_OK;
 }
@@ -76,34 +716,781 @@ SR_API int sr_a2l_threshold(const struct sr_datafeed_analog *analog,
  *        space for count bytes.
  * @param count The number of samples to process.
  *
- * @return SR_OK on success or SR_ERR on failure.
+ * @retval SR_OK Success.
+ * @retval SR_ERR Unsupported encoding.
+ * @retval SR_ERR_ARG Invalid argument.
  */
 SR_API int sr_a2l_schmitt_trigger(const struct sr_datafeed_analog *analog,
 		float lo_thr, float hi_thr, uint8_t *state, uint8_t *output,
 		uint64_t count)
 {
-	float *input;
+	struct a2l_channel ch;
+	int ret;
+
+	if (!state || !output)
+		return SR_ERR_ARG;
+	ret = a2l_channel_init(&ch, analog, lo_thr, hi_thr, state);
+	if (ret != SR_OK)
+		return ret;
+
+	a2l_bytes(&ch, output, count);
+
+	return SR_OK;
+}
+
+/**
+ * Convert several analog channels to the bits of a logic payload, by
+ * using a fixed threshold per channel.
+ *
+ * The analog packets must hold the same number of samples. Channel i
+ * ends up in bit i of each logic sample, bits beyond num_channels are
+ * cleared. No memory gets allocated, which suits continuous conversion.
+ *
+ * @param[in] analog Array of num_channels analog packets.
+ * @param[in] thresholds Array of num_channels thresholds.
+ * @param[in] num_channels The number of channels to convert.
+ * @param[in,out] logic The logic payload to fill in. The caller provides
+ *                the data buffer (space for num_samples * unitsize
+ *                bytes) and sets unitsize. The length gets set here.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR Unsupported encoding.
+ * @retval SR_ERR_ARG Invalid argument.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_a2l_threshold_logic(const struct sr_datafeed_analog **analog,
+		const float *thresholds, unsigned int num_channels,
+		struct sr_datafeed_logic *logic)
+{
+	return a2l_logic(analog, NULL, thresholds, NULL, num_channels, logic);
+}
+
+/**
+ * Convert several analog channels to the bits of a logic payload, by
+ * using a Schmitt-trigger per channel.
+ *
+ * See sr_a2l_threshold_logic() for the layout, and
+ * sr_a2l_schmitt_trigger() for the thresholds and state.
+ *
+ * @param[in] analog Array of num_channels analog packets.
+ * @param[in] lo_thr Array of num_channels low thresholds.
+ * @param[in] hi_thr Array of num_channels high thresholds.
+ * @param[in,out] states Array of num_channels converter states.
+ * @param[in] num_channels The number of channels to convert.
+ * @param[in,out] logic The logic payload to fill in.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR Unsupported encoding.
+ * @retval SR_ERR_ARG Invalid argument.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_a2l_schmitt_trigger_logic(const struct sr_datafeed_analog **analog,
+		const float *lo_thr, const float *hi_thr, uint8_t *states,
+		unsigned int num_channels, struct sr_datafeed_logic *logic)
+{
+	if (!lo_thr || !states)
+		return SR_ERR_ARG;
+
+	return a2l_logic(analog, lo_thr, hi_thr, states, num_channels, logic);
+}
+
+#ifdef SR_SIMD_X86
+
+/* One byte of logic and analog each, 16 samples per iteration. */
+static SR_SIMD_TARGET_SSE2 size_t split_1_1_sse2(const uint8_t *data,
+		size_t num_samples, uint8_t *logic, uint8_t *analog)
+{
+	__m128i a, b, low;
+	size_t i;
+
+	low = _mm_set1_epi16(0x00ff);
+	for (i = 0; i + 16 <= num_samples; i += 16) {
+		a = _mm_loadu_si128((const __m128i *)&data[2 * i]);
+		b = _mm_loadu_si128((const __m128i *)&data[2 * i + 16]);
+		_mm_storeu_si128((__m128i *)&logic[i], _mm_packus_epi16(
+			_mm_and_si128(a, low), _mm_and_si128(b, low)));
+		_mm_storeu_si128((__m128i *)&analog[i], _mm_packus_epi16(
+			_mm_srli_epi16(a, 8), _mm_srli_epi16(b, 8)));
+	}
+
+	return i;
+}
+
+static SR_SIMD_TARGET_AVX2 size_t split_1_1_avx2(const uint8_t *data,
+		size_t num_samples, uint8_t *logic, uint8_t *analog)
+{
+	__m256i a, b, low;
+	size_t i;
+
+	low = _mm256_set1_epi16(0x00ff);
+	for (i = 0; i + 32 <= num_samples; i += 32) {
+		a = _mm256_loadu_si256((const __m256i *)&data[2 * i]);
+		b = _mm256_loadu_si256((const __m256i *)&data[2 * i + 32]);
+		/* Packing works per 128bit lane, restore the order. */
+		_mm256_storeu_si256((__m256i *)&logic[i], _mm256_permute4x64_epi64(
+			_mm256_packus_epi16(_mm256_and_si256(a, low),
+				_mm256_and_si256(b, low)), _MM_SHUFFLE(3, 1, 2, 0)));
+		_mm256_storeu_si256((__m256i *)&analog[i], _mm256_permute4x64_epi64(
+			_mm256_packus_epi16(_mm256_srli_epi16(a, 8),
+				_mm256_srli_epi16(b, 8)), _MM_SHUFFLE(3, 1, 2, 0)));
+	}
+
+	return i;
+}
+
+#endif
+
+#ifdef SR_SIMD_ARM_NEON
+
+static size_t split_1_1_neon(const uint8_t *data, size_t num_samples,
+		uint8_t *logic, uint8_t *analog)
+{
+	uint8x16x2_t v;
+	size_t i;
+
+	for (i = 0; i + 16 <= num_samples; i += 16) {
+		v = vld2q_u8(&data[2 * i]);
+		vst1q_u8(&logic[i], v.val[0]);
+		vst1q_u8(&analog[i], v.val[1]);
+	}
+
+	return i;
+}
+
+#endif
+
+/**
+ * Split a stream of interleaved logic and analog samples.
+ *
+ * Mixed-signal devices often send both in a single USB stream, where each
+ * sample holds logic_size bytes of logic data followed by analog_size
+ * bytes of the analog channel's raw value. This copies both parts into
+ * separate buffers, ready to be sent as a logic packet and a raw-encoded
+ * analog packet. The common case of one byte each is vectorized.
+ *
+ * @param[in] data The interleaved samples.
+ * @param[in] num_samples The number of samples.
+ * @param[in] logic_size The number of logic bytes per sample.
+ * @param[in] analog_size The number of analog bytes per sample.
+ * @param[out] logic Space for num_samples * logic_size bytes.
+ * @param[out] analog Space for num_samples * analog_size bytes.
+ *
+ * @private
+ */
+SR_PRIV void sr_split_logic_analog(const uint8_t *data, size_t num_samples,
+		size_t logic_size, size_t analog_size,
+		uint8_t *logic, uint8_t *analog)
+{
+	unsigned int features;
+	size_t i, b, done, stride;
+
+	done = 0;
+	if (logic_size == 1 && analog_size == 1) {
+		features = sr_simd_features();
+#ifdef SR_SIMD_X86
+		if (features & SR_SIMD_AVX2)
+			done = split_1_1_avx2(data, num_samples, logic, analog);
+		else if (features & SR_SIMD_SSE2)
+			done = split_1_1_sse2(data, num_samples, logic, analog);
+#endif
+#ifdef SR_SIMD_ARM_NEON
+		if (features & SR_SIMD_NEON)
+			done = split_1_1_neon(data, num_samples, logic, analog);
+#endif
+		(void)features;
+	}
 
-	if (!analog->encoding->is_float) {
-		input = g_try_malloc(sizeof(float) * count);
-		if (!input)
-			return SR_ERR;
+	stride = logic_size + analog_size;
+	for (i = done; i < num_samples; i++) {
+		for (b = 0; b < logic_size; b++)
+			logic[i * logic_size + b] = data[i * stride + b];
+		for (b = 0; b < analog_size; b++)
+			analog[i * analog_size + b] = data[i * stride + logic_size + b];
+	}
+}
 
-		sr_analog_to_float(analog, input);
-	} else
-		input = analog->data;
+/*
+ * Bit matrix transposes. Row r of an NxN matrix is the r-th N-bit word,
+ * and its bit c moves to bit r of word c. Each step, for d from N / 2
+ * down to 1, swaps the upper d bits of every 2d-bit group in row k with
+ * the lower d bits in row k + d (for all k with k & d == 0).
+ *
+ * Vector code holds several rows per register. Rows k and k + d then
+ * either live in different registers, or a shuffle pairs them up. The
+ * shifts work on 64bit lanes whatever N is, the masks drop any bits
+ * which cross a row boundary.
+ */
 
-	for (uint64_t i = 0; i < count; i++) {
-		if (input[i] < lo_thr)
-			*state = 0;
-		else if (input[i] > hi_thr)
-			*state = 1;
+static void transpose_rows(uint64_t *a, unsigned int n)
+{
+	uint64_t m, t;
+	unsigned int d, k;
 
-		output[i] = *state;
+	m = (n == 64) ? UINT32_MAX : (1ULL << (n / 2)) - 1;
+	for (d = n / 2; d; d >>= 1, m ^= m << d) {
+		for (k = 0; k < n; k = (k + d + 1) & ~d) {
+			t = ((a[k] >> d) ^ a[k + d]) & m;
+			a[k] ^= t << d;
+			a[k + d] ^= t;
+		}
 	}
+}
 
-	if (!analog->encoding->is_float)
-		g_free(input);
+/*
+ * The mask for step d, for size bytes worth of n-bit rows: bits c with
+ * c & d == 0. With low_rows, only in rows k with k & d == 0, for steps
+ * where both rows are in the same register.
+ */
+static void transpose_mask(uint8_t *mask, size_t size, unsigned int n,
+		unsigned int d, gboolean low_rows)
+{
+	unsigned int i, b;
+
+	for (i = 0; i < size; i++) {
+		mask[i] = 0;
+		if (low_rows && ((8 * i / n) & d))
+			continue;
+		for (b = 0; b < 8; b++) {
+			if (!(((8 * i + b) % n) & d))
+				mask[i] |= 1 << b;
+		}
+	}
+}
+
+#ifdef SR_SIMD_X86
+
+static SR_SIMD_TARGET_SSE2 size_t transpose8_sse2(const uint8_t *in,
+		uint8_t *out, size_t count)
+{
+	__m128i v, t, m7, m14, m28;
+	size_t i;
+
+	m7 = _mm_set1_epi64x(0x00aa00aa00aa00aaULL);
+	m14 = _mm_set1_epi64x(0x0000cccc0000ccccULL);
+	m28 = _mm_set1_epi64x(0x00000000f0f0f0f0ULL);
+	for (i = 0; i + 2 <= count; i += 2) {
+		v = _mm_loadu_si128((const __m128i *)&in[8 * i]);
+		t = _mm_and_si128(_mm_xor_si128(v, _mm_srli_epi64(v, 7)), m7);
+		v = _mm_xor_si128(v, _mm_xor_si128(t, _mm_slli_epi64(t, 7)));
+		t = _mm_and_si128(_mm_xor_si128(v, _mm_srli_epi64(v, 14)), m14);
+		v = _mm_xor_si128(v, _mm_xor_si128(t, _mm_slli_epi64(t, 14)));
+		t = _mm_and_si128(_mm_xor_si128(v, _mm_srli_epi64(v, 28)), m28);
+		v = _mm_xor_si128(v, _mm_xor_si128(t, _mm_slli_epi64(t, 28)));
+		_mm_storeu_si128((__m128i *)&out[8 * i], v);
+	}
+
+	return i;
+}
+
+static SR_SIMD_TARGET_AVX2 size_t transpose8_avx2(const uint8_t *in,
+		uint8_t *out, size_t count)
+{
+	__m256i v, t, m7, m14, m28;
+	size_t i;
+
+	m7 = _mm256_set1_epi64x(0x00aa00aa00aa00aaULL);
+	m14 = _mm256_set1_epi64x(0x0000cccc0000ccccULL);
+	m28 = _mm256_set1_epi64x(0x00000000f0f0f0f0ULL);
+	for (i = 0; i + 4 <= count; i += 4) {
+		v = _mm256_loadu_si256((const __m256i *)&in[8 * i]);
+		t = _mm256_and_si256(_mm256_xor_si256(v, _mm256_srli_epi64(v, 7)), m7);
+		v = _mm256_xor_si256(v, _mm256_xor_si256(t, _mm256_slli_epi64(t, 7)));
+		t = _mm256_and_si256(_mm256_xor_si256(v, _mm256_srli_epi64(v, 14)), m14);
+		v = _mm256_xor_si256(v, _mm256_xor_si256(t, _mm256_slli_epi64(t, 14)));
+		t = _mm256_and_si256(_mm256_xor_si256(v, _mm256_srli_epi64(v, 28)), m28);
+		v = _mm256_xor_si256(v, _mm256_xor_si256(t, _mm256_slli_epi64(t, 28)));
+		_mm256_storeu_si256((__m256i *)&out[8 * i], v);
+	}
+
+	return i;
+}
+
+/* Pair up the rows which are the given number of bits apart. */
+static inline __attribute__((always_inline)) SR_SIMD_TARGET_SSE2
+__m128i transpose_swap_sse2(__m128i v, unsigned int bits)
+{
+	if (bits == 64)
+		return _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2));
+	if (bits == 32)
+		return _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1));
+
+	return _mm_shufflehi_epi16(_mm_shufflelo_epi16(v,
+		_MM_SHUFFLE(2, 3, 0, 1)), _MM_SHUFFLE(2, 3, 0, 1));
+}
+
+/*
+ * Inlined into instances for each N, so that the compiler can unroll the
+ * steps and keep the rows in registers.
+ */
+static inline __attribute__((always_inline)) SR_SIMD_TARGET_SSE2
+void transpose_sse2(const uint8_t *in, uint8_t *out, size_t count,
+		unsigned int n)
+{
+	__m128i v[32], m[6], p, t;
+	uint8_t mask[16];
+	unsigned int rows, vecs, d, s, i, j;
+	size_t k;
+
+	rows = 128 / n;
+	vecs = n * n / 128;
+	for (d = n / 2, s = 0; d; d >>= 1, s++) {
+		transpose_mask(mask, sizeof(mask), n, d, d < rows);
+		m[s] = _mm_loadu_si128((const __m128i *)mask);
+	}
+
+	for (k = 0; k < count; k++) {
+		for (i = 0; i < vecs; i++)
+			v[i] = _mm_loadu_si128((const __m128i *)&in[16 * (k * vecs + i)]);
+		for (d = n / 2, s = 0; d; d >>= 1, s++) {
+			if (d >= rows) {
+				j = d / rows;
+				for (i = 0; i < vecs; i = (i + j + 1) & ~j) {
+					t = _mm_and_si128(_mm_xor_si128(
+						_mm_srli_epi64(v[i], d), v[i + j]), m[s]);
+					v[i] = _mm_xor_si128(v[i], _mm_slli_epi64(t, d));
+					v[i + j] = _mm_xor_si128(v[i + j], t);
+				}
+				continue;
+			}
+			for (i = 0; i < vecs; i++) {
+				p = transpose_swap_sse2(v[i], d * n);
+				t = _mm_and_si128(_mm_xor_si128(
+					_mm_srli_epi64(v[i], d), p), m[s]);
+				v[i] = _mm_xor_si128(v[i], _mm_xor_si128(
+					_mm_slli_epi64(t, d),
+					transpose_swap_sse2(t, d * n)));
+			}
+		}
+		for (i = 0; i < vecs; i++)
+			_mm_storeu_si128((__m128i *)&out[16 * (k * vecs + i)], v[i]);
+	}
+}
+
+static inline __attribute__((always_inline)) SR_SIMD_TARGET_AVX2
+__m256i transpose_swap_avx2(__m256i v, unsigned int bits)
+{
+	if (bits == 128)
+		return _mm256_permute4x64_epi64(v, _MM_SHUFFLE(1, 0, 3, 2));
+	if (bits == 64)
+		return _mm256_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2));
+	if (bits == 32)
+		return _mm256_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1));
+
+	return _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(v,
+		_MM_SHUFFLE(2, 3, 0, 1)), _MM_SHUFFLE(2, 3, 0, 1));
+}
+
+static inline __attribute__((always_inline)) SR_SIMD_TARGET_AVX2
+void transpose_avx2(const uint8_t *in, uint8_t *out, size_t count,
+		unsigned int n)
+{
+	__m256i v[16], m[6], p, t;
+	uint8_t mask[32];
+	unsigned int rows, vecs, d, s, i, j;
+	size_t k;
+
+	rows = 256 / n;
+	vecs = n * n / 256;
+	for (d = n / 2, s = 0; d; d >>= 1, s++) {
+		transpose_mask(mask, sizeof(mask), n, d, d < rows);
+		m[s] = _mm256_loadu_si256((const __m256i *)mask);
+	}
+
+	for (k = 0; k < count; k++) {
+		for (i = 0; i < vecs; i++)
+			v[i] = _mm256_loadu_si256((const __m256i *)&in[32 * (k * vecs + i)]);
+		for (d = n / 2, s = 0; d; d >>= 1, s++) {
+			if (d >= rows) {
+				j = d / rows;
+				for (i = 0; i < vecs; i = (i + j + 1) & ~j) {
+					t = _mm256_and_si256(_mm256_xor_si256(
+						_mm256_srli_epi64(v[i], d), v[i + j]), m[s]);
+					v[i] = _mm256_xor_si256(v[i], _mm256_slli_epi64(t, d));
+					v[i + j] = _mm256_xor_si256(v[i + j], t);
+				}
+				continue;
+			}
+			for (i = 0; i < vecs; i++) {
+				p = transpose_swap_avx2(v[i], d * n);
+				t = _mm256_and_si256(_mm256_xor_si256(
+					_mm256_srli_epi64(v[i], d), p), m[s]);
+				v[i] = _mm256_xor_si256(v[i], _mm256_xor_si256(
+					_mm256_slli_epi64(t, d),
+					transpose_swap_avx2(t, d * n)));
+			}
+		}
+		for (i = 0; i < vecs; i++)
+			_mm256_storeu_si256((__m256i *)&out[32 * (k * vecs + i)], v[i]);
+	}
+}
+
+
+static SR_SIMD_TARGET_SSE2 void transpose16_sse2(const uint8_t *in,
+		uint8_t *out, size_t count)
+{
+	transpose_sse2(in, out, count, 16);
+}
+
+static SR_SIMD_TARGET_SSE2 void transpose32_sse2(const uint8_t *in,
+		uint8_t *out, size_t count)
+{
+	transpose_sse2(in, out, count, 32);
+}
+
+static SR_SIMD_TARGET_SSE2 void transpose64_sse2(const uint8_t *in,
+		uint8_t *out, size_t count)
+{
+	transpose_sse2(in, out, count, 64);
+}
+
+static SR_SIMD_TARGET_AVX2 void transpose16_avx2(const uint8_t *in,
+		uint8_t *out, size_t count)
+{
+	transpose_avx2(in, out, count, 16);
+}
+
+static SR_SIMD_TARGET_AVX2 void transpose32_avx2(const uint8_t *in,
+		uint8_t *out, size_t count)
+{
+	transpose_avx2(in, out, count, 32);
+}
+
+static SR_SIMD_TARGET_AVX2 void transpose64_avx2(const uint8_t *in,
+		uint8_t *out, size_t count)
+{
+	transpose_avx2(in, out, count, 64);
+}
+
+#endif
+
+#ifdef SR_SIMD_ARM_NEON
+
+static size_t transpose8_neon(const uint8_t *in, uint8_t *out, size_t count)
+{
+	uint64x2_t v, t;
+	size_t i;
+
+	for (i = 0; i + 2 <= count; i += 2) {
+		v = vreinterpretq_u64_u8(vld1q_u8(&in[8 * i]));
+		t = vandq_u64(veorq_u64(v, vshrq_n_u64(v, 7)),
+			vdupq_n_u64(0x00aa00aa00aa00aaULL));
+		v = veorq_u64(v, veorq_u64(t, vshlq_n_u64(t, 7)));
+		t = vandq_u64(veorq_u64(v, vshrq_n_u64(v, 14)),
+			vdupq_n_u64(0x0000cccc0000ccccULL));
+		v = veorq_u64(v, veorq_u64(t, vshlq_n_u64(t, 14)));
+		t = vandq_u64(veorq_u64(v, vshrq_n_u64(v, 28)),
+			vdupq_n_u64(0x00000000f0f0f0f0ULL));
+		v = veorq_u64(v, veorq_u64(t, vshlq_n_u64(t, 28)));
+		vst1q_u8(&out[8 * i], vreinterpretq_u8_u64(v));
+	}
+
+	return i;
+}
+
+static inline uint64x2_t transpose_swap_neon(uint64x2_t v, unsigned int bits)
+{
+	if (bits == 64)
+		return vextq_u64(v, v, 1);
+	if (bits == 32)
+		return vreinterpretq_u64_u32(vrev64q_u32(vreinterpretq_u32_u64(v)));
+
+	return vreinterpretq_u64_u16(vrev32q_u16(vreinterpretq_u16_u64(v)));
+}
+
+static void transpose_neon(const uint8_t *in, uint8_t *out, size_t count,
+		unsigned int n)
+{
+	uint64x2_t v[32], m[6], p, t;
+	int64x2_t shl, shr;
+	uint8_t mask[16];
+	unsigned int rows, vecs, d, s, i, j;
+	size_t k;
+
+	rows = 128 / n;
+	vecs = n * n / 128;
+	for (d = n / 2, s = 0; d; d >>= 1, s++) {
+		transpose_mask(mask, sizeof(mask), n, d, d < rows);
+		m[s] = vreinterpretq_u64_u8(vld1q_u8(mask));
+	}
+
+	for (k = 0; k < count; k++) {
+		for (i = 0; i < vecs; i++)
+			v[i] = vreinterpretq_u64_u8(vld1q_u8(&in[16 * (k * vecs + i)]));
+		for (d = n / 2, s = 0; d; d >>= 1, s++) {
+			shl = vdupq_n_s64(d);
+			shr = vdupq_n_s64(-(int64_t)d);
+			if (d >= rows) {
+				j = d / rows;
+				for (i = 0; i < vecs; i = (i + j + 1) & ~j) {
+					t = vandq_u64(veorq_u64(vshlq_u64(v[i], shr),
+						v[i + j]), m[s]);
+					v[i] = veorq_u64(v[i], vshlq_u64(t, shl));
+					v[i + j] = veorq_u64(v[i + j], t);
+				}
+				continue;
+			}
+			for (i = 0; i < vecs; i++) {
+				p = transpose_swap_neon(v[i], d * n);
+				t = vandq_u64(veorq_u64(vshlq_u64(v[i], shr), p), m[s]);
+				v[i] = veorq_u64(v[i], veorq_u64(vshlq_u64(t, shl),
+					transpose_swap_neon(t, d * n)));
+			}
+		}
+		for (i = 0; i < vecs; i++)
+			vst1q_u8(&out[16 * (k * vecs + i)], vreinterpretq_u8_u64(v[i]));
+	}
+}
+
+#endif
+
+/* Transpose all matrices with vector code, if available. */
+static gboolean transpose_simd(const uint8_t *in, uint8_t *out, size_t count,
+		unsigned int n)
+{
+	unsigned int features;
+
+	features = sr_simd_features();
+#ifdef SR_SIMD_X86
+	if (features & SR_SIMD_AVX2) {
+		if (n == 16)
+			transpose16_avx2(in, out, count);
+		else if (n == 32)
+			transpose32_avx2(in, out, count);
+		else
+			transpose64_avx2(in, out, count);
+		return TRUE;
+	}
+	if (features & SR_SIMD_SSE2) {
+		if (n == 16)
+			transpose16_sse2(in, out, count);
+		else if (n == 32)
+			transpose32_sse2(in, out, count);
+		else
+			transpose64_sse2(in, out, count);
+		return TRUE;
+	}
+#endif
+#ifdef SR_SIMD_ARM_NEON
+	if (features & SR_SIMD_NEON) {
+		transpose_neon(in, out, count, n);
+		return TRUE;
+	}
+#endif
+	(void)features;
+	(void)in;
+	(void)out;
+	(void)count;
+	(void)n;
+
+	return FALSE;
+}
+
+/**
+ * Transpose 8x8 bit matrices.
+ *
+ * Each matrix is eight consecutive bytes, and bit c of byte r moves to
+ * bit r of byte c.
+ *
+ * @param[in] in The matrices.
+ * @param[out] out Space for the transposed matrices. Can be the same as in.
+ * @param[in] count The number of matrices.
+ *
+ * @since 0.6.0
+ */
+SR_API void sr_transpose_8x8(const uint8_t *in, uint8_t *out, size_t count)
+{
+	unsigned int features;
+	uint64_t x;
+	size_t i, done;
+
+	done = 0;
+	features = sr_simd_features();
+#ifdef SR_SIMD_X86
+	if (features & SR_SIMD_AVX2)
+		done = transpose8_avx2(in, out, count);
+	else if (features & SR_SIMD_SSE2)
+		done = transpose8_sse2(in, out, count);
+#endif
+#ifdef SR_SIMD_ARM_NEON
+	if (features & SR_SIMD_NEON)
+		done = transpose8_neon(in, out, count);
+#endif
+	(void)features;
+
+	for (i = done; i < count; i++) {
+		x = transpose8(RL64(&in[8 * i]));
+		WL32(&out[8 * i], x);
+		WL32(&out[8 * i + 4], x >> 32);
+	}
+}
+
+/**
+ * Transpose 16x16 bit matrices.
+ *
+ * Each matrix is 16 consecutive words, and bit c of word r moves to bit
+ * r of word c.
+ *
+ * @param[in] in The matrices.
+ * @param[out] out Space for the transposed matrices. Can be the same as in.
+ * @param[in] count The number of matrices.
+ *
+ * @since 0.6.0
+ */
+SR_API void sr_transpose_16x16(const uint16_t *in, uint16_t *out, size_t count)
+{
+	uint64_t a[16];
+	unsigned int r;
+	size_t i;
+
+	if (transpose_simd((const uint8_t *)in, (uint8_t *)out, count, 16))
+		return;
+
+	for (i = 0; i < count; i++) {
+		for (r = 0; r < 16; r++)
+			a[r] = in[16 * i + r];
+		transpose_rows(a, 16);
+		for (r = 0; r < 16; r++)
+			out[16 * i + r] = a[r];
+	}
+}
+
+/**
+ * Transpose 32x32 bit matrices.
+ *
+ * Each matrix is 32 consecutive words, and bit c of word r moves to bit
+ * r of word c.
+ *
+ * @param[in] in The matrices.
+ * @param[out] out Space for the transposed matrices. Can be the same as in.
+ * @param[in] count The number of matrices.
+ *
+ * @since 0.6.0
+ */
+SR_API void sr_transpose_32x32(const uint32_t *in, uint32_t *out, size_t count)
+{
+	uint64_t a[32];
+	unsigned int r;
+	size_t i;
+
+	if (transpose_simd((const uint8_t *)in, (uint8_t *)out, count, 32))
+		return;
+
+	for (i = 0; i < count; i++) {
+		for (r = 0; r < 32; r++)
+			a[r] = in[32 * i + r];
+		transpose_rows(a, 32);
+		for (r = 0; r < 32; r++)
+			out[32 * i + r] = a[r];
+	}
+}
+
+/**
+ * Transpose 64x64 bit matrices.
+ *
+ * Each matrix is 64 consecutive words, and bit c of word r moves to bit
+ * r of word c.
+ *
+ * @param[in] in The matrices.
+ * @param[out] out Space for the transposed matrices. Can be the same as in.
+ * @param[in] count The number of matrices.
+ *
+ * @since 0.6.0
+ */
+SR_API void sr_transpose_64x64(const uint64_t *in, uint64_t *out, size_t count)
+{
+	uint64_t a[64];
+	size_t i;
+
+	if (transpose_simd((const uint8_t *)in, (uint8_t *)out, count, 64))
+		return;
+
+	for (i = 0; i < count; i++) {
+		memcpy(a, &in[64 * i], sizeof(a));
+		transpose_rows(a, 64);
+		memcpy(&out[64 * i], a, sizeof(a));
+	}
+}
+
+/* The number of 16x16 matrices sr_logic_from_planar() handles at once. */
+#define PLANAR_CHUNK 64
+
+/**
+ * Convert channel-planar logic data to samples.
+ *
+ * Some logic analyzers send blocks which hold one little endian word of
+ * consecutive samples per enabled channel, in the order of the channel
+ * indices. This turns them into 16bit logic samples, where each enabled
+ * channel ends up in the bit of its index, and the others read as low.
+ *
+ * @param[in] planar The blocks of channel words.
+ * @param[in] num_blocks The number of blocks.
+ * @param[in] block_bits The number of bits in each word, i.e. of samples
+ *                       in a block: 16, 32 or 64.
+ * @param[in] msb_first TRUE if the most significant bit of a word is the
+ *                      first sample, FALSE if the least significant one is.
+ * @param[in] channel_mask The enabled channels, each with a word per block.
+ * @param[out] logic Space for num_blocks * block_bits samples with a unit
+ *                   size of 2, little endian.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid arguments.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_logic_from_planar(const uint8_t *planar, size_t num_blocks,
+		unsigned int block_bits, gboolean msb_first, uint16_t channel_mask,
+		uint8_t *logic)
+{
+	uint16_t mat[PLANAR_CHUNK * 16];
+	unsigned int pos[16], num_channels, parts, c, q, i, s;
+	size_t block_size, b, n, k;
+	const uint8_t *word;
+	uint8_t *out;
+
+	if (!planar || !logic || !channel_mask)
+		return SR_ERR_ARG;
+	if (block_bits != 16 && block_bits != 32 && block_bits != 64)
+		return SR_ERR_ARG;
+
+	num_channels = 0;
+	for (c = 0; c < 16; c++) {
+		if (channel_mask & (1 << c))
+			pos[num_channels++] = c;
+	}
+	block_size = num_channels * block_bits / 8;
+
+	/*
+	 * Each 16bit part of the words makes a 16x16 matrix, with a row per
+	 * channel. The rows of disabled channels stay zero.
+	 */
+	parts = block_bits / 16;
+	for (b = 0; b < num_blocks; b += n) {
+		n = MIN(num_blocks - b, PLANAR_CHUNK / parts);
+		if (num_channels < 16)
+			memset(mat, 0, n * parts * 16 * sizeof(mat[0]));
+		for (k = 0; k < n; k++) {
+			word = planar + (b + k) * block_size;
+			for (c = 0; c < num_channels; c++, word += 2 * parts) {
+				for (q = 0; q < parts; q++)
+					mat[16 * (k * parts + q) + pos[c]] = RL16(word + 2 * q);
+			}
+		}
+		sr_transpose_16x16(mat, mat, n * parts);
+		for (k = 0; k < n * parts; k++) {
+			out = logic + 2 * ((b + k / parts) * block_bits);
+			s = 16 * (k % parts);
+			if (msb_first) {
+				s = block_bits - 1 - s;
+				for (i = 0; i < 16; i++)
+					WL16(out + 2 * (s - i), mat[16 * k + i]);
+			} else {
+				for (i = 0; i < 16; i++)
+					WL16(out + 2 * (s + i), mat[16 * k + i]);
+			}
+		}
+	}
 
 	return SR_OK;
 }
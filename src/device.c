@@ -909,4 +909,63 @@ SR_API GSList *sr_dev_inst_channel_groups_get(const struct sr_dev_inst *sdi)
 	return sdi->channel_groups;
 }
 
+/**
+ * Get the USB transfer statistics of a device instance.
+ *
+ * Streaming USB drivers size their bulk transfers according to the data
+ * rate, and add transfers when the host was late to handle completions.
+ * The counters are reset when an acquisition starts, and keep their values
+ * after it stopped.
+ *
+ * @param sdi Device instance to use. Must not be NULL.
+ * @param transfers Pointer to store the number of transfers in use in.
+ *                  May be NULL.
+ * @param in_flight Pointer to store the number of currently submitted
+ *                  transfers in. May be NULL.
+ * @param late Pointer to store the number of late completions in.
+ *             May be NULL.
+ * @param empty Pointer to store the number of transfers which completed
+ *              without data in. May be NULL.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ * @retval SR_ERR_NA Not a USB device, or no USB support.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_dev_inst_usb_stats_get(const struct sr_dev_inst *sdi,
+		unsigned int *transfers, unsigned int *in_flight,
+		uint64_t *late, uint64_t *empty)
+{
+#ifdef HAVE_LIBUSB_1_0
+	const struct sr_usb_dev_inst *usb;
+#endif
+
+	if (!sdi)
+		return SR_ERR_ARG;
+
+#ifdef HAVE_LIBUSB_1_0
+	if (sdi->inst_type != SR_INST_USB || !(usb = sdi->conn))
+		return SR_ERR_NA;
+
+	if (transfers)
+		*transfers = usb->stream.num_transfers;
+	if (in_flight)
+		*in_flight = MAX(g_atomic_int_get(&usb->stream.in_flight), 0);
+	if (late)
+		*late = usb->stream.late_completions;
+	if (empty)
+		*empty = usb->stream.empty_transfers;
+
+	return SR_OK;
+#else
+	(void)transfers;
+	(void)in_flight;
+	(void)late;
+	(void)empty;
+
+	return SR_ERR_NA;
+#endif
+}
+
 /** @} */
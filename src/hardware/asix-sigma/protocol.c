@@ -1140,51 +1140,33 @@ SR_PRIV int sigma_set_samplerate(const struct sr_dev_inst *sdi)
  * samples gets accumulated to reduce the number of send calls. Which
  * also enforces an optional sample count limit for data acquisition.
  *
- * The buffer holds up to CHUNK_SIZE bytes. The unit size is fixed (the
- * driver provides a fixed channel layout regardless of samplerate).
+ * The sample memory holds timestamped changes, the queue keeps them
+ * as runs of equal samples and sends SR_DF_LOGIC_RLE packets. The unit
+ * size is fixed (the driver provides a fixed channel layout regardless
+ * of samplerate).
  */
 
-#define CHUNK_SIZE	(4 * 1024 * 1024)
+#define SUBMIT_MAX_RUNS	(256 * 1024)
 
 struct submit_buffer {
-	size_t unit_size;
-	size_t max_samples, curr_samples;
-	uint8_t *sample_data;
-	uint8_t *write_pointer;
 	struct sr_dev_inst *sdi;
-	struct sr_datafeed_packet packet;
-	struct sr_datafeed_logic logic;
+	struct sr_logic_rle_queue *queue;
 };
 
 static int alloc_submit_buffer(struct sr_dev_inst *sdi)
 {
 	struct dev_context *devc;
 	struct submit_buffer *buffer;
-	size_t size;
 
 	devc = sdi->priv;
 
 	buffer = g_malloc0(sizeof(*buffer));
 	devc->buffer = buffer;
 
-	buffer->unit_size = sizeof(uint16_t);
-	size = CHUNK_SIZE;
-	size /= buffer->unit_size;
-	buffer->max_samples = size;
-	size *= buffer->unit_size;
-	buffer->sample_data = g_try_malloc0(size);
-	if (!buffer->sample_data)
-		return SR_ERR_MALLOC;
-	buffer->write_pointer = buffer->sample_data;
+	buffer->queue = sr_logic_rle_queue_new(sizeof(uint16_t),
+		SUBMIT_MAX_RUNS);
 	sr_sw_limits_init(&devc->limit.submit);
-
 	buffer->sdi = sdi;
-	memset(&buffer->logic, 0, sizeof(buffer->logic));
-	buffer->logic.unitsize = buffer->unit_size;
-	buffer->logic.data = buffer->sample_data;
-	memset(&buffer->packet, 0, sizeof(buffer->packet));
-	buffer->packet.type = SR_DF_LOGIC;
-	buffer->packet.payload = &buffer->logic;
 
 	return SR_OK;
 }
@@ -1232,32 +1214,18 @@ static void free_submit_buffer(struct dev_context *devc)
 		return;
 	devc->buffer = NULL;
 
-	g_free(buffer->sample_data);
+	sr_logic_rle_queue_free(buffer->queue);
 	g_free(buffer);
 }
 
 static int flush_submit_buffer(struct dev_context *devc)
 {
 	struct submit_buffer *buffer;
-	int ret;
 
 	buffer = devc->buffer;
 
-	/* Is queued sample data available? */
-	if (!buffer->curr_samples)
-		return SR_OK;
-
-	/* Submit to the session feed. */
-	buffer->logic.length = buffer->curr_samples * buffer->unit_size;
-	ret = sr_session_send(buffer->sdi, &buffer->packet);
-	if (ret != SR_OK)
-		return ret;
-
-	/* Rewind queue position. */
-	buffer->curr_samples = 0;
-	buffer->write_pointer = buffer->sample_data;
-
-	return SR_OK;
+	/* Submit queued sample data to the session feed, if any. */
+	return sr_logic_rle_queue_send(buffer->queue, buffer->sdi);
 }
 
 static int addto_submit_buffer(struct dev_context *devc,
@@ -1265,6 +1233,7 @@ static int addto_submit_buffer(struct dev_context *devc,
 {
 	struct submit_buffer *buffer;
 	struct sr_sw_limits *limits;
+	uint8_t value[sizeof(uint16_t)];
 	int ret;
 
 	buffer = devc->buffer;
@@ -1273,22 +1242,21 @@ static int addto_submit_buffer(struct dev_context *devc,
 		count = 0;
 
 	/*
-	 * Individually accumulate and check each sample, such that
-	 * accumulation between flushes won't exceed local storage, and
-	 * enforcement of user specified limits is exact.
+	 * Enforcement of user specified limits is exact, only the part
+	 * of the run up to the sample count limit gets queued.
 	 */
-	while (count--) {
-		write_u16le_inc(&buffer->write_pointer, sample);
-		buffer->curr_samples++;
-		if (buffer->curr_samples == buffer->max_samples) {
-			ret = flush_submit_buffer(devc);
-			if (ret != SR_OK)
-				return ret;
-		}
-		sr_sw_limits_update_samples_read(limits, 1);
-		if (!devc->use_triggers && sr_sw_limits_check(limits))
-			break;
+	if (!devc->use_triggers && limits->limit_samples)
+		count = MIN(count, limits->limit_samples - limits->samples_read);
+	if (!count)
+		return SR_OK;
+
+	write_u16le(value, sample);
+	if (sr_logic_rle_queue_add(buffer->queue, value, count)) {
+		ret = flush_submit_buffer(devc);
+		if (ret != SR_OK)
+			return ret;
 	}
+	sr_sw_limits_update_samples_read(limits, count);
 
 	return SR_OK;
 }
@@ -1859,7 +1827,8 @@ static void sigma_decode_dram_cluster(struct dev_context *devc,
 	/*
 	 * If this cluster is not adjacent to the previously received
 	 * cluster, then send the appropriate number of samples with the
-	 * previous values to the sigrok session. This "decodes RLE".
+	 * previous values to the sigrok session. The run is queued as
+	 * such, and not expanded to individual samples.
 	 *
 	 * These samples cannot match the trigger since they just repeat
 	 * the previously submitted data pattern. (This assumption holds
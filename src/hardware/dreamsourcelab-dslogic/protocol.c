@@ -21,6 +21,7 @@
 #include <config.h>
 #include <math.h>
 #include <stdbool.h>
+#include <string.h>
 #include <glib.h>
 #include <glib/gstdio.h>
 #include "protocol.h"
@@ -665,6 +666,7 @@ static void abort_acquisition(struct dev_context *devc)
 	int i;
 
 	devc->acq_aborted = TRUE;
+	devc->acq_running = FALSE;
 
 	for (i = devc->num_transfers - 1; i >= 0; i--) {
 		if (devc->transfers[i])
@@ -675,15 +677,20 @@ static void abort_acquisition(struct dev_context *devc)
 static void finish_acquisition(struct sr_dev_inst *sdi)
 {
 	struct dev_context *devc;
+	struct sr_usb_dev_inst *usb;
 
 	devc = sdi->priv;
+	usb = sdi->conn;
 
 	std_session_send_df_end(sdi);
+	usb_stream_log(&usb->stream);
 
 	usb_source_remove(sdi->session, devc->ctx);
 
+	devc->acq_running = FALSE;
 	devc->num_transfers = 0;
 	g_free(devc->transfers);
+	devc->transfers = NULL;
 	g_free(devc->deinterleave_buffer);
 }
 
@@ -714,9 +721,15 @@ static void free_transfer(struct libusb_transfer *transfer)
 
 static void resubmit_transfer(struct libusb_transfer *transfer)
 {
+	struct sr_dev_inst *sdi;
+	struct sr_usb_dev_inst *usb;
 	int ret;
 
-	if ((ret = libusb_submit_transfer(transfer)) == LIBUSB_SUCCESS)
+	sdi = transfer->user_data;
+	usb = sdi->conn;
+
+	transfer->timeout = usb->stream.timeout;
+	if ((ret = usb_stream_submit(&usb->stream, transfer)) == LIBUSB_SUCCESS)
 		return;
 
 	sr_err("%s: %s", __func__, libusb_error_name(ret));
@@ -727,25 +740,9 @@ static void resubmit_transfer(struct libusb_transfer *transfer)
 static void deinterleave_buffer(const uint8_t *src, size_t length,
 	uint16_t *dst_ptr, size_t channel_count, uint16_t channel_mask)
 {
-	uint16_t sample;
-
-	for (const uint64_t *src_ptr = (uint64_t*)src;
-		src_ptr < (uint64_t*)(src + length);
-		src_ptr += channel_count) {
-		for (int bit = 0; bit != 64; bit++) {
-			const uint64_t *word_ptr = src_ptr;
-			sample = 0;
-			for (unsigned int channel = 0; channel != 16;
-				channel++) {
-				const uint16_t m = channel_mask >> channel;
-				if (!m)
-					break;
-				if ((m & 1) && ((*word_ptr++ >> bit) & UINT64_C(1)))
-					sample |= 1 << channel;
-			}
-			*dst_ptr++ = sample;
-		}
-	}
+	/* Blocks of one 64bit word of samples per enabled channel. */
+	sr_logic_from_planar(src, length / (8 * channel_count), 64, FALSE,
+		channel_mask, (uint8_t *)dst_ptr);
 }
 
 static void send_data(struct sr_dev_inst *sdi,
@@ -765,10 +762,59 @@ static void send_data(struct sr_dev_inst *sdi,
 	sr_session_send(sdi, &packet);
 }
 
+/*
+ * Pass the channel words on as one bit array per enabled channel. That's
+ * a strided copy, the bit order within the words already matches.
+ */
+static void send_planar(struct sr_dev_inst *sdi, const uint8_t *src,
+	size_t length, size_t channel_count, uint16_t channel_mask,
+	size_t sample_count)
+{
+	struct dev_context *const devc = sdi->priv;
+	uint8_t *const planes = (uint8_t *)devc->deinterleave_buffer;
+	const size_t num_blocks = length / (DSLOGIC_ATOMIC_BYTES * channel_count);
+	const size_t stride = num_blocks * DSLOGIC_ATOMIC_BYTES;
+	uint32_t channels[16];
+	unsigned int num_planes = 0;
+
+	for (unsigned int i = 0; i < 16; i++) {
+		if (channel_mask & (1 << i))
+			channels[num_planes++] = i;
+	}
+
+	for (size_t b = 0; b < num_blocks; b++) {
+		for (unsigned int c = 0; c < num_planes; c++) {
+			memcpy(planes + c * stride + b * DSLOGIC_ATOMIC_BYTES,
+				src, DSLOGIC_ATOMIC_BYTES);
+			src += DSLOGIC_ATOMIC_BYTES;
+		}
+	}
+
+	const struct sr_datafeed_logic_planar planar = {
+		.num_samples = sample_count,
+		.unitsize = sizeof(uint16_t),
+		.num_planes = num_planes,
+		.channels = channels,
+		.stride = stride,
+		.data = planes
+	};
+
+	const struct sr_datafeed_packet packet = {
+		.type = SR_DF_LOGIC_PLANAR,
+		.payload = &planar
+	};
+
+	sr_session_send(sdi, &packet);
+}
+
+static int add_transfer(const struct sr_dev_inst *sdi);
+
 static void LIBUSB_CALL receive_transfer(struct libusb_transfer *transfer)
 {
 	struct sr_dev_inst *const sdi = transfer->user_data;
 	struct dev_context *const devc = sdi->priv;
+	struct sr_usb_dev_inst *const usb = sdi->conn;
+	const unsigned int grow = usb_stream_completed(&usb->stream, transfer);
 	const size_t channel_count = enabled_channel_count(sdi);
 	const uint16_t channel_mask = enabled_channel_mask(sdi);
 	const unsigned int cur_sample_count = DSLOGIC_ATOMIC_SAMPLES *
@@ -835,19 +881,19 @@ static void LIBUSB_CALL receive_transfer(struct libusb_transfer *transfer)
 		 * etc. for each of the enabled channels, then looping back to the
 		 * channel.
 		 *
-		 * Because sigrok's internal representation is bit-interleaved channels
-		 * we must recast the data.
-		 *
-		 * Hopefully in future it will be possible to pass the data on as-is.
+		 * That's close to what SR_DF_LOGIC_PLANAR packets hold, so send
+		 * those if some consumer takes them. Otherwise, and for blocks
+		 * which get split at the trigger, we must recast the data into
+		 * bit-interleaved channels.
 		 */
 		if (transfer->actual_length % (DSLOGIC_ATOMIC_BYTES * channel_count) != 0)
 			sr_err("Invalid transfer length!");
-		deinterleave_buffer(transfer->buffer, transfer->actual_length,
-			devc->deinterleave_buffer, channel_count, channel_mask);
 
 		/* Send the incoming transfer to the session bus. */
 		if (devc->trigger_pos > devc->sent_samples
 			&& devc->trigger_pos <= devc->sent_samples + num_samples) {
+			deinterleave_buffer(transfer->buffer, transfer->actual_length,
+				devc->deinterleave_buffer, channel_count, channel_mask);
 			/* DSLogic trigger in this block. Send trigger position. */
 			trigger_offset = devc->trigger_pos - devc->sent_samples;
 			/* Pre-trigger samples. */
@@ -861,7 +907,13 @@ static void LIBUSB_CALL receive_transfer(struct libusb_transfer *transfer)
 			send_data(sdi, devc->deinterleave_buffer
 				+ trigger_offset, num_samples);
 			devc->sent_samples += num_samples;
+		} else if (sr_session_logic_planar_wanted(sdi)) {
+			send_planar(sdi, transfer->buffer, transfer->actual_length,
+				channel_count, channel_mask, num_samples);
+			devc->sent_samples += num_samples;
 		} else {
+			deinterleave_buffer(transfer->buffer, transfer->actual_length,
+				devc->deinterleave_buffer, channel_count, channel_mask);
 			send_data(sdi, devc->deinterleave_buffer, num_samples);
 			devc->sent_samples += num_samples;
 		}
@@ -870,8 +922,16 @@ static void LIBUSB_CALL receive_transfer(struct libusb_transfer *transfer)
 	if (devc->limit_samples && devc->sent_samples >= devc->limit_samples) {
 		abort_acquisition(devc);
 		free_transfer(transfer);
-	} else
-		resubmit_transfer(transfer);
+		return;
+	}
+
+	resubmit_transfer(transfer);
+
+	/* Grow the pool of transfers, after a late completion. */
+	for (unsigned int i = 0; i < grow; i++) {
+		if (!devc->acq_running || add_transfer(sdi) != SR_OK)
+			break;
+	}
 }
 
 static int receive_data(int fd, int revents, void *cb_data)
@@ -890,66 +950,76 @@ static int receive_data(int fd, int revents, void *cb_data)
 	return TRUE;
 }
 
-static size_t to_bytes_per_ms(const struct sr_dev_inst *sdi)
+static uint64_t bytes_per_sec(const struct sr_dev_inst *sdi)
 {
 	const struct dev_context *const devc = sdi->priv;
 	const size_t ch_count = enabled_channel_count(sdi);
 
 	if (devc->continuous_mode)
-		return (devc->cur_samplerate * ch_count) / (1000 * 8);
+		return (devc->cur_samplerate * ch_count) / 8;
 
 
 	/* If we're in buffered mode, the transfer rate is not so important,
 	 * but we expect to get at least 10% of the high-speed USB bandwidth.
 	 */
-	return 35000000 / (1000 * 10);
+	return 35000000 / 10;
 }
 
-static size_t get_buffer_size(const struct sr_dev_inst *sdi)
+/*
+ * Set up and submit another transfer. The transfers array has room for
+ * the maximum number of transfers.
+ */
+static int add_transfer(const struct sr_dev_inst *sdi)
 {
-	/*
-	 * The buffer should be large enough to hold 10ms of data and
-	 * a multiple of the size of a data atom.
-	 */
-	const size_t block_size = enabled_channel_count(sdi) * 512;
-	const size_t s = 10 * to_bytes_per_ms(sdi);
-	if (!block_size)
-		return s;
-	return ((s + block_size - 1) / block_size) * block_size;
-}
+	struct dev_context *devc;
+	struct sr_usb_dev_inst *usb;
+	struct libusb_transfer *transfer;
+	unsigned int i;
+	int ret;
+	unsigned char *buf;
 
-static unsigned int get_number_of_transfers(const struct sr_dev_inst *sdi)
-{
-	/* Total buffer size should be able to hold about 100ms of data. */
-	const unsigned int s = get_buffer_size(sdi);
-	const unsigned int n = (100 * to_bytes_per_ms(sdi) + s - 1) / s;
-	return (n > NUM_SIMUL_TRANSFERS) ? NUM_SIMUL_TRANSFERS : n;
-}
+	devc = sdi->priv;
+	usb = sdi->conn;
 
-static unsigned int get_timeout(const struct sr_dev_inst *sdi)
-{
-	const size_t total_size = get_buffer_size(sdi) *
-		get_number_of_transfers(sdi);
-	const unsigned int timeout = total_size / to_bytes_per_ms(sdi);
-	return timeout + timeout / 4; /* Leave a headroom of 25% percent. */
+	i = devc->num_transfers;
+	if (i >= usb->stream.max_transfers)
+		return SR_ERR_BUG;
+
+	if (!(buf = g_try_malloc(usb->stream.buffer_size))) {
+		sr_err("USB transfer buffer malloc failed.");
+		return SR_ERR_MALLOC;
+	}
+	transfer = libusb_alloc_transfer(0);
+	libusb_fill_bulk_transfer(transfer, usb->devhdl,
+			6 | LIBUSB_ENDPOINT_IN, buf, usb->stream.buffer_size,
+			receive_transfer, (void *)sdi, usb->stream.timeout);
+	sr_info("submitting transfer: %d", i);
+	if ((ret = usb_stream_submit(&usb->stream, transfer)) != 0) {
+		sr_err("Failed to submit transfer: %s.",
+		       libusb_error_name(ret));
+		libusb_free_transfer(transfer);
+		g_free(buf);
+		return SR_ERR;
+	}
+	devc->transfers[i] = transfer;
+	devc->num_transfers = i + 1;
+	devc->submitted_transfers++;
+
+	return SR_OK;
 }
 
 static int start_transfers(const struct sr_dev_inst *sdi)
 {
 	const size_t channel_count = enabled_channel_count(sdi);
-	const size_t size = get_buffer_size(sdi);
-	const unsigned int num_transfers = get_number_of_transfers(sdi);
-	const unsigned int timeout = get_timeout(sdi);
 
 	struct dev_context *devc;
 	struct sr_usb_dev_inst *usb;
-	struct libusb_transfer *transfer;
 	unsigned int i;
-	int ret;
-	unsigned char *buf;
+	size_t size;
 
 	devc = sdi->priv;
 	usb = sdi->conn;
+	size = usb->stream.buffer_size;
 
 	devc->sent_samples = 0;
 	devc->acq_aborted = FALSE;
@@ -957,7 +1027,9 @@ static int start_transfers(const struct sr_dev_inst *sdi)
 	devc->submitted_transfers = 0;
 
 	g_free(devc->transfers);
-	devc->transfers = g_try_malloc0(sizeof(*devc->transfers) * num_transfers);
+	devc->num_transfers = 0;
+	devc->transfers = g_try_malloc0(sizeof(*devc->transfers) *
+		usb->stream.max_transfers);
 	if (!devc->transfers) {
 		sr_err("USB transfers malloc failed.");
 		return SR_ERR_MALLOC;
@@ -971,28 +1043,13 @@ static int start_transfers(const struct sr_dev_inst *sdi)
 		return SR_ERR_MALLOC;
 	}
 
-	devc->num_transfers = num_transfers;
-	for (i = 0; i < num_transfers; i++) {
-		if (!(buf = g_try_malloc(size))) {
-			sr_err("USB transfer buffer malloc failed.");
-			return SR_ERR_MALLOC;
-		}
-		transfer = libusb_alloc_transfer(0);
-		libusb_fill_bulk_transfer(transfer, usb->devhdl,
-				6 | LIBUSB_ENDPOINT_IN, buf, size,
-				receive_transfer, (void *)sdi, timeout);
-		sr_info("submitting transfer: %d", i);
-		if ((ret = libusb_submit_transfer(transfer)) != 0) {
-			sr_err("Failed to submit transfer: %s.",
-			       libusb_error_name(ret));
-			libusb_free_transfer(transfer);
-			g_free(buf);
+	for (i = 0; i < usb->stream.num_transfers; i++) {
+		if (add_transfer(sdi) != SR_OK) {
 			abort_acquisition(devc);
 			return SR_ERR;
 		}
-		devc->transfers[i] = transfer;
-		devc->submitted_transfers++;
 	}
+	devc->acq_running = TRUE;
 
 	std_session_send_df_header(sdi);
 
@@ -1028,8 +1085,6 @@ static void LIBUSB_CALL trigger_receive(struct libusb_transfer *transfer)
 
 SR_PRIV int dslogic_acquisition_start(const struct sr_dev_inst *sdi)
 {
-	const unsigned int timeout = get_timeout(sdi);
-
 	struct sr_dev_driver *di;
 	struct drv_context *drvc;
 	struct dev_context *devc;
@@ -1048,7 +1103,17 @@ SR_PRIV int dslogic_acquisition_start(const struct sr_dev_inst *sdi)
 	devc->empty_transfer_count = 0;
 	devc->acq_aborted = FALSE;
 
-	usb_source_add(sdi->session, devc->ctx, timeout, receive_data, drvc);
+	/*
+	 * Buffers hold 10ms of data and a multiple of the size of a data
+	 * atom, the transfers about 100ms. Only continuous mode streams
+	 * at the samplerate and benefits from adding transfers.
+	 */
+	usb_stream_init(&usb->stream, bytes_per_sec(sdi),
+		enabled_channel_count(sdi) * 512, 10, 100, NUM_SIMUL_TRANSFERS,
+		devc->continuous_mode ? MAX_SIMUL_TRANSFERS : NUM_SIMUL_TRANSFERS);
+
+	usb_source_add(sdi->session, devc->ctx, usb->stream.timeout,
+		receive_data, drvc);
 
 	if ((ret = command_stop_acquisition(sdi)) != SR_OK)
 		return ret;
@@ -36,6 +36,7 @@
 
 #define MAX_RENUM_DELAY_MS	3000
 #define NUM_SIMUL_TRANSFERS	32
+#define MAX_SIMUL_TRANSFERS	(NUM_SIMUL_TRANSFERS * 4)
 #define MAX_EMPTY_TRANSFERS	(NUM_SIMUL_TRANSFERS * 2)
 
 #define NUM_CHANNELS		16
@@ -123,6 +124,8 @@ struct dev_context {
 	uint64_t capture_ratio;
 
 	gboolean acq_aborted;
+	/* Transfers are set up, and the pool may grow. */
+	gboolean acq_running;
 
 	unsigned int sent_samples;
 	int submitted_transfers;
@@ -269,9 +269,9 @@ SR_PRIV void fx2lafw_abort_acquisition(struct dev_context *devc)
 {
 	int i;
 
-	devc->acq_aborted = TRUE;
+	g_atomic_int_set(&devc->acq_aborted, TRUE);
 
-	for (i = devc->num_transfers - 1; i >= 0; i--) {
+	for (i = g_atomic_int_get(&devc->num_transfers) - 1; i >= 0; i--) {
 		if (devc->transfers[i])
 			libusb_cancel_transfer(devc->transfers[i]);
 	}
@@ -280,15 +280,29 @@ SR_PRIV void fx2lafw_abort_acquisition(struct dev_context *devc)
 static void finish_acquisition(struct sr_dev_inst *sdi)
 {
 	struct dev_context *devc;
+	struct sr_usb_dev_inst *usb;
 
 	devc = sdi->priv;
+	usb = sdi->conn;
 
 	std_session_send_df_end(sdi);
+	usb_stream_log(&usb->stream);
 
-	usb_source_remove(sdi->session, devc->ctx);
+	if (devc->queue) {
+		usb_queue_source_remove(sdi->session, devc->queue);
+		usb_queue_free(devc->queue);
+		devc->queue = NULL;
+	} else {
+		usb_source_remove(sdi->session, devc->ctx);
+	}
 
-	devc->num_transfers = 0;
+	g_atomic_int_set(&devc->num_transfers, 0);
 	g_free(devc->transfers);
+	devc->transfers = NULL;
+	g_free(devc->transfer_buffers);
+	devc->transfer_buffers = NULL;
+	sr_buffer_pool_free(devc->buffer_pool);
+	devc->buffer_pool = NULL;
 
 	/* Free the deinterlace buffers if we had them. */
 	if (g_slist_length(devc->enabled_analog_channels) > 0) {
@@ -306,32 +320,73 @@ static void free_transfer(struct libusb_transfer *transfer)
 {
 	struct sr_dev_inst *sdi;
 	struct dev_context *devc;
-	unsigned int i;
+	int i;
 
 	sdi = transfer->user_data;
 	devc = sdi->priv;
 
-	g_free(transfer->buffer);
-	transfer->buffer = NULL;
-	libusb_free_transfer(transfer);
-
 	for (i = 0; i < devc->num_transfers; i++) {
 		if (devc->transfers[i] == transfer) {
-			devc->transfers[i] = NULL;
+			g_atomic_pointer_set(&devc->transfers[i], NULL);
+			sr_buffer_unref(devc->transfer_buffers[i]);
+			devc->transfer_buffers[i] = NULL;
 			break;
 		}
 	}
 
-	devc->submitted_transfers--;
-	if (devc->submitted_transfers == 0)
+	transfer->buffer = NULL;
+	libusb_free_transfer(transfer);
+
+	/* The last transfer to go ends the acquisition. */
+	if (g_atomic_int_dec_and_test(&devc->submitted_transfers))
 		finish_acquisition(sdi);
 }
 
+/* Called by the event thread as well, while the session adds transfers. */
+static struct sr_buffer **transfer_buffer(struct dev_context *devc,
+		struct libusb_transfer *transfer)
+{
+	int i, num_transfers;
+
+	num_transfers = g_atomic_int_get(&devc->num_transfers);
+	for (i = 0; i < num_transfers; i++) {
+		if (g_atomic_pointer_get(&devc->transfers[i]) == transfer)
+			return &devc->transfer_buffers[i];
+	}
+
+	return NULL;
+}
+
 static void resubmit_transfer(struct libusb_transfer *transfer)
 {
+	struct sr_dev_inst *sdi;
+	struct dev_context *devc;
+	struct sr_usb_dev_inst *usb;
+	struct sr_buffer **slot, *buf;
 	int ret;
 
-	if ((ret = libusb_submit_transfer(transfer)) == LIBUSB_SUCCESS)
+	sdi = transfer->user_data;
+	devc = sdi->priv;
+	usb = sdi->conn;
+
+	/*
+	 * Don't overwrite sample data that a session feed consumer still
+	 * holds on to, receive into a fresh buffer from the pool instead.
+	 */
+	slot = transfer_buffer(devc, transfer);
+	if (slot && *slot && sr_buffer_is_shared(*slot)) {
+		if (!(buf = sr_buffer_pool_get(devc->buffer_pool))) {
+			fx2lafw_abort_acquisition(devc);
+			free_transfer(transfer);
+			return;
+		}
+		sr_buffer_unref(*slot);
+		*slot = buf;
+		transfer->buffer = sr_buffer_data(buf);
+	}
+
+	transfer->timeout = usb->stream.timeout;
+	if ((ret = usb_stream_submit(&usb->stream, transfer)) == LIBUSB_SUCCESS)
 		return;
 
 	sr_err("%s: %s", __func__, libusb_error_name(ret));
@@ -339,29 +394,27 @@ static void resubmit_transfer(struct libusb_transfer *transfer)
 
 }
 
-static void mso_send_data_proc(struct sr_dev_inst *sdi,
+static void mso_send_data_proc(struct sr_dev_inst *sdi, struct sr_buffer *buf,
 	uint8_t *data, size_t length, size_t sample_width)
 {
-	size_t i;
 	struct dev_context *devc;
 	struct sr_datafeed_analog analog;
 	struct sr_analog_encoding encoding;
 	struct sr_analog_meaning meaning;
 	struct sr_analog_spec spec;
 
+	(void)buf;
 	(void)sample_width;
 
 	devc = sdi->priv;
 
 	length /= 2;
 
-	/* Send the logic */
-	for (i = 0; i < length; i++) {
-		devc->logic_buffer[i] = data[i * 2];
-		/* Rescale to -10V - +10V from 0-255. */
-		devc->analog_buffer[i] = (data[i * 2 + 1] - 128.0f) / 12.8f;
-	};
+	/* Logic and analog bytes alternate. */
+	sr_split_logic_analog(data, length, 1, 1,
+		devc->logic_buffer, devc->analog_buffer);
 
+	/* Send the logic */
 	const struct sr_datafeed_logic logic = {
 		.length = length,
 		.unitsize = 1,
@@ -375,7 +428,16 @@ static void mso_send_data_proc(struct sr_dev_inst *sdi,
 
 	sr_session_send(sdi, &logic_packet);
 
+	/*
+	 * Send the analog samples as they are, the encoding rescales
+	 * them to -10V - +10V from 0-255: (x - 128) / 12.8.
+	 */
 	sr_analog_init(&analog, &encoding, &meaning, &spec, 2);
+	encoding.unitsize = 1;
+	encoding.is_signed = FALSE;
+	encoding.is_float = FALSE;
+	sr_rational_set(&encoding.scale, 5, 64);
+	sr_rational_set(&encoding.offset, -10, 1);
 	analog.meaning->channels = devc->enabled_analog_channels;
 	analog.meaning->mq = SR_MQ_VOLTAGE;
 	analog.meaning->unit = SR_UNIT_VOLT;
@@ -391,7 +453,7 @@ static void mso_send_data_proc(struct sr_dev_inst *sdi,
 	sr_session_send(sdi, &analog_packet);
 }
 
-static void la_send_data_proc(struct sr_dev_inst *sdi,
+static void la_send_data_proc(struct sr_dev_inst *sdi, struct sr_buffer *buf,
 	uint8_t *data, size_t length, size_t sample_width)
 {
 	const struct sr_datafeed_logic logic = {
@@ -405,20 +467,85 @@ static void la_send_data_proc(struct sr_dev_inst *sdi,
 		.payload = &logic
 	};
 
-	sr_session_send(sdi, &packet);
+	sr_session_send_buffer(sdi, &packet, buf);
 }
 
-static void LIBUSB_CALL receive_transfer(struct libusb_transfer *transfer)
+/*
+ * Send received sample data to the session bus, once the trigger fired.
+ * Returns TRUE when the sample limit has been reached.
+ */
+static gboolean process_data(struct sr_dev_inst *sdi, struct sr_buffer *buf,
+	uint8_t *data, int length)
 {
-	struct sr_dev_inst *sdi;
 	struct dev_context *devc;
-	gboolean packet_has_error = FALSE;
 	unsigned int num_samples;
 	int trigger_offset, cur_sample_count, unitsize;
 	int pre_trigger_samples;
 
+	devc = sdi->priv;
+
+	unitsize = devc->sample_wide ? 2 : 1;
+	cur_sample_count = length / unitsize;
+
+	if (devc->trigger_fired) {
+		if (!devc->limit_samples || devc->sent_samples < devc->limit_samples) {
+			/* Send the incoming transfer to the session bus. */
+			if (devc->limit_samples && devc->sent_samples + cur_sample_count > devc->limit_samples)
+				num_samples = devc->limit_samples - devc->sent_samples;
+			else
+				num_samples = cur_sample_count;
+
+			devc->send_data_proc(sdi, buf, data,
+				num_samples * unitsize, unitsize);
+			devc->sent_samples += num_samples;
+		}
+	} else {
+		trigger_offset = soft_trigger_logic_check(devc->stl,
+			data, length, &pre_trigger_samples);
+		if (trigger_offset > -1) {
+			devc->sent_samples += pre_trigger_samples;
+			num_samples = cur_sample_count - trigger_offset;
+			if (devc->limit_samples &&
+					num_samples > devc->limit_samples - devc->sent_samples)
+				num_samples = devc->limit_samples - devc->sent_samples;
+
+			devc->send_data_proc(sdi, buf,
+					data + trigger_offset * unitsize,
+					num_samples * unitsize, unitsize);
+			devc->sent_samples += num_samples;
+
+			devc->trigger_fired = TRUE;
+		}
+	}
+
+	return devc->limit_samples && devc->sent_samples >= devc->limit_samples;
+}
+
+static int add_transfer(const struct sr_dev_inst *sdi);
+
+/* Grow the pool of transfers, after late completions. */
+static void add_transfers(const struct sr_dev_inst *sdi, unsigned int count)
+{
+	while (count-- > 0) {
+		if (add_transfer(sdi) != SR_OK)
+			break;
+	}
+}
+
+static void LIBUSB_CALL receive_transfer(struct libusb_transfer *transfer)
+{
+	struct sr_dev_inst *sdi;
+	struct dev_context *devc;
+	struct sr_usb_dev_inst *usb;
+	gboolean packet_has_error = FALSE;
+	struct sr_buffer **slot;
+	unsigned int grow;
+
 	sdi = transfer->user_data;
 	devc = sdi->priv;
+	usb = sdi->conn;
+
+	grow = usb_stream_completed(&usb->stream, transfer);
 
 	/*
 	 * If acquisition has already ended, just free any queued up
@@ -432,10 +559,6 @@ static void LIBUSB_CALL receive_transfer(struct libusb_transfer *transfer)
 	sr_dbg("receive_transfer(): status %s received %d bytes.",
 		libusb_error_name(transfer->status), transfer->actual_length);
 
-	/* Save incoming transfer before reusing the transfer struct. */
-	unitsize = devc->sample_wide ? 2 : 1;
-	cur_sample_count = transfer->actual_length / unitsize;
-
 	switch (transfer->status) {
 	case LIBUSB_TRANSFER_NO_DEVICE:
 		fx2lafw_abort_acquisition(devc);
@@ -465,42 +588,152 @@ static void LIBUSB_CALL receive_transfer(struct libusb_transfer *transfer)
 	} else {
 		devc->empty_transfer_count = 0;
 	}
-	if (devc->trigger_fired) {
-		if (!devc->limit_samples || devc->sent_samples < devc->limit_samples) {
-			/* Send the incoming transfer to the session bus. */
-			if (devc->limit_samples && devc->sent_samples + cur_sample_count > devc->limit_samples)
-				num_samples = devc->limit_samples - devc->sent_samples;
-			else
-				num_samples = cur_sample_count;
+	slot = transfer_buffer(devc, transfer);
+	if (process_data(sdi, slot ? *slot : NULL, transfer->buffer,
+			transfer->actual_length)) {
+		fx2lafw_abort_acquisition(devc);
+		free_transfer(transfer);
+		return;
+	}
 
-			devc->send_data_proc(sdi, (uint8_t *)transfer->buffer,
-				num_samples * unitsize, unitsize);
-			devc->sent_samples += num_samples;
+	resubmit_transfer(transfer);
+	if (grow && devc->transfers && !devc->acq_aborted)
+		add_transfers(sdi, grow);
+}
+
+/*
+ * Transfer callback when running the libusb event thread. Puts a fresh
+ * buffer into the transfer and resubmits it right away, the received
+ * data gets processed by receive_queued() in the session.
+ */
+static void LIBUSB_CALL queue_transfer(struct libusb_transfer *transfer)
+{
+	struct sr_dev_inst *sdi;
+	struct dev_context *devc;
+	struct sr_usb_dev_inst *usb;
+	struct usb_completion c;
+	struct sr_buffer **slot, *buf;
+	guint grow;
+	int ret;
+
+	sdi = transfer->user_data;
+	devc = sdi->priv;
+	usb = sdi->conn;
+
+	/* Only the session changes the transfer arrays, it adds these. */
+	if ((grow = usb_stream_completed(&usb->stream, transfer)))
+		g_atomic_int_add(&devc->grow_transfers, grow);
+
+	c.transfer = NULL;
+	c.buf = NULL;
+	c.length = transfer->actual_length;
+	c.status = transfer->status;
+
+	/* Only the session may free transfers, hand them back. */
+	if (g_atomic_int_get(&devc->acq_aborted) ||
+			transfer->status == LIBUSB_TRANSFER_NO_DEVICE) {
+		c.transfer = transfer;
+		usb_queue_push(devc->queue, &c);
+		return;
+	}
+
+	if (!(slot = transfer_buffer(devc, transfer))) {
+		sr_err("Completed transfer is unknown.");
+		c.transfer = transfer;
+		c.status = LIBUSB_TRANSFER_ERROR;
+		usb_queue_push(devc->queue, &c);
+		return;
+	}
+	if (c.length > 0 && (transfer->status == LIBUSB_TRANSFER_COMPLETED ||
+			transfer->status == LIBUSB_TRANSFER_TIMED_OUT)) {
+		if (!(buf = sr_buffer_pool_get(devc->buffer_pool))) {
+			c.transfer = transfer;
+			c.status = LIBUSB_TRANSFER_ERROR;
+			usb_queue_push(devc->queue, &c);
+			return;
+		}
+		c.buf = *slot;
+		if (usb_queue_push(devc->queue, &c)) {
+			*slot = buf;
+			transfer->buffer = sr_buffer_data(buf);
+		} else {
+			/* Receive into the same buffer again, the data is lost. */
+			sr_buffer_unref(buf);
+			g_atomic_int_set(&devc->overrun, TRUE);
 		}
 	} else {
-		trigger_offset = soft_trigger_logic_check(devc->stl,
-			transfer->buffer, transfer->actual_length, &pre_trigger_samples);
-		if (trigger_offset > -1) {
-			devc->sent_samples += pre_trigger_samples;
-			num_samples = cur_sample_count - trigger_offset;
-			if (devc->limit_samples &&
-					num_samples > devc->limit_samples - devc->sent_samples)
-				num_samples = devc->limit_samples - devc->sent_samples;
+		/* Let the session keep track of empty transfers. */
+		usb_queue_push(devc->queue, &c);
+	}
 
-			devc->send_data_proc(sdi, (uint8_t *)transfer->buffer
-					+ trigger_offset * unitsize,
-					num_samples * unitsize, unitsize);
-			devc->sent_samples += num_samples;
+	transfer->timeout = usb->stream.timeout;
+	if ((ret = usb_stream_submit(&usb->stream, transfer)) != LIBUSB_SUCCESS) {
+		sr_err("%s: %s", __func__, libusb_error_name(ret));
+		c.transfer = transfer;
+		c.buf = NULL;
+		c.status = LIBUSB_TRANSFER_ERROR;
+		usb_queue_push(devc->queue, &c);
+		return;
+	}
 
-			devc->trigger_fired = TRUE;
-		}
+	/* The acquisition may have been aborted while we resubmitted. */
+	if (g_atomic_int_get(&devc->acq_aborted))
+		libusb_cancel_transfer(transfer);
+}
+
+/*
+ * Set up and submit another transfer. The transfer arrays have room for
+ * the maximum number of transfers.
+ */
+static int add_transfer(const struct sr_dev_inst *sdi)
+{
+	struct dev_context *devc;
+	struct sr_usb_dev_inst *usb;
+	struct libusb_transfer *transfer;
+	struct sr_buffer *buf;
+	int i, ret;
+
+	devc = sdi->priv;
+	usb = sdi->conn;
+
+	i = devc->num_transfers;
+	if ((unsigned int)i >= usb->stream.max_transfers)
+		return SR_ERR_BUG;
+
+	if (!(buf = sr_buffer_pool_get(devc->buffer_pool))) {
+		sr_err("USB transfer buffer malloc failed.");
+		return SR_ERR_MALLOC;
+	}
+	transfer = libusb_alloc_transfer(0);
+	libusb_fill_bulk_transfer(transfer, usb->devhdl,
+			2 | LIBUSB_ENDPOINT_IN, sr_buffer_data(buf),
+			usb->stream.buffer_size,
+			devc->queue ? queue_transfer : receive_transfer,
+			(void *)sdi, usb->stream.timeout);
+
+	/* The transfer must be known when it completes. */
+	devc->transfers[i] = transfer;
+	devc->transfer_buffers[i] = buf;
+	g_atomic_int_set(&devc->num_transfers, i + 1);
+	g_atomic_int_inc(&devc->submitted_transfers);
+
+	sr_info("submitting transfer: %d", i);
+	if ((ret = usb_stream_submit(&usb->stream, transfer)) != 0) {
+		sr_err("Failed to submit transfer: %s.",
+		       libusb_error_name(ret));
+		g_atomic_pointer_set(&devc->transfers[i], NULL);
+		devc->transfer_buffers[i] = NULL;
+		g_atomic_int_add(&devc->submitted_transfers, -1);
+		libusb_free_transfer(transfer);
+		sr_buffer_unref(buf);
+		return SR_ERR;
 	}
 
-	if (devc->limit_samples && devc->sent_samples >= devc->limit_samples) {
-		fx2lafw_abort_acquisition(devc);
-		free_transfer(transfer);
-	} else
-		resubmit_transfer(transfer);
+	/* Don't keep a transfer running for an aborted acquisition. */
+	if (g_atomic_int_get(&devc->acq_aborted))
+		libusb_cancel_transfer(transfer);
+
+	return SR_OK;
 }
 
 static int configure_channels(const struct sr_dev_inst *sdi)
@@ -537,60 +770,64 @@ static int configure_channels(const struct sr_dev_inst *sdi)
 	return SR_OK;
 }
 
-static unsigned int to_bytes_per_ms(unsigned int samplerate)
-{
-	return samplerate / 1000;
-}
-
-static size_t get_buffer_size(struct dev_context *devc)
-{
-	size_t s;
-
-	/*
-	 * The buffer should be large enough to hold 10ms of data and
-	 * a multiple of 512.
-	 */
-	s = 10 * to_bytes_per_ms(devc->cur_samplerate);
-	return (s + 511) & ~511;
-}
-
-static unsigned int get_number_of_transfers(struct dev_context *devc)
+static int receive_data(int fd, int revents, void *cb_data)
 {
-	unsigned int n;
-
-	/* Total buffer size should be able to hold about 500ms of data. */
-	n = (500 * to_bytes_per_ms(devc->cur_samplerate) /
-		get_buffer_size(devc));
+	struct timeval tv;
+	struct drv_context *drvc;
 
-	if (n > NUM_SIMUL_TRANSFERS)
-		return NUM_SIMUL_TRANSFERS;
+	(void)fd;
+	(void)revents;
 
-	return n;
-}
+	drvc = (struct drv_context *)cb_data;
 
-static unsigned int get_timeout(struct dev_context *devc)
-{
-	size_t total_size;
-	unsigned int timeout;
+	tv.tv_sec = tv.tv_usec = 0;
+	libusb_handle_events_timeout(drvc->sr_ctx->libusb_ctx, &tv);
 
-	total_size = get_buffer_size(devc) *
-			get_number_of_transfers(devc);
-	timeout = total_size / to_bytes_per_ms(devc->cur_samplerate);
-	return timeout + timeout / 4; /* Leave a headroom of 25% percent. */
+	return TRUE;
 }
 
-static int receive_data(int fd, int revents, void *cb_data)
+static int receive_queued(int fd, int revents, void *cb_data)
 {
-	struct timeval tv;
-	struct drv_context *drvc;
+	struct sr_dev_inst *sdi;
+	struct dev_context *devc;
+	struct usb_completion c;
+	guint grow;
 
 	(void)fd;
 	(void)revents;
 
-	drvc = (struct drv_context *)cb_data;
+	sdi = cb_data;
+	devc = sdi->priv;
 
-	tv.tv_sec = tv.tv_usec = 0;
-	libusb_handle_events_timeout(drvc->sr_ctx->libusb_ctx, &tv);
+	if (g_atomic_int_get(&devc->overrun) && !devc->acq_aborted) {
+		sr_err("USB data arrived faster than the session processed it.");
+		fx2lafw_abort_acquisition(devc);
+	}
+
+	/* The last transfer to be freed ends the acquisition. */
+	while (devc->queue && usb_queue_pop(devc->queue, &c)) {
+		if (c.buf) {
+			devc->empty_transfer_count = 0;
+			if (!devc->acq_aborted && process_data(sdi, c.buf,
+					sr_buffer_data(c.buf), c.length))
+				fx2lafw_abort_acquisition(devc);
+			sr_buffer_unref(c.buf);
+		} else if (!c.transfer && !devc->acq_aborted &&
+				++devc->empty_transfer_count > MAX_EMPTY_TRANSFERS) {
+			/* The FX2 gave up, see receive_transfer(). */
+			fx2lafw_abort_acquisition(devc);
+		}
+		if (c.transfer) {
+			if (!devc->acq_aborted)
+				fx2lafw_abort_acquisition(devc);
+			free_transfer(c.transfer);
+		}
+	}
+
+	/* Grow the pool here, the event thread doesn't touch the arrays. */
+	grow = g_atomic_int_and(&devc->grow_transfers, 0);
+	if (grow && devc->queue && !devc->acq_aborted)
+		add_transfers(sdi, grow);
 
 	return TRUE;
 }
@@ -600,17 +837,15 @@ static int start_transfers(const struct sr_dev_inst *sdi)
 	struct dev_context *devc;
 	struct sr_usb_dev_inst *usb;
 	struct sr_trigger *trigger;
-	struct libusb_transfer *transfer;
-	unsigned int i, num_transfers;
-	int timeout, ret;
-	unsigned char *buf;
-	size_t size;
+	unsigned int i, max_transfers;
+	int ret;
 
 	devc = sdi->priv;
 	usb = sdi->conn;
 
 	devc->sent_samples = 0;
 	devc->acq_aborted = FALSE;
+	devc->overrun = FALSE;
 	devc->empty_transfer_count = 0;
 
 	if ((trigger = sr_session_trigger_get(sdi->session))) {
@@ -624,39 +859,32 @@ static int start_transfers(const struct sr_dev_inst *sdi)
 	} else
 		devc->trigger_fired = TRUE;
 
-	num_transfers = get_number_of_transfers(devc);
-
-	size = get_buffer_size(devc);
 	devc->submitted_transfers = 0;
+	devc->num_transfers = 0;
+	devc->grow_transfers = 0;
 
-	devc->transfers = g_try_malloc0(sizeof(*devc->transfers) * num_transfers);
-	if (!devc->transfers) {
+	max_transfers = usb->stream.max_transfers;
+	devc->transfers = g_try_malloc0(sizeof(*devc->transfers) * max_transfers);
+	devc->transfer_buffers = g_try_malloc0(
+		sizeof(*devc->transfer_buffers) * max_transfers);
+	if (!devc->transfers || !devc->transfer_buffers) {
 		sr_err("USB transfers malloc failed.");
 		return SR_ERR_MALLOC;
 	}
 
-	timeout = get_timeout(devc);
-	devc->num_transfers = num_transfers;
-	for (i = 0; i < num_transfers; i++) {
-		if (!(buf = g_try_malloc(size))) {
-			sr_err("USB transfer buffer malloc failed.");
-			return SR_ERR_MALLOC;
-		}
-		transfer = libusb_alloc_transfer(0);
-		libusb_fill_bulk_transfer(transfer, usb->devhdl,
-				2 | LIBUSB_ENDPOINT_IN, buf, size,
-				receive_transfer, (void *)sdi, timeout);
-		sr_info("submitting transfer: %d", i);
-		if ((ret = libusb_submit_transfer(transfer)) != 0) {
-			sr_err("Failed to submit transfer: %s.",
-			       libusb_error_name(ret));
-			libusb_free_transfer(transfer);
-			g_free(buf);
+	/*
+	 * Transfer buffers come from a pool, so that session feed consumers
+	 * can keep the sample data without copying it. Buffers which are
+	 * still in use when their transfer completes again get replaced.
+	 */
+	devc->buffer_pool = sr_buffer_pool_new(usb->stream.buffer_size,
+		usb->stream.num_transfers);
+
+	for (i = 0; i < usb->stream.num_transfers; i++) {
+		if ((ret = add_transfer(sdi)) != SR_OK) {
 			fx2lafw_abort_acquisition(devc);
-			return SR_ERR;
+			return ret;
 		}
-		devc->transfers[i] = transfer;
-		devc->submitted_transfers++;
 	}
 
 	/*
@@ -679,12 +907,15 @@ SR_PRIV int fx2lafw_start_acquisition(const struct sr_dev_inst *sdi)
 	struct sr_dev_driver *di;
 	struct drv_context *drvc;
 	struct dev_context *devc;
-	int timeout, ret;
-	size_t size;
+	struct sr_usb_dev_inst *usb;
+	struct usb_stream *stream;
+	int ret;
 
 	di = sdi->driver;
 	drvc = di->context;
 	devc = sdi->priv;
+	usb = sdi->conn;
+	stream = &usb->stream;
 
 	devc->ctx = drvc->sr_ctx;
 	devc->sent_samples = 0;
@@ -696,16 +927,39 @@ SR_PRIV int fx2lafw_start_acquisition(const struct sr_dev_inst *sdi)
 		return SR_ERR;
 	}
 
-	timeout = get_timeout(devc);
-	usb_source_add(sdi->session, devc->ctx, timeout, receive_data, drvc);
+	/*
+	 * Buffers hold 10ms of data and a multiple of 512 bytes, the
+	 * transfers about 500ms initially.
+	 */
+	usb_stream_init(stream, devc->cur_samplerate * (devc->sample_wide ? 2 : 1),
+		512, 10, 500, NUM_SIMUL_TRANSFERS, MAX_SIMUL_TRANSFERS);
+
+	if (devc->ctx->usb_thread_enabled) {
+		/*
+		 * Let the session fall behind by about two seconds before
+		 * sample data gets lost.
+		 */
+		devc->queue = usb_queue_new(4 * stream->num_transfers,
+			stream->max_transfers);
+		if (!devc->queue)
+			return SR_ERR_MALLOC;
+		ret = usb_queue_source_add(sdi->session, devc->ctx,
+			devc->queue, stream->timeout, receive_queued, (void *)sdi);
+		if (ret != SR_OK) {
+			usb_queue_free(devc->queue);
+			devc->queue = NULL;
+			return ret;
+		}
+	} else {
+		usb_source_add(sdi->session, devc->ctx, stream->timeout,
+			receive_data, drvc);
+	}
 
-	size = get_buffer_size(devc);
 	/* Prepare for analog sampling. */
 	if (g_slist_length(devc->enabled_analog_channels) > 0) {
 		/* We need a buffer half the size of a transfer. */
-		devc->logic_buffer = g_try_malloc(size / 2);
-		devc->analog_buffer = g_try_malloc(
-			sizeof(float) * size / 2);
+		devc->logic_buffer = g_try_malloc(stream->buffer_size / 2);
+		devc->analog_buffer = g_try_malloc(stream->buffer_size / 2);
 	}
 	start_transfers(sdi);
 	if ((ret = command_start_acquisition(sdi)) != SR_OK) {
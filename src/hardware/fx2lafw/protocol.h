@@ -37,6 +37,7 @@
 
 #define MAX_RENUM_DELAY_MS	3000
 #define NUM_SIMUL_TRANSFERS	32
+#define MAX_SIMUL_TRANSFERS	(NUM_SIMUL_TRANSFERS * 4)
 #define MAX_EMPTY_TRANSFERS	(NUM_SIMUL_TRANSFERS * 2)
 
 #define NUM_CHANNELS		16
@@ -114,13 +115,26 @@ struct dev_context {
 	int submitted_transfers;
 	int empty_transfer_count;
 
-	unsigned int num_transfers;
+	/*
+	 * Only the session adds transfers. It fills a slot before it
+	 * publishes the new count, which the event thread reads atomically.
+	 */
+	int num_transfers;
 	struct libusb_transfer **transfers;
+	/* Sample data buffers of the transfers, same order as transfers. */
+	struct sr_buffer **transfer_buffers;
+	struct sr_buffer_pool *buffer_pool;
+	/* Completed transfers when using the libusb event thread, or NULL. */
+	struct usb_queue *queue;
+	/* Set by the event thread when the queue ran full. */
+	gboolean overrun;
+	/* Transfers the event thread asks the session to add. */
+	guint grow_transfers;
 	struct sr_context *ctx;
-	void (*send_data_proc)(struct sr_dev_inst *sdi,
+	void (*send_data_proc)(struct sr_dev_inst *sdi, struct sr_buffer *buf,
 		uint8_t *data, size_t length, size_t sample_width);
 	uint8_t *logic_buffer;
-	float *analog_buffer;
+	uint8_t *analog_buffer;
 };
 
 SR_PRIV int fx2lafw_dev_open(struct sr_dev_inst *sdi, struct sr_dev_driver *di);
@@ -1370,17 +1370,20 @@ SR_PRIV int hmo_receive_data(int fd, int revents, void *cb_data)
 	struct scope_state *state;
 	struct sr_datafeed_packet packet;
 	GByteArray *data;
+	GArray *values;
 	struct sr_datafeed_analog analog;
 	struct sr_analog_encoding encoding;
 	struct sr_analog_meaning meaning;
 	struct sr_analog_spec spec;
 	struct sr_datafeed_logic logic;
 	size_t group;
+	gboolean last_channel;
 
 	(void)fd;
 	(void)revents;
 
 	data = NULL;
+	values = NULL;
 
 	if (!(sdi = cb_data))
 		return TRUE;
@@ -1405,21 +1408,50 @@ SR_PRIV int hmo_receive_data(int fd, int revents, void *cb_data)
 	if (devc->current_channel == devc->enabled_channels)
 		std_session_send_df_frame_begin(sdi);
 
-	/*
-	 * Pass on the received data of the channel(s).
-	 */
 	switch (ch->type) {
 	case SR_CHANNEL_ANALOG:
+		/* The data was requested in host byte order. */
+		if (sr_scpi_get_block_floatv(sdi->conn, NULL,
+				G_BYTE_ORDER == G_BIG_ENDIAN, &values) != SR_OK)
+			return TRUE;
+		devc->num_samples = values->len;
+		break;
+	case SR_CHANNEL_LOGIC:
 		if (sr_scpi_get_block(sdi->conn, NULL, &data) != SR_OK) {
 			if (data)
 				g_byte_array_free(data, TRUE);
 			return TRUE;
 		}
+		devc->num_samples = data->len / devc->pod_count;
+		break;
+	default:
+		break;
+	}
+
+	/*
+	 * Request the next enabled channel's data, or the first channel
+	 * of the next frame, before passing this block on. The device
+	 * prepares the next block while this one gets processed.
+	 */
+	last_channel = !devc->current_channel->next;
+	if (!last_channel) {
+		devc->current_channel = devc->current_channel->next;
+		hmo_request_data(sdi);
+	} else if (devc->num_frames + 1 < devc->frame_limit &&
+			devc->num_samples < devc->samples_limit) {
+		devc->current_channel = devc->enabled_channels;
+		hmo_request_data(sdi);
+	}
 
+	/*
+	 * Pass on the received data of the channel(s).
+	 */
+	switch (ch->type) {
+	case SR_CHANNEL_ANALOG:
 		packet.type = SR_DF_ANALOG;
 
-		analog.data = data->data;
-		analog.num_samples = data->len / sizeof(float);
+		analog.data = values->data;
+		analog.num_samples = values->len;
 		/* Truncate acquisition if a smaller number of samples has been requested. */
 		if (devc->samples_limit > 0 && analog.num_samples > devc->samples_limit)
 			analog.num_samples = devc->samples_limit;
@@ -1436,18 +1468,11 @@ SR_PRIV int hmo_receive_data(int fd, int revents, void *cb_data)
 		meaning.channels = g_slist_append(NULL, ch);
 		packet.payload = &analog;
 		sr_session_send(sdi, &packet);
-		devc->num_samples = data->len / sizeof(float);
 		g_slist_free(meaning.channels);
-		g_byte_array_free(data, TRUE);
-		data = NULL;
+		g_array_free(values, TRUE);
+		values = NULL;
 		break;
 	case SR_CHANNEL_LOGIC:
-		if (sr_scpi_get_block(sdi->conn, NULL, &data) != SR_OK) {
-			if (data)
-				g_byte_array_free(data, TRUE);
-			return TRUE;
-		}
-
 		/*
 		 * If only data from the first pod is involved in the
 		 * acquisition, then the raw input bytes can get passed
@@ -1476,7 +1501,6 @@ SR_PRIV int hmo_receive_data(int fd, int revents, void *cb_data)
 			hmo_queue_logic_data(devc, group, data);
 		}
 
-		devc->num_samples = data->len / devc->pod_count;
 		g_byte_array_free(data, TRUE);
 		data = NULL;
 		break;
@@ -1486,15 +1510,11 @@ SR_PRIV int hmo_receive_data(int fd, int revents, void *cb_data)
 	}
 
 	/*
-	 * Advance to the next enabled channel. When data for all enabled
-	 * channels was received, then flush potentially queued logic data,
-	 * and send the "frame end" packet.
+	 * When data for all enabled channels was received, then flush
+	 * potentially queued logic data, and send the "frame end" packet.
 	 */
-	if (devc->current_channel->next) {
-		devc->current_channel = devc->current_channel->next;
-		hmo_request_data(sdi);
+	if (!last_channel)
 		return TRUE;
-	}
 	hmo_send_logic_packet(sdi, devc);
 
 	/*
@@ -1509,15 +1529,12 @@ SR_PRIV int hmo_receive_data(int fd, int revents, void *cb_data)
 
 	/*
 	 * End of frame was reached. Stop acquisition after the specified
-	 * number of frames or after the specified number of samples, or
-	 * continue reception by starting over at the first enabled channel.
+	 * number of frames or after the specified number of samples. The
+	 * next frame's first channel was requested above otherwise.
 	 */
 	if (++devc->num_frames >= devc->frame_limit || devc->num_samples >= devc->samples_limit) {
 		sr_dev_acquisition_stop(sdi);
 		hmo_cleanup_logic_data(devc);
-	} else {
-		devc->current_channel = devc->enabled_channels;
-		hmo_request_data(sdi);
 	}
 
 	return TRUE;
@@ -297,7 +297,6 @@ static void clear_helper(struct dev_context *devc)
 {
 	unsigned int i;
 
-	g_free(devc->data);
 	g_free(devc->buffer);
 	for (i = 0; i < ARRAY_SIZE(devc->coupling); i++)
 		g_free(devc->coupling[i]);
@@ -431,7 +430,6 @@ static struct sr_dev_inst *probe_device(struct sr_scpi_dev_inst *scpi)
 	}
 
 	devc->buffer = g_malloc(ACQ_BUFFER_SIZE);
-	devc->data = g_malloc(ACQ_BUFFER_SIZE * sizeof(float));
 
 	devc->data_source = DATA_SOURCE_LIVE;
 
@@ -986,6 +984,8 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 	sr_scpi_source_add(sdi->session, scpi, G_IO_IN, 50,
 			rigol_ds_receive, (void *)sdi);
 
+	devc->pipeline = rigol_ds_pipeline_new(sdi);
+
 	std_session_send_df_header(sdi);
 
 	devc->channel_entry = devc->enabled_channels;
@@ -1006,6 +1006,10 @@ static int dev_acquisition_stop(struct sr_dev_inst *sdi)
 
 	devc = sdi->priv;
 
+	/* Send the analog data which is still being converted. */
+	sr_scpi_pipeline_free(devc->pipeline);
+	devc->pipeline = NULL;
+
 	std_session_send_df_end(sdi);
 
 	g_slist_free(devc->enabled_channels);
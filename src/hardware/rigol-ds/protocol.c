@@ -532,9 +532,9 @@ static int rigol_ds_read_header(struct sr_dev_inst *sdi)
 	size_t header_length;
 	int ret;
 
-	/* Try to read the hashsign and length digit. */
+	/* Read the hashsign and length digit. */
 	if (devc->num_header_bytes < 2) {
-		ret = sr_scpi_read_data(scpi, buf + devc->num_header_bytes,
+		ret = sr_scpi_read_exact(scpi, buf + devc->num_header_bytes,
 				2 - devc->num_header_bytes);
 		if (ret < 0) {
 			sr_err("Read error while reading data header.");
@@ -553,9 +553,9 @@ static int rigol_ds_read_header(struct sr_dev_inst *sdi)
 
 	header_length = 2 + buf[1] - '0';
 
-	/* Try to read the length. */
+	/* Read the length. */
 	if (devc->num_header_bytes < header_length) {
-		ret = sr_scpi_read_data(scpi, buf + devc->num_header_bytes,
+		ret = sr_scpi_read_exact(scpi, buf + devc->num_header_bytes,
 				header_length - devc->num_header_bytes);
 		if (ret < 0) {
 			sr_err("Read error while reading data header.");
@@ -580,19 +580,89 @@ static int rigol_ds_read_header(struct sr_dev_inst *sdi)
 	return ret;
 }
 
-SR_PRIV int rigol_ds_receive(int fd, int revents, void *cb_data)
+/* What it takes to convert and send a chunk of analog data. */
+struct analog_chunk {
+	struct sr_channel *ch;
+	enum protocol_version protocol;
+	int vref;
+	double vdiv, offset, origin;
+};
+
+/* Runs on the pipeline's worker thread. */
+static void analog_chunk_convert(struct sr_scpi_block *block, void *cb_data)
 {
-	struct sr_dev_inst *sdi;
-	struct sr_scpi_dev_inst *scpi;
-	struct dev_context *devc;
+	struct analog_chunk *chunk;
+	const uint8_t *raw;
+	float *data;
+	size_t i, len;
+
+	(void)cb_data;
+
+	chunk = block->priv;
+	raw = block->raw->data;
+	len = block->raw->len;
+	data = g_malloc(len * sizeof(float));
+
+	if (chunk->protocol >= PROTOCOL_V3)
+		for (i = 0; i < len; i++)
+			data[i] = ((int)raw[i] - chunk->vref - chunk->origin) * chunk->vdiv;
+	else
+		for (i = 0; i < len; i++)
+			data[i] = (128 - raw[i]) * chunk->vdiv - chunk->offset;
+
+	block->data = data;
+	block->num_samples = len;
+}
+
+static void analog_chunk_send(struct sr_scpi_block *block, void *cb_data)
+{
+	const struct sr_dev_inst *sdi;
+	struct analog_chunk *chunk;
 	struct sr_datafeed_packet packet;
 	struct sr_datafeed_analog analog;
 	struct sr_analog_encoding encoding;
 	struct sr_analog_meaning meaning;
 	struct sr_analog_spec spec;
+	float vdivlog;
+	int digits;
+
+	sdi = cb_data;
+	chunk = block->priv;
+
+	vdivlog = log10f(chunk->vdiv);
+	digits = -(int)vdivlog + (vdivlog < 0.0);
+	sr_analog_init(&analog, &encoding, &meaning, &spec, digits);
+	analog.meaning->channels = g_slist_append(NULL, chunk->ch);
+	analog.num_samples = block->num_samples;
+	analog.data = block->data;
+	analog.meaning->mq = SR_MQ_VOLTAGE;
+	analog.meaning->unit = SR_UNIT_VOLT;
+	analog.meaning->mqflags = 0;
+	packet.type = SR_DF_ANALOG;
+	packet.payload = &analog;
+	sr_session_send(sdi, &packet);
+	g_slist_free(analog.meaning->channels);
+
+	g_free(chunk);
+}
+
+SR_PRIV struct sr_scpi_pipeline *rigol_ds_pipeline_new(const struct sr_dev_inst *sdi)
+{
+	return sr_scpi_pipeline_new(analog_chunk_convert, analog_chunk_send,
+		(void *)sdi, ACQ_PIPELINE_DEPTH);
+}
+
+SR_PRIV int rigol_ds_receive(int fd, int revents, void *cb_data)
+{
+	struct sr_dev_inst *sdi;
+	struct sr_scpi_dev_inst *scpi;
+	struct dev_context *devc;
+	struct sr_datafeed_packet packet;
 	struct sr_datafeed_logic logic;
-	double vdiv, offset, origin;
-	int len, i, vref;
+	struct analog_chunk *chunk;
+	GByteArray *raw;
+	char *buf;
+	int len;
 	struct sr_channel *ch;
 	gsize expected_data_bytes;
 
@@ -606,6 +676,9 @@ SR_PRIV int rigol_ds_receive(int fd, int revents, void *cb_data)
 
 	scpi = sdi->conn;
 
+	/* Send what has been converted in the meantime. */
+	sr_scpi_pipeline_flush(devc->pipeline, FALSE);
+
 	if (!(revents == G_IO_IN || revents == 0))
 		return TRUE;
 
@@ -666,7 +739,7 @@ SR_PRIV int rigol_ds_receive(int fd, int revents, void *cb_data)
 				return TRUE;
 			if (len == -1) {
 				sr_err("Error while reading block header, aborting capture.");
-				std_session_send_df_frame_end(sdi);
+				sr_scpi_pipeline_frame_end(devc->pipeline, sdi);
 				sr_dev_acquisition_stop(sdi);
 				return TRUE;
 			}
@@ -694,11 +767,31 @@ SR_PRIV int rigol_ds_receive(int fd, int revents, void *cb_data)
 		len = ACQ_BUFFER_SIZE;
 	sr_dbg("Requesting read of %d bytes", len);
 
-	len = sr_scpi_read_data(scpi, (char *)devc->buffer, len);
+	/*
+	 * Analog chunks get received into their own array, and converted
+	 * by the pipeline while the next chunk or channel gets fetched.
+	 *
+	 * Note that this blocks in sr_scpi_read_exact() until the whole
+	 * chunk (up to ACQ_BUFFER_SIZE bytes) arrived, or the device went
+	 * quiet for the SCPI read timeout, rather than returning to the
+	 * event loop with whatever the transport had so far.
+	 */
+	raw = NULL;
+	if (ch->type == SR_CHANNEL_ANALOG) {
+		raw = g_byte_array_sized_new(len);
+		g_byte_array_set_size(raw, len);
+		buf = (char *)raw->data;
+	} else {
+		buf = (char *)devc->buffer;
+	}
+
+	len = sr_scpi_read_exact(scpi, buf, len);
 
-	if (len == -1) {
+	if (len < 0) {
 		sr_err("Error while reading block data, aborting capture.");
-		std_session_send_df_frame_end(sdi);
+		if (raw)
+			g_byte_array_free(raw, TRUE);
+		sr_scpi_pipeline_frame_end(devc->pipeline, sdi);
 		sr_dev_acquisition_stop(sdi);
 		return TRUE;
 	}
@@ -708,30 +801,17 @@ SR_PRIV int rigol_ds_receive(int fd, int revents, void *cb_data)
 	devc->num_block_read += len;
 
 	if (ch->type == SR_CHANNEL_ANALOG) {
-		vref = devc->vert_reference[ch->index];
-		vdiv = devc->vert_inc[ch->index];
-		origin = devc->vert_origin[ch->index];
-		offset = devc->vert_offset[ch->index];
-		if (devc->model->series->protocol >= PROTOCOL_V3)
-			for (i = 0; i < len; i++)
-				devc->data[i] = ((int)devc->buffer[i] - vref - origin) * vdiv;
-		else
-			for (i = 0; i < len; i++)
-				devc->data[i] = (128 - devc->buffer[i]) * vdiv - offset;
-		float vdivlog = log10f(vdiv);
-		int digits = -(int)vdivlog + (vdivlog < 0.0);
-		sr_analog_init(&analog, &encoding, &meaning, &spec, digits);
-		analog.meaning->channels = g_slist_append(NULL, ch);
-		analog.num_samples = len;
-		analog.data = devc->data;
-		analog.meaning->mq = SR_MQ_VOLTAGE;
-		analog.meaning->unit = SR_UNIT_VOLT;
-		analog.meaning->mqflags = 0;
-		packet.type = SR_DF_ANALOG;
-		packet.payload = &analog;
-		sr_session_send(sdi, &packet);
-		g_slist_free(analog.meaning->channels);
+		chunk = g_malloc(sizeof(*chunk));
+		chunk->ch = ch;
+		chunk->protocol = devc->model->series->protocol;
+		chunk->vref = devc->vert_reference[ch->index];
+		chunk->vdiv = devc->vert_inc[ch->index];
+		chunk->origin = devc->vert_origin[ch->index];
+		chunk->offset = devc->vert_offset[ch->index];
+		sr_scpi_pipeline_push(devc->pipeline, raw, chunk);
 	} else {
+		/* Keep the order of packets within the frame. */
+		sr_scpi_pipeline_flush(devc->pipeline, TRUE);
 		logic.length = len;
 		// TODO: For the MSO1000Z series, we need a way to express that
 		// this data is in fact just for a single channel, with the valid
@@ -759,7 +839,7 @@ SR_PRIV int rigol_ds_receive(int fd, int revents, void *cb_data)
 		/* End acquisition when data for all channels is acquired. */
 		if (!sr_scpi_read_complete(scpi) && !devc->channel_entry->next) {
 			sr_err("Read should have been completed");
-			std_session_send_df_frame_end(sdi);
+			sr_scpi_pipeline_frame_end(devc->pipeline, sdi);
 			sr_dev_acquisition_stop(sdi);
 			return TRUE;
 		}
@@ -793,7 +873,7 @@ SR_PRIV int rigol_ds_receive(int fd, int revents, void *cb_data)
 		rigol_ds_channel_start(sdi);
 	} else {
 		/* Done with this frame. */
-		std_session_send_df_frame_end(sdi);
+		sr_scpi_pipeline_frame_end(devc->pipeline, sdi);
 
 		if (++devc->num_frames == devc->limit_frames) {
 			/* Last frame, stop capture. */
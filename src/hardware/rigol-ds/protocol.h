@@ -34,6 +34,9 @@
 /* Maximum number of samples to retrieve at once. */
 #define ACQ_BLOCK_SIZE (30 * 1000)
 
+/* Number of received chunks which may await conversion. */
+#define ACQ_PIPELINE_DEPTH 4
+
 #define MAX_ANALOG_CHANNELS 4
 #define MAX_DIGITAL_CHANNELS 16
 
@@ -157,15 +160,17 @@ struct dev_context {
 	enum wait_events wait_event;
 	/* Trigger/block copying/stop waiting status */
 	int wait_status;
-	/* Acq buffers used for reading from the scope and sending data to app */
+	/* Acq buffer used for reading logic data from the scope */
 	unsigned char *buffer;
-	float *data;
+	/* Converts analog data while the next chunk gets fetched */
+	struct sr_scpi_pipeline *pipeline;
 };
 
 SR_PRIV int rigol_ds_config_set(const struct sr_dev_inst *sdi, const char *format, ...);
 SR_PRIV int rigol_ds_capture_start(const struct sr_dev_inst *sdi);
 SR_PRIV int rigol_ds_channel_start(const struct sr_dev_inst *sdi);
 SR_PRIV int rigol_ds_receive(int fd, int revents, void *cb_data);
+SR_PRIV struct sr_scpi_pipeline *rigol_ds_pipeline_new(const struct sr_dev_inst *sdi);
 SR_PRIV int rigol_ds_get_dev_cfg(const struct sr_dev_inst *sdi);
 SR_PRIV int rigol_ds_get_dev_cfg_vertical(const struct sr_dev_inst *sdi);
 
@@ -578,7 +578,7 @@ static int configure_channels(const struct sr_dev_inst *sdi)
 			continue;
 
 		mask = 1 << c->index;
-		devc->dig_channel_masks[devc->dig_channel_cnt++] = mask;
+		devc->dig_channel_cnt++;
 		devc->dig_channel_mask |= mask;
 
 	}
@@ -849,40 +849,36 @@ static void saleae_logic_pro_convert_data(const struct sr_dev_inst *sdi,
 					 const uint32_t *src, size_t srccnt)
 {
 	struct dev_context *devc = sdi->priv;
-	uint8_t *dst = devc->conv_buffer;
-	uint32_t samples;
-	uint16_t channel_mask;
-	unsigned int sample_index, batch_index;
-	uint16_t *dst_batch;
-
-	/* Copy partial batch to the beginning. */
-	memcpy(dst, dst + devc->conv_size, CONV_BATCH_SIZE);
-	/* Reset converted size. */
+	const uint8_t *data = (const uint8_t *)src;
+	size_t batch_size, num_batches, len, n;
+
+	batch_size = devc->dig_channel_cnt * 4;
+	len = srccnt * 4;
 	devc->conv_size = 0;
 
-	batch_index = devc->batch_index;
-	while (srccnt--) {
-		samples = *src++;
-		dst_batch = (uint16_t*)dst;
-
-		/* First index of the batch. */
-		if (batch_index == 0)
-			memset(dst, 0, CONV_BATCH_SIZE);
-
-		/* Convert one channel. */
-		channel_mask = devc->dig_channel_masks[batch_index];
-		for (sample_index = 0; sample_index <= 31; sample_index++)
-			if ((samples >> (31 - sample_index)) & 1)
-				dst_batch[sample_index] |= channel_mask;
-
-		/* Last index of the batch. */
-		if (++batch_index == devc->dig_channel_cnt) {
-			devc->conv_size += CONV_BATCH_SIZE;
-			batch_index = 0;
-			dst += CONV_BATCH_SIZE;
-		}
+	/* Complete the batch left over from the previous packet. */
+	if (devc->batch_index) {
+		n = MIN(batch_size - devc->batch_index, len);
+		memcpy(devc->batch + devc->batch_index, data, n);
+		devc->batch_index += n;
+		data += n;
+		len -= n;
+		if (devc->batch_index < batch_size)
+			return;
+		sr_logic_from_planar(devc->batch, 1, 32, TRUE,
+			devc->dig_channel_mask, devc->conv_buffer);
+		devc->conv_size += CONV_BATCH_SIZE;
+		devc->batch_index = 0;
 	}
-	devc->batch_index = batch_index;
+
+	num_batches = len / batch_size;
+	sr_logic_from_planar(data, num_batches, 32, TRUE,
+		devc->dig_channel_mask, devc->conv_buffer + devc->conv_size);
+	devc->conv_size += num_batches * CONV_BATCH_SIZE;
+
+	/* Keep the partial batch for the next packet. */
+	devc->batch_index = len - num_batches * batch_size;
+	memcpy(devc->batch, data + num_batches * batch_size, devc->batch_index);
 }
 
 SR_PRIV void LIBUSB_CALL saleae_logic_pro_receive_data(struct libusb_transfer *transfer)
@@ -39,7 +39,6 @@
 struct dev_context {
 	unsigned int dig_channel_cnt;
 	uint16_t dig_channel_mask;
-	uint16_t dig_channel_masks[16];
 	uint64_t dig_samplerate;
 
 	uint32_t lfsr;
@@ -50,7 +49,9 @@ struct dev_context {
 
 	uint8_t *conv_buffer;
 	unsigned int conv_size;
+	/* Bytes of the partial batch from the previous packet. */
 	unsigned int batch_index;
+	uint8_t batch[16 * 4];
 };
 
 SR_PRIV int saleae_logic_pro_init(const struct sr_dev_inst *sdi);
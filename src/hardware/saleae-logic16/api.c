@@ -37,7 +37,6 @@
 #define FX2_FIRMWARE		"saleae-logic16-fx2.fw"
 
 #define MAX_RENUM_DELAY_MS	3000
-#define NUM_SIMUL_TRANSFERS	32
 
 static const uint32_t scanopts[] = {
 	SR_CONF_CONN,
@@ -512,6 +511,7 @@ static void abort_acquisition(struct dev_context *devc)
 	int i;
 
 	devc->sent_samples = -1;
+	devc->acq_running = FALSE;
 
 	for (i = devc->num_transfers - 1; i >= 0; i--) {
 		if (devc->transfers[i])
@@ -519,46 +519,6 @@ static void abort_acquisition(struct dev_context *devc)
 	}
 }
 
-static unsigned int bytes_per_ms(struct dev_context *devc)
-{
-	return devc->cur_samplerate * devc->num_channels / 8000;
-}
-
-static size_t get_buffer_size(struct dev_context *devc)
-{
-	size_t s;
-
-	/*
-	 * The buffer should be large enough to hold 10ms of data and
-	 * a multiple of 512.
-	 */
-	s = 10 * bytes_per_ms(devc);
-	return (s + 511) & ~511;
-}
-
-static unsigned int get_number_of_transfers(struct dev_context *devc)
-{
-	unsigned int n;
-
-	/* Total buffer size should be able to hold about 500ms of data. */
-	n = 500 * bytes_per_ms(devc) / get_buffer_size(devc);
-
-	if (n > NUM_SIMUL_TRANSFERS)
-		return NUM_SIMUL_TRANSFERS;
-
-	return n;
-}
-
-static unsigned int get_timeout(struct dev_context *devc)
-{
-	size_t total_size;
-	unsigned int timeout;
-
-	total_size = get_buffer_size(devc) * get_number_of_transfers(devc);
-	timeout = total_size / bytes_per_ms(devc);
-	return timeout + timeout / 4; /* Leave a headroom of 25% percent. */
-}
-
 static int configure_channels(const struct sr_dev_inst *sdi)
 {
 	struct dev_context *devc;
@@ -578,17 +538,7 @@ static int configure_channels(const struct sr_dev_inst *sdi)
 		channel_bit = 1 << (ch->index);
 
 		devc->cur_channels |= channel_bit;
-
-#ifdef WORDS_BIGENDIAN
-		/*
-		 * Output logic data should be stored in little endian format.
-		 * To speed things up during conversion, do the switcharoo
-		 * here instead.
-		 */
-		channel_bit = 1 << (ch->index ^ 8);
-#endif
-
-		devc->channel_masks[devc->num_channels++] = channel_bit;
+		devc->num_channels++;
 	}
 
 	return SR_OK;
@@ -628,11 +578,9 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 	struct drv_context *drvc;
 	struct sr_usb_dev_inst *usb;
 	struct sr_trigger *trigger;
-	struct libusb_transfer *transfer;
-	unsigned int i, timeout, num_transfers;
+	unsigned int i;
 	int ret;
-	unsigned char *buf;
-	size_t size, convsize;
+	size_t convsize;
 
 	drvc = di->context;
 	devc = sdi->priv;
@@ -646,8 +594,7 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 
 	devc->sent_samples = 0;
 	devc->empty_transfer_count = 0;
-	devc->cur_channel = 0;
-	memset(devc->channel_data, 0, sizeof(devc->channel_data));
+	devc->partial_len = 0;
 
 	if ((trigger = sr_session_trigger_get(sdi->session))) {
 		int pre_trigger_samples = 0;
@@ -660,11 +607,16 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 	} else
 		devc->trigger_fired = TRUE;
 
-	timeout = get_timeout(devc);
-	num_transfers = get_number_of_transfers(devc);
-	size = get_buffer_size(devc);
-	convsize = (size / devc->num_channels + 2) * 16;
+	/*
+	 * Buffers hold 10ms of data and a multiple of 512 bytes, the
+	 * transfers about 500ms initially.
+	 */
+	usb_stream_init(&usb->stream,
+		devc->cur_samplerate * devc->num_channels / 8, 512, 10, 500,
+		NUM_SIMUL_TRANSFERS, MAX_SIMUL_TRANSFERS);
+	convsize = (usb->stream.buffer_size / devc->num_channels + 2) * 16;
 	devc->submitted_transfers = 0;
+	devc->num_transfers = 0;
 
 	devc->convbuffer_size = convsize;
 	if (!(devc->convbuffer = g_try_malloc(convsize))) {
@@ -672,7 +624,8 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 		return SR_ERR_MALLOC;
 	}
 
-	devc->transfers = g_try_malloc0(sizeof(*devc->transfers) * num_transfers);
+	devc->transfers = g_try_malloc0(sizeof(*devc->transfers) *
+		usb->stream.max_transfers);
 	if (!devc->transfers) {
 		sr_err("USB transfers malloc failed.");
 		g_free(devc->convbuffer);
@@ -686,37 +639,23 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 		return ret;
 	}
 
-	devc->num_transfers = num_transfers;
-	for (i = 0; i < num_transfers; i++) {
-		if (!(buf = g_try_malloc(size))) {
-			sr_err("USB transfer buffer malloc failed.");
+	for (i = 0; i < usb->stream.num_transfers; i++) {
+		if ((ret = logic16_add_transfer(sdi)) != SR_OK) {
 			if (devc->submitted_transfers)
 				abort_acquisition(devc);
 			else {
 				g_free(devc->transfers);
 				g_free(devc->convbuffer);
 			}
-			return SR_ERR_MALLOC;
-		}
-		transfer = libusb_alloc_transfer(0);
-		libusb_fill_bulk_transfer(transfer, usb->devhdl,
-				2 | LIBUSB_ENDPOINT_IN, buf, size,
-				logic16_receive_transfer, (void *)sdi, timeout);
-		if ((ret = libusb_submit_transfer(transfer)) != 0) {
-			sr_err("Failed to submit transfer: %s.",
-			       libusb_error_name(ret));
-			libusb_free_transfer(transfer);
-			g_free(buf);
-			abort_acquisition(devc);
-			return SR_ERR;
+			return ret;
 		}
-		devc->transfers[i] = transfer;
-		devc->submitted_transfers++;
 	}
+	devc->acq_running = TRUE;
 
 	devc->ctx = drvc->sr_ctx;
 
-	usb_source_add(sdi->session, devc->ctx, timeout, receive_data, (void *)sdi);
+	usb_source_add(sdi->session, devc->ctx, usb->stream.timeout,
+		receive_data, (void *)sdi);
 
 	std_session_send_df_header(sdi);
 
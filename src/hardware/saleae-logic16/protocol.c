@@ -749,15 +749,20 @@ SR_PRIV int logic16_init_device(const struct sr_dev_inst *sdi)
 static void finish_acquisition(struct sr_dev_inst *sdi)
 {
 	struct dev_context *devc;
+	struct sr_usb_dev_inst *usb;
 
 	devc = sdi->priv;
+	usb = sdi->conn;
 
 	std_session_send_df_end(sdi);
+	usb_stream_log(&usb->stream);
 
 	usb_source_remove(sdi->session, devc->ctx);
 
+	devc->acq_running = FALSE;
 	devc->num_transfers = 0;
 	g_free(devc->transfers);
+	devc->transfers = NULL;
 	g_free(devc->convbuffer);
 	if (devc->stl) {
 		soft_trigger_logic_free(devc->stl);
@@ -792,9 +797,15 @@ static void free_transfer(struct libusb_transfer *transfer)
 
 static void resubmit_transfer(struct libusb_transfer *transfer)
 {
+	struct sr_dev_inst *sdi;
+	struct sr_usb_dev_inst *usb;
 	int ret;
 
-	if ((ret = libusb_submit_transfer(transfer)) == LIBUSB_SUCCESS)
+	sdi = transfer->user_data;
+	usb = sdi->conn;
+
+	transfer->timeout = usb->stream.timeout;
+	if ((ret = usb_stream_submit(&usb->stream, transfer)) == LIBUSB_SUCCESS)
 		return;
 
 	free_transfer(transfer);
@@ -803,44 +814,115 @@ static void resubmit_transfer(struct libusb_transfer *transfer)
 	sr_err("%s: %s", __func__, libusb_error_name(ret));
 }
 
-static size_t convert_sample_data(struct dev_context *devc,
-		uint8_t *dest, size_t destcnt, const uint8_t *src, size_t srccnt)
+/**
+ * Set up and submit another transfer. The transfers array has room for
+ * the maximum number of transfers.
+ *
+ * @param sdi The device instance.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_MALLOC Memory allocation failure.
+ * @retval SR_ERR Transfer submission failure.
+ *
+ * @private
+ */
+SR_PRIV int logic16_add_transfer(const struct sr_dev_inst *sdi)
 {
-	uint16_t *channel_data;
-	int i, cur_channel;
-	size_t ret = 0;
-	uint16_t sample, channel_mask;
+	struct dev_context *devc;
+	struct sr_usb_dev_inst *usb;
+	struct libusb_transfer *transfer;
+	unsigned int i;
+	int ret;
+	unsigned char *buf;
 
-	srccnt /= 2;
+	devc = sdi->priv;
+	usb = sdi->conn;
+
+	i = devc->num_transfers;
+	if (i >= usb->stream.max_transfers)
+		return SR_ERR_BUG;
+
+	if (!(buf = g_try_malloc(usb->stream.buffer_size))) {
+		sr_err("USB transfer buffer malloc failed.");
+		return SR_ERR_MALLOC;
+	}
+	transfer = libusb_alloc_transfer(0);
+	libusb_fill_bulk_transfer(transfer, usb->devhdl,
+			2 | LIBUSB_ENDPOINT_IN, buf, usb->stream.buffer_size,
+			logic16_receive_transfer, (void *)sdi, usb->stream.timeout);
+	if ((ret = usb_stream_submit(&usb->stream, transfer)) != 0) {
+		sr_err("Failed to submit transfer: %s.",
+		       libusb_error_name(ret));
+		libusb_free_transfer(transfer);
+		g_free(buf);
+		return SR_ERR;
+	}
+	devc->transfers[i] = transfer;
+	devc->num_transfers = i + 1;
+	devc->submitted_transfers++;
 
-	channel_data = devc->channel_data;
-	cur_channel = devc->cur_channel;
+	return SR_OK;
+}
 
-	while (srccnt--) {
-		sample = src[0] | (src[1] << 8);
-		src += 2;
+/* Grow the pool of transfers, after a late completion. */
+static void add_transfers(const struct sr_dev_inst *sdi, unsigned int count)
+{
+	struct dev_context *devc;
 
-		channel_mask = devc->channel_masks[cur_channel];
+	devc = sdi->priv;
 
-		for (i = 15; i >= 0; --i, sample >>= 1)
-			if (sample & 1)
-				channel_data[i] |= channel_mask;
+	while (count-- > 0 && devc->acq_running) {
+		if (logic16_add_transfer(sdi) != SR_OK)
+			break;
+	}
+}
 
-		if (++cur_channel == devc->num_channels) {
-			cur_channel = 0;
-			if (destcnt < 16 * 2) {
-				sr_err("Conversion buffer too small!");
-				break;
-			}
-			memcpy(dest, channel_data, 16 * 2);
-			memset(channel_data, 0, 16 * 2);
-			dest += 16 * 2;
-			ret += 16;
-			destcnt -= 16 * 2;
+/*
+ * The device sends a 16bit word of 16 samples per enabled channel, most
+ * significant bit first. A block of such words may span transfers.
+ */
+static size_t convert_sample_data(struct dev_context *devc,
+		uint8_t *dest, size_t destcnt, const uint8_t *src, size_t srccnt)
+{
+	size_t block_size, num_blocks, len, ret;
+
+	block_size = devc->num_channels * 2;
+	srccnt &= ~(size_t)1;
+	ret = 0;
+
+	/* Complete the block left over from the previous transfer. */
+	if (devc->partial_len) {
+		len = MIN(block_size - devc->partial_len, srccnt);
+		memcpy(devc->partial + devc->partial_len, src, len);
+		devc->partial_len += len;
+		src += len;
+		srccnt -= len;
+		if (devc->partial_len < block_size)
+			return 0;
+		devc->partial_len = 0;
+		if (destcnt < 16 * 2) {
+			sr_err("Conversion buffer too small!");
+			return 0;
 		}
+		sr_logic_from_planar(devc->partial, 1, 16, TRUE,
+			devc->cur_channels, dest);
+		dest += 16 * 2;
+		destcnt -= 16 * 2;
+		ret += 16;
 	}
 
-	devc->cur_channel = cur_channel;
+	num_blocks = srccnt / block_size;
+	if (num_blocks > destcnt / (16 * 2)) {
+		sr_err("Conversion buffer too small!");
+		num_blocks = destcnt / (16 * 2);
+		srccnt = num_blocks * block_size;
+	}
+	sr_logic_from_planar(src, num_blocks, 16, TRUE, devc->cur_channels, dest);
+	ret += 16 * num_blocks;
+
+	/* Keep the rest for the next transfer. */
+	devc->partial_len = srccnt - num_blocks * block_size;
+	memcpy(devc->partial, src + num_blocks * block_size, devc->partial_len);
 
 	return ret;
 }
@@ -852,12 +934,17 @@ SR_PRIV void LIBUSB_CALL logic16_receive_transfer(struct libusb_transfer *transf
 	struct sr_datafeed_logic logic;
 	struct sr_dev_inst *sdi;
 	struct dev_context *devc;
+	struct sr_usb_dev_inst *usb;
 	size_t new_samples, num_samples;
 	int trigger_offset;
 	int pre_trigger_samples;
+	unsigned int grow;
 
 	sdi = transfer->user_data;
 	devc = sdi->priv;
+	usb = sdi->conn;
+
+	grow = usb_stream_completed(&usb->stream, transfer);
 
 	/*
 	 * If acquisition has already ended, just free any queued up
@@ -914,6 +1001,7 @@ SR_PRIV void LIBUSB_CALL logic16_receive_transfer(struct libusb_transfer *transf
 
 	if (new_samples <= 0) {
 		resubmit_transfer(transfer);
+		add_transfers(sdi, grow);
 		return;
 	}
 
@@ -959,4 +1047,5 @@ SR_PRIV void LIBUSB_CALL logic16_receive_transfer(struct libusb_transfer *transf
 	}
 
 	resubmit_transfer(transfer);
+	add_transfers(sdi, grow);
 }
@@ -29,6 +29,9 @@
 
 #define LOG_PREFIX "saleae-logic16"
 
+#define NUM_SIMUL_TRANSFERS	32
+#define MAX_SIMUL_TRANSFERS	(NUM_SIMUL_TRANSFERS * 4)
+
 enum voltage_range {
 	VOLTAGE_RANGE_UNKNOWN,
 	VOLTAGE_RANGE_18_33_V,	/* 1.8V and 3.3V logic */
@@ -75,12 +78,14 @@ struct dev_context {
 	uint8_t eeprom_data[8];
 
 	int64_t sent_samples;
+	/* Transfers are set up, and the pool may grow. */
+	gboolean acq_running;
 	int submitted_transfers;
 	int empty_transfer_count;
 	int num_channels;
-	int cur_channel;
-	uint16_t channel_masks[16];
-	uint16_t channel_data[16];
+	/* Part of a block of channel words, from the previous transfer. */
+	uint8_t partial[16 * 2];
+	size_t partial_len;
 	uint8_t *convbuffer;
 	size_t convbuffer_size;
 	struct soft_trigger_logic *stl;
@@ -100,6 +105,7 @@ SR_PRIV int logic16_setup_acquisition(const struct sr_dev_inst *sdi,
 SR_PRIV int logic16_start_acquisition(const struct sr_dev_inst *sdi);
 SR_PRIV int logic16_abort_acquisition(const struct sr_dev_inst *sdi);
 SR_PRIV int logic16_init_device(const struct sr_dev_inst *sdi);
+SR_PRIV int logic16_add_transfer(const struct sr_dev_inst *sdi);
 SR_PRIV void LIBUSB_CALL logic16_receive_transfer(struct libusb_transfer *transfer);
 
 #endif
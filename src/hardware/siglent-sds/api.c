@@ -891,6 +891,8 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 	sr_scpi_source_add(sdi->session, scpi, G_IO_IN, 7000,
 		siglent_sds_receive, (void *) sdi);
 
+	devc->pipeline = siglent_sds_pipeline_new(sdi);
+
 	std_session_send_df_header(sdi);
 
 	devc->channel_entry = devc->enabled_channels;
@@ -911,6 +913,10 @@ static int dev_acquisition_stop(struct sr_dev_inst *sdi)
 
 	devc = sdi->priv;
 
+	/* Send the analog data which is still being converted. */
+	sr_scpi_pipeline_free(devc->pipeline);
+	devc->pipeline = NULL;
+
 	std_session_send_df_end(sdi);
 
 	g_slist_free(devc->enabled_channels);
@@ -315,7 +315,7 @@ static int siglent_sds_read_header(struct sr_dev_inst *sdi)
 	long data_length = 0;
 
 	/* Read header from device. */
-	ret = sr_scpi_read_data(scpi, buf, SIGLENT_HEADER_SIZE);
+	ret = sr_scpi_read_exact(scpi, buf, SIGLENT_HEADER_SIZE);
 	if (ret < SIGLENT_HEADER_SIZE) {
 		sr_err("Read error while reading data header.");
 		return SR_ERR;
@@ -453,19 +453,82 @@ static int siglent_sds_get_digital(const struct sr_dev_inst *sdi, struct sr_chan
 	return len;
 }
 
-SR_PRIV int siglent_sds_receive(int fd, int revents, void *cb_data)
+/* What it takes to convert and send a block of analog data. */
+struct analog_block {
+	struct sr_channel *ch;
+	float vdiv, offset;
+};
+
+/* Runs on the pipeline's worker thread. */
+static void analog_block_convert(struct sr_scpi_block *block, void *cb_data)
 {
-	struct sr_dev_inst *sdi;
-	struct sr_scpi_dev_inst *scpi;
-	struct dev_context *devc;
+	struct analog_block *ab;
+	const int8_t *raw;
+	float *data;
+	size_t i, len;
+
+	(void)cb_data;
+
+	ab = block->priv;
+	raw = (const int8_t *)block->raw->data;
+	len = block->raw->len;
+	data = g_malloc(len * sizeof(float));
+
+	for (i = 0; i < len; i++)
+		data[i] = (ab->vdiv * ((float)raw[i] / 25)) - ab->offset;
+
+	block->data = data;
+	block->num_samples = len;
+}
+
+static void analog_block_send(struct sr_scpi_block *block, void *cb_data)
+{
+	const struct sr_dev_inst *sdi;
+	struct analog_block *ab;
 	struct sr_datafeed_packet packet;
 	struct sr_datafeed_analog analog;
 	struct sr_analog_encoding encoding;
 	struct sr_analog_meaning meaning;
 	struct sr_analog_spec spec;
+	float vdivlog;
+	int digits;
+
+	sdi = cb_data;
+	ab = block->priv;
+
+	vdivlog = log10f(ab->vdiv);
+	digits = -(int) vdivlog + (vdivlog < 0.0);
+	sr_analog_init(&analog, &encoding, &meaning, &spec, digits);
+	analog.meaning->channels = g_slist_append(NULL, ab->ch);
+	analog.num_samples = block->num_samples;
+	analog.data = block->data;
+	analog.meaning->mq = SR_MQ_VOLTAGE;
+	analog.meaning->unit = SR_UNIT_VOLT;
+	analog.meaning->mqflags = 0;
+	packet.type = SR_DF_ANALOG;
+	packet.payload = &analog;
+	sr_session_send(sdi, &packet);
+	g_slist_free(analog.meaning->channels);
+
+	g_free(ab);
+}
+
+SR_PRIV struct sr_scpi_pipeline *siglent_sds_pipeline_new(const struct sr_dev_inst *sdi)
+{
+	return sr_scpi_pipeline_new(analog_block_convert, analog_block_send,
+		(void *)sdi, ACQ_PIPELINE_DEPTH);
+}
+
+SR_PRIV int siglent_sds_receive(int fd, int revents, void *cb_data)
+{
+	struct sr_dev_inst *sdi;
+	struct sr_scpi_dev_inst *scpi;
+	struct dev_context *devc;
+	struct sr_datafeed_packet packet;
 	struct sr_datafeed_logic logic;
 	struct sr_channel *ch;
-	int len, i;
+	struct analog_block *ab;
+	int len;
 	float wait;
 	gboolean read_complete = FALSE;
 
@@ -479,6 +542,9 @@ SR_PRIV int siglent_sds_receive(int fd, int revents, void *cb_data)
 
 	scpi = sdi->conn;
 
+	/* Send what has been converted in the meantime. */
+	sr_scpi_pipeline_flush(devc->pipeline, FALSE);
+
 	if (!(revents == G_IO_IN || revents == 0))
 		return TRUE;
 
@@ -539,7 +605,7 @@ SR_PRIV int siglent_sds_receive(int fd, int revents, void *cb_data)
 				return TRUE;
 			if (len == -1) {
 				sr_err("Read error, aborting capture.");
-				std_session_send_df_frame_end(sdi);
+				sr_scpi_pipeline_frame_end(devc->pipeline, sdi);
 				sdi->driver->dev_acquisition_stop(sdi);
 				return TRUE;
 			}
@@ -548,7 +614,7 @@ SR_PRIV int siglent_sds_receive(int fd, int revents, void *cb_data)
 
 			if (len == -1) {
 				sr_err("Read error, aborting capture.");
-				std_session_send_df_frame_end(sdi);
+				sr_scpi_pipeline_frame_end(devc->pipeline, sdi);
 				sdi->driver->dev_acquisition_stop(sdi);
 				return TRUE;
 			}
@@ -565,7 +631,7 @@ SR_PRIV int siglent_sds_receive(int fd, int revents, void *cb_data)
 					len = sr_scpi_read_data(scpi, (char *)devc->buffer, devc->num_samples-devc->num_block_bytes);
 					if (len == -1) {
 						sr_err("Read error, aborting capture.");
-						std_session_send_df_frame_end(sdi);
+						sr_scpi_pipeline_frame_end(devc->pipeline, sdi);
 						sdi->driver->dev_acquisition_stop(sdi);
 						return TRUE;
 					}
@@ -574,35 +640,14 @@ SR_PRIV int siglent_sds_receive(int fd, int revents, void *cb_data)
 				}
 				sr_dbg("Received block: %i, %d bytes.", devc->num_block_read, len);
 				if (ch->type == SR_CHANNEL_ANALOG) {
-					float vdiv = devc->vdiv[ch->index];
-					float offset = devc->vert_offset[ch->index];
-					GArray *float_data;
-					static GArray *data;
-					float voltage, vdivlog;
-					int digits;
-
-					data = g_array_sized_new(FALSE, FALSE, sizeof(uint8_t), len);
-					g_array_append_vals(data, devc->buffer, len);
-					float_data = g_array_new(FALSE, FALSE, sizeof(float));
-					for (i = 0; i < len; i++) {
-						voltage = (float)g_array_index(data, int8_t, i) / 25;
-						voltage = ((vdiv * voltage) - offset);
-						g_array_append_val(float_data, voltage);
-					}
-					vdivlog = log10f(vdiv);
-					digits = -(int) vdivlog + (vdivlog < 0.0);
-					sr_analog_init(&analog, &encoding, &meaning, &spec, digits);
-					analog.meaning->channels = g_slist_append(NULL, ch);
-					analog.num_samples = float_data->len;
-					analog.data = (float *)float_data->data;
-					analog.meaning->mq = SR_MQ_VOLTAGE;
-					analog.meaning->unit = SR_UNIT_VOLT;
-					analog.meaning->mqflags = 0;
-					packet.type = SR_DF_ANALOG;
-					packet.payload = &analog;
-					sr_session_send(sdi, &packet);
-					g_slist_free(analog.meaning->channels);
-					g_array_free(data, TRUE);
+					/* Convert on the worker while the next block gets read. */
+					ab = g_malloc(sizeof(*ab));
+					ab->ch = ch;
+					ab->vdiv = devc->vdiv[ch->index];
+					ab->offset = devc->vert_offset[ch->index];
+					sr_scpi_pipeline_push(devc->pipeline,
+						g_byte_array_append(g_byte_array_sized_new(len),
+							devc->buffer, len), ab);
 				}
 				len = 0;
 				if (devc->num_samples == (devc->num_block_bytes - SIGLENT_HEADER_SIZE)) {
@@ -612,7 +657,7 @@ SR_PRIV int siglent_sds_receive(int fd, int revents, void *cb_data)
 					read_complete = TRUE;
 					if (!sr_scpi_read_complete(scpi)) {
 						sr_err("Read should have been completed.");
-						std_session_send_df_frame_end(sdi);
+						sr_scpi_pipeline_frame_end(devc->pipeline, sdi);
 						sdi->driver->dev_acquisition_stop(sdi);
 						return TRUE;
 					}
@@ -629,7 +674,7 @@ SR_PRIV int siglent_sds_receive(int fd, int revents, void *cb_data)
 				siglent_sds_channel_start(sdi);
 			} else {
 				/* Done with this frame. */
-				std_session_send_df_frame_end(sdi);
+				sr_scpi_pipeline_frame_end(devc->pipeline, sdi);
 				if (++devc->num_frames == devc->limit_frames) {
 					/* Last frame, stop capture. */
 					sdi->driver->dev_acquisition_stop(sdi);
@@ -646,13 +691,15 @@ SR_PRIV int siglent_sds_receive(int fd, int revents, void *cb_data)
 	} else {
 		if (!siglent_sds_get_digital(sdi, ch))
 			return TRUE;
+		/* Keep the order of packets within the frame. */
+		sr_scpi_pipeline_flush(devc->pipeline, TRUE);
 		logic.length = devc->dig_buffer->len;
 		logic.unitsize = 2;
 		logic.data = devc->dig_buffer->data;
 		packet.type = SR_DF_LOGIC;
 		packet.payload = &logic;
 		sr_session_send(sdi, &packet);
-		std_session_send_df_frame_end(sdi);
+		sr_scpi_pipeline_frame_end(devc->pipeline, sdi);
 		sdi->driver->dev_acquisition_stop(sdi);
 
 		if (++devc->num_frames == devc->limit_frames) {
@@ -31,6 +31,9 @@
 //#define ACQ_BUFFER_SIZE (6000000)
 #define ACQ_BUFFER_SIZE (18000000)
 
+/* Number of received blocks which may await conversion. */
+#define ACQ_PIPELINE_DEPTH 4
+
 #define SIGLENT_HEADER_SIZE 363
 #define SIGLENT_DIG_HEADER_SIZE 346
 
@@ -153,6 +156,8 @@ struct dev_context {
 	unsigned char *buffer;
 	float *data;
 	GArray *dig_buffer;
+	/* Converts analog data while the next block gets fetched. */
+	struct sr_scpi_pipeline *pipeline;
 };
 
 SR_PRIV int siglent_sds_config_set(const struct sr_dev_inst *sdi,
@@ -160,6 +165,7 @@ SR_PRIV int siglent_sds_config_set(const struct sr_dev_inst *sdi,
 SR_PRIV int siglent_sds_capture_start(const struct sr_dev_inst *sdi);
 SR_PRIV int siglent_sds_channel_start(const struct sr_dev_inst *sdi);
 SR_PRIV int siglent_sds_receive(int fd, int revents, void *cb_data);
+SR_PRIV struct sr_scpi_pipeline *siglent_sds_pipeline_new(const struct sr_dev_inst *sdi);
 SR_PRIV int siglent_sds_get_dev_cfg(const struct sr_dev_inst *sdi);
 SR_PRIV int siglent_sds_get_dev_cfg_vertical(const struct sr_dev_inst *sdi);
 SR_PRIV int siglent_sds_get_dev_cfg_horizontal(const struct sr_dev_inst *sdi);
@@ -231,6 +231,8 @@ static struct sr_key_info sr_key_info_config[] = {
 		"Device mode", NULL},
 	{SR_CONF_TEST_MODE, SR_T_STRING, "test_mode",
 		"Test mode", NULL},
+	{SR_CONF_SAMPLE_OFFSET, SR_T_UINT64, "sample_offset",
+		"Sample offset", NULL},
 
 	ALL_ZERO
 };
@@ -32,17 +32,91 @@
 #define CHUNK_SIZE           (4 * 1024 * 1024)
 #define DEFAULT_NUM_CHANNELS 8
 #define DEFAULT_SAMPLERATE   0
+#define DEFAULT_THREADS      0
+#define DEFAULT_BLOCKSIZE    CHUNK_SIZE
 
 struct context {
 	gboolean started;
 	uint64_t samplerate;
 	uint16_t unitsize;
+	/* Workers splitting samples into planes, for consumers taking those. */
+	struct sr_input_pool *pool;
+	uint32_t *channels;
+	uint32_t num_channels;
 };
 
+/* Describe the planes of a block of samples. */
+static void block_planar(const struct context *inc, gsize len, uint8_t *out,
+		struct sr_datafeed_logic_planar *planar)
+{
+	planar->num_samples = len / inc->unitsize;
+	planar->unitsize = inc->unitsize;
+	planar->num_planes = inc->num_channels;
+	planar->channels = inc->channels;
+	planar->stride = (planar->num_samples + 7) / 8;
+	planar->data = out;
+}
+
+static int convert_block(const uint8_t *data, gsize len, uint8_t *out,
+		void *cb_data)
+{
+	struct sr_input *in;
+	struct sr_datafeed_logic logic;
+	struct sr_datafeed_logic_planar planar;
+
+	in = cb_data;
+	logic.length = len;
+	logic.unitsize = ((struct context *)in->priv)->unitsize;
+	logic.data = (void *)data;
+	block_planar(in->priv, len, out, &planar);
+	sr_logic_planar_unpack(&logic, &planar);
+
+	return SR_OK;
+}
+
+static int send_block(const uint8_t *data, gsize len, const uint8_t *out,
+		void *cb_data)
+{
+	struct sr_input *in;
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_logic_planar planar;
+
+	(void)data;
+
+	in = cb_data;
+	block_planar(in->priv, len, (uint8_t *)out, &planar);
+	packet.type = SR_DF_LOGIC_PLANAR;
+	packet.payload = &planar;
+
+	return sr_session_send(in->sdi, &packet);
+}
+
+static int init_pool(struct sr_input *in, int num_threads, uint64_t block_size)
+{
+	struct context *inc;
+	uint64_t block_samples;
+	uint32_t i;
+
+	inc = in->priv;
+	inc->num_channels = g_slist_length(in->sdi->channels);
+	inc->channels = g_malloc(inc->num_channels * sizeof(uint32_t));
+	for (i = 0; i < inc->num_channels; i++)
+		inc->channels[i] = i;
+
+	block_samples = MAX(block_size / inc->unitsize, 1);
+	inc->pool = sr_input_pool_new(num_threads,
+		block_samples * inc->unitsize,
+		inc->num_channels * ((block_samples + 7) / 8),
+		convert_block, send_block, in);
+
+	return inc->pool ? SR_OK : SR_ERR_MALLOC;
+}
+
 static int init(struct sr_input *in, GHashTable *options)
 {
 	struct context *inc;
-	int num_channels, i;
+	int num_channels, num_threads, i;
+	uint64_t block_size;
 	char name[16];
 
 	num_channels = g_variant_get_int32(g_hash_table_lookup(options, "numchannels"));
@@ -51,6 +125,13 @@ static int init(struct sr_input *in, GHashTable *options)
 		return SR_ERR_ARG;
 	}
 
+	num_threads = g_variant_get_int32(g_hash_table_lookup(options, "threads"));
+	if (num_threads < 0) {
+		sr_err("Invalid value for threads: must not be negative.");
+		return SR_ERR_ARG;
+	}
+	block_size = g_variant_get_uint64(g_hash_table_lookup(options, "blocksize"));
+
 	in->sdi = g_malloc0(sizeof(struct sr_dev_inst));
 	in->priv = inc = g_malloc0(sizeof(struct context));
 
@@ -63,18 +144,21 @@ static int init(struct sr_input *in, GHashTable *options)
 
 	inc->unitsize = (g_slist_length(in->sdi->channels) + 7) / 8;
 
+	if (num_threads)
+		return init_pool(in, num_threads, block_size);
+
 	return SR_OK;
 }
 
-static int process_buffer(struct sr_input *in)
+/* Send whole samples, in chunks. */
+static int send_samples(struct sr_input *in, const uint8_t *data, gsize size)
 {
 	struct sr_datafeed_packet packet;
 	struct sr_datafeed_meta meta;
 	struct sr_datafeed_logic logic;
 	struct sr_config *src;
 	struct context *inc;
-	gsize chunk_size, i;
-	int chunk;
+	gsize i, chunk;
 
 	inc = in->priv;
 	if (!inc->started) {
@@ -93,39 +177,77 @@ static int process_buffer(struct sr_input *in)
 		inc->started = TRUE;
 	}
 
+	/* Split blocks of samples into planes on the workers. */
+	if (inc->pool && sr_session_logic_planar_wanted(in->sdi)) {
+		if (!size)
+			return SR_OK;
+		return sr_input_pool_run(inc->pool, data, size);
+	}
+
 	packet.type = SR_DF_LOGIC;
 	packet.payload = &logic;
 	logic.unitsize = inc->unitsize;
 
-	/* Cut off at multiple of unitsize. */
-	chunk_size = in->buf->len / logic.unitsize * logic.unitsize;
-
-	for (i = 0; i < chunk_size; i += chunk) {
-		logic.data = in->buf->str + i;
-		chunk = MIN(CHUNK_SIZE, chunk_size - i);
+	/* Packets must not split samples. */
+	for (i = 0; i < size; i += chunk) {
+		logic.data = (uint8_t *)data + i;
+		chunk = MIN(CHUNK_SIZE / logic.unitsize * logic.unitsize, size - i);
 		logic.length = chunk;
 		sr_session_send(in->sdi, &packet);
 	}
-	g_string_erase(in->buf, 0, chunk_size);
 
 	return SR_OK;
 }
 
-static int receive(struct sr_input *in, GString *buf)
+static int process_buffer(struct sr_input *in)
 {
+	struct context *inc;
+	gsize chunk_size;
 	int ret;
 
-	g_string_append_len(in->buf, buf->str, buf->len);
+	inc = in->priv;
+
+	/* Cut off at multiple of unitsize. */
+	chunk_size = in->buf->len / inc->unitsize * inc->unitsize;
+
+	ret = send_samples(in, (const uint8_t *)in->buf->str, chunk_size);
+	g_string_erase(in->buf, 0, chunk_size);
+
+	return ret;
+}
+
+static int consume(struct sr_input *in, const uint8_t *data, gsize len)
+{
+	struct context *inc;
+	gsize fill, size;
+	int ret;
 
 	if (!in->sdi_ready) {
+		g_string_append_len(in->buf, (const char *)data, len);
 		/* sdi is ready, notify frontend. */
 		in->sdi_ready = TRUE;
 		return SR_OK;
 	}
 
-	ret = process_buffer(in);
+	/* Complete the sample left over from before, if any. */
+	inc = in->priv;
+	if (in->buf->len) {
+		fill = (inc->unitsize - in->buf->len % inc->unitsize) % inc->unitsize;
+		fill = MIN(fill, len);
+		g_string_append_len(in->buf, (const char *)data, fill);
+		data += fill;
+		len -= fill;
+		if ((ret = process_buffer(in)) != SR_OK)
+			return ret;
+	}
 
-	return ret;
+	/* Send the rest in place, and keep a partial sample. */
+	size = len / inc->unitsize * inc->unitsize;
+	if ((ret = send_samples(in, data, size)) != SR_OK)
+		return ret;
+	g_string_append_len(in->buf, (const char *)data + size, len - size);
+
+	return SR_OK;
 }
 
 static int end(struct sr_input *in)
@@ -158,6 +280,8 @@ static int reset(struct sr_input *in)
 static struct sr_option options[] = {
 	{ "numchannels", "Number of logic channels", "The number of (logic) channels in the data", NULL, NULL },
 	{ "samplerate", "Sample rate (Hz)", "The sample rate of the (logic) data in Hz", NULL, NULL },
+	{ "threads", "Conversion threads", "The number of threads splitting samples into per-channel planes for consumers taking those, 0 to send samples as they are", NULL, NULL },
+	{ "blocksize", "Conversion block size", "The number of bytes each thread converts at a time", NULL, NULL },
 	ALL_ZERO
 };
 
@@ -166,11 +290,22 @@ static const struct sr_option *get_options(void)
 	if (!options[0].def) {
 		options[0].def = g_variant_ref_sink(g_variant_new_int32(DEFAULT_NUM_CHANNELS));
 		options[1].def = g_variant_ref_sink(g_variant_new_uint64(DEFAULT_SAMPLERATE));
+		options[2].def = g_variant_ref_sink(g_variant_new_int32(DEFAULT_THREADS));
+		options[3].def = g_variant_ref_sink(g_variant_new_uint64(DEFAULT_BLOCKSIZE));
 	}
 
 	return options;
 }
 
+static void cleanup(struct sr_input *in)
+{
+	struct context *inc;
+
+	inc = in->priv;
+	sr_input_pool_free(inc->pool);
+	g_free(inc->channels);
+}
+
 SR_PRIV struct sr_input_module input_binary = {
 	.id = "binary",
 	.name = "Binary",
@@ -178,7 +313,8 @@ SR_PRIV struct sr_input_module input_binary = {
 	.exts = NULL,
 	.options = get_options,
 	.init = init,
-	.receive = receive,
+	.consume = consume,
 	.end = end,
 	.reset = reset,
+	.cleanup = cleanup,
 };
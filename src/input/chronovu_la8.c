@@ -127,7 +127,11 @@ static int init(struct sr_input *in, GHashTable *options)
 	return SR_OK;
 }
 
-static int process_buffer(struct sr_input *in)
+/*
+ * Send whole samples, in chunks. Returns how much of the data was sent,
+ * which stops short of the "header".
+ */
+static gsize send_samples(struct sr_input *in, const uint8_t *data, gsize size)
 {
 	struct sr_datafeed_packet packet;
 	struct sr_datafeed_meta meta;
@@ -165,38 +169,60 @@ static int process_buffer(struct sr_input *in)
 	logic.unitsize = unitsize;
 
 	/* Cut off at multiple of unitsize. Avoid sending the "header". */
-	chunk_size = in->buf->len / logic.unitsize * logic.unitsize;
+	chunk_size = size / logic.unitsize * logic.unitsize;
 	chunk_size = MIN(chunk_size, inc->samples_remain * unitsize);
 
 	for (i = 0; i < chunk_size; i += chunk) {
-		logic.data = in->buf->str + i;
-		chunk = MIN(CHUNK_SIZE, chunk_size - i);
+		logic.data = (uint8_t *)data + i;
+		chunk = MIN(CHUNK_SIZE / unitsize * unitsize, chunk_size - i);
 		if (chunk) {
 			logic.length = chunk;
 			sr_session_send(in->sdi, &packet);
 			inc->samples_remain -= chunk / unitsize;
 		}
 	}
+
+	return chunk_size;
+}
+
+static int process_buffer(struct sr_input *in)
+{
+	gsize chunk_size;
+
+	chunk_size = send_samples(in, (const uint8_t *)in->buf->str,
+		in->buf->len);
 	g_string_erase(in->buf, 0, chunk_size);
 
 	return SR_OK;
 }
 
-static int receive(struct sr_input *in, GString *buf)
+static int consume(struct sr_input *in, const uint8_t *data, gsize len)
 {
-	int ret;
-
-	g_string_append_len(in->buf, buf->str, buf->len);
+	gsize unitsize, fill, sent;
 
 	if (!in->sdi_ready) {
+		g_string_append_len(in->buf, (const char *)data, len);
 		/* sdi is ready, notify frontend. */
 		in->sdi_ready = TRUE;
 		return SR_OK;
 	}
 
-	ret = process_buffer(in);
+	/* Complete the sample left over from before, if any. */
+	unitsize = (g_slist_length(in->sdi->channels) + 7) / 8;
+	if (in->buf->len) {
+		fill = (unitsize - in->buf->len % unitsize) % unitsize;
+		fill = MIN(fill, len);
+		g_string_append_len(in->buf, (const char *)data, fill);
+		data += fill;
+		len -= fill;
+		process_buffer(in);
+	}
+
+	/* Send the rest in place, unless past the samples already. */
+	sent = in->buf->len ? 0 : send_samples(in, data, len);
+	g_string_append_len(in->buf, (const char *)data + sent, len - sent);
 
-	return ret;
+	return SR_OK;
 }
 
 static int end(struct sr_input *in)
@@ -251,7 +277,7 @@ SR_PRIV struct sr_input_module input_chronovu_la8 = {
 	.options = get_options,
 	.format_match = format_match,
 	.init = init,
-	.receive = receive,
+	.consume = consume,
 	.end = end,
 	.reset = reset,
 };
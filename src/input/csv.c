@@ -253,8 +253,13 @@ struct context {
 	int *analog_datafeed_digits;
 	GSList **analog_datafeed_channels;
 
-	/* Current line number. */
+	/* Current line number, read position in the input buffer. */
 	size_t line_number;
+	size_t buf_pos;
+
+	/* Columns of the current line, NULL terminated. */
+	char **columns;
+	size_t columns_size;
 
 	/* List of previously created sigrok channels. */
 	GSList *prev_sr_channels;
@@ -742,32 +747,86 @@ static const struct column_details *lookup_column_details(struct context *inc, s
  * columns.
  */
 
-static void strip_comment(char *buf, const GString *prefix)
+/*
+ * Find the next occurrence of a (short) text in a memory range. This
+ * is a cheap memchr() scan for the text's first character in the
+ * common case of single character delimiters or line terminations.
+ */
+static char *find_text(char *p, const char *end, const char *text, size_t len)
+{
+	while (p < end && (p = memchr(p, text[0], end - p))) {
+		if (len == 1)
+			return p;
+		if ((size_t)(end - p) >= len && !memcmp(p, text, len))
+			return p;
+		p++;
+	}
+
+	return NULL;
+}
+
+static size_t strip_comment(char *buf, size_t len, const GString *prefix)
 {
 	char *ptr;
 
 	if (!prefix->len)
-		return;
+		return len;
 
 	if ((ptr = strstr(buf, prefix->str))) {
 		*ptr = '\0';
 		g_strstrip(buf);
+		len = strlen(buf);
 	}
+
+	return len;
 }
 
 /**
  * Splits a text line into a set of columns.
  *
- * @param[in] buf	The input text line to split.
+ * @param[in] buf	The input text line to split, gets modified.
+ * @param[in] len	The length of the text line.
  * @param[in] inc	The input module's context.
+ * @param[in] max_count	The number of columns of interest, 0 for all.
  *
- * @returns An array of strings, representing the columns' text.
+ * @returns The number of columns found, up to @a max_count.
  *
  * This routine splits a text line on previously determined separators.
+ * The separators get replaced by NUL characters in place, the columns'
+ * text is referenced from the context's columns[] array which is NULL
+ * terminated. The array is kept across lines, such that splitting does
+ * not allocate memory in the steady state. When @a max_count is given,
+ * text after that many columns remains unsplit but is not referenced.
  */
-static char **split_line(char *buf, struct context *inc)
+static size_t split_line(char *buf, size_t len, struct context *inc,
+	size_t max_count)
 {
-	return g_strsplit(buf, inc->delimiter->str, 0);
+	const char *delim, *end;
+	size_t delim_len, count;
+	char *sep;
+
+	delim = inc->delimiter->str;
+	delim_len = inc->delimiter->len;
+	end = buf + len;
+	count = 0;
+	for (;;) {
+		if (count + 1 >= inc->columns_size) {
+			inc->columns_size = MAX(2 * inc->columns_size, 16);
+			inc->columns = g_renew(char *, inc->columns,
+				inc->columns_size);
+		}
+		inc->columns[count++] = buf;
+		sep = find_text(buf, end, delim, delim_len);
+		if (!sep)
+			break;
+		*sep = '\0';
+		buf = sep + delim_len;
+		if (max_count && count == max_count)
+			break;
+	}
+	inc->columns[count] = NULL;
+
+	return count;
 }
 
 /**
@@ -1343,16 +1402,16 @@ static int initial_parse(const struct sr_input *in, GString *buf)
 {
 	struct context *inc;
 	size_t num_columns;
-	size_t line_number, line_idx;
+	size_t line_number, line_idx, line_len;
 	int ret;
-	char **lines, *line, **columns;
+	char **lines, *line;
 
 	ret = SR_OK;
 	inc = in->priv;
-	columns = NULL;
 
 	/* Search for the first line to process (header or data). */
 	line_number = 0;
+	line_len = 0;
 	if (inc->termination)
 		lines = g_strsplit(buf->str, inc->termination, 0);
 	else
@@ -1367,8 +1426,8 @@ static int initial_parse(const struct sr_input *in, GString *buf)
 			sr_spew("Blank line %zu skipped.", line_number);
 			continue;
 		}
-		strip_comment(line, inc->comment);
-		if (line[0] == '\0') {
+		line_len = strip_comment(line, strlen(line), inc->comment);
+		if (!line_len) {
 			sr_spew("Comment-only line %zu skipped.", line_number);
 			continue;
 		}
@@ -1383,19 +1442,13 @@ static int initial_parse(const struct sr_input *in, GString *buf)
 	}
 
 	/* Get the number of columns in the line. */
-	columns = split_line(line, inc);
-	if (!columns) {
-		sr_err("Error while parsing line %zu.", line_number);
-		ret = SR_ERR;
-		goto out;
-	}
-	num_columns = g_strv_length(columns);
+	num_columns = split_line(line, line_len, inc, 0);
 	if (!num_columns) {
 		sr_err("Error while parsing line %zu.", line_number);
 		ret = SR_ERR;
 		goto out;
 	}
-	sr_dbg("Got %zu columns in text line: %s.", num_columns, line);
+	sr_dbg("Got %zu columns in text line %zu.", num_columns, line_number);
 
 	/*
 	 * Interpret the user provided column format specs. This might
@@ -1407,7 +1460,8 @@ static int initial_parse(const struct sr_input *in, GString *buf)
 	 * Check the then created channels for consistency across .reset
 	 * and .receive sequences (file re-load).
 	 */
-	ret = make_column_details_from_format(in, inc->column_formats, columns);
+	ret = make_column_details_from_format(in, inc->column_formats,
+		inc->columns);
 	if (ret != SR_OK) {
 		sr_err("Cannot parse columns format using line %zu.", line_number);
 		goto out;
@@ -1460,8 +1514,6 @@ static int initial_parse(const struct sr_input *in, GString *buf)
 	}
 
 out:
-	if (columns)
-		g_strfreev(columns);
 	g_strfreev(lines);
 
 	return ret;
@@ -1504,15 +1556,20 @@ static int initial_receive(const struct sr_input *in)
 	if (!termination)
 		/* Don't have a full line yet. */
 		return SR_ERR_NA;
+	if (!strcmp(termination, "\r") &&
+			!memchr(in->buf->str, '\r', in->buf->len - 1))
+		/* A single CR at the end might be half a CR/LF. */
+		return SR_ERR_NA;
 
 	p = g_strrstr_len(in->buf->str, in->buf->len, termination);
 	if (!p)
 		/* Don't have a full line yet. */
 		return SR_ERR_NA;
-	len = p - in->buf->str - 1;
+	len = p - in->buf->str;
 	new_buf = g_string_new_len(in->buf->str, len);
 	g_string_append_c(new_buf, '\0');
 
+	g_free(inc->termination);
 	inc->termination = g_strdup(termination);
 
 	if (in->buf->str[0] != '\0')
@@ -1525,16 +1582,81 @@ static int initial_receive(const struct sr_input *in)
 	return ret;
 }
 
-static int process_buffer(struct sr_input *in, gboolean is_eof)
+static int process_line(struct sr_input *in, char *line, size_t line_len)
 {
 	struct context *inc;
-	gsize num_columns;
-	size_t line_idx, col_idx, col_nr;
+	size_t num_columns, col_idx, col_nr;
 	const struct column_details *details;
 	col_parse_cb parse_func;
 	int ret;
-	char *processed_up_to;
-	char **lines, *line, **columns, *column;
+
+	inc = in->priv;
+
+	inc->line_number++;
+	if (inc->line_number < inc->start_line) {
+		sr_spew("Line %zu skipped (before start).", inc->line_number);
+		return SR_OK;
+	}
+	if (!line_len) {
+		sr_spew("Blank line %zu skipped.", inc->line_number);
+		return SR_OK;
+	}
+
+	/* Remove trailing comment. */
+	line_len = strip_comment(line, line_len, inc->comment);
+	if (!line_len) {
+		sr_spew("Comment-only line %zu skipped.", inc->line_number);
+		return SR_OK;
+	}
+
+	/* Skip the header line, its content was used as the channel names. */
+	if (inc->use_header && !inc->header_seen) {
+		sr_spew("Header line %zu skipped.", inc->line_number);
+		inc->header_seen = TRUE;
+		return SR_OK;
+	}
+
+	/* Split the line into columns, check for minimum length. */
+	num_columns = split_line(line, line_len, inc, inc->column_want_count);
+	if (num_columns < inc->column_want_count) {
+		sr_err("Insufficient column count %zu in line %zu.",
+			num_columns, inc->line_number);
+		return SR_ERR;
+	}
+
+	/* Have the columns of the current text line processed. */
+	clear_logic_samples(inc);
+	clear_analog_samples(inc);
+	for (col_idx = 0; col_idx < inc->column_want_count; col_idx++) {
+		col_nr = col_idx + 1;
+		details = lookup_column_details(inc, col_nr);
+		if (!details || !details->text_format)
+			continue;
+		parse_func = col_parse_funcs[details->text_format];
+		if (!parse_func)
+			continue;
+		ret = parse_func(inc->columns[col_idx], inc, details);
+		if (ret != SR_OK)
+			return SR_ERR;
+	}
+
+	/* Send sample data to the session bus (buffered). */
+	ret = queue_logic_samples(in);
+	ret += queue_analog_samples(in);
+	if (ret != SR_OK) {
+		sr_err("Sending samples failed.");
+		return SR_ERR;
+	}
+
+	return SR_OK;
+}
+
+static int process_buffer(struct sr_input *in, gboolean is_eof)
+{
+	struct context *inc;
+	size_t term_len;
+	char *line, *line_end, *buf_end;
+	int ret;
 
 	inc = in->priv;
 	if (!inc->started) {
@@ -1544,110 +1666,47 @@ static int process_buffer(struct sr_input *in, gboolean is_eof)
 
 	/*
 	 * Consider empty input non-fatal. Keep accumulating input until
-	 * at least one full text line has become available. Grab the
-	 * maximum amount of accumulated data that consists of full text
-	 * lines, and process what has been received so far, leaving not
-	 * yet complete lines for the next invocation.
+	 * at least one full text line has become available. Process all
+	 * full text lines which were received so far in a single pass,
+	 * leaving not yet complete lines for the next invocation.
 	 *
 	 * Enforce that all previously buffered data gets processed in
 	 * the "EOF" condition. Do not insist in the presence of the
 	 * termination sequence for the last line (may often be missing
-	 * on Windows). A present termination sequence will just result
-	 * in the "execution of an empty line", and does not harm.
+	 * on Windows).
+	 *
+	 * Lines and columns get split in place, and consumed text is
+	 * not removed from the input buffer right away. The read position
+	 * advances instead, and the buffer only gets compacted when the
+	 * consumed part dominates, which keeps the copying of unprocessed
+	 * text bounded.
 	 */
-	if (!in->buf->len)
-		return SR_OK;
-	if (is_eof) {
-		processed_up_to = in->buf->str + in->buf->len;
-	} else {
-		processed_up_to = g_strrstr_len(in->buf->str, in->buf->len,
-			inc->termination);
-		if (!processed_up_to)
-			return SR_OK;
-		*processed_up_to = '\0';
-		processed_up_to += strlen(inc->termination);
+	term_len = strlen(inc->termination);
+	line = in->buf->str + inc->buf_pos;
+	buf_end = in->buf->str + in->buf->len;
+	while (line < buf_end) {
+		line_end = find_text(line, buf_end, inc->termination, term_len);
+		if (!line_end && !is_eof)
+			break;
+		if (!line_end)
+			line_end = buf_end;
+		*line_end = '\0';
+		ret = process_line(in, line, line_end - line);
+		if (ret != SR_OK)
+			return ret;
+		line = (line_end < buf_end) ? line_end + term_len : buf_end;
 	}
 
-	/* Split input text lines and process their columns. */
-	ret = SR_OK;
-	lines = g_strsplit(in->buf->str, inc->termination, 0);
-	for (line_idx = 0; (line = lines[line_idx]); line_idx++) {
-		inc->line_number++;
-		if (inc->line_number < inc->start_line) {
-			sr_spew("Line %zu skipped (before start).", inc->line_number);
-			continue;
-		}
-		if (line[0] == '\0') {
-			sr_spew("Blank line %zu skipped.", inc->line_number);
-			continue;
-		}
-
-		/* Remove trailing comment. */
-		strip_comment(line, inc->comment);
-		if (line[0] == '\0') {
-			sr_spew("Comment-only line %zu skipped.", inc->line_number);
-			continue;
-		}
-
-		/* Skip the header line, its content was used as the channel names. */
-		if (inc->use_header && !inc->header_seen) {
-			sr_spew("Header line %zu skipped.", inc->line_number);
-			inc->header_seen = TRUE;
-			continue;
-		}
-
-		/* Split the line into columns, check for minimum length. */
-		columns = split_line(line, inc);
-		if (!columns) {
-			sr_err("Error while parsing line %zu.", inc->line_number);
-			g_strfreev(lines);
-			return SR_ERR;
-		}
-		num_columns = g_strv_length(columns);
-		if (num_columns < inc->column_want_count) {
-			sr_err("Insufficient column count %zu in line %zu.",
-				num_columns, inc->line_number);
-			g_strfreev(columns);
-			g_strfreev(lines);
-			return SR_ERR;
-		}
-
-		/* Have the columns of the current text line processed. */
-		clear_logic_samples(inc);
-		clear_analog_samples(inc);
-		for (col_idx = 0; col_idx < inc->column_want_count; col_idx++) {
-			column = columns[col_idx];
-			col_nr = col_idx + 1;
-			details = lookup_column_details(inc, col_nr);
-			if (!details || !details->text_format)
-				continue;
-			parse_func = col_parse_funcs[details->text_format];
-			if (!parse_func)
-				continue;
-			ret = parse_func(column, inc, details);
-			if (ret != SR_OK) {
-				g_strfreev(columns);
-				g_strfreev(lines);
-				return SR_ERR;
-			}
-		}
-
-		/* Send sample data to the session bus (buffered). */
-		ret = queue_logic_samples(in);
-		ret += queue_analog_samples(in);
-		if (ret != SR_OK) {
-			sr_err("Sending samples failed.");
-			g_strfreev(columns);
-			g_strfreev(lines);
-			return SR_ERR;
-		}
-
-		g_strfreev(columns);
+	inc->buf_pos = line - in->buf->str;
+	if (inc->buf_pos == in->buf->len) {
+		g_string_truncate(in->buf, 0);
+		inc->buf_pos = 0;
+	} else if (inc->buf_pos > in->buf->len / 2) {
+		g_string_erase(in->buf, 0, inc->buf_pos);
+		inc->buf_pos = 0;
 	}
-	g_strfreev(lines);
-	g_string_erase(in->buf, 0, processed_up_to - in->buf->str);
 
-	return ret;
+	return SR_OK;
 }
 
 static int receive(struct sr_input *in, GString *buf)
@@ -1718,6 +1777,8 @@ static void cleanup(struct sr_input *in)
 	inc->analog_datafeed_buffer = NULL;
 	g_free(inc->analog_datafeed_digits);
 	inc->analog_datafeed_digits = NULL;
+	g_free(inc->columns);
+	inc->columns = NULL;
 	/* analog_datafeed_channels was released in keep_header_for_reread() */
 	/* TODO Release channel names (before releasing details). */
 	g_free(inc->column_details);
@@ -33,6 +33,42 @@
 #define CHUNK_SIZE	(4 * 1024 * 1024)
 /** @endcond */
 
+/* Output buffers per worker thread, i.e. how far workers run ahead. */
+#define POOL_SLOTS_PER_THREAD	2
+
+/* A block being converted, in one of the pool's output buffers. */
+struct pool_slot {
+	uint8_t *out;
+	gboolean done;
+	int ret;
+};
+
+/*
+ * Worker threads converting consecutive blocks of input data, while the
+ * thread which runs the pool sends the results in order.
+ */
+struct sr_input_pool {
+	gsize block_size;
+	sr_input_block_convert convert;
+	sr_input_block_send send;
+	void *cb_data;
+	GThread **threads;
+	unsigned int num_threads;
+	struct pool_slot *slots;
+	unsigned int num_slots;
+	/* The data of the current sr_input_pool_run() call. */
+	const uint8_t *data;
+	gsize len;
+	/* Blocks up to queued may be converted, next is the one to take. */
+	uint64_t queued;
+	uint64_t next;
+	/* Blocks taken but not done yet. */
+	unsigned int busy;
+	gboolean quit;
+	GMutex mutex;
+	GCond cond;
+};
+
 /**
  * @file
  *
@@ -51,7 +87,9 @@
  * Like all libsigrok data handling, processing is done in a streaming
  * manner: input should be supplied a chunk at a time. This way anything
  * that processes data can do so in real time, without the user having
- * to wait for the whole thing to be finished.
+ * to wait for the whole thing to be finished. Files can be handed over
+ * with sr_input_load_file() instead, which maps them into memory rather
+ * than reading them chunk by chunk.
  *
  * Every input module is "pluggable", meaning it's handled as being separate
  * from the main libsigrok, but linked in to it statically. To keep things
@@ -588,9 +626,111 @@ SR_API int sr_input_send(const struct sr_input *in, GString *buf)
 
 	len = buf ? buf->len : 0;
 	sr_spew("Sending %zu bytes to %s module.", len, in->module->id);
+	if (in->module->consume)
+		return in->module->consume((struct sr_input *)in,
+			buf ? (const uint8_t *)buf->str : NULL, len);
+
 	return in->module->receive((struct sr_input *)in, buf);
 }
 
+/* Hand data to the module, in place if the module can take it that way. */
+static int input_feed(struct sr_input *in, const uint8_t *data, gsize len)
+{
+	GString chunk;
+
+	if (in->module->consume)
+		return in->module->consume(in, data, len);
+
+	/* Modules only read from the string, so it can wrap the data. */
+	chunk.str = (gchar *)data;
+	chunk.len = len;
+	chunk.allocated_len = len;
+
+	return in->module->receive(in, &chunk);
+}
+
+static void input_file_close(struct sr_input *in)
+{
+	if (!in->file)
+		return;
+
+	g_mapped_file_unref(in->file);
+	in->file = NULL;
+	in->file_offset = 0;
+}
+
+/**
+ * Send the content of a file to the specified input instance.
+ *
+ * The file gets mapped into memory, and input modules which can handle
+ * it send their packets straight out of the mapping. This saves reading
+ * the file into buffers, and copying it around in the input module.
+ *
+ * Like sr_input_send(), this returns the moment the device instance
+ * becomes ready, which gives the caller the chance to add it to a
+ * session. Calling this again with the same file continues where the
+ * previous call stopped, and does nothing once all of the file was
+ * sent. Call sr_input_end() afterwards, as usual.
+ *
+ * @param in The input instance. Must not be NULL.
+ * @param filename The file to send. Must not be NULL.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ * @retval SR_ERR The file could not be mapped.
+ * @retval other The input module's error code.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_input_load_file(const struct sr_input *in_ro,
+		const char *filename)
+{
+	struct sr_input *in;
+	GError *error;
+	const uint8_t *data;
+	gsize size, len;
+	gboolean was_ready;
+	int ret;
+
+	in = (struct sr_input *)in_ro;	/* "un-const" */
+	if (!in || !in->module || !filename || !filename[0])
+		return SR_ERR_ARG;
+
+	if (!in->file) {
+		error = NULL;
+		in->file = g_mapped_file_new(filename, FALSE, &error);
+		if (!in->file) {
+			sr_err("Failed to map %s: %s", filename, error->message);
+			g_error_free(error);
+			return SR_ERR;
+		}
+		in->file_offset = 0;
+	}
+	data = (const uint8_t *)g_mapped_file_get_contents(in->file);
+	size = g_mapped_file_get_length(in->file);
+
+	ret = SR_OK;
+	was_ready = in->sdi_ready;
+	while (in->file_offset < size) {
+		/*
+		 * Modules take the data in place once the device is ready.
+		 * Before that, and when they copy all of it anyway, chunks
+		 * limit the amount of data buffered at a time.
+		 */
+		len = size - in->file_offset;
+		if (!in->sdi_ready || !in->module->consume)
+			len = MIN(len, CHUNK_SIZE);
+		sr_spew("Sending %" G_GSIZE_FORMAT " bytes of %s to %s module.",
+			len, filename, in->module->id);
+		ret = input_feed(in, data + in->file_offset, len);
+		in->file_offset += len;
+		if (ret != SR_OK || (!was_ready && in->sdi_ready))
+			break;
+	}
+
+	return ret;
+}
+
 /**
  * Signal the input module no more data will come.
  *
@@ -601,8 +741,13 @@ SR_API int sr_input_send(const struct sr_input *in, GString *buf)
  */
 SR_API int sr_input_end(const struct sr_input *in)
 {
+	int ret;
+
 	sr_spew("Calling end() on %s module.", in->module->id);
-	return in->module->end((struct sr_input *)in);
+	ret = in->module->end((struct sr_input *)in);
+	input_file_close((struct sr_input *)in);
+
+	return ret;
 }
 
 /**
@@ -655,6 +800,7 @@ SR_API int sr_input_reset(const struct sr_input *in_ro)
 	if (in->buf)
 		g_string_truncate(in->buf, 0);
 	in->sdi_ready = FALSE;
+	input_file_close(in);
 
 	return rc;
 }
@@ -689,8 +835,228 @@ SR_API void sr_input_free(const struct sr_input *in)
 			" unprocessed bytes at free time.", in->buf->len);
 	}
 	g_string_free(in->buf, TRUE);
+	input_file_close((struct sr_input *)in);
 	g_free(in->priv);
 	g_free((gpointer)in);
 }
 
 /** @} */
+
+static gpointer pool_thread(gpointer data)
+{
+	struct sr_input_pool *pool;
+	struct pool_slot *slot;
+	uint64_t block;
+	gsize offset;
+	int ret;
+
+	pool = data;
+	for (;;) {
+		g_mutex_lock(&pool->mutex);
+		while (!pool->quit && pool->next >= pool->queued)
+			g_cond_wait(&pool->cond, &pool->mutex);
+		if (pool->quit) {
+			g_mutex_unlock(&pool->mutex);
+			break;
+		}
+		block = pool->next++;
+		pool->busy++;
+		g_mutex_unlock(&pool->mutex);
+
+		slot = &pool->slots[block % pool->num_slots];
+		offset = block * pool->block_size;
+		ret = pool->convert(pool->data + offset,
+			MIN(pool->block_size, pool->len - offset),
+			slot->out, pool->cb_data);
+
+		g_mutex_lock(&pool->mutex);
+		slot->ret = ret;
+		slot->done = TRUE;
+		pool->busy--;
+		g_cond_broadcast(&pool->cond);
+		g_mutex_unlock(&pool->mutex);
+	}
+
+	return NULL;
+}
+
+/**
+ * Create a pool of worker threads for converting input data.
+ *
+ * @param num_threads The number of worker threads. With none (or when
+ *                    none can be created), blocks get converted by the
+ *                    thread running the pool.
+ * @param block_size The size of the blocks the data gets split into.
+ *                   Modules make it a multiple of their sample size.
+ * @param out_size The size of the conversion result of a block.
+ * @param convert Converts a block, in a worker thread.
+ * @param send Sends the result of a block, in the thread running the
+ *             pool, in the order of the blocks.
+ * @param cb_data Opaque pointer passed to the callbacks.
+ *
+ * @return The new pool, or NULL on memory allocation failure.
+ *
+ * @private
+ */
+SR_PRIV struct sr_input_pool *sr_input_pool_new(unsigned int num_threads,
+		gsize block_size, gsize out_size, sr_input_block_convert convert,
+		sr_input_block_send send, void *cb_data)
+{
+	struct sr_input_pool *pool;
+	GError *error;
+	unsigned int i;
+
+	pool = g_malloc0(sizeof(*pool));
+	pool->block_size = block_size;
+	pool->convert = convert;
+	pool->send = send;
+	pool->cb_data = cb_data;
+	pool->num_slots = MAX(num_threads, 1) * POOL_SLOTS_PER_THREAD;
+	pool->slots = g_malloc0(pool->num_slots * sizeof(*pool->slots));
+	for (i = 0; i < pool->num_slots; i++) {
+		if (!(pool->slots[i].out = g_try_malloc(out_size))) {
+			sr_err("Input conversion buffer malloc failed.");
+			sr_input_pool_free(pool);
+			return NULL;
+		}
+	}
+	g_mutex_init(&pool->mutex);
+	g_cond_init(&pool->cond);
+
+	pool->threads = g_malloc0(MAX(num_threads, 1) * sizeof(GThread *));
+	for (i = 0; i < num_threads; i++) {
+		error = NULL;
+		pool->threads[i] = g_thread_try_new("sr-input-convert",
+			pool_thread, pool, &error);
+		if (!pool->threads[i]) {
+			sr_warn("Failed to create conversion thread: %s.",
+				error->message);
+			g_error_free(error);
+			break;
+		}
+		pool->num_threads++;
+	}
+	sr_dbg("Converting input in blocks of %" G_GSIZE_FORMAT
+		" bytes with %u threads.", block_size, pool->num_threads);
+
+	return pool;
+}
+
+/**
+ * Convert data on the pool's worker threads, and send the results.
+ *
+ * Returns when all of the data was sent, so it needs to stay valid
+ * during the call only.
+ *
+ * @param pool The pool. Must not be NULL.
+ * @param data The data.
+ * @param len The size of the data. Only the last block can be shorter
+ *            than the pool's block size.
+ *
+ * @retval SR_OK Success.
+ * @retval other The error code of the first failed callback.
+ *
+ * @private
+ */
+SR_PRIV int sr_input_pool_run(struct sr_input_pool *pool,
+		const uint8_t *data, gsize len)
+{
+	struct pool_slot *slot;
+	uint64_t num_blocks, block;
+	gsize offset, size;
+	unsigned int i;
+	int ret;
+
+	num_blocks = (len + pool->block_size - 1) / pool->block_size;
+	ret = SR_OK;
+
+	if (!pool->num_threads) {
+		slot = &pool->slots[0];
+		for (block = 0; block < num_blocks && ret == SR_OK; block++) {
+			offset = block * pool->block_size;
+			size = MIN(pool->block_size, len - offset);
+			ret = pool->convert(data + offset, size, slot->out,
+				pool->cb_data);
+			if (ret == SR_OK)
+				ret = pool->send(data + offset, size, slot->out,
+					pool->cb_data);
+		}
+		return ret;
+	}
+
+	g_mutex_lock(&pool->mutex);
+	pool->data = data;
+	pool->len = len;
+	pool->queued = 0;
+	pool->next = 0;
+	g_mutex_unlock(&pool->mutex);
+
+	for (block = 0; block < num_blocks; block++) {
+		slot = &pool->slots[block % pool->num_slots];
+
+		/* Workers run ahead as far as there are free slots. */
+		g_mutex_lock(&pool->mutex);
+		pool->queued = MIN(num_blocks, block + pool->num_slots);
+		g_cond_broadcast(&pool->cond);
+		while (!slot->done)
+			g_cond_wait(&pool->cond, &pool->mutex);
+		g_mutex_unlock(&pool->mutex);
+
+		offset = block * pool->block_size;
+		size = MIN(pool->block_size, len - offset);
+		ret = slot->ret;
+		if (ret == SR_OK)
+			ret = pool->send(data + offset, size, slot->out,
+				pool->cb_data);
+
+		g_mutex_lock(&pool->mutex);
+		slot->done = FALSE;
+		g_mutex_unlock(&pool->mutex);
+		if (ret != SR_OK)
+			break;
+	}
+
+	/* After a failure, wait for the blocks still being converted. */
+	g_mutex_lock(&pool->mutex);
+	pool->queued = pool->next;
+	while (pool->busy)
+		g_cond_wait(&pool->cond, &pool->mutex);
+	for (i = 0; i < pool->num_slots; i++)
+		pool->slots[i].done = FALSE;
+	pool->data = NULL;
+	pool->len = 0;
+	g_mutex_unlock(&pool->mutex);
+
+	return ret;
+}
+
+/**
+ * Stop the pool's worker threads, and free the pool.
+ *
+ * @param pool The pool. Can be NULL.
+ *
+ * @private
+ */
+SR_PRIV void sr_input_pool_free(struct sr_input_pool *pool)
+{
+	unsigned int i;
+
+	if (!pool)
+		return;
+
+	if (pool->threads) {
+		g_mutex_lock(&pool->mutex);
+		pool->quit = TRUE;
+		g_cond_broadcast(&pool->cond);
+		g_mutex_unlock(&pool->mutex);
+		for (i = 0; i < pool->num_threads; i++)
+			g_thread_join(pool->threads[i]);
+		g_free(pool->threads);
+		g_cond_clear(&pool->cond);
+		g_mutex_clear(&pool->mutex);
+	}
+	for (i = 0; i < pool->num_slots; i++)
+		g_free(pool->slots[i].out);
+	g_free(pool->slots);
+	g_free(pool);
+}
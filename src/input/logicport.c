@@ -67,7 +67,7 @@ void sr_channel_group_free(struct sr_channel_group *cg);
 #define LOG_PREFIX	"input/logicport"
 
 #define MAX_CHANNELS	34
-#define CHUNK_SIZE	(4 * 1024 * 1024)
+#define MAX_RUNS	(256 * 1024)
 
 #define CRLF		"\r\n"
 #define DC1_CHR		'\x11'
@@ -131,9 +131,7 @@ struct context {
 	GSList *signal_groups;
 	GSList *channels;
 	size_t unitsize;
-	size_t samples_per_chunk;
-	size_t samples_in_buffer;
-	uint8_t *feed_buffer;
+	struct sr_logic_rle_queue *feed_queue;
 };
 
 static struct signal_group_desc *alloc_signal_group(const char *name)
@@ -820,7 +818,10 @@ static int create_channels_groups(struct sr_input *in)
 	return SR_OK;
 }
 
-/* Allocate the session feed buffer. */
+/*
+ * Allocate the session feed buffer. The input file holds sample values
+ * with repeat counts, which get passed on as runs.
+ */
 static int create_feed_buffer(struct sr_input *in)
 {
 	struct context *inc;
@@ -828,11 +829,7 @@ static int create_feed_buffer(struct sr_input *in)
 	inc = in->priv;
 
 	inc->unitsize = (inc->channel_count + 7) / 8;
-	inc->samples_per_chunk = CHUNK_SIZE / inc->unitsize;
-	inc->samples_in_buffer = 0;
-	inc->feed_buffer = g_malloc0(inc->samples_per_chunk * inc->unitsize);
-	if (!inc->feed_buffer)
-		return SR_ERR_MALLOC;
+	inc->feed_queue = sr_logic_rle_queue_new(inc->unitsize, MAX_RUNS);
 
 	return SR_OK;
 }
@@ -844,11 +841,10 @@ static int send_buffer(struct sr_input *in)
 	struct sr_datafeed_packet packet;
 	struct sr_datafeed_meta meta;
 	struct sr_config *src;
-	struct sr_datafeed_logic logic;
 	int rc;
 
 	inc = in->priv;
-	if (!inc->samples_in_buffer)
+	if (!inc->feed_queue || !inc->feed_queue->rle.num_runs)
 		return SR_OK;
 
 	if (!inc->header_sent) {
@@ -872,15 +868,7 @@ static int send_buffer(struct sr_input *in)
 		inc->rate_sent = TRUE;
 	}
 
-	packet.type = SR_DF_LOGIC;
-	packet.payload = &logic;
-	logic.unitsize = inc->unitsize;
-	logic.data = inc->feed_buffer;
-	logic.length = inc->unitsize * inc->samples_in_buffer;
-	rc = sr_session_send(in->sdi, &packet);
-
-	inc->samples_in_buffer = 0;
-
+	rc = sr_logic_rle_queue_send(inc->feed_queue, in->sdi);
 	if (rc)
 		return rc;
 
@@ -888,16 +876,14 @@ static int send_buffer(struct sr_input *in)
 }
 
 /*
- * Add N copies of the current sample to the buffer. Send the buffer to
- * the session feed when a maximum amount of data was collected.
+ * Add a run of N copies of the current sample to the buffer. Send the
+ * buffer to the session feed when a maximum amount of runs was collected.
  */
 static int add_samples(struct sr_input *in, uint64_t samples, size_t count)
 {
 	struct context *inc;
 	uint8_t sample_buffer[sizeof(uint64_t)];
 	size_t idx;
-	size_t copy_count;
-	uint8_t *p;
 	int rc;
 
 	inc = in->priv;
@@ -905,24 +891,10 @@ static int add_samples(struct sr_input *in, uint64_t samples, size_t count)
 		sample_buffer[idx] = samples & 0xff;
 		samples >>= 8;
 	}
-	while (count) {
-		copy_count = inc->samples_per_chunk - inc->samples_in_buffer;
-		if (copy_count > count)
-			copy_count = count;
-		count -= copy_count;
-
-		p = inc->feed_buffer + inc->samples_in_buffer * inc->unitsize;
-		while (copy_count-- > 0) {
-			memcpy(p, sample_buffer, inc->unitsize);
-			p += inc->unitsize;
-			inc->samples_in_buffer++;
-		}
-
-		if (inc->samples_in_buffer == inc->samples_per_chunk) {
-			rc = send_buffer(in);
-			if (rc)
-				return rc;
-		}
+	if (sr_logic_rle_queue_add(inc->feed_queue, sample_buffer, count)) {
+		rc = send_buffer(in);
+		if (rc)
+			return rc;
 	}
 
 	return SR_OK;
@@ -1158,7 +1130,7 @@ static void cleanup(struct sr_input *in)
 		g_free(inc->signal_names[idx]);
 	g_slist_free_full(inc->signal_groups, sg_free);
 	g_slist_free_full(inc->channels, g_free);
-	g_free(inc->feed_buffer);
+	sr_logic_rle_queue_free(inc->feed_queue);
 	memset(inc, 0, sizeof(*inc));
 }
 
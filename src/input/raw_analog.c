@@ -34,6 +34,8 @@
 #define CHUNK_SIZE		(4 * 1024 * 1024)
 #define DEFAULT_NUM_CHANNELS	1
 #define DEFAULT_SAMPLERATE	0
+#define DEFAULT_THREADS		0
+#define DEFAULT_BLOCKSIZE	CHUNK_SIZE
 
 struct context {
 	gboolean started;
@@ -45,6 +47,9 @@ struct context {
 	struct sr_analog_encoding encoding;
 	struct sr_analog_meaning meaning;
 	struct sr_analog_spec spec;
+	/* Workers converting to floats, NULL to send samples as they are. */
+	struct sr_input_pool *pool;
+	struct sr_analog_encoding float_encoding;
 };
 
 struct sample_format {
@@ -112,13 +117,105 @@ static void init_context(struct context *inc, const struct sample_format *fmt, G
 	inc->spec.spec_digits = 0;
 }
 
+/* Samples which consumers would convert to floats, other than by copying. */
+static gboolean needs_conversion(const struct sr_analog_encoding *enc)
+{
+	gboolean bigendian;
+
+#ifdef WORDS_BIGENDIAN
+	bigendian = TRUE;
+#else
+	bigendian = FALSE;
+#endif
+
+	if (!enc->is_float)
+		return TRUE;
+	if (enc->unitsize != sizeof(float))
+		return FALSE;
+
+	return enc->is_bigendian != bigendian
+		|| enc->scale.p != 1 || enc->scale.q != 1 || enc->offset.p != 0;
+}
+
+static int convert_block(const uint8_t *data, gsize len, uint8_t *out,
+		void *cb_data)
+{
+	struct sr_input *in;
+	struct context *inc;
+	struct sr_datafeed_analog analog;
+
+	in = cb_data;
+	inc = in->priv;
+	analog = inc->analog;
+	analog.data = (void *)data;
+	analog.num_samples = len / inc->samplesize;
+
+	return sr_analog_to_float(&analog, (float *)out);
+}
+
+static int send_block(const uint8_t *data, gsize len, const uint8_t *out,
+		void *cb_data)
+{
+	struct sr_input *in;
+	struct context *inc;
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_analog analog;
+
+	(void)data;
+
+	in = cb_data;
+	inc = in->priv;
+	analog = inc->analog;
+	analog.data = (void *)out;
+	analog.num_samples = len / inc->samplesize;
+	analog.encoding = &inc->float_encoding;
+	packet.type = SR_DF_ANALOG;
+	packet.payload = &analog;
+
+	return sr_session_send(in->sdi, &packet);
+}
+
+static int init_pool(struct sr_input *in, int num_threads, uint64_t block_size)
+{
+	struct context *inc;
+	struct sr_analog_encoding *enc;
+	int num_channels;
+
+	inc = in->priv;
+	num_channels = g_slist_length(in->sdi->channels);
+	block_size = MAX(block_size / inc->samplesize, 1) * inc->samplesize;
+	inc->pool = sr_input_pool_new(num_threads, block_size,
+		block_size / inc->samplesize * num_channels * sizeof(float),
+		convert_block, send_block, in);
+	if (!inc->pool)
+		return SR_ERR_MALLOC;
+
+	enc = &inc->float_encoding;
+	*enc = inc->encoding;
+	enc->unitsize = sizeof(float);
+	enc->is_signed = TRUE;
+	enc->is_float = TRUE;
+#ifdef WORDS_BIGENDIAN
+	enc->is_bigendian = TRUE;
+#else
+	enc->is_bigendian = FALSE;
+#endif
+	enc->scale.p = 1;
+	enc->scale.q = 1;
+	enc->offset.p = 0;
+	enc->offset.q = 1;
+
+	return SR_OK;
+}
+
 static int init(struct sr_input *in, GHashTable *options)
 {
 	struct context *inc;
 	int num_channels;
 	char channelname[16];
 	const char *format;
-	int fmt_index;
+	int fmt_index, num_threads;
+	uint64_t block_size;
 
 	num_channels = g_variant_get_int32(g_hash_table_lookup(options, "numchannels"));
 	if (num_channels < 1) {
@@ -126,6 +223,13 @@ static int init(struct sr_input *in, GHashTable *options)
 		return SR_ERR_ARG;
 	}
 
+	num_threads = g_variant_get_int32(g_hash_table_lookup(options, "threads"));
+	if (num_threads < 0) {
+		sr_err("Invalid value for threads: must not be negative.");
+		return SR_ERR_ARG;
+	}
+	block_size = g_variant_get_uint64(g_hash_table_lookup(options, "blocksize"));
+
 	format = g_variant_get_string(g_hash_table_lookup(options, "format"), NULL);
 	if ((fmt_index = parse_format_string(format)) == -1) {
 		GString *formats = g_string_sized_new(200);
@@ -149,16 +253,21 @@ static int init(struct sr_input *in, GHashTable *options)
 	inc->samplesize = sample_formats[fmt_index].encoding.unitsize * num_channels;
 	init_context(inc, &sample_formats[fmt_index], in->sdi->channels);
 
+	if (num_threads && needs_conversion(&inc->encoding))
+		return init_pool(in, num_threads, block_size);
+
 	return SR_OK;
 }
 
-static int process_buffer(struct sr_input *in)
+/* Send whole samples, in chunks. Sets how much of the data was sent. */
+static int send_samples(struct sr_input *in, const uint8_t *data, gsize size,
+		gsize *sent)
 {
 	struct context *inc;
 	struct sr_datafeed_meta meta;
 	struct sr_datafeed_packet packet;
 	struct sr_config *src;
-	unsigned int offset, chunk_size;
+	gsize offset, chunk_size;
 
 	inc = in->priv;
 	if (!inc->started) {
@@ -177,26 +286,46 @@ static int process_buffer(struct sr_input *in)
 		inc->started = TRUE;
 	}
 
+	/* Convert whole blocks of samples on the workers. */
+	if (inc->pool) {
+		*sent = size / inc->samplesize * inc->samplesize;
+		if (!*sent)
+			return SR_OK;
+		return sr_input_pool_run(inc->pool, data, *sent);
+	}
+
 	/* Round down to the last channels * unitsize boundary. */
 	inc->analog.num_samples = CHUNK_SIZE / inc->samplesize;
 	chunk_size = inc->analog.num_samples * inc->samplesize;
 	offset = 0;
 
-	while ((offset + chunk_size) < in->buf->len) {
-		inc->analog.data = in->buf->str + offset;
+	while ((offset + chunk_size) < size) {
+		inc->analog.data = (uint8_t *)data + offset;
 		sr_session_send(in->sdi, &inc->packet);
 		offset += chunk_size;
 	}
 
-	inc->analog.num_samples = (in->buf->len - offset) / inc->samplesize;
+	inc->analog.num_samples = (size - offset) / inc->samplesize;
 	chunk_size = inc->analog.num_samples * inc->samplesize;
 	if (chunk_size > 0) {
-		inc->analog.data = in->buf->str + offset;
+		inc->analog.data = (uint8_t *)data + offset;
 		sr_session_send(in->sdi, &inc->packet);
 		offset += chunk_size;
 	}
+	*sent = offset;
+
+	return SR_OK;
+}
+
+static int process_buffer(struct sr_input *in)
+{
+	gsize offset;
+	int ret;
+
+	ret = send_samples(in, (const uint8_t *)in->buf->str, in->buf->len,
+		&offset);
 
-	if ((unsigned int)offset < in->buf->len) {
+	if (offset < in->buf->len) {
 		/*
 		 * The incoming buffer wasn't processed completely. Stash
 		 * the leftover data for next time.
@@ -206,24 +335,40 @@ static int process_buffer(struct sr_input *in)
 		g_string_truncate(in->buf, 0);
 	}
 
-	return SR_OK;
+	return ret;
 }
 
-static int receive(struct sr_input *in, GString *buf)
+static int consume(struct sr_input *in, const uint8_t *data, gsize len)
 {
+	struct context *inc;
+	gsize fill, sent;
 	int ret;
 
-	g_string_append_len(in->buf, buf->str, buf->len);
-
 	if (!in->sdi_ready) {
+		g_string_append_len(in->buf, (const char *)data, len);
 		/* sdi is ready, notify frontend. */
 		in->sdi_ready = TRUE;
 		return SR_OK;
 	}
 
-	ret = process_buffer(in);
+	/* Complete the sample left over from before, if any. */
+	inc = in->priv;
+	if (in->buf->len) {
+		fill = (inc->samplesize - in->buf->len % inc->samplesize) % inc->samplesize;
+		fill = MIN(fill, len);
+		g_string_append_len(in->buf, (const char *)data, fill);
+		data += fill;
+		len -= fill;
+		if ((ret = process_buffer(in)) != SR_OK)
+			return ret;
+	}
 
-	return ret;
+	/* Send the rest in place, and keep a partial sample. */
+	if ((ret = send_samples(in, data, len, &sent)) != SR_OK)
+		return ret;
+	g_string_append_len(in->buf, (const char *)data + sent, len - sent);
+
+	return SR_OK;
 }
 
 static int end(struct sr_input *in)
@@ -247,6 +392,8 @@ static struct sr_option options[] = {
 	{ "numchannels", "Number of analog channels", "The number of (analog) channels in the data", NULL, NULL },
 	{ "samplerate", "Sample rate (Hz)", "The sample rate of the (analog) data in Hz", NULL, NULL },
 	{ "format", "Data format", "The format of the data (data type, signedness, endianness)", NULL, NULL },
+	{ "threads", "Conversion threads", "The number of threads converting samples to floats, 0 to send them unconverted", NULL, NULL },
+	{ "blocksize", "Conversion block size", "The number of bytes each thread converts at a time", NULL, NULL },
 	ALL_ZERO
 };
 
@@ -260,6 +407,8 @@ static const struct sr_option *get_options(void)
 			options[2].values = g_slist_append(options[2].values,
 				g_variant_ref_sink(g_variant_new_string(sample_formats[i].fmt_name)));
 		}
+		options[3].def = g_variant_ref_sink(g_variant_new_int32(DEFAULT_THREADS));
+		options[4].def = g_variant_ref_sink(g_variant_new_uint64(DEFAULT_BLOCKSIZE));
 	}
 
 	return options;
@@ -267,13 +416,13 @@ static const struct sr_option *get_options(void)
 
 static void cleanup(struct sr_input *in)
 {
+	struct context *inc;
+
+	/* The options belong to the module, not to this instance. */
+	inc = in->priv;
+	sr_input_pool_free(inc->pool);
 	g_free(in->priv);
 	in->priv = NULL;
-
-	g_variant_unref(options[0].def);
-	g_variant_unref(options[1].def);
-	g_variant_unref(options[2].def);
-	g_slist_free_full(options[2].values, (GDestroyNotify)g_variant_unref);
 }
 
 static int reset(struct sr_input *in)
@@ -294,7 +443,7 @@ SR_PRIV struct sr_input_module input_raw_analog = {
 	.exts = (const char*[]){"raw", "bin", NULL},
 	.options = get_options,
 	.init = init,
-	.receive = receive,
+	.consume = consume,
 	.end = end,
 	.cleanup = cleanup,
 	.reset = reset,
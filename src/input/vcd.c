@@ -48,6 +48,7 @@
  * - $var with 'wire' and 'reg' types of scalar variables
  * - $timescale definition for samplerate
  * - multiple character variable identifiers
+ * - several variables sharing an identifier
  *
  * Most important unsupported features:
  * - vector variables (bit vectors etc.)
@@ -67,7 +68,8 @@
 
 #define LOG_PREFIX "input/vcd"
 
-#define CHUNK_SIZE (4 * 1024 * 1024)
+/* Runs of unchanged samples per SR_DF_LOGIC_RLE packet. */
+#define MAX_RUNS (256 * 1024)
 
 struct context {
 	gboolean started;
@@ -81,9 +83,9 @@ struct context {
 	int64_t skip;
 	gboolean skip_until_end;
 	GSList *channels;
+	GHashTable *identifiers;
 	size_t bytes_per_sample;
-	size_t samples_in_buffer;
-	uint8_t *buffer;
+	struct sr_logic_rle_queue *queue;
 	uint8_t *current_levels;
 	GSList *prev_sr_channels;
 };
@@ -91,6 +93,9 @@ struct context {
 struct vcd_channel {
 	gchar *name;
 	gchar *identifier;
+	unsigned int channel_idx;
+	/* Further variable with the same identifier. */
+	struct vcd_channel *alias;
 };
 
 /*
@@ -131,10 +136,10 @@ static gboolean parse_section(GString *buf, gchar **name, gchar **contents)
 		pos++;
 
 	/* Read the content. */
-	while (pos < buf->len - 4 && strncmp(buf->str + pos, "$end", 4))
+	while (pos + 4 <= buf->len && strncmp(buf->str + pos, "$end", 4))
 		g_string_append_c(scontent, buf->str[pos++]);
 
-	if (sname->len && pos < buf->len - 4 && !strncmp(buf->str + pos, "$end", 4)) {
+	if (sname->len && pos + 4 <= buf->len && !strncmp(buf->str + pos, "$end", 4)) {
 		status = TRUE;
 		pos += 4;
 		while (pos < buf->len && g_ascii_isspace(buf->str[pos]))
@@ -232,7 +237,7 @@ static int check_header_in_reread(const struct sr_input *in)
  */
 static gboolean parse_header(const struct sr_input *in, GString *buf)
 {
-	struct vcd_channel *vcd_ch;
+	struct vcd_channel *vcd_ch, *prev_ch;
 	uint64_t p, q;
 	struct context *inc;
 	gboolean status;
@@ -241,6 +246,8 @@ static gboolean parse_header(const struct sr_input *in, GString *buf)
 	inc = in->priv;
 	name = contents = NULL;
 	status = FALSE;
+	if (!inc->identifiers)
+		inc->identifiers = g_hash_table_new(g_str_hash, g_str_equal);
 	while (parse_section(buf, &name, &contents)) {
 		sr_dbg("Section '%s', contents '%s'.", name, contents);
 
@@ -282,18 +289,30 @@ static gboolean parse_header(const struct sr_input *in, GString *buf)
 				sr_warn("Skipping '%s%s' because only %d channels requested.",
 					parts[3], parts[4] ? : "", inc->maxchannels);
 			else {
-				vcd_ch = g_malloc(sizeof(struct vcd_channel));
+				vcd_ch = g_malloc0(sizeof(struct vcd_channel));
 				vcd_ch->identifier = g_strdup(parts[2]);
 				if (length == 4)
 					vcd_ch->name = g_strdup(parts[3]);
 				else
 					vcd_ch->name = g_strconcat(parts[3], parts[4], NULL);
+				vcd_ch->channel_idx = inc->channelcount;
 
 				sr_info("Channel %d is '%s' identified by '%s'.",
 						inc->channelcount, vcd_ch->name, vcd_ch->identifier);
 
 				sr_channel_new(in->sdi, inc->channelcount++, SR_CHANNEL_LOGIC, TRUE, vcd_ch->name);
 				inc->channels = g_slist_append(inc->channels, vcd_ch);
+
+				/* Value changes apply to all variables of an identifier. */
+				prev_ch = g_hash_table_lookup(inc->identifiers, vcd_ch->identifier);
+				if (prev_ch) {
+					while (prev_ch->alias)
+						prev_ch = prev_ch->alias;
+					prev_ch->alias = vcd_ch;
+				} else {
+					g_hash_table_insert(inc->identifiers,
+						vcd_ch->identifier, vcd_ch);
+				}
 			}
 
 			g_strfreev(parts);
@@ -314,6 +333,7 @@ static gboolean parse_header(const struct sr_input *in, GString *buf)
 	 */
 	inc->bytes_per_sample = (inc->channelcount + 7) / 8;
 	inc->current_levels = g_malloc0(inc->bytes_per_sample);
+	inc->queue = sr_logic_rle_queue_new(inc->bytes_per_sample, MAX_RUNS);
 
 	inc->got_header = status;
 	if (status)
@@ -347,82 +367,83 @@ static int format_match(GHashTable *metadata, unsigned int *confidence)
 	return SR_OK;
 }
 
-/* Send all accumulated bytes from inc->buffer. */
+/* Send all accumulated runs of samples. */
 static void send_buffer(const struct sr_input *in)
 {
 	struct context *inc;
-	struct sr_datafeed_packet packet;
-	struct sr_datafeed_logic logic;
 
 	inc = in->priv;
 
-	if (inc->samples_in_buffer == 0)
+	if (!inc->queue)
 		return;
 
-	packet.type = SR_DF_LOGIC;
-	packet.payload = &logic;
-	logic.unitsize = inc->bytes_per_sample;
-	logic.data = inc->buffer;
-	logic.length = inc->bytes_per_sample * inc->samples_in_buffer;
-	sr_session_send(in->sdi, &packet);
-	inc->samples_in_buffer = 0;
+	sr_logic_rle_queue_send(inc->queue, in->sdi);
 }
 
 /*
- * Add N copies of the current sample to buffer.
- * When the buffer fills up, automatically send it.
+ * Add a run of N copies of the current sample.
+ * When the queue fills up, automatically send it.
  */
 static void add_samples(const struct sr_input *in, size_t count)
 {
 	struct context *inc;
-	size_t samples_per_chunk;
-	size_t space_left, i;
-	uint8_t *p;
 
 	inc = in->priv;
-	samples_per_chunk = CHUNK_SIZE / inc->bytes_per_sample;
 
-	while (count) {
-		space_left = samples_per_chunk - inc->samples_in_buffer;
+	if (sr_logic_rle_queue_add(inc->queue, inc->current_levels, count))
+		send_buffer(in);
+}
 
-		if (space_left > count)
-			space_left = count;
+/* Set the channels' levels depending on the identifier and parsed value. */
+static void process_bit(struct context *inc, const char *identifier,
+	unsigned int bit)
+{
+	struct vcd_channel *vcd_ch;
+	unsigned int ch;
+	uint8_t mask;
 
-		p = inc->buffer + inc->samples_in_buffer * inc->bytes_per_sample;
-		for (i = 0; i < space_left; i++) {
-			memcpy(p, inc->current_levels, inc->bytes_per_sample);
-			p += inc->bytes_per_sample;
-			inc->samples_in_buffer++;
-			count--;
-		}
+	vcd_ch = g_hash_table_lookup(inc->identifiers, identifier);
+	if (!vcd_ch) {
+		sr_dbg("Did not find channel for identifier '%s'.", identifier);
+		return;
+	}
 
-		if (inc->samples_in_buffer == samples_per_chunk)
-			send_buffer(in);
+	for (; vcd_ch; vcd_ch = vcd_ch->alias) {
+		ch = vcd_ch->channel_idx;
+		mask = (uint8_t)1 << (ch % 8);
+		if (bit)
+			inc->current_levels[ch / 8] |= mask;
+		else
+			inc->current_levels[ch / 8] &= ~mask;
 	}
 }
 
-/* Set the channel level depending on the identifier and parsed value. */
-static void process_bit(struct context *inc, char *identifier, unsigned int bit)
+static inline gboolean is_separator(char c)
 {
-	GSList *l;
-	struct vcd_channel *vcd_ch;
-	unsigned int j;
-
-	for (j = 0, l = inc->channels; j < inc->channelcount && l; j++, l = l->next) {
-		vcd_ch = l->data;
-		if (g_strcmp0(identifier, vcd_ch->identifier) == 0) {
-			/* Found our channel. */
-			size_t byte_idx = (j / 8);
-			size_t bit_idx = j - 8 * byte_idx;
-			if (bit)
-				inc->current_levels[byte_idx] |= (uint8_t)1 << bit_idx;
-			else
-				inc->current_levels[byte_idx] &= ~((uint8_t)1 << bit_idx);
-			break;
-		}
-	}
-	if (j == inc->channelcount)
-		sr_dbg("Did not find channel for identifier '%s'.", identifier);
+	return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+/*
+ * Get the next whitespace delimited token from the text at *pos. The
+ * token gets NUL terminated in place, *pos advances past it.
+ */
+static char *next_token(char **pos)
+{
+	char *p, *token;
+
+	p = *pos;
+	while (is_separator(*p))
+		p++;
+	if (!*p)
+		return NULL;
+	token = p;
+	while (*p && !is_separator(*p))
+		p++;
+	if (*p)
+		*p++ = '\0';
+	*pos = p;
+
+	return token;
 }
 
 /* Parse a set of lines from the data section. */
@@ -430,25 +451,22 @@ static void parse_contents(const struct sr_input *in, char *data)
 {
 	struct context *inc;
 	uint64_t timestamp;
-	unsigned int bit, i;
-	char **tokens;
+	char *pos, *token, *identifier;
 
 	inc = in->priv;
 
-	/* Read one space-delimited token at a time. */
-	tokens = g_strsplit_set(data, " \t\r\n", 0);
-	remove_empty_parts(tokens);
-	for (i = 0; tokens[i]; i++) {
+	/* Read one space-delimited token at a time, in place. */
+	pos = data;
+	while ((token = next_token(&pos))) {
 		if (inc->skip_until_end) {
-			if (!strcmp(tokens[i], "$end")) {
-				/* Done with unhandled/unknown section. */
+			/* Done with unhandled/unknown section? */
+			if (!strcmp(token, "$end"))
 				inc->skip_until_end = FALSE;
-				break;
-			}
+			continue;
 		}
-		if (tokens[i][0] == '#' && g_ascii_isdigit(tokens[i][1])) {
+		if (token[0] == '#' && g_ascii_isdigit(token[1])) {
 			/* Numeric value beginning with # is a new timestamp value */
-			timestamp = strtoull(tokens[i] + 1, NULL, 10);
+			timestamp = strtoull(token + 1, NULL, 10);
 
 			if (inc->downsample > 1)
 				timestamp /= inc->downsample;
@@ -467,8 +485,9 @@ static void parse_contents(const struct sr_input *in, char *data)
 				/* Ignore repeated timestamps (e.g. sigrok outputs these) */
 			} else if (timestamp < inc->prev_timestamp) {
 				sr_err("Invalid timestamp: %" PRIu64 " (smaller than previous timestamp).", timestamp);
+				/* Ignore what follows until the next $end. */
 				inc->skip_until_end = TRUE;
-				break;
+				continue;
 			} else {
 				if (inc->compress != 0 && timestamp - inc->prev_timestamp > inc->compress) {
 					/* Compress long idle periods */
@@ -481,68 +500,55 @@ static void parse_contents(const struct sr_input *in, char *data)
 				add_samples(in, timestamp - inc->prev_timestamp);
 				inc->prev_timestamp = timestamp;
 			}
-		} else if (tokens[i][0] == '$' && tokens[i][1] != '\0') {
+		} else if (token[0] == '$' && token[1] != '\0') {
 			/*
 			 * This is probably a $dumpvars, $comment or similar.
 			 * $dump* contain useful data.
 			 */
-			if (g_strcmp0(tokens[i], "$dumpvars") == 0
-					|| g_strcmp0(tokens[i], "$dumpon") == 0
-					|| g_strcmp0(tokens[i], "$dumpoff") == 0
-					|| g_strcmp0(tokens[i], "$end") == 0) {
+			if (g_strcmp0(token, "$dumpvars") == 0
+					|| g_strcmp0(token, "$dumpon") == 0
+					|| g_strcmp0(token, "$dumpoff") == 0
+					|| g_strcmp0(token, "$end") == 0) {
 				/* Ignore, parse contents as normally. */
 			} else {
-				/* Ignore this and future lines until $end. */
+				/* Ignore this and future tokens until $end. */
 				inc->skip_until_end = TRUE;
-				break;
 			}
-		} else if (strchr("rR", tokens[i][0]) != NULL) {
+		} else if (token[0] == 'r' || token[0] == 'R') {
 			sr_dbg("Real type vector values not supported yet!");
-			if (!tokens[++i])
-				/* No tokens left, bail out */
+			/* Skip the identifier. */
+			if (!next_token(&pos))
 				break;
-			else
-				/* Process next token */
-				continue;
-		} else if (strchr("bB", tokens[i][0]) != NULL) {
-			bit = (tokens[i][1] == '1');
-
+		} else if (token[0] == 'b' || token[0] == 'B') {
 			/*
-			 * Bail out if a) char after 'b' is NUL, or b) there is
-			 * a second character after 'b', or c) there is no
-			 * identifier.
+			 * A vector value, the identifier is the next token.
+			 * Only scalar variables have channels, they take the
+			 * least significant bit.
 			 */
-			if (!tokens[i][1] || tokens[i][2] || !tokens[++i]) {
+			if (!token[1] || !(identifier = next_token(&pos))) {
 				sr_dbg("Unexpected vector format!");
 				break;
 			}
-
-			process_bit(inc, tokens[i], bit);
-		} else if (strchr("01xXzZ", tokens[i][0]) != NULL) {
-			char *identifier;
-
-			/* A new 1-bit sample value */
-			bit = (tokens[i][0] == '1');
-
+			process_bit(inc, identifier, token[strlen(token) - 1] == '1');
+		} else if (strchr("01xXzZ", token[0]) != NULL) {
 			/*
-			 * The identifier is either the next character, or, if
-			 * there was whitespace after the bit, the next token.
+			 * A new 1-bit sample value. The identifier is either
+			 * the next character, or, if there was whitespace
+			 * after the bit, the next token.
 			 */
-			if (tokens[i][1] == '\0') {
-				if (!tokens[++i]) {
+			if (token[1] == '\0') {
+				if (!(identifier = next_token(&pos))) {
 					sr_dbg("Identifier missing!");
 					break;
 				}
-				identifier = tokens[i];
 			} else {
-				identifier = tokens[i] + 1;
+				identifier = token + 1;
 			}
-			process_bit(inc, identifier, bit);
+			process_bit(inc, identifier, token[0] == '1');
 		} else {
-			sr_warn("Skipping unknown token '%s'.", tokens[i]);
+			sr_warn("Skipping unknown token '%s'.", token);
 		}
 	}
-	g_strfreev(tokens);
 }
 
 static int init(struct sr_input *in, GHashTable *options)
@@ -563,8 +569,6 @@ static int init(struct sr_input *in, GHashTable *options)
 	in->sdi = g_malloc0(sizeof(struct sr_dev_inst));
 	in->priv = inc;
 
-	inc->buffer = g_malloc(CHUNK_SIZE);
-
 	return SR_OK;
 }
 
@@ -609,11 +613,10 @@ static int process_buffer(struct sr_input *in)
 		inc->started = TRUE;
 	}
 
-	while ((p = g_strrstr_len(in->buf->str, in->buf->len, "\n"))) {
+	/* Process all complete lines, the tokenizer skips whitespace. */
+	if ((p = g_strrstr_len(in->buf->str, in->buf->len, "\n"))) {
 		*p = '\0';
-		g_strstrip(in->buf->str);
-		if (in->buf->str[0] != '\0')
-			parse_contents(in, in->buf->str);
+		parse_contents(in, in->buf->str);
 		g_string_erase(in->buf, 0, p - in->buf->str + 1);
 	}
 
@@ -672,11 +675,14 @@ static void cleanup(struct sr_input *in)
 
 	inc = in->priv;
 	keep_header_for_reread(in);
+	if (inc->identifiers)
+		g_hash_table_destroy(inc->identifiers);
+	inc->identifiers = NULL;
 	g_slist_free_full(inc->channels, free_channel);
 	inc->channels = NULL;
 
-	g_free(inc->buffer);
-	inc->buffer = NULL;
+	sr_logic_rle_queue_free(inc->queue);
+	inc->queue = NULL;
 	g_free(inc->current_levels);
 	inc->current_levels = NULL;
 }
@@ -694,7 +700,6 @@ static int reset(struct sr_input *in)
 	inc->skip_until_end = FALSE;
 	inc->channelcount = 0;
 	/* The inc->channels list was released in cleanup() above. */
-	inc->buffer = g_malloc(CHUNK_SIZE);
 
 	return SR_OK;
 }
@@ -737,6 +737,10 @@ struct sr_context {
 	struct sr_dev_driver **driver_list;
 #ifdef HAVE_LIBUSB_1_0
 	libusb_context *libusb_ctx;
+	/** Handle libusb events of streaming drivers on a separate thread. */
+	gboolean usb_thread_enabled;
+	/** The libusb event thread while any acquisition uses it, or NULL. */
+	struct usb_event_thread *usb_thread;
 #endif
 	sr_resource_open_callback resource_open_cb;
 	sr_resource_close_callback resource_close_cb;
@@ -766,6 +770,10 @@ struct sr_input {
 	GString *buf;
 	struct sr_dev_inst *sdi;
 	gboolean sdi_ready;
+	/** The file sr_input_load_file() feeds, NULL if none. */
+	GMappedFile *file;
+	/** How much of the file was fed so far. */
+	gsize file_offset;
 	void *priv;
 };
 
@@ -868,6 +876,20 @@ struct sr_input_module {
 	 */
 	int (*receive) (struct sr_input *in, GString *buf);
 
+	/**
+	 * Like receive(), but takes the data as a plain buffer which is
+	 * only valid during the call.
+	 *
+	 * Modules implementing this send what they can straight out of
+	 * the buffer, and keep only leftovers in in->buf. That way data
+	 * from memory mapped files doesn't get copied. Modules implement
+	 * either receive() or this.
+	 *
+	 * @retval SR_OK Success
+	 * @retval other Negative error code.
+	 */
+	int (*consume) (struct sr_input *in, const uint8_t *data, gsize len);
+
 	/**
 	 * Signal the input module no more data will come.
 	 *
@@ -925,6 +947,8 @@ struct sr_output {
 	 * there, and only flush it when it reaches a certain size.
 	 */
 	void *priv;
+	/** Where sr_output_write() puts the output, NULL if not set. */
+	struct sr_output_sink *sink;
 };
 
 /** Output module driver. */
@@ -1007,6 +1031,21 @@ struct sr_output_module {
 	int (*receive) (const struct sr_output *o,
 			const struct sr_datafeed_packet *packet, GString **out);
 
+	/**
+	 * Like receive(), but the output gets appended to <code>out</code>,
+	 * which the caller reuses across packets. Modules implement either
+	 * this or receive().
+	 *
+	 * @param o Pointer to the respective 'struct sr_output'.
+	 * @param packet The complete packet.
+	 * @param out The string to append output to.
+	 *
+	 * @retval SR_OK Success
+	 * @retval other Negative error code.
+	 */
+	int (*append) (const struct sr_output *o,
+			const struct sr_datafeed_packet *packet, GString *out);
+
 	/**
 	 * This function is called after the caller is finished using
 	 * the output module, and can be used to free any internal
@@ -1018,6 +1057,26 @@ struct sr_output_module {
 	int (*cleanup) (struct sr_output *o);
 };
 
+/**
+ * What a transform module does to logic and analog packets, expressed in a
+ * form that fuses with the operations of adjacent transform modules.
+ */
+struct sr_transform_op {
+	/**
+	 * Logic samples become (sample & logic_and) ^ logic_xor. Bit n is
+	 * channel n. Bytes beyond the first eight of a sample use the
+	 * high masks.
+	 */
+	uint64_t logic_and;
+	uint64_t logic_xor;
+	uint8_t logic_and_high;
+	uint8_t logic_xor_high;
+	/** The analog encoding's scale gets replaced by its reciprocal... */
+	gboolean analog_reciprocal;
+	/** ...and then multiplied by this. */
+	struct sr_rational analog_factor;
+};
+
 /** Transform module instance. */
 struct sr_transform {
 	/** A pointer to this transform's module. */
@@ -1094,6 +1153,23 @@ struct sr_transform_module {
 			struct sr_datafeed_packet *packet_in,
 			struct sr_datafeed_packet **packet_out);
 
+	/**
+	 * Optional. Describe what receive() does to logic and analog
+	 * packets. The session then fuses the operations of adjacent
+	 * transforms, and applies them in a single pass over the sample
+	 * data. The operation must not depend on the packet.
+	 *
+	 * @param t Pointer to the respective 'struct sr_transform'.
+	 * @param op The operation to fill in. Comes initialized to
+	 *           leave packets unchanged.
+	 *
+	 * @retval SR_OK Success
+	 * @retval other The module can't express what it does, the
+	 *               session runs receive() instead.
+	 */
+	int (*get_op) (const struct sr_transform *t,
+			struct sr_transform_op *op);
+
 	/**
 	 * This function is called after the caller is finished using
 	 * the transform module, and can be used to free any internal
@@ -1106,6 +1182,30 @@ struct sr_transform_module {
 };
 
 #ifdef HAVE_LIBUSB_1_0
+/** Sizing and statistics of a driver's streaming bulk transfers. */
+struct usb_stream {
+	/** Size of each transfer buffer in bytes. */
+	size_t buffer_size;
+	/** Number of transfers to keep in flight. */
+	unsigned int num_transfers;
+	/** Upper limit for num_transfers when growing the pool. */
+	unsigned int max_transfers;
+	/** Transfer timeout in ms. */
+	unsigned int timeout;
+	/** Time it takes the device to fill a buffer. */
+	int64_t buffer_us;
+	/** Transfers currently submitted. Accessed atomically. */
+	int in_flight;
+	/** Completed transfers. */
+	uint64_t completions;
+	/** Completions which arrived after half of the transfers ran dry. */
+	uint64_t late_completions;
+	/** Completions without data, or with an error. */
+	uint64_t empty_transfers;
+	/** Time of the previous completion, 0 before the first one. */
+	int64_t last_completion_us;
+};
+
 /** USB device instance */
 struct sr_usb_dev_inst {
 	/** USB bus */
@@ -1114,6 +1214,8 @@ struct sr_usb_dev_inst {
 	uint8_t address;
 	/** libusb device handle */
 	struct libusb_device_handle *devhdl;
+	/** Bulk transfers of the current or last acquisition. */
+	struct usb_stream stream;
 };
 #endif
 
@@ -1336,6 +1438,9 @@ struct sr_session {
 	/** List of struct datafeed_callback pointers. */
 	GSList *datafeed_callbacks;
 	GSList *transforms;
+	/** Sample data output of fused transform operations, reused. */
+	uint8_t *transform_buf;
+	size_t transform_buf_size;
 	struct sr_trigger *trigger;
 
 	/** Callback to invoke on session stop. */
@@ -1356,6 +1461,16 @@ struct sr_session {
 	unsigned int stop_check_id;
 	/** Whether the session has been started. */
 	gboolean running;
+	/** Queue depth for asynchronous datafeed dispatch, 0 if disabled. */
+	unsigned int dispatch_depth;
+	/** Policy applied when the dispatch queue is full. */
+	enum sr_dispatch_policy dispatch_policy;
+	/** Asynchronous dispatcher while the session is running, or NULL. */
+	struct sr_dispatch *dispatch;
+	/** Highest number of packets queued for dispatch at the same time. */
+	unsigned int dispatch_high_water;
+	/** Number of packets dropped because the dispatch queue was full. */
+	uint64_t dispatch_dropped;
 };
 
 SR_PRIV int sr_session_source_add_internal(struct sr_session *session,
@@ -1386,10 +1501,56 @@ SR_PRIV int sr_session_send_meta(const struct sr_dev_inst *sdi,
 		uint32_t key, GVariant *var);
 SR_PRIV int sr_session_send(const struct sr_dev_inst *sdi,
 		const struct sr_datafeed_packet *packet);
+SR_PRIV int sr_session_send_buffer(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, struct sr_buffer *buf);
+SR_PRIV void sr_session_datafeed_run(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, struct sr_buffer *buf);
+SR_PRIV gboolean sr_session_logic_planar_wanted(const struct sr_dev_inst *sdi);
+SR_PRIV struct sr_buffer *sr_packet_buffer(const struct sr_datafeed_packet *packet);
 SR_PRIV int sr_sessionfile_check(const char *filename);
 SR_PRIV struct sr_dev_inst *sr_session_prepare_sdi(const char *filename,
 		struct sr_session **session);
 
+/*--- session_dispatch.c ----------------------------------------------------*/
+
+struct sr_dispatch;
+
+SR_PRIV int sr_session_dispatch_start(struct sr_session *session);
+SR_PRIV void sr_session_dispatch_stop(struct sr_session *session);
+SR_PRIV int sr_session_dispatch_push(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet);
+
+/*--- transform/transform.c -------------------------------------------------*/
+
+SR_PRIV void sr_transform_op_init(struct sr_transform_op *op);
+SR_PRIV int sr_transform_op_fuse(struct sr_transform_op *op,
+		const struct sr_transform_op *next);
+SR_PRIV gboolean sr_transform_op_logic(const struct sr_transform_op *op,
+		const uint8_t *in, uint8_t *out, uint64_t length, uint16_t unitsize);
+SR_PRIV int sr_transform_op_analog(const struct sr_transform_op *op,
+		struct sr_analog_encoding *encoding);
+SR_PRIV int sr_transform_op_receive(const struct sr_transform *t,
+		struct sr_datafeed_packet *packet_in,
+		struct sr_datafeed_packet **packet_out);
+
+/*--- input/input.c ---------------------------------------------------------*/
+
+struct sr_input_pool;
+
+/* Converts a block of input data into out, in a worker thread. */
+typedef int (*sr_input_block_convert)(const uint8_t *data, gsize len,
+		uint8_t *out, void *cb_data);
+/* Sends a converted block, in order, in the thread running the pool. */
+typedef int (*sr_input_block_send)(const uint8_t *data, gsize len,
+		const uint8_t *out, void *cb_data);
+
+SR_PRIV struct sr_input_pool *sr_input_pool_new(unsigned int num_threads,
+		gsize block_size, gsize out_size, sr_input_block_convert convert,
+		sr_input_block_send send, void *cb_data);
+SR_PRIV int sr_input_pool_run(struct sr_input_pool *pool,
+		const uint8_t *data, gsize len);
+SR_PRIV void sr_input_pool_free(struct sr_input_pool *pool);
+
 /*--- session_file.c --------------------------------------------------------*/
 
 #if !HAVE_ZIP_DISCARD
@@ -1409,6 +1570,93 @@ SR_PRIV int sr_analog_init(struct sr_datafeed_analog *analog,
                            struct sr_analog_spec *spec,
                            int digits);
 
+/*--- simd.c ----------------------------------------------------------------*/
+
+/*
+ * Vectorized code paths get compiled for the respective instruction set
+ * extension via function attributes, and are selected at run-time based
+ * on sr_simd_features(). Portable code must always remain available.
+ */
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__clang__) || \
+	(defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))))
+#define SR_SIMD_X86 1
+#define SR_SIMD_TARGET_SSE2 __attribute__((target("sse2")))
+#define SR_SIMD_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#if (defined(__ARM_NEON) || defined(__ARM_NEON__)) && !defined(WORDS_BIGENDIAN)
+#define SR_SIMD_ARM_NEON 1
+#endif
+
+#define SR_SIMD_SSE2	(1 << 0)
+#define SR_SIMD_AVX2	(1 << 1)
+#define SR_SIMD_NEON	(1 << 2)
+
+SR_PRIV unsigned int sr_simd_features(void);
+SR_PRIV void sr_simd_features_limit(unsigned int features);
+
+/*--- buffer.c --------------------------------------------------------------*/
+
+struct sr_buffer_pool;
+
+SR_PRIV gboolean sr_buffer_is_shared(const struct sr_buffer *buf);
+SR_PRIV gboolean sr_buffer_contains(const struct sr_buffer *buf,
+		const void *data, size_t len);
+SR_PRIV struct sr_buffer_pool *sr_buffer_pool_new(size_t size,
+		unsigned int max_free);
+SR_PRIV struct sr_buffer *sr_buffer_pool_get(struct sr_buffer_pool *pool);
+SR_PRIV void sr_buffer_pool_free(struct sr_buffer_pool *pool);
+
+/*--- logic_rle.c -----------------------------------------------------------*/
+
+struct sr_logic_rle_iter {
+	const struct sr_datafeed_logic_rle *rle;
+	/* Current run, and samples of it already expanded. */
+	uint64_t run;
+	uint64_t offset;
+};
+
+/* Collects runs into SR_DF_LOGIC_RLE packets. */
+struct sr_logic_rle_queue {
+	struct sr_datafeed_logic_rle rle;
+	uint64_t max_runs;
+};
+
+/* Takes a chunk of dense logic data expanded from another representation. */
+typedef int (*sr_logic_chunk_cb)(const struct sr_datafeed_logic *logic,
+		void *cb_data);
+
+SR_PRIV void sr_logic_rle_fill(uint8_t *dst, const uint8_t *value,
+		uint16_t unitsize, uint64_t count);
+SR_PRIV void sr_logic_rle_iter_init(struct sr_logic_rle_iter *it,
+		const struct sr_datafeed_logic_rle *rle);
+SR_PRIV uint64_t sr_logic_rle_expand(struct sr_logic_rle_iter *it,
+		uint8_t *dst, uint64_t max_samples);
+SR_PRIV int sr_logic_rle_foreach_chunk(const struct sr_datafeed_logic_rle *rle,
+		sr_logic_chunk_cb cb, void *cb_data);
+SR_PRIV struct sr_logic_rle_queue *sr_logic_rle_queue_new(uint16_t unitsize,
+		uint64_t max_runs);
+SR_PRIV gboolean sr_logic_rle_queue_add(struct sr_logic_rle_queue *q,
+		const void *value, uint64_t count);
+SR_PRIV int sr_logic_rle_queue_send(struct sr_logic_rle_queue *q,
+		const struct sr_dev_inst *sdi);
+SR_PRIV void sr_logic_rle_queue_free(struct sr_logic_rle_queue *q);
+
+/*--- logic_planar.c --------------------------------------------------------*/
+
+SR_PRIV void sr_logic_planar_pack(const struct sr_datafeed_logic_planar *planar,
+		uint64_t first, uint64_t count, uint8_t *dst);
+SR_PRIV void sr_logic_planar_unpack(const struct sr_datafeed_logic *logic,
+		const struct sr_datafeed_logic_planar *planar);
+SR_PRIV int sr_logic_planar_foreach_chunk(
+		const struct sr_datafeed_logic_planar *planar,
+		sr_logic_chunk_cb cb, void *cb_data);
+
+/*--- conversion.c ----------------------------------------------------------*/
+
+SR_PRIV void sr_split_logic_analog(const uint8_t *data, size_t num_samples,
+		size_t logic_size, size_t analog_size,
+		uint8_t *logic, uint8_t *analog);
+
 /*--- std.c -----------------------------------------------------------------*/
 
 typedef int (*dev_close_callback)(struct sr_dev_inst *sdi);
@@ -1513,12 +1761,17 @@ SR_PRIV void sr_hexdump_free(GString *s);
 
 /*--- soft-trigger.c --------------------------------------------------------*/
 
+struct soft_trigger_stage;
+
 struct soft_trigger_logic {
 	const struct sr_dev_inst *sdi;
 	const struct sr_trigger *trigger;
-	int count;
 	int unitsize;
+	int num_words;
+	int num_stages;
+	struct soft_trigger_stage *stages;
 	int cur_stage;
+	gboolean have_prev;
 	uint8_t *prev_sample;
 	uint8_t *pre_trigger_buffer;
 	uint8_t *pre_trigger_head;
@@ -1703,6 +1956,95 @@ SR_PRIV int ezusb_upload_firmware(struct sr_context *ctx, libusb_device *dev,
 
 /*--- usb.c -----------------------------------------------------------------*/
 
+/**
+ * Indices of a bounded ring which one producer and one consumer thread
+ * share without locking, as the USB completion queue uses it. Plain
+ * items are limited to the depth, others may also use the reserve.
+ */
+struct usb_ring {
+	/** Ring size minus one, the size is a power of two. */
+	guint mask;
+	guint depth;
+	guint reserve;
+	/** Free running indices, only ever advanced by consumer/producer. */
+	gint head;
+	gint tail;
+};
+
+/**
+ * Set up ring indices.
+ * @return The ring size, at least depth + reserve.
+ */
+static inline guint usb_ring_init(struct usb_ring *r, guint depth,
+		guint reserve)
+{
+	guint size;
+
+	r->depth = MAX(depth, 1);
+	r->reserve = reserve;
+	size = 1;
+	while (size < r->depth + r->reserve)
+		size <<= 1;
+	r->mask = size - 1;
+	r->head = 0;
+	r->tail = 0;
+
+	return size;
+}
+
+/** Number of items in a ring. */
+static inline guint usb_ring_fill(struct usb_ring *r)
+{
+	return (guint)g_atomic_int_get(&r->tail) - (guint)g_atomic_int_get(&r->head);
+}
+
+/**
+ * Get the slot for a new item, which may use the reserve or not.
+ * Producer only, the item gets visible with usb_ring_push_done().
+ * @return FALSE if the ring is full.
+ */
+static inline gboolean usb_ring_push_slot(struct usb_ring *r,
+		gboolean use_reserve, guint *slot)
+{
+	guint limit;
+
+	limit = use_reserve ? r->depth + r->reserve : r->depth;
+	if (usb_ring_fill(r) >= limit)
+		return FALSE;
+	*slot = (guint)g_atomic_int_get(&r->tail) & r->mask;
+
+	return TRUE;
+}
+
+/** Make the item in the slot from usb_ring_push_slot() visible. */
+static inline void usb_ring_push_done(struct usb_ring *r)
+{
+	g_atomic_int_set(&r->tail, (guint)g_atomic_int_get(&r->tail) + 1);
+}
+
+/**
+ * Get the slot of the oldest item. Consumer only, the slot is free
+ * again after usb_ring_pop_done().
+ * @return FALSE if the ring is empty.
+ */
+static inline gboolean usb_ring_pop_slot(struct usb_ring *r, guint *slot)
+{
+	guint head;
+
+	head = g_atomic_int_get(&r->head);
+	if (head == (guint)g_atomic_int_get(&r->tail))
+		return FALSE;
+	*slot = head & r->mask;
+
+	return TRUE;
+}
+
+/** Release the slot from usb_ring_pop_slot(). */
+static inline void usb_ring_pop_done(struct usb_ring *r)
+{
+	g_atomic_int_set(&r->head, (guint)g_atomic_int_get(&r->head) + 1);
+}
+
 #ifdef HAVE_LIBUSB_1_0
 SR_PRIV GSList *sr_usb_find(libusb_context *usb_ctx, const char *conn);
 SR_PRIV int sr_usb_open(libusb_context *usb_ctx, struct sr_usb_dev_inst *usb);
@@ -1710,6 +2052,41 @@ SR_PRIV void sr_usb_close(struct sr_usb_dev_inst *usb);
 SR_PRIV int usb_source_add(struct sr_session *session, struct sr_context *ctx,
 		int timeout, sr_receive_data_callback cb, void *cb_data);
 SR_PRIV int usb_source_remove(struct sr_session *session, struct sr_context *ctx);
+
+/** A transfer completion passed from the libusb event thread. */
+struct usb_completion {
+	/** The transfer if it was not resubmitted, to be freed by the driver. */
+	struct libusb_transfer *transfer;
+	/** The received data, or NULL. The item owns one reference. */
+	struct sr_buffer *buf;
+	/** Number of bytes received into @a buf. */
+	int length;
+	/** Status of the completed transfer. */
+	enum libusb_transfer_status status;
+};
+
+struct usb_event_thread;
+struct usb_queue;
+
+SR_PRIV struct usb_queue *usb_queue_new(unsigned int depth,
+		unsigned int reserve);
+SR_PRIV void usb_queue_free(struct usb_queue *q);
+SR_PRIV gboolean usb_queue_push(struct usb_queue *q,
+		const struct usb_completion *c);
+SR_PRIV gboolean usb_queue_pop(struct usb_queue *q, struct usb_completion *c);
+SR_PRIV int usb_queue_source_add(struct sr_session *session,
+		struct sr_context *ctx, struct usb_queue *q, int timeout,
+		sr_receive_data_callback cb, void *cb_data);
+SR_PRIV int usb_queue_source_remove(struct sr_session *session,
+		struct usb_queue *q);
+SR_PRIV void usb_stream_init(struct usb_stream *s, uint64_t bytes_per_sec,
+		size_t block_size, unsigned int buffer_ms, unsigned int total_ms,
+		unsigned int num_transfers, unsigned int max_transfers);
+SR_PRIV int usb_stream_submit(struct usb_stream *s,
+		struct libusb_transfer *transfer);
+SR_PRIV unsigned int usb_stream_completed(struct usb_stream *s,
+		const struct libusb_transfer *transfer);
+SR_PRIV void usb_stream_log(const struct usb_stream *s);
 SR_PRIV int usb_get_port_path(libusb_device *dev, char *path, int path_len);
 SR_PRIV gboolean usb_match_manuf_prod(libusb_device *dev,
 		const char *manufacturer, const char *product);
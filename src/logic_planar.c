@@ -0,0 +1,344 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2026 The sigrok developers
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <string.h>
+#include <glib.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+
+/** @cond PRIVATE */
+#define LOG_PREFIX "logic-planar"
+/** @endcond */
+
+/* Size of the dense chunks handed to consumers which don't take planes. */
+#define DENSE_CHUNK_SIZE (1024 * 1024)
+
+/* Groups of eight samples per batch of 8x8 bit matrix transposes. */
+#define TRANSPOSE_GROUPS 256
+
+/**
+ * @file
+ *
+ * Channel-planar logic data.
+ */
+
+/**
+ * @defgroup grp_logic_planar Channel-planar logic data
+ *
+ * Logic data as one bit array per channel.
+ *
+ * Many devices deliver their samples channel by channel, and consumers
+ * which look at individual channels (protocol decoders, CSV output) are
+ * better off with that layout, too. Sources can send SR_DF_LOGIC_PLANAR
+ * packets when sr_session_logic_planar_wanted() says a consumer takes
+ * them. Datafeed callbacks registered with
+ * sr_session_datafeed_planar_callback_add() and output modules with the
+ * SR_OUTPUT_LOGIC_PLANAR flag receive the planes as they are, everything
+ * else receives the equivalent SR_DF_LOGIC packets. That way the bit
+ * matrix transposition only happens when somebody needs packed samples.
+ *
+ * @{
+ */
+
+/**
+ * Get the bit array of a channel in channel-planar logic data.
+ *
+ * @param planar The logic data. Must not be NULL.
+ * @param channel The channel, as bit index within a sample.
+ *
+ * @return The channel's plane, or NULL if the channel has none (and
+ *         therefore reads as low).
+ *
+ * @since 0.6.0
+ */
+SR_API const uint8_t *sr_logic_planar_channel(
+		const struct sr_datafeed_logic_planar *planar, uint32_t channel)
+{
+	const uint8_t *data;
+	uint32_t i;
+
+	data = planar->data;
+	for (i = 0; i < planar->num_planes; i++) {
+		if (planar->channels[i] == channel)
+			return data + i * planar->stride;
+	}
+
+	return NULL;
+}
+
+/**
+ * Pack channel-planar logic data into a dense sample buffer.
+ *
+ * @param planar The logic data. Must not be NULL.
+ * @param logic The dense logic data. Must not be NULL. Its data is
+ *              newly allocated and must be freed by the caller
+ *              with g_free().
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ * @retval SR_ERR_MALLOC Memory allocation failure.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_logic_planar_densify(const struct sr_datafeed_logic_planar *planar,
+		struct sr_datafeed_logic *logic)
+{
+	if (!planar || !logic || !planar->unitsize)
+		return SR_ERR_ARG;
+	if (planar->num_planes && planar->stride < (planar->num_samples + 7) / 8)
+		return SR_ERR_ARG;
+
+	logic->unitsize = planar->unitsize;
+	logic->length = planar->num_samples * planar->unitsize;
+	logic->data = NULL;
+	if (!planar->num_samples)
+		return SR_OK;
+
+	if (!(logic->data = g_try_malloc(logic->length))) {
+		sr_err("Logic data malloc of %" PRIu64 " bytes failed.",
+			logic->length);
+		logic->length = 0;
+		return SR_ERR_MALLOC;
+	}
+	sr_logic_planar_pack(planar, 0, planar->num_samples, logic->data);
+
+	return SR_OK;
+}
+
+/**
+ * Split dense logic data into one bit array per channel.
+ *
+ * @param logic The dense logic data. Must not be NULL.
+ * @param channels The channels to extract, as bit indices within a
+ *                 sample. The array is referenced by the result, not
+ *                 copied.
+ * @param num_planes The number of channels.
+ * @param planar The channel-planar logic data. Must not be NULL. Its
+ *               data is newly allocated and must be freed by the caller
+ *               with g_free().
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ * @retval SR_ERR_MALLOC Memory allocation failure.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_logic_planar_split(const struct sr_datafeed_logic *logic,
+		uint32_t *channels, uint32_t num_planes,
+		struct sr_datafeed_logic_planar *planar)
+{
+	uint8_t *data;
+	uint64_t num_samples, stride;
+	uint32_t i;
+
+	if (!logic || !planar || !logic->unitsize || (num_planes && !channels))
+		return SR_ERR_ARG;
+	for (i = 0; i < num_planes; i++) {
+		if (channels[i] >= logic->unitsize * 8U)
+			return SR_ERR_ARG;
+	}
+
+	num_samples = logic->length / logic->unitsize;
+	stride = (num_samples + 7) / 8;
+	planar->num_samples = num_samples;
+	planar->unitsize = logic->unitsize;
+	planar->num_planes = num_planes;
+	planar->channels = channels;
+	planar->stride = stride;
+	planar->data = NULL;
+	if (!stride || !num_planes)
+		return SR_OK;
+
+	if (!(data = g_try_malloc(num_planes * stride))) {
+		sr_err("Logic planes malloc of %" PRIu64 " bytes failed.",
+			num_planes * stride);
+		return SR_ERR_MALLOC;
+	}
+	planar->data = data;
+	sr_logic_planar_unpack(logic, planar);
+
+	return SR_OK;
+}
+
+/** @} */
+
+/**
+ * Pack part of channel-planar logic data into dense samples.
+ *
+ * @param planar The logic data.
+ * @param first The first sample to pack. Must be a multiple of 8.
+ * @param count The number of samples to pack.
+ * @param dst The buffer, with room for @a count samples.
+ *
+ * @private
+ */
+SR_PRIV void sr_logic_planar_pack(const struct sr_datafeed_logic_planar *planar,
+		uint64_t first, uint64_t count, uint8_t *dst)
+{
+	static const uint8_t zeros[TRANSPOSE_GROUPS];
+	const uint8_t *data, *rows[8], *row;
+	uint8_t m[TRANSPOSE_GROUPS * 8];
+	uint64_t num_groups, g, n, s, end;
+	unsigned int lane, j, k;
+	uint16_t unitsize;
+	uint32_t i, ch;
+	gboolean used;
+
+	data = planar->data;
+	unitsize = planar->unitsize;
+	first /= 8;
+	num_groups = (count + 7) / 8;
+	for (lane = 0; lane < unitsize; lane++) {
+		used = FALSE;
+		memset(rows, 0, sizeof(rows));
+		for (i = 0; i < planar->num_planes; i++) {
+			ch = planar->channels[i];
+			if (ch / 8 != lane)
+				continue;
+			rows[ch % 8] = data + i * planar->stride + first;
+			used = TRUE;
+		}
+		if (!used) {
+			for (s = 0; s < count; s++)
+				dst[s * unitsize + lane] = 0;
+			continue;
+		}
+
+		/* Byte g of the eight planes is a matrix of eight samples. */
+		for (g = 0; g < num_groups; g += n) {
+			n = MIN(num_groups - g, TRANSPOSE_GROUPS);
+			for (k = 0; k < 8; k++) {
+				row = rows[k] ? rows[k] + g : zeros;
+				for (j = 0; j < n; j++)
+					m[j * 8 + k] = row[j];
+			}
+			sr_transpose_8x8(m, m, n);
+			end = MIN(count - g * 8, n * 8);
+			for (s = 0; s < end; s++)
+				dst[(g * 8 + s) * unitsize + lane] = m[s];
+		}
+	}
+}
+
+/**
+ * Split dense samples into the planes of channel-planar logic data.
+ *
+ * @param logic The dense logic data.
+ * @param planar The logic data to fill in. Its fields describe the
+ *               planes, and its data must have room for them.
+ *
+ * @private
+ */
+SR_PRIV void sr_logic_planar_unpack(const struct sr_datafeed_logic *logic,
+		const struct sr_datafeed_logic_planar *planar)
+{
+	const uint8_t *src;
+	uint8_t *data, m[TRANSPOSE_GROUPS * 8];
+	uint64_t num_samples, stride, g, n, s, end;
+	unsigned int lane, j;
+	uint32_t i, ch;
+	gboolean used;
+
+	/*
+	 * Transposing eight samples' worth of one byte lane yields the
+	 * next byte of the planes of all eight channels in that lane.
+	 */
+	src = logic->data;
+	data = planar->data;
+	num_samples = planar->num_samples;
+	stride = planar->stride;
+	for (lane = 0; lane < logic->unitsize; lane++) {
+		used = FALSE;
+		for (i = 0; i < planar->num_planes && !used; i++)
+			used = planar->channels[i] / 8 == lane;
+		if (!used)
+			continue;
+		for (g = 0; g < (num_samples + 7) / 8; g += n) {
+			n = MIN((num_samples + 7) / 8 - g, TRANSPOSE_GROUPS);
+			end = MIN(n * 8, num_samples - g * 8);
+			for (s = 0; s < end; s++)
+				m[s] = src[(g * 8 + s) * logic->unitsize + lane];
+			memset(m + end, 0, n * 8 - end);
+			sr_transpose_8x8(m, m, n);
+			for (i = 0; i < planar->num_planes; i++) {
+				ch = planar->channels[i];
+				if (ch / 8 != lane)
+					continue;
+				for (j = 0; j < n; j++)
+					data[i * stride + g + j] = m[j * 8 + ch % 8];
+			}
+		}
+	}
+}
+
+/**
+ * Pass channel-planar logic data on as dense chunks.
+ *
+ * This serves consumers which only handle SR_DF_LOGIC packets, without
+ * packing the planes into a single huge buffer.
+ *
+ * @param planar The logic data. Must not be NULL.
+ * @param cb Function to call for each chunk. Iteration stops when it
+ *           doesn't return SR_OK.
+ * @param cb_data Opaque pointer passed to @a cb.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_MALLOC Memory allocation failure.
+ * @retval other The return value of a failed @a cb invocation.
+ *
+ * @private
+ */
+SR_PRIV int sr_logic_planar_foreach_chunk(
+		const struct sr_datafeed_logic_planar *planar,
+		sr_logic_chunk_cb cb, void *cb_data)
+{
+	struct sr_datafeed_logic logic;
+	uint64_t chunk_samples, first, count;
+	uint8_t *buf;
+	int ret;
+
+	if (!planar->unitsize)
+		return SR_OK;
+
+	/* Chunks start on plane byte boundaries. */
+	chunk_samples = MAX(DENSE_CHUNK_SIZE / planar->unitsize, 8) & ~7ULL;
+	chunk_samples = MIN(chunk_samples, planar->num_samples);
+	if (!chunk_samples)
+		return SR_OK;
+
+	if (!(buf = g_try_malloc(chunk_samples * planar->unitsize))) {
+		sr_err("Logic chunk malloc failed.");
+		return SR_ERR_MALLOC;
+	}
+
+	ret = SR_OK;
+	logic.unitsize = planar->unitsize;
+	logic.data = buf;
+	for (first = 0; first < planar->num_samples; first += count) {
+		count = MIN(chunk_samples, planar->num_samples - first);
+		sr_logic_planar_pack(planar, first, count, buf);
+		logic.length = count * planar->unitsize;
+		if ((ret = cb(&logic, cb_data)) != SR_OK)
+			break;
+	}
+	g_free(buf);
+
+	return ret;
+}
@@ -0,0 +1,365 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2026 The sigrok developers
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <string.h>
+#include <glib.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+
+/** @cond PRIVATE */
+#define LOG_PREFIX "logic-rle"
+/** @endcond */
+
+/* Size of the dense chunks handed to consumers which don't take runs. */
+#define DENSE_CHUNK_SIZE (1024 * 1024)
+
+/**
+ * @file
+ *
+ * Run-length compressed logic data.
+ */
+
+/**
+ * @defgroup grp_logic_rle Run-length compressed logic data
+ *
+ * Logic data as a sequence of (value, run length) pairs.
+ *
+ * Sources which know that the input signals remain unchanged for many
+ * samples (timestamped captures, VCD files) send SR_DF_LOGIC_RLE packets
+ * instead of expanding the runs into SR_DF_LOGIC packets. Datafeed
+ * callbacks registered with sr_session_datafeed_rle_callback_add() and
+ * output modules with the SR_OUTPUT_LOGIC_RLE flag receive the runs as
+ * they are, everything else receives the equivalent dense SR_DF_LOGIC
+ * packets.
+ *
+ * @{
+ */
+
+/**
+ * Get the number of samples in run-length compressed logic data.
+ *
+ * @param rle The logic data. Must not be NULL.
+ *
+ * @return The total of all run lengths.
+ *
+ * @since 0.6.0
+ */
+SR_API uint64_t sr_logic_rle_num_samples(const struct sr_datafeed_logic_rle *rle)
+{
+	uint64_t i, num_samples;
+
+	num_samples = 0;
+	for (i = 0; i < rle->num_runs; i++)
+		num_samples += rle->lengths[i];
+
+	return num_samples;
+}
+
+/**
+ * Expand run-length compressed logic data into a dense sample buffer.
+ *
+ * @param rle The logic data. Must not be NULL.
+ * @param logic The dense logic data. Must not be NULL. Its data is
+ *              newly allocated and must be freed by the caller
+ *              with g_free().
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ * @retval SR_ERR_MALLOC Memory allocation failure.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_logic_rle_densify(const struct sr_datafeed_logic_rle *rle,
+		struct sr_datafeed_logic *logic)
+{
+	struct sr_logic_rle_iter it;
+	uint64_t num_samples;
+
+	if (!rle || !logic || !rle->unitsize)
+		return SR_ERR_ARG;
+
+	num_samples = sr_logic_rle_num_samples(rle);
+	logic->unitsize = rle->unitsize;
+	logic->length = num_samples * rle->unitsize;
+	logic->data = NULL;
+	if (!num_samples)
+		return SR_OK;
+
+	if (!(logic->data = g_try_malloc(logic->length))) {
+		sr_err("Logic data malloc of %" PRIu64 " bytes failed.",
+			logic->length);
+		logic->length = 0;
+		return SR_ERR_MALLOC;
+	}
+	sr_logic_rle_iter_init(&it, rle);
+	sr_logic_rle_expand(&it, logic->data, num_samples);
+
+	return SR_OK;
+}
+
+/** @} */
+
+/**
+ * Fill a buffer with repetitions of a sample value.
+ *
+ * @param dst The buffer, with room for @a count samples.
+ * @param value The sample value, @a unitsize bytes.
+ * @param unitsize The size of a sample in bytes.
+ * @param count The number of samples to write.
+ *
+ * @private
+ */
+SR_PRIV void sr_logic_rle_fill(uint8_t *dst, const uint8_t *value,
+		uint16_t unitsize, uint64_t count)
+{
+	uint64_t done, total, len;
+
+	if (!count)
+		return;
+
+	if (unitsize == 1) {
+		memset(dst, value[0], count);
+		return;
+	}
+
+	/* Double the filled area with each copy. */
+	memcpy(dst, value, unitsize);
+	done = unitsize;
+	total = count * unitsize;
+	while (done < total) {
+		len = MIN(done, total - done);
+		memcpy(dst + done, dst, len);
+		done += len;
+	}
+}
+
+/**
+ * Start iterating over the samples of run-length compressed logic data.
+ *
+ * @param it The iterator state.
+ * @param rle The logic data, which must remain valid while iterating.
+ *
+ * @private
+ */
+SR_PRIV void sr_logic_rle_iter_init(struct sr_logic_rle_iter *it,
+		const struct sr_datafeed_logic_rle *rle)
+{
+	it->rle = rle;
+	it->run = 0;
+	it->offset = 0;
+}
+
+/**
+ * Expand the next samples of run-length compressed logic data.
+ *
+ * @param it The iterator state.
+ * @param dst The buffer, with room for @a max_samples samples.
+ * @param max_samples The maximum number of samples to write.
+ *
+ * @return The number of samples written, 0 when all runs are done.
+ *
+ * @private
+ */
+SR_PRIV uint64_t sr_logic_rle_expand(struct sr_logic_rle_iter *it,
+		uint8_t *dst, uint64_t max_samples)
+{
+	const struct sr_datafeed_logic_rle *rle;
+	const uint8_t *values;
+	uint64_t done, count;
+
+	rle = it->rle;
+	values = rle->values;
+	done = 0;
+	while (done < max_samples && it->run < rle->num_runs) {
+		count = MIN(rle->lengths[it->run] - it->offset, max_samples - done);
+		sr_logic_rle_fill(dst + done * rle->unitsize,
+			values + it->run * rle->unitsize, rle->unitsize, count);
+		done += count;
+		it->offset += count;
+		if (it->offset == rle->lengths[it->run]) {
+			it->run++;
+			it->offset = 0;
+		}
+	}
+
+	return done;
+}
+
+/**
+ * Pass run-length compressed logic data on as dense chunks.
+ *
+ * This serves consumers which only handle SR_DF_LOGIC packets, without
+ * expanding long runs into a single huge buffer.
+ *
+ * @param rle The logic data. Must not be NULL.
+ * @param cb Function to call for each chunk. Iteration stops when it
+ *           doesn't return SR_OK.
+ * @param cb_data Opaque pointer passed to @a cb.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_MALLOC Memory allocation failure.
+ * @retval other The return value of a failed @a cb invocation.
+ *
+ * @private
+ */
+SR_PRIV int sr_logic_rle_foreach_chunk(const struct sr_datafeed_logic_rle *rle,
+		sr_logic_chunk_cb cb, void *cb_data)
+{
+	struct sr_logic_rle_iter it;
+	struct sr_datafeed_logic logic;
+	uint64_t num_samples, chunk_samples, count;
+	uint8_t *buf;
+	int ret;
+
+	if (!rle->unitsize)
+		return SR_OK;
+
+	num_samples = sr_logic_rle_num_samples(rle);
+	chunk_samples = MAX(DENSE_CHUNK_SIZE / rle->unitsize, 1);
+	chunk_samples = MIN(chunk_samples, num_samples);
+	if (!chunk_samples)
+		return SR_OK;
+
+	if (!(buf = g_try_malloc(chunk_samples * rle->unitsize))) {
+		sr_err("Logic chunk malloc failed.");
+		return SR_ERR_MALLOC;
+	}
+
+	ret = SR_OK;
+	logic.unitsize = rle->unitsize;
+	logic.data = buf;
+	sr_logic_rle_iter_init(&it, rle);
+	while ((count = sr_logic_rle_expand(&it, buf, chunk_samples))) {
+		logic.length = count * rle->unitsize;
+		if ((ret = cb(&logic, cb_data)) != SR_OK)
+			break;
+	}
+	g_free(buf);
+
+	return ret;
+}
+
+/**
+ * Create a queue which collects runs of logic samples into packets.
+ *
+ * @param unitsize The size of a sample in bytes.
+ * @param max_runs The number of runs per packet.
+ *
+ * @return The new queue. Release with sr_logic_rle_queue_free().
+ *
+ * @private
+ */
+SR_PRIV struct sr_logic_rle_queue *sr_logic_rle_queue_new(uint16_t unitsize,
+		uint64_t max_runs)
+{
+	struct sr_logic_rle_queue *q;
+
+	q = g_malloc0(sizeof(*q));
+	q->max_runs = MAX(max_runs, 1);
+	q->rle.unitsize = unitsize;
+	q->rle.values = g_malloc(q->max_runs * unitsize);
+	q->rle.lengths = g_malloc(q->max_runs * sizeof(uint64_t));
+
+	return q;
+}
+
+/**
+ * Append a run of samples to a queue.
+ *
+ * A run with the same value as the previous one extends that run.
+ *
+ * @param q The queue. Must not be NULL.
+ * @param value The sample value, of the queue's unit size.
+ * @param count The number of samples.
+ *
+ * @return TRUE if the queue is full and must be sent before adding
+ *         another run, FALSE otherwise.
+ *
+ * @private
+ */
+SR_PRIV gboolean sr_logic_rle_queue_add(struct sr_logic_rle_queue *q,
+		const void *value, uint64_t count)
+{
+	struct sr_datafeed_logic_rle *rle;
+	uint8_t *values;
+
+	rle = &q->rle;
+	values = rle->values;
+	if (!count)
+		return rle->num_runs == q->max_runs;
+
+	if (rle->num_runs && !memcmp(values + (rle->num_runs - 1) * rle->unitsize,
+			value, rle->unitsize)) {
+		rle->lengths[rle->num_runs - 1] += count;
+		return rle->num_runs == q->max_runs;
+	}
+
+	memcpy(values + rle->num_runs * rle->unitsize, value, rle->unitsize);
+	rle->lengths[rle->num_runs++] = count;
+
+	return rle->num_runs == q->max_runs;
+}
+
+/**
+ * Send the runs collected in a queue to the session bus.
+ *
+ * Does nothing if the queue is empty. The queue is empty afterwards.
+ *
+ * @param q The queue. Must not be NULL.
+ * @param sdi The device instance to send the packet from.
+ *
+ * @retval SR_OK Success.
+ * @retval other Error sending the packet.
+ *
+ * @private
+ */
+SR_PRIV int sr_logic_rle_queue_send(struct sr_logic_rle_queue *q,
+		const struct sr_dev_inst *sdi)
+{
+	struct sr_datafeed_packet packet;
+	int ret;
+
+	if (!q->rle.num_runs)
+		return SR_OK;
+
+	packet.type = SR_DF_LOGIC_RLE;
+	packet.payload = &q->rle;
+	ret = sr_session_send(sdi, &packet);
+	q->rle.num_runs = 0;
+
+	return ret;
+}
+
+/**
+ * Release a run queue. Runs which were not sent are discarded.
+ *
+ * @param q The queue. NULL is silently ignored.
+ *
+ * @private
+ */
+SR_PRIV void sr_logic_rle_queue_free(struct sr_logic_rle_queue *q)
+{
+	if (!q)
+		return;
+
+	g_free(q->rle.values);
+	g_free(q->rle.lengths);
+	g_free(q);
+}
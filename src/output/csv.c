@@ -209,20 +209,18 @@ static const char *xlabels[] = {
 	"femtoseconds", "attoseconds",
 };
 
-static GString *gen_header(const struct sr_output *o,
-			   const struct sr_datafeed_header *hdr)
+static void gen_header(const struct sr_output *o,
+		       const struct sr_datafeed_header *hdr, GString *header)
 {
 	struct context *ctx;
 	struct sr_channel *ch;
 	GVariant *gvar;
-	GString *header;
 	GSList *channels, *l;
 	unsigned int num_channels, i;
 	uint64_t samplerate = 0, sr;
 	char *samplerate_s;
 
 	ctx = o->priv;
-	header = g_string_sized_new(512);
 
 	if (ctx->period == 0) {
 		if (sr_config_get(o->sdi->driver, o->sdi, NULL,
@@ -279,8 +277,6 @@ static GString *gen_header(const struct sr_output *o,
 		}
 		ctx->did_header = TRUE;
 	}
-
-	return header;
 }
 
 /*
@@ -398,7 +394,66 @@ static void process_logic(struct context *ctx,
 	}
 }
 
-static void dump_saved_values(struct context *ctx, GString **out)
+/* Planar data has the samples of each channel in one place already. */
+static void process_logic_planar(struct context *ctx,
+		const struct sr_datafeed_logic_planar *planar)
+{
+	unsigned int i, j, ch, num_samples;
+	const uint8_t *plane;
+
+	num_samples = planar->num_samples;
+	ctx->channels_seen += ctx->logic_channel_count;
+	sr_dbg("Logic packet had %u planes", planar->num_planes);
+	if (!ctx->logic_samples) {
+		ctx->logic_samples = g_malloc(num_samples * ctx->num_logic_channels);
+		if (!ctx->num_samples)
+			ctx->num_samples = num_samples;
+	}
+	if (ctx->num_samples != num_samples)
+		sr_warn("Expecting %u samples, got %u",
+			ctx->num_samples, num_samples);
+
+	for (j = ch = 0; ch < ctx->num_logic_channels; j++) {
+		if (ctx->channels[j].ch->type != SR_CHANNEL_LOGIC)
+			continue;
+		if (ctx->label_do && !ctx->label_names)
+			ctx->channels[j].label = "logic";
+		plane = sr_logic_planar_channel(planar, ctx->channels[j].ch->index);
+		for (i = 0; i < num_samples; i++)
+			ctx->logic_samples[i * ctx->num_logic_channels + ch] =
+				plane ? plane[i / 8] & (1 << (i % 8)) : 0;
+		ch++;
+	}
+}
+
+static void dump_labels(struct context *ctx, GString *out)
+{
+	unsigned int i, num_channels;
+
+	if (!ctx->label_do)
+		return;
+
+	num_channels = ctx->num_logic_channels + ctx->num_analog_channels;
+	if (ctx->time)
+		g_string_append_printf(out, "%s%s",
+			ctx->label_names ? "Time" : ctx->xlabel, ctx->value);
+	for (i = 0; i < num_channels; i++) {
+		g_string_append_printf(out, "%s%s",
+			ctx->channels[i].label, ctx->value);
+		if (ctx->channels[i].ch->type == SR_CHANNEL_ANALOG
+				&& ctx->label_names)
+			g_free(ctx->channels[i].label);
+	}
+	if (ctx->do_trigger)
+		g_string_append_printf(out, "Trigger%s", ctx->value);
+	/* Drop last separator. */
+	g_string_truncate(out, out->len - 1);
+	g_string_append(out, ctx->record);
+
+	ctx->label_do = FALSE;
+}
+
+static void dump_saved_values(struct context *ctx, GString *out)
 {
 	unsigned int i, j, analog_size, num_channels;
 	float *analog_sample, value;
@@ -411,31 +466,10 @@ static void dump_saved_values(struct context *ctx, GString **out)
 	} else {
 		sr_info("Dumping %u samples", ctx->num_samples);
 
-		*out = g_string_sized_new(512);
 		num_channels =
 		    ctx->num_logic_channels + ctx->num_analog_channels;
 
-		if (ctx->label_do) {
-			if (ctx->time)
-				g_string_append_printf(*out, "%s%s",
-					ctx->label_names ? "Time" :
-					ctx->xlabel, ctx->value);
-			for (i = 0; i < num_channels; i++) {
-				g_string_append_printf(*out, "%s%s",
-					ctx->channels[i].label, ctx->value);
-				if (ctx->channels[i].ch->type == SR_CHANNEL_ANALOG
-						&& ctx->label_names)
-					g_free(ctx->channels[i].label);
-			}
-			if (ctx->do_trigger)
-				g_string_append_printf(*out, "Trigger%s",
-						       ctx->value);
-			/* Drop last separator. */
-			g_string_truncate(*out, (*out)->len - 1);
-			g_string_append(*out, ctx->record);
-
-			ctx->label_do = FALSE;
-		}
+		dump_labels(ctx, out);
 
 		analog_size = ctx->num_analog_channels * sizeof(float);
 		if (ctx->dedup && !ctx->previous_sample)
@@ -465,7 +499,7 @@ static void dump_saved_values(struct context *ctx, GString **out)
 			}
 
 			if (ctx->time)
-				g_string_append_printf(*out, "%" PRIu64 "%s",
+				g_string_append_printf(out, "%" PRIu64 "%s",
 					ctx->sample_time, ctx->value);
 
 			for (j = 0; j < num_channels; j++) {
@@ -475,10 +509,10 @@ static void dump_saved_values(struct context *ctx, GString **out)
 					    fmax(value, ctx->channels[j].max);
 					ctx->channels[j].min =
 					    fmin(value, ctx->channels[j].min);
-					g_string_append_printf(*out, "%g%s",
+					g_string_append_printf(out, "%g%s",
 						value, ctx->value);
 				} else if (ctx->channels[j].ch->type == SR_CHANNEL_LOGIC) {
-					g_string_append_printf(*out, "%c%s",
+					g_string_append_printf(out, "%c%s",
 							       ctx->logic_samples[i * ctx->num_logic_channels + j] ? '1' : '0', ctx->value);
 				} else {
 					sr_warn("Unexpected channel type: %d",
@@ -487,12 +521,12 @@ static void dump_saved_values(struct context *ctx, GString **out)
 			}
 
 			if (ctx->do_trigger) {
-				g_string_append_printf(*out, "%d%s",
+				g_string_append_printf(out, "%d%s",
 					ctx->trigger, ctx->value);
 				ctx->trigger = FALSE;
 			}
-			g_string_truncate(*out, (*out)->len - 1);
-			g_string_append(*out, ctx->record);
+			g_string_truncate(out, out->len - 1);
+			g_string_append(out, ctx->record);
 		}
 	}
 
@@ -507,6 +541,85 @@ static void dump_saved_values(struct context *ctx, GString **out)
 	ctx->logic_samples = NULL;
 }
 
+static void append_logic_row(struct context *ctx, GString *out,
+		const GString *row)
+{
+	if (ctx->time)
+		g_string_append_printf(out, "%" PRIu64 "%s",
+			ctx->sample_time, ctx->value);
+	g_string_append_len(out, row->str, row->len);
+	if (ctx->do_trigger) {
+		g_string_append_printf(out, "%d%s", ctx->trigger, ctx->value);
+		ctx->trigger = FALSE;
+	}
+	g_string_truncate(out, out->len - 1);
+	g_string_append(out, ctx->record);
+}
+
+/*
+ * Logic-only data is written straight from the runs. The channel values
+ * get formatted once per run, and with deduplication only the first
+ * sample of a run is written (plus the packet's last sample, like for
+ * dense packets).
+ */
+static void process_logic_rle(struct context *ctx,
+		const struct sr_datafeed_logic_rle *rle, GString *out)
+{
+	const uint8_t *values, *value;
+	GString *row, *prev_row;
+	uint64_t i, k, pos, len, num_samples;
+	unsigned int j;
+	int idx;
+
+	num_samples = sr_logic_rle_num_samples(rle);
+	if (!num_samples)
+		return;
+
+	sr_info("Dumping %" PRIu64 " samples", num_samples);
+	for (j = 0; j < ctx->num_logic_channels; j++) {
+		if (ctx->label_do && !ctx->label_names)
+			ctx->channels[j].label = "logic";
+	}
+
+	dump_labels(ctx, out);
+
+	row = g_string_sized_new(64);
+	prev_row = g_string_sized_new(64);
+	values = rle->values;
+	pos = 0;
+	for (i = 0; i < rle->num_runs; i++) {
+		if (!(len = rle->lengths[i]))
+			continue;
+		value = values + i * rle->unitsize;
+		g_string_truncate(row, 0);
+		for (j = 0; j < ctx->num_logic_channels; j++) {
+			idx = ctx->channels[j].ch->index;
+			g_string_append_c(row,
+				(value[idx / 8] & (1 << (idx % 8))) ? '1' : '0');
+			g_string_append(row, ctx->value);
+		}
+
+		if (!ctx->dedup) {
+			for (k = 0; k < len; k++) {
+				ctx->sample_time += ctx->period;
+				append_logic_row(ctx, out, row);
+			}
+		} else {
+			ctx->sample_time += ctx->period;
+			if (pos == 0 || pos == num_samples - 1 ||
+					!g_string_equal(row, prev_row))
+				append_logic_row(ctx, out, row);
+			ctx->sample_time += ctx->period * (len - 1);
+			if (len > 1 && pos + len == num_samples)
+				append_logic_row(ctx, out, row);
+			g_string_assign(prev_row, row->str);
+		}
+		pos += len;
+	}
+	g_string_free(row, TRUE);
+	g_string_free(prev_row, TRUE);
+}
+
 static void save_gnuplot(struct context *ctx)
 {
 	float offset, max, sum;
@@ -559,12 +672,12 @@ static void save_gnuplot(struct context *ctx)
 	g_string_free(script, TRUE);
 }
 
-static int receive(const struct sr_output *o,
-		   const struct sr_datafeed_packet *packet, GString **out)
+static int append(const struct sr_output *o,
+		  const struct sr_datafeed_packet *packet, GString *out)
 {
 	struct context *ctx;
+	struct sr_datafeed_logic logic;
 
-	*out = NULL;
 	if (!o || !o->sdi)
 		return SR_ERR_ARG;
 	if (!(ctx = o->priv))
@@ -573,7 +686,7 @@ static int receive(const struct sr_output *o,
 	sr_dbg("Got packet of type %d", packet->type);
 	switch (packet->type) {
 	case SR_DF_HEADER:
-		*out = gen_header(o, packet->payload);
+		gen_header(o, packet->payload, out);
 		break;
 	case SR_DF_TRIGGER:
 		ctx->trigger = TRUE;
@@ -581,11 +694,28 @@ static int receive(const struct sr_output *o,
 	case SR_DF_LOGIC:
 		process_logic(ctx, packet->payload);
 		break;
+	case SR_DF_LOGIC_RLE:
+		if (ctx->logic_channel_count == ctx->channel_count) {
+			process_logic_rle(ctx, packet->payload, out);
+			break;
+		}
+		/* Mixed signal data gets collected per frame anyway. */
+		if (sr_logic_rle_densify(packet->payload, &logic) != SR_OK)
+			return SR_ERR_MALLOC;
+		process_logic(ctx, &logic);
+		g_free(logic.data);
+		break;
+	case SR_DF_LOGIC_PLANAR:
+		process_logic_planar(ctx, packet->payload);
+		break;
 	case SR_DF_ANALOG:
 		process_analog(ctx, packet->payload);
 		break;
 	case SR_DF_FRAME_BEGIN:
-		*out = g_string_new(ctx->frame);
+		/* Data of the previous frame goes before the separator. */
+		if (ctx->channels_seen)
+			dump_saved_values(ctx, out);
+		g_string_append(out, ctx->frame);
 		/* Fallthrough */
 	case SR_DF_END:
 		/* Got to end of frame/session with part of the data. */
@@ -671,9 +801,9 @@ SR_PRIV struct sr_output_module output_csv = {
 	.name = "CSV",
 	.desc = "Comma-separated values",
 	.exts = (const char *[]){"csv", NULL},
-	.flags = 0,
+	.flags = SR_OUTPUT_LOGIC_RLE | SR_OUTPUT_LOGIC_PLANAR,
 	.options = get_options,
 	.init = init,
-	.receive = receive,
+	.append = append,
 	.cleanup = cleanup,
 };
@@ -18,7 +18,13 @@
  */
 
 #include <config.h>
+#include <errno.h>
+#include <limits.h>
 #include <string.h>
+#include <unistd.h>
+#ifndef _WIN32
+#include <sys/uio.h>
+#endif
 #include <libsigrok/libsigrok.h>
 #include "libsigrok-internal.h"
 
@@ -26,6 +32,22 @@
 #define LOG_PREFIX "output"
 /** @endcond */
 
+/* Output collected by a sink before it gets written out. */
+#define SINK_BUFFER_SIZE (256 * 1024)
+
+/* Chunks per sink write: the collected output, plus one more. */
+#define SINK_MAX_CHUNKS 2
+
+struct sr_output_sink {
+	/* Exactly one of these is set. */
+	int fd;
+	FILE *file;
+	sr_output_sink_callback cb;
+	void *cb_data;
+	/* Output collected since the last write, reused. */
+	GString *buf;
+};
+
 /**
  * @file
  *
@@ -48,6 +70,9 @@
  *
  * Output modules generate a newly allocated GString. The caller is then
  * expected to free this with g_string_free() when finished with it.
+ * Alternatively, the caller sets a sink (a file descriptor, stdio stream,
+ * or callback) and uses sr_output_write(), which collects the output in
+ * a reused buffer and writes it out in large batches.
  *
  * @{
  */
@@ -275,6 +300,7 @@ SR_API const struct sr_output *sr_output_new(const struct sr_output_module *omod
 	op->module = omod;
 	op->sdi = sdi;
 	op->filename = g_strdup(filename);
+	op->sink = NULL;
 
 	new_opts = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
 			(GDestroyNotify)g_variant_unref);
@@ -325,18 +351,435 @@ SR_API const struct sr_output *sr_output_new(const struct sr_output_module *omod
 	return op;
 }
 
+/* Where output goes: a string returned to the caller, or the sink. */
+struct output_target {
+	const struct sr_output *o;
+	gboolean to_sink;
+	GString *out;
+};
+
+static int sink_write_fd(int fd, const struct sr_output_chunk *chunks,
+		unsigned int count)
+{
+#ifndef _WIN32
+	struct iovec iov[SINK_MAX_CHUNKS];
+	unsigned int i, first;
+	ssize_t ret;
+	size_t done;
+
+	for (i = 0; i < count; i++) {
+		iov[i].iov_base = (void *)chunks[i].data;
+		iov[i].iov_len = chunks[i].len;
+	}
+
+	first = 0;
+	while (first < count) {
+		ret = writev(fd, iov + first, count - first);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			sr_err("Output write failed: %s", g_strerror(errno));
+			return SR_ERR_IO;
+		}
+		/* Skip what was written, and resume within a partial chunk. */
+		done = ret;
+		while (first < count && done >= iov[first].iov_len) {
+			done -= iov[first].iov_len;
+			first++;
+		}
+		if (first < count) {
+			iov[first].iov_base = (uint8_t *)iov[first].iov_base + done;
+			iov[first].iov_len -= done;
+		}
+	}
+#else
+	const uint8_t *p;
+	unsigned int i;
+	size_t left;
+	int ret;
+
+	for (i = 0; i < count; i++) {
+		p = chunks[i].data;
+		left = chunks[i].len;
+		while (left) {
+			ret = write(fd, p, MIN(left, INT_MAX));
+			if (ret < 0) {
+				if (errno == EINTR)
+					continue;
+				sr_err("Output write failed: %s",
+					g_strerror(errno));
+				return SR_ERR_IO;
+			}
+			p += ret;
+			left -= ret;
+		}
+	}
+#endif
+
+	return SR_OK;
+}
+
+/*
+ * Write the collected output, followed by up to SINK_MAX_CHUNKS - 1
+ * more chunks, in one go. The collected output is gone afterwards.
+ */
+static int sink_write(struct sr_output_sink *sink,
+		const struct sr_output_chunk *extra, unsigned int num_extra)
+{
+	struct sr_output_chunk chunks[SINK_MAX_CHUNKS];
+	unsigned int i, count;
+	int ret;
+
+	count = 0;
+	if (sink->buf->len) {
+		chunks[count].data = sink->buf->str;
+		chunks[count++].len = sink->buf->len;
+	}
+	for (i = 0; i < num_extra; i++)
+		chunks[count++] = extra[i];
+	if (!count)
+		return SR_OK;
+
+	ret = SR_OK;
+	if (sink->cb) {
+		ret = sink->cb(chunks, count, sink->cb_data);
+	} else if (sink->file) {
+		for (i = 0; i < count && ret == SR_OK; i++) {
+			if (fwrite(chunks[i].data, 1, chunks[i].len,
+					sink->file) != chunks[i].len) {
+				sr_err("Output write failed.");
+				ret = SR_ERR_IO;
+			}
+		}
+	} else {
+		ret = sink_write_fd(sink->fd, chunks, count);
+	}
+	g_string_truncate(sink->buf, 0);
+
+	return ret;
+}
+
+/* Add output to the sink, which writes it out when the buffer is full. */
+static int sink_add(struct sr_output_sink *sink, const char *data, size_t len)
+{
+	struct sr_output_chunk chunk;
+
+	if (sink->buf->len + len <= SINK_BUFFER_SIZE) {
+		g_string_append_len(sink->buf, data, len);
+		return SR_OK;
+	}
+
+	/* Large pieces go out right away, along with the buffer. */
+	chunk.data = data;
+	chunk.len = len;
+
+	return sink_write(sink, &chunk, 1);
+}
+
+/* Pass a packet the module takes as it is to the module. */
+static int target_receive(struct output_target *t,
+		const struct sr_datafeed_packet *packet)
+{
+	const struct sr_output *o;
+	struct sr_output_sink *sink;
+	GString *out;
+	int ret, ret_sink;
+
+	o = t->o;
+	sink = t->to_sink ? o->sink : NULL;
+
+	if (o->module->append && sink) {
+		ret = o->module->append(o, packet, sink->buf);
+		if (sink->buf->len >= SINK_BUFFER_SIZE &&
+				(ret_sink = sink_write(sink, NULL, 0)) != SR_OK)
+			return ret_sink;
+		return ret;
+	}
+	if (o->module->append) {
+		if (!t->out)
+			t->out = g_string_sized_new(512);
+		return o->module->append(o, packet, t->out);
+	}
+
+	out = NULL;
+	ret = o->module->receive(o, packet, &out);
+	if (!out)
+		return ret;
+
+	if (sink) {
+		ret_sink = sink_add(sink, out->str, out->len);
+		g_string_free(out, TRUE);
+		return ret != SR_OK ? ret : ret_sink;
+	}
+	if (!t->out) {
+		t->out = out;
+	} else {
+		g_string_append_len(t->out, out->str, out->len);
+		g_string_free(out, TRUE);
+	}
+
+	return ret;
+}
+
+static int dense_receive(const struct sr_datafeed_logic *logic, void *cb_data)
+{
+	struct sr_datafeed_packet packet;
+
+	packet.type = SR_DF_LOGIC;
+	packet.payload = logic;
+
+	return target_receive(cb_data, &packet);
+}
+
+/*
+ * SR_DF_LOGIC_RLE and SR_DF_LOGIC_PLANAR packets are converted into
+ * SR_DF_LOGIC packets for output modules which don't have the
+ * SR_OUTPUT_LOGIC_RLE or SR_OUTPUT_LOGIC_PLANAR flag, respectively.
+ */
+static int target_send(struct output_target *t,
+		const struct sr_datafeed_packet *packet)
+{
+	const struct sr_output_module *omod;
+
+	omod = t->o->module;
+	if (packet->type == SR_DF_LOGIC_RLE &&
+			!sr_output_test_flag(omod, SR_OUTPUT_LOGIC_RLE))
+		return sr_logic_rle_foreach_chunk(packet->payload,
+			dense_receive, t);
+	if (packet->type == SR_DF_LOGIC_PLANAR &&
+			!sr_output_test_flag(omod, SR_OUTPUT_LOGIC_PLANAR))
+		return sr_logic_planar_foreach_chunk(packet->payload,
+			dense_receive, t);
+
+	return target_receive(t, packet);
+}
+
 /**
  * Send a packet to the specified output instance.
  *
  * The instance's output is returned as a newly allocated GString,
- * which must be freed by the caller.
+ * which must be freed by the caller, or NULL if there is none.
+ *
+ * SR_DF_LOGIC_RLE and SR_DF_LOGIC_PLANAR packets are converted into
+ * SR_DF_LOGIC packets for output modules which don't have the
+ * SR_OUTPUT_LOGIC_RLE or SR_OUTPUT_LOGIC_PLANAR flag, respectively.
+ *
+ * @see sr_output_write() for writing the output straight to a sink.
  *
  * @since 0.4.0
  */
 SR_API int sr_output_send(const struct sr_output *o,
 		const struct sr_datafeed_packet *packet, GString **out)
 {
-	return o->module->receive(o, packet, out);
+	struct output_target t;
+	int ret;
+
+	t.o = o;
+	t.to_sink = FALSE;
+	t.out = NULL;
+	ret = target_send(&t, packet);
+	/* Append modules get a buffer, which may have stayed empty. */
+	if (o->module->append && t.out && (ret != SR_OK || !t.out->len)) {
+		g_string_free(t.out, TRUE);
+		t.out = NULL;
+	}
+	*out = t.out;
+
+	return ret;
+}
+
+/* Get the sink of an output instance, with nothing left to write. */
+static int sink_prepare(const struct sr_output *o,
+		struct sr_output_sink **sink)
+{
+	struct sr_output *op;
+	int ret;
+
+	op = (struct sr_output *)o;
+	if (op->sink) {
+		if ((ret = sink_write(op->sink, NULL, 0)) != SR_OK)
+			return ret;
+		if (op->sink->file)
+			fflush(op->sink->file);
+	} else {
+		op->sink = g_malloc0(sizeof(struct sr_output_sink));
+		op->sink->buf = g_string_sized_new(SINK_BUFFER_SIZE);
+	}
+	op->sink->fd = -1;
+	op->sink->file = NULL;
+	op->sink->cb = NULL;
+	op->sink->cb_data = NULL;
+	*sink = op->sink;
+
+	return SR_OK;
+}
+
+/**
+ * Have the output of an output instance written to a file descriptor.
+ *
+ * Output which was collected for a previous sink is written to that
+ * one first. The descriptor remains owned by the caller.
+ *
+ * @param o The output instance. Must not be NULL.
+ * @param fd The file descriptor.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ * @retval SR_ERR_IO Writing to the previous sink failed.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_output_sink_fd_set(const struct sr_output *o, int fd)
+{
+	struct sr_output_sink *sink;
+	int ret;
+
+	if (!o || fd < 0)
+		return SR_ERR_ARG;
+
+	if ((ret = sink_prepare(o, &sink)) != SR_OK)
+		return ret;
+	sink->fd = fd;
+
+	return SR_OK;
+}
+
+/**
+ * Have the output of an output instance written to a stdio stream.
+ *
+ * Output which was collected for a previous sink is written to that
+ * one first. The stream remains owned by the caller.
+ *
+ * @param o The output instance. Must not be NULL.
+ * @param file The stream. Must not be NULL.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ * @retval SR_ERR_IO Writing to the previous sink failed.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_output_sink_file_set(const struct sr_output *o, FILE *file)
+{
+	struct sr_output_sink *sink;
+	int ret;
+
+	if (!o || !file)
+		return SR_ERR_ARG;
+
+	if ((ret = sink_prepare(o, &sink)) != SR_OK)
+		return ret;
+	sink->file = file;
+
+	return SR_OK;
+}
+
+/**
+ * Have the output of an output instance passed to a callback.
+ *
+ * The callback gets the output in batches of chunks, which are only
+ * valid during the call. Output which was collected for a previous sink
+ * is written to that one first.
+ *
+ * @param o The output instance. Must not be NULL.
+ * @param cb The function to call with output. Must not be NULL. It
+ *           returns SR_OK, or an error code which sr_output_write()
+ *           passes on.
+ * @param cb_data Opaque pointer passed to @a cb.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ * @retval SR_ERR_IO Writing to the previous sink failed.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_output_sink_callback_set(const struct sr_output *o,
+		sr_output_sink_callback cb, void *cb_data)
+{
+	struct sr_output_sink *sink;
+	int ret;
+
+	if (!o || !cb)
+		return SR_ERR_ARG;
+
+	if ((ret = sink_prepare(o, &sink)) != SR_OK)
+		return ret;
+	sink->cb = cb;
+	sink->cb_data = cb_data;
+
+	return SR_OK;
+}
+
+/**
+ * Send a packet to an output instance, and write the output to its sink.
+ *
+ * Output modules add their output to a buffer which the instance reuses,
+ * and which gets written out when it's full, on sr_output_flush(), after
+ * SR_DF_END packets, and when the instance is freed. Unlike with
+ * sr_output_send(), no string gets allocated per packet.
+ *
+ * @param o The output instance. Must not be NULL, and must have a sink
+ *          set with sr_output_sink_fd_set(), sr_output_sink_file_set(),
+ *          or sr_output_sink_callback_set().
+ * @param packet The packet. Must not be NULL.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument, or no sink set.
+ * @retval SR_ERR_IO Writing to the sink failed.
+ * @retval other Error processing the packet.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_output_write(const struct sr_output *o,
+		const struct sr_datafeed_packet *packet)
+{
+	struct output_target t;
+	int ret;
+
+	if (!o || !packet)
+		return SR_ERR_ARG;
+	if (!o->sink) {
+		sr_err("Output instance has no sink.");
+		return SR_ERR_ARG;
+	}
+
+	t.o = o;
+	t.to_sink = TRUE;
+	t.out = NULL;
+	ret = target_send(&t, packet);
+	if (ret == SR_OK && packet->type == SR_DF_END)
+		ret = sr_output_flush(o);
+
+	return ret;
+}
+
+/**
+ * Write the output an output instance collected to its sink.
+ *
+ * @param o The output instance. Must not be NULL.
+ *
+ * @retval SR_OK Success, or no sink set.
+ * @retval SR_ERR_ARG Invalid argument.
+ * @retval SR_ERR_IO Writing to the sink failed.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_output_flush(const struct sr_output *o)
+{
+	int ret;
+
+	if (!o)
+		return SR_ERR_ARG;
+	if (!o->sink)
+		return SR_OK;
+
+	ret = sink_write(o->sink, NULL, 0);
+	if (o->sink->file && fflush(o->sink->file) != 0 && ret == SR_OK) {
+		sr_err("Output write failed: %s", g_strerror(errno));
+		ret = SR_ERR_IO;
+	}
+
+	return ret;
 }
 
 /**
@@ -346,18 +789,24 @@ SR_API int sr_output_send(const struct sr_output *o,
  */
 SR_API int sr_output_free(const struct sr_output *o)
 {
-	int ret;
+	int ret, ret_flush;
 
 	if (!o)
 		return SR_ERR_ARG;
 
+	ret_flush = sr_output_flush(o);
+	if (o->sink) {
+		g_string_free(o->sink->buf, TRUE);
+		g_free(o->sink);
+	}
+
 	ret = SR_OK;
 	if (o->module->cleanup)
 		ret = o->module->cleanup((struct sr_output *)o);
 	g_free((char *)o->filename);
 	g_free((gpointer)o);
 
-	return ret;
+	return ret != SR_OK ? ret : ret_flush;
 }
 
 /** @} */
@@ -18,31 +18,94 @@
  */
 
 #include <config.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 #include <errno.h>
 #include <glib.h>
 #include <glib/gstdio.h>
-#include <zip.h>
+#include <zlib.h>
 #include <libsigrok/libsigrok.h>
 #include "libsigrok-internal.h"
 
 #define LOG_PREFIX "output/srzip"
 
+/* Default size of the logic-1-N / analog-1-M-N archive members. */
+#define DEFAULT_CHUNK_SIZE (4 * 1024 * 1024)
+
+/* ZIP record signatures and sizes, see PKWARE's APPNOTE.TXT. */
+#define ZIP_LOCAL_SIG		0x04034b50
+#define ZIP_CENTRAL_SIG		0x02014b50
+#define ZIP_END_SIG		0x06054b50
+#define ZIP64_END_SIG		0x06064b50
+#define ZIP64_LOCATOR_SIG	0x07064b50
+#define ZIP_LOCAL_LEN		30
+#define ZIP_CENTRAL_LEN		46
+#define ZIP_END_LEN		22
+#define ZIP64_END_LEN		56
+#define ZIP64_LOCATOR_LEN	20
+#define ZIP64_EXTRA_LEN		12
+
+/* A member which was written to the archive, for the central directory. */
+struct zip_entry {
+	char *name;
+	uint16_t method;
+	uint32_t crc;
+	uint32_t comp_size;
+	uint32_t size;
+	uint64_t offset;
+};
+
+/*
+ * Sample data of one archive member family ("logic-1", "analog-1-M").
+ * Data is accumulated in memory until a chunk is complete, the chunk
+ * is then compressed and written to the archive as a member of its own.
+ */
+struct chunk_stream {
+	char *basename;
+	unsigned int chunk_num;
+	uint8_t *buf;
+	size_t size;
+	size_t len;
+	size_t itemsize;
+	/* Number of samples in each chunk written so far. */
+	GArray *index;
+};
+
 struct out_context {
 	gboolean zip_created;
 	uint64_t samplerate;
 	char *filename;
 	gint first_analog_index;
 	gint *analog_index_map;
+	uint64_t chunk_size;
+	int unitsize;
+	/* The archive, which is open until the end of the acquisition. */
+	FILE *archive;
+	uint64_t archive_size;
+	GArray *entries;
+	uint16_t dos_time;
+	uint16_t dos_date;
+	z_stream zs;
+	gboolean zs_ready;
+	uint8_t *zbuf;
+	size_t zbuf_size;
+	/* Set after a failed write, no further members get added. */
+	gboolean failed;
+	/* The partial member couldn't be removed after a failed write. */
+	gboolean corrupt;
+	GKeyFile *meta;
+	struct chunk_stream logic;
+	struct chunk_stream *analog;
+	float *fbuf;
+	size_t fbuf_size;
 };
 
 static int init(struct sr_output *o, GHashTable *options)
 {
 	struct out_context *outc;
 
-	(void)options;
-
 	if (!o->filename || o->filename[0] == '\0') {
 		sr_info("srzip output module requires a file name, cannot save.");
 		return SR_ERR_ARG;
@@ -50,23 +113,238 @@ static int init(struct sr_output *o, GHashTable *options)
 
 	outc = g_malloc0(sizeof(struct out_context));
 	outc->filename = g_strdup(o->filename);
+	outc->chunk_size = g_variant_get_uint32(g_hash_table_lookup(options, "chunksize"));
+	if (outc->chunk_size < sizeof(float))
+		outc->chunk_size = DEFAULT_CHUNK_SIZE;
 	o->priv = outc;
 
 	return SR_OK;
 }
 
+/* Write to the archive, or undo a partially written member on failure. */
+static int archive_write(struct out_context *outc, const void *data,
+		size_t len, uint64_t entry_offset)
+{
+	if (fwrite(data, 1, len, outc->archive) == len) {
+		outc->archive_size += len;
+		return SR_OK;
+	}
+
+	sr_err("Failed to write '%s': %s", outc->filename, g_strerror(errno));
+	outc->failed = TRUE;
+	if (fflush(outc->archive) == 0 && fseeko(outc->archive,
+			entry_offset, SEEK_SET) == 0 &&
+			ftruncate(fileno(outc->archive), entry_offset) == 0)
+		outc->archive_size = entry_offset;
+	else
+		outc->corrupt = TRUE;
+
+	return SR_ERR_IO;
+}
+
+/*
+ * Compress data with raw deflate (as libzip would) into outc->zbuf.
+ * Returns the compressed size, or 0 if storing the data is better.
+ */
+static size_t zip_deflate(struct out_context *outc, const uint8_t *data,
+		size_t len)
+{
+	size_t bound;
+
+	if (!outc->zs_ready) {
+		memset(&outc->zs, 0, sizeof(outc->zs));
+		if (deflateInit2(&outc->zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+				-MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+			return 0;
+		outc->zs_ready = TRUE;
+	} else if (deflateReset(&outc->zs) != Z_OK) {
+		return 0;
+	}
+
+	bound = deflateBound(&outc->zs, len);
+	if (bound > outc->zbuf_size) {
+		g_free(outc->zbuf);
+		outc->zbuf_size = 0;
+		if (!(outc->zbuf = g_try_malloc(bound)))
+			return 0;
+		outc->zbuf_size = bound;
+	}
+
+	outc->zs.next_in = (Bytef *)data;
+	outc->zs.avail_in = len;
+	outc->zs.next_out = outc->zbuf;
+	outc->zs.avail_out = outc->zbuf_size;
+	if (deflate(&outc->zs, Z_FINISH) != Z_STREAM_END ||
+			outc->zs.total_out >= len)
+		return 0;
+
+	return outc->zs.total_out;
+}
+
+/*
+ * Write a complete member to the archive: The local header, followed by
+ * the (compressed) data. The entry for the central directory is only
+ * recorded once the member was written successfully.
+ */
+static int zip_add_member(struct out_context *outc, const char *name,
+		const uint8_t *data, size_t len, gboolean compress)
+{
+	struct zip_entry entry;
+	uint8_t hdr[ZIP_LOCAL_LEN];
+	const uint8_t *payload;
+	size_t comp_size;
+	int ret;
+
+	if (outc->failed)
+		return SR_ERR_IO;
+
+	entry.offset = outc->archive_size;
+	entry.crc = crc32(0, data, len);
+	entry.size = len;
+	comp_size = compress ? zip_deflate(outc, data, len) : 0;
+	if (comp_size) {
+		entry.method = Z_DEFLATED;
+		entry.comp_size = comp_size;
+		payload = outc->zbuf;
+	} else {
+		entry.method = 0;
+		entry.comp_size = len;
+		payload = data;
+	}
+
+	WL32(&hdr[0], ZIP_LOCAL_SIG);
+	WL16(&hdr[4], 20);
+	WL16(&hdr[6], 0);
+	WL16(&hdr[8], entry.method);
+	WL16(&hdr[10], outc->dos_time);
+	WL16(&hdr[12], outc->dos_date);
+	WL32(&hdr[14], entry.crc);
+	WL32(&hdr[18], entry.comp_size);
+	WL32(&hdr[22], entry.size);
+	WL16(&hdr[26], strlen(name));
+	WL16(&hdr[28], 0);
+
+	if ((ret = archive_write(outc, hdr, sizeof(hdr), entry.offset)) != SR_OK)
+		return ret;
+	if ((ret = archive_write(outc, name, strlen(name), entry.offset)) != SR_OK)
+		return ret;
+	if ((ret = archive_write(outc, payload, entry.comp_size,
+			entry.offset)) != SR_OK)
+		return ret;
+
+	entry.name = g_strdup(name);
+	g_array_append_val(outc->entries, entry);
+
+	return SR_OK;
+}
+
+/*
+ * Write the central directory, which makes the archive complete. Zip64
+ * records are only added when offsets or the number of members don't
+ * fit the classic end of central directory record.
+ */
+static int zip_write_directory(struct out_context *outc)
+{
+	struct zip_entry *entry;
+	uint8_t hdr[ZIP_CENTRAL_LEN + ZIP64_EXTRA_LEN];
+	uint8_t end[ZIP64_END_LEN + ZIP64_LOCATOR_LEN + ZIP_END_LEN];
+	uint64_t dir_offset, dir_size;
+	gboolean zip64, large;
+	size_t hdr_len, end_len;
+	guint i;
+	int ret;
+
+	dir_offset = outc->archive_size;
+	zip64 = FALSE;
+	for (i = 0; i < outc->entries->len; i++) {
+		entry = &g_array_index(outc->entries, struct zip_entry, i);
+		large = entry->offset >= 0xffffffff;
+		zip64 |= large;
+		hdr_len = ZIP_CENTRAL_LEN + (large ? ZIP64_EXTRA_LEN : 0);
+
+		WL32(&hdr[0], ZIP_CENTRAL_SIG);
+		/* Made by UNIX, version 4.5. */
+		WL16(&hdr[4], (3 << 8) | 45);
+		WL16(&hdr[6], large ? 45 : 20);
+		WL16(&hdr[8], 0);
+		WL16(&hdr[10], entry->method);
+		WL16(&hdr[12], outc->dos_time);
+		WL16(&hdr[14], outc->dos_date);
+		WL32(&hdr[16], entry->crc);
+		WL32(&hdr[20], entry->comp_size);
+		WL32(&hdr[24], entry->size);
+		WL16(&hdr[28], strlen(entry->name));
+		WL16(&hdr[30], hdr_len - ZIP_CENTRAL_LEN);
+		WL16(&hdr[32], 0);
+		WL16(&hdr[34], 0);
+		WL16(&hdr[36], 0);
+		/* Regular file, mode 0644. */
+		WL32(&hdr[38], 0100644 << 16);
+		WL32(&hdr[42], large ? 0xffffffff : entry->offset);
+		if (large) {
+			WL16(&hdr[46], 0x0001);
+			WL16(&hdr[48], 8);
+			WL32(&hdr[50], entry->offset);
+			WL32(&hdr[54], entry->offset >> 32);
+		}
+		ret = archive_write(outc, hdr, hdr_len, dir_offset);
+		if (ret == SR_OK)
+			ret = archive_write(outc, entry->name,
+				strlen(entry->name), dir_offset);
+		if (ret != SR_OK)
+			return ret;
+	}
+	dir_size = outc->archive_size - dir_offset;
+	zip64 |= outc->entries->len >= 0xffff || dir_offset >= 0xffffffff;
+
+	end_len = 0;
+	if (zip64) {
+		WL32(&end[0], ZIP64_END_SIG);
+		WL32(&end[4], ZIP64_END_LEN - 12);
+		WL32(&end[8], 0);
+		WL16(&end[12], (3 << 8) | 45);
+		WL16(&end[14], 45);
+		WL32(&end[16], 0);
+		WL32(&end[20], 0);
+		WL32(&end[24], outc->entries->len);
+		WL32(&end[28], 0);
+		WL32(&end[32], outc->entries->len);
+		WL32(&end[36], 0);
+		WL32(&end[40], dir_size);
+		WL32(&end[44], dir_size >> 32);
+		WL32(&end[48], dir_offset);
+		WL32(&end[52], dir_offset >> 32);
+		WL32(&end[56], ZIP64_LOCATOR_SIG);
+		WL32(&end[60], 0);
+		WL32(&end[64], outc->archive_size);
+		WL32(&end[68], outc->archive_size >> 32);
+		WL32(&end[72], 1);
+		end_len = ZIP64_END_LEN + ZIP64_LOCATOR_LEN;
+	}
+	WL32(&end[end_len], ZIP_END_SIG);
+	WL16(&end[end_len + 4], 0);
+	WL16(&end[end_len + 6], 0);
+	WL16(&end[end_len + 8], zip64 ? 0xffff : outc->entries->len);
+	WL16(&end[end_len + 10], zip64 ? 0xffff : outc->entries->len);
+	WL32(&end[end_len + 12], zip64 ? 0xffffffff : dir_size);
+	WL32(&end[end_len + 16], zip64 ? 0xffffffff : dir_offset);
+	WL16(&end[end_len + 20], 0);
+	end_len += ZIP_END_LEN;
+
+	return archive_write(outc, end, end_len, dir_offset);
+}
+
 static int zip_create(const struct sr_output *o)
 {
 	struct out_context *outc;
-	struct zip *zipfile;
-	struct zip_source *versrc, *metasrc;
 	struct sr_channel *ch;
 	GVariant *gvar;
+	GDateTime *now;
 	GKeyFile *meta;
 	GSList *l;
 	const char *devgroup;
-	char *s, *metabuf;
-	gsize metalen;
+	char *s;
+	int ret;
 	guint logic_channels = 0, enabled_logic_channels = 0;
 	guint enabled_analog_channels = 0;
 	guint index;
@@ -79,20 +357,36 @@ static int zip_create(const struct sr_output *o)
 		g_variant_unref(gvar);
 	}
 
-	/* Quietly delete it first, libzip wants replace ops otherwise. */
-	g_unlink(outc->filename);
-	zipfile = zip_open(outc->filename, ZIP_CREATE, NULL);
-	if (!zipfile)
+	/*
+	 * Members get written to the archive as soon as they are complete,
+	 * the central directory follows at the end of the acquisition.
+	 */
+	if (!(outc->archive = g_fopen(outc->filename, "wb"))) {
+		sr_err("Cannot create '%s': %s", outc->filename,
+			g_strerror(errno));
 		return SR_ERR;
+	}
+	outc->archive_size = 0;
+	outc->entries = g_array_new(FALSE, FALSE, sizeof(struct zip_entry));
+	now = g_date_time_new_now_local();
+	outc->dos_time = g_date_time_get_hour(now) << 11 |
+		g_date_time_get_minute(now) << 5 |
+		g_date_time_get_second(now) / 2;
+	outc->dos_date = (g_date_time_get_year(now) - 1980) << 9 |
+		g_date_time_get_month(now) << 5 |
+		g_date_time_get_day_of_month(now);
+	g_date_time_unref(now);
 
 	/* "version" */
-	versrc = zip_source_buffer(zipfile, "2", 1, FALSE);
-	if (zip_add(zipfile, "version", versrc) < 0) {
-		sr_err("Error saving version into zipfile: %s",
-			zip_strerror(zipfile));
-		zip_source_free(versrc);
-		zip_discard(zipfile);
-		return SR_ERR;
+	if ((ret = zip_add_member(outc, "version",
+			(const uint8_t *)"2", 1, FALSE)) != SR_OK) {
+		sr_err("Error saving version into zipfile.");
+		fclose(outc->archive);
+		outc->archive = NULL;
+		g_unlink(outc->filename);
+		g_array_free(outc->entries, TRUE);
+		outc->entries = NULL;
+		return ret;
 	}
 
 	/* init "metadata" */
@@ -143,6 +437,7 @@ static int zip_create(const struct sr_output *o)
 	 * entry as terminator, which is set to -1. */
 	outc->analog_index_map = g_malloc0(sizeof(gint) * (enabled_analog_channels + 1));
 	outc->analog_index_map[enabled_analog_channels] = -1;
+	outc->analog = g_malloc0(sizeof(struct chunk_stream) * enabled_analog_channels);
 
 	index = 0;
 	for (l = o->sdi->channels; l; l = l->next) {
@@ -157,6 +452,8 @@ static int zip_create(const struct sr_output *o)
 			break;
 		case SR_CHANNEL_ANALOG:
 			outc->analog_index_map[index] = ch->index;
+			outc->analog[index].basename = g_strdup_printf("analog-1-%u",
+					outc->first_analog_index + index);
 			s = g_strdup_printf("analog%d", outc->first_analog_index + index);
 			index++;
 			break;
@@ -166,147 +463,156 @@ static int zip_create(const struct sr_output *o)
 			g_free(s);
 		}
 	}
+	outc->logic.basename = g_strdup("logic-1");
 
-	metabuf = g_key_file_to_data(meta, &metalen, NULL);
-	g_key_file_free(meta);
-
-	metasrc = zip_source_buffer(zipfile, metabuf, metalen, FALSE);
-	if (zip_add(zipfile, "metadata", metasrc) < 0) {
-		sr_err("Error saving metadata into zipfile: %s",
-			zip_strerror(zipfile));
-		zip_source_free(metasrc);
-		zip_discard(zipfile);
-		g_free(metabuf);
-		return SR_ERR;
-	}
-
-	if (zip_close(zipfile) < 0) {
-		sr_err("Error saving zipfile: %s", zip_strerror(zipfile));
-		zip_discard(zipfile);
-		g_free(metabuf);
-		return SR_ERR;
-	}
-	g_free(metabuf);
+	/*
+	 * The metadata needs the unitsize and the chunk index, it gets
+	 * written at the end of the acquisition.
+	 */
+	outc->meta = meta;
 
 	return SR_OK;
 }
 
-static int zip_append(const struct sr_output *o, unsigned char *buf,
-		int unitsize, int length)
+/* Compress a complete chunk, and write it to the archive. */
+static int zip_flush_chunk(struct out_context *outc, struct chunk_stream *cs)
 {
-	struct out_context *outc;
-	struct zip *archive;
-	struct zip_source *logicsrc;
-	int64_t i, num_files;
-	struct zip_stat zs;
-	struct zip_source *metasrc;
-	GKeyFile *kf;
-	GError *error;
-	uint64_t chunk_num;
-	const char *entry_name;
-	char *metabuf;
-	gsize metalen;
 	char *chunkname;
-	unsigned int next_chunk_num;
+	uint64_t num_samples;
+	int ret;
 
-	outc = o->priv;
-	if (!(archive = zip_open(outc->filename, 0, NULL)))
-		return SR_ERR;
+	if (cs->len == 0)
+		return SR_OK;
+
+	chunkname = g_strdup_printf("%s-%u", cs->basename, cs->chunk_num + 1);
+	ret = zip_add_member(outc, chunkname, cs->buf, cs->len, TRUE);
+	if (ret == SR_OK) {
+		cs->chunk_num++;
+		num_samples = cs->len / cs->itemsize;
+		g_array_append_val(cs->index, num_samples);
+	} else {
+		sr_err("Failed to add chunk '%s'.", chunkname);
+	}
+	g_free(chunkname);
+	cs->len = 0;
 
-	if (zip_stat(archive, "metadata", 0, &zs) < 0) {
-		sr_err("Failed to open metadata: %s", zip_strerror(archive));
-		zip_discard(archive);
+	return ret;
+}
+
+/*
+ * Get a chunk stream ready for appending. The chunk size is rounded down
+ * to a multiple of the item size, so that chunks never split a sample.
+ */
+static int chunk_prepare(struct out_context *outc, struct chunk_stream *cs,
+		size_t itemsize)
+{
+	if (!outc->archive) {
+		sr_err("Session file was already written, cannot append.");
 		return SR_ERR;
 	}
-	kf = sr_sessionfile_read_metadata(archive, &zs);
-	if (!kf) {
-		zip_discard(archive);
-		return SR_ERR_DATA;
-	}
-	/*
-	 * If the file was only initialized but doesn't yet have any
-	 * data it in, it won't have a unitsize field in metadata yet.
-	 */
-	error = NULL;
-	metabuf = NULL;
-	if (!g_key_file_has_key(kf, "device 1", "unitsize", &error)) {
-		if (error && error->code != G_KEY_FILE_ERROR_KEY_NOT_FOUND) {
-			sr_err("Failed to check unitsize key: %s", error->message);
-			g_error_free(error);
-			g_key_file_free(kf);
-			zip_discard(archive);
-			return SR_ERR;
-		}
-		g_clear_error(&error);
-
-		/* Add unitsize field. */
-		g_key_file_set_integer(kf, "device 1", "unitsize", unitsize);
-		metabuf = g_key_file_to_data(kf, &metalen, NULL);
-		metasrc = zip_source_buffer(archive, metabuf, metalen, FALSE);
-
-		if (zip_replace(archive, zs.index, metasrc) < 0) {
-			sr_err("Failed to replace metadata: %s",
-				zip_strerror(archive));
-			g_key_file_free(kf);
-			zip_source_free(metasrc);
-			zip_discard(archive);
-			g_free(metabuf);
-			return SR_ERR;
+
+	if (!cs->buf) {
+		cs->size = outc->chunk_size / itemsize * itemsize;
+		if (cs->size == 0)
+			cs->size = itemsize;
+		if (!(cs->buf = g_try_malloc(cs->size))) {
+			sr_err("Chunk buffer allocation failed.");
+			return SR_ERR_MALLOC;
 		}
+		cs->len = 0;
+		cs->itemsize = itemsize;
+		cs->index = g_array_new(FALSE, FALSE, sizeof(uint64_t));
 	}
-	g_key_file_free(kf);
 
-	next_chunk_num = 1;
-	num_files = zip_get_num_entries(archive, 0);
-	for (i = 0; i < num_files; i++) {
-		entry_name = zip_get_name(archive, i, 0);
-		if (!entry_name || strncmp(entry_name, "logic-1", 7) != 0)
-			continue;
-		if (entry_name[7] == '\0') {
-			/*
-			 * This file has no extra chunks, just a single
-			 * "logic-1". Rename it to "logic-1-1" and continue
-			 * with chunk 2.
-			 */
-			if (zip_rename(archive, i, "logic-1-1") < 0) {
-				sr_err("Failed to rename 'logic-1' to 'logic-1-1': %s",
-					zip_strerror(archive));
-				zip_discard(archive);
-				g_free(metabuf);
-				return SR_ERR;
-			}
-			next_chunk_num = 2;
-			break;
-		} else if (entry_name[7] == '-') {
-			chunk_num = g_ascii_strtoull(entry_name + 8, NULL, 10);
-			if (chunk_num < G_MAXINT && chunk_num >= next_chunk_num)
-				next_chunk_num = chunk_num + 1;
+	return SR_OK;
+}
+
+/* Append sample data to a chunk stream. */
+static int zip_append(struct out_context *outc, struct chunk_stream *cs,
+		const uint8_t *data, size_t length, size_t itemsize)
+{
+	size_t copy;
+	int ret;
+
+	if ((ret = chunk_prepare(outc, cs, itemsize)) != SR_OK)
+		return ret;
+
+	while (length > 0) {
+		copy = MIN(length, cs->size - cs->len);
+		memcpy(cs->buf + cs->len, data, copy);
+		cs->len += copy;
+		data += copy;
+		length -= copy;
+		if (cs->len == cs->size) {
+			if ((ret = zip_flush_chunk(outc, cs)) != SR_OK)
+				return ret;
 		}
 	}
 
-	if (length % unitsize != 0) {
-		sr_warn("Chunk size %d not a multiple of the"
-			" unit size %d.", length, unitsize);
+	return SR_OK;
+}
+
+static int check_unitsize(struct out_context *outc, uint16_t unitsize)
+{
+	if (unitsize == 0)
+		return SR_ERR_ARG;
+	if (outc->unitsize == 0)
+		outc->unitsize = unitsize;
+	if (unitsize != outc->unitsize) {
+		sr_err("Unit size changed from %d to %u.",
+			outc->unitsize, unitsize);
+		return SR_ERR_DATA;
 	}
-	logicsrc = zip_source_buffer(archive, buf, length, FALSE);
-	chunkname = g_strdup_printf("logic-1-%u", next_chunk_num);
-	i = zip_add(archive, chunkname, logicsrc);
-	g_free(chunkname);
-	if (i < 0) {
-		sr_err("Failed to add chunk 'logic-1-%u': %s",
-			next_chunk_num, zip_strerror(archive));
-		zip_source_free(logicsrc);
-		zip_discard(archive);
-		g_free(metabuf);
-		return SR_ERR;
+
+	return SR_OK;
+}
+
+static int zip_append_logic(const struct sr_output *o,
+		const struct sr_datafeed_logic *logic)
+{
+	struct out_context *outc;
+	int ret;
+
+	outc = o->priv;
+
+	if ((ret = check_unitsize(outc, logic->unitsize)) != SR_OK)
+		return ret;
+	if (logic->length % logic->unitsize != 0) {
+		sr_warn("Chunk size %" PRIu64 " not a multiple of the"
+			" unit size %u.", logic->length, logic->unitsize);
 	}
-	if (zip_close(archive) < 0) {
-		sr_err("Error saving session file: %s", zip_strerror(archive));
-		zip_discard(archive);
-		g_free(metabuf);
-		return SR_ERR;
+
+	return zip_append(outc, &outc->logic, logic->data, logic->length,
+		logic->unitsize);
+}
+
+/* Expand runs straight into the chunk buffer. */
+static int zip_append_logic_rle(const struct sr_output *o,
+		const struct sr_datafeed_logic_rle *rle)
+{
+	struct out_context *outc;
+	struct chunk_stream *cs;
+	struct sr_logic_rle_iter it;
+	uint64_t count;
+	int ret;
+
+	outc = o->priv;
+	cs = &outc->logic;
+
+	if ((ret = check_unitsize(outc, rle->unitsize)) != SR_OK)
+		return ret;
+	if ((ret = chunk_prepare(outc, cs, rle->unitsize)) != SR_OK)
+		return ret;
+
+	sr_logic_rle_iter_init(&it, rle);
+	while ((count = sr_logic_rle_expand(&it, cs->buf + cs->len,
+			(cs->size - cs->len) / rle->unitsize))) {
+		cs->len += count * rle->unitsize;
+		if (cs->len == cs->size) {
+			if ((ret = zip_flush_chunk(outc, cs)) != SR_OK)
+				return ret;
+		}
 	}
-	g_free(metabuf);
 
 	return SR_OK;
 }
@@ -315,19 +621,10 @@ static int zip_append_analog(const struct sr_output *o,
 		const struct sr_datafeed_analog *analog)
 {
 	struct out_context *outc;
-	struct zip *archive;
-	struct zip_source *analogsrc;
-	int64_t i, num_files;
-	struct zip_stat zs;
-	uint64_t chunk_num;
-	const char *entry_name;
-	char *basename;
-	gsize baselen;
 	struct sr_channel *channel;
-	float *chunkbuf;
-	gsize chunksize;
-	char *chunkname;
-	unsigned int next_chunk_num, index;
+	size_t size;
+	unsigned int index;
+	int ret;
 
 	outc = o->priv;
 
@@ -347,66 +644,105 @@ static int zip_append_analog(const struct sr_output *o,
 	if (outc->analog_index_map[index] == -1)
 		return SR_ERR_ARG; /* Channel index was not in the list */
 
-	index += outc->first_analog_index;
-
-	if (!(archive = zip_open(outc->filename, 0, NULL)))
-		return SR_ERR;
-
-	if (zip_stat(archive, "metadata", 0, &zs) < 0) {
-		sr_err("Failed to open metadata: %s", zip_strerror(archive));
-		goto err_zip_discard;
+	size = sizeof(float) * analog->num_samples;
+	if (size > outc->fbuf_size) {
+		g_free(outc->fbuf);
+		outc->fbuf_size = 0;
+		if (!(outc->fbuf = g_try_malloc(size)))
+			return SR_ERR_MALLOC;
+		outc->fbuf_size = size;
 	}
+	if ((ret = sr_analog_to_float(analog, outc->fbuf)) != SR_OK)
+		return ret;
 
-	basename = g_strdup_printf("analog-1-%u", index);
-	baselen = strlen(basename);
-	next_chunk_num = 1;
-	num_files = zip_get_num_entries(archive, 0);
-	for (i = 0; i < num_files; i++) {
-		entry_name = zip_get_name(archive, i, 0);
-		if (!entry_name || strncmp(entry_name, basename, baselen) != 0) {
-			continue;
-		} else if (entry_name[baselen] == '-') {
-			chunk_num = g_ascii_strtoull(entry_name + baselen + 1, NULL, 10);
-			if (chunk_num < G_MAXINT && chunk_num >= next_chunk_num)
-				next_chunk_num = chunk_num + 1;
-		}
-	}
-
-	chunksize = sizeof(float) * analog->num_samples;
-	if (!(chunkbuf = g_try_malloc(chunksize)))
-		goto err_free_basename;
-
-	if (sr_analog_to_float(analog, chunkbuf) != SR_OK)
-		goto err_free_chunkbuf;
-
-	analogsrc = zip_source_buffer(archive, chunkbuf, chunksize, FALSE);
-	chunkname = g_strdup_printf("%s-%u", basename, next_chunk_num);
-	i = zip_add(archive, chunkname, analogsrc);
-	if (i < 0) {
-		sr_err("Failed to add chunk '%s': %s", chunkname, zip_strerror(archive));
-		g_free(chunkname);
-		zip_source_free(analogsrc);
-		goto err_free_chunkbuf;
-	}
-	g_free(chunkname);
-	if (zip_close(archive) < 0) {
-		sr_err("Error saving session file: %s", zip_strerror(archive));
-		goto err_free_chunkbuf;
-	}
-
-	g_free(basename);
-	g_free(chunkbuf);
+	return zip_append(outc, &outc->analog[index],
+		(const uint8_t *)outc->fbuf, size, sizeof(float));
+}
 
-	return SR_OK;
+/*
+ * Record the number of samples in each chunk member, so that readers
+ * can locate a sample without decompressing the chunks before it.
+ */
+static void meta_set_index(GKeyFile *meta, const struct chunk_stream *cs)
+{
+	char **counts, *key;
+	guint i;
+
+	if (!cs->index || !cs->index->len)
+		return;
+
+	counts = g_malloc0((cs->index->len + 1) * sizeof(char *));
+	for (i = 0; i < cs->index->len; i++)
+		counts[i] = g_strdup_printf("%" PRIu64,
+			g_array_index(cs->index, uint64_t, i));
+	key = g_strdup_printf("index %s", cs->basename);
+	g_key_file_set_string_list(meta, "device 1", key,
+		(const gchar * const *)counts, cs->index->len);
+	g_free(key);
+	g_strfreev(counts);
+}
 
-err_free_chunkbuf:
-	g_free(chunkbuf);
-err_free_basename:
-	g_free(basename);
-err_zip_discard:
-	zip_discard(archive);
+/*
+ * Flush pending chunks, then write the metadata and the central directory
+ * (once, for the whole capture). After a write error, the archive still
+ * gets completed with the members written before it.
+ */
+static int zip_finalize(const struct sr_output *o)
+{
+	struct out_context *outc;
+	char *metabuf;
+	gsize metalen;
+	gint *map;
+	int ret, err;
+	guint i;
 
-	return SR_ERR;
+	outc = o->priv;
+	if (!outc->archive)
+		return SR_OK;
+
+	ret = zip_flush_chunk(outc, &outc->logic);
+	for (map = outc->analog_index_map; ret == SR_OK && *map != -1; map++)
+		ret = zip_flush_chunk(outc, &outc->analog[map - outc->analog_index_map]);
+
+	/* Don't let a failed member keep the others from being readable. */
+	outc->failed = outc->corrupt;
+
+	if (outc->unitsize)
+		g_key_file_set_integer(outc->meta, "device 1",
+			"unitsize", outc->unitsize);
+	meta_set_index(outc->meta, &outc->logic);
+	for (map = outc->analog_index_map; *map != -1; map++)
+		meta_set_index(outc->meta,
+			&outc->analog[map - outc->analog_index_map]);
+	metabuf = g_key_file_to_data(outc->meta, &metalen, NULL);
+	err = zip_add_member(outc, "metadata", (const uint8_t *)metabuf,
+		metalen, TRUE);
+	if (err != SR_OK)
+		sr_err("Error saving metadata into zipfile.");
+	g_free(metabuf);
+	if (err == SR_OK)
+		err = zip_write_directory(outc);
+	if (fclose(outc->archive) != 0 && err == SR_OK) {
+		sr_err("Failed to write '%s': %s", outc->filename,
+			g_strerror(errno));
+		err = SR_ERR_IO;
+	}
+	outc->archive = NULL;
+	if (ret == SR_OK)
+		ret = err;
+
+	for (i = 0; i < outc->entries->len; i++)
+		g_free(g_array_index(outc->entries, struct zip_entry, i).name);
+	g_array_free(outc->entries, TRUE);
+	outc->entries = NULL;
+	if (outc->zs_ready)
+		deflateEnd(&outc->zs);
+	outc->zs_ready = FALSE;
+	g_free(outc->zbuf);
+	outc->zbuf = NULL;
+	outc->zbuf_size = 0;
+
+	return ret;
 }
 
 static int receive(const struct sr_output *o, const struct sr_datafeed_packet *packet,
@@ -414,8 +750,6 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 {
 	struct out_context *outc;
 	const struct sr_datafeed_meta *meta;
-	const struct sr_datafeed_logic *logic;
-	const struct sr_datafeed_analog *analog;
 	const struct sr_config *src;
 	GSList *l;
 
@@ -441,8 +775,17 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 				return ret;
 			outc->zip_created = TRUE;
 		}
-		logic = packet->payload;
-		ret = zip_append(o, logic->data, logic->unitsize, logic->length);
+		ret = zip_append_logic(o, packet->payload);
+		if (ret != SR_OK)
+			return ret;
+		break;
+	case SR_DF_LOGIC_RLE:
+		if (!outc->zip_created) {
+			if ((ret = zip_create(o)) != SR_OK)
+				return ret;
+			outc->zip_created = TRUE;
+		}
+		ret = zip_append_logic_rle(o, packet->payload);
 		if (ret != SR_OK)
 			return ret;
 		break;
@@ -452,8 +795,12 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 				return ret;
 			outc->zip_created = TRUE;
 		}
-		analog = packet->payload;
-		ret = zip_append_analog(o, analog);
+		ret = zip_append_analog(o, packet->payload);
+		if (ret != SR_OK)
+			return ret;
+		break;
+	case SR_DF_END:
+		ret = zip_finalize(o);
 		if (ret != SR_OK)
 			return ret;
 		break;
@@ -463,25 +810,53 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 }
 
 static struct sr_option options[] = {
+	{ "chunksize", "Chunk size", "Size of the sample data archive members in bytes", NULL, NULL },
 	ALL_ZERO
 };
 
 static const struct sr_option *get_options(void)
 {
+	if (!options[0].def) {
+		options[0].def = g_variant_new_uint32(DEFAULT_CHUNK_SIZE);
+		g_variant_ref_sink(options[0].def);
+	}
+
 	return options;
 }
 
 static int cleanup(struct sr_output *o)
 {
 	struct out_context *outc;
+	gint i;
+	int ret;
 
 	outc = o->priv;
+
+	/* Still write the archive if the acquisition didn't end regularly. */
+	ret = zip_finalize(o);
+
+	if (outc->analog) {
+		for (i = 0; outc->analog_index_map[i] != -1; i++) {
+			g_free(outc->analog[i].basename);
+			g_free(outc->analog[i].buf);
+			if (outc->analog[i].index)
+				g_array_free(outc->analog[i].index, TRUE);
+		}
+		g_free(outc->analog);
+	}
+	g_free(outc->logic.basename);
+	g_free(outc->logic.buf);
+	if (outc->logic.index)
+		g_array_free(outc->logic.index, TRUE);
+	if (outc->meta)
+		g_key_file_free(outc->meta);
+	g_free(outc->fbuf);
 	g_free(outc->analog_index_map);
 	g_free(outc->filename);
 	g_free(outc);
 	o->priv = NULL;
 
-	return SR_OK;
+	return ret;
 }
 
 SR_PRIV struct sr_output_module output_srzip = {
@@ -489,7 +864,7 @@ SR_PRIV struct sr_output_module output_srzip = {
 	.name = "srzip",
 	.desc = "srzip session file format data",
 	.exts = (const char*[]){"sr", NULL},
-	.flags = SR_OUTPUT_INTERNAL_IO_HANDLING,
+	.flags = SR_OUTPUT_INTERNAL_IO_HANDLING | SR_OUTPUT_LOGIC_RLE,
 	.options = get_options,
 	.init = init,
 	.receive = receive,
@@ -27,14 +27,23 @@
 
 #define LOG_PREFIX "output/vcd"
 
+/* Longest timestamp, plus one value change for each of 94 channels. */
+#define MAX_LINE_LEN (1 + 32 + 3 * 94 + 1)
+
 struct context {
 	int num_enabled_channels;
-	uint8_t *prevsample;
 	gboolean header_done;
 	uint64_t period;
 	int *channel_index;
 	uint64_t samplerate;
 	uint64_t samplecount;
+	/* Timescale ticks per sample, or 0 if that's not integral. */
+	uint64_t ticks_per_sample;
+	/* Unit size the sample masks were set up for. */
+	unsigned int unitsize;
+	/* Channel bits of a sample, and their previous values. */
+	uint64_t mask[2];
+	uint64_t prevsample[2];
 };
 
 static int init(struct sr_output *o, GHashTable *options)
@@ -110,26 +119,31 @@ static uint64_t get_timescale_freq(uint64_t samplerate)
 	return timescale;
 }
 
-static GString *gen_header(const struct sr_output *o)
+static void update_ticks_per_sample(struct context *ctx)
+{
+	ctx->ticks_per_sample = 0;
+	if (ctx->samplerate && ctx->period % ctx->samplerate == 0)
+		ctx->ticks_per_sample = ctx->period / ctx->samplerate;
+}
+
+static void gen_header(const struct sr_output *o, GString *header)
 {
 	struct context *ctx;
 	struct sr_channel *ch;
 	GVariant *gvar;
-	GString *header;
 	GSList *l;
 	time_t t;
 	int num_channels, i;
 	char *samplerate_s, *frequency_s, *timestamp;
 
 	ctx = o->priv;
-	header = g_string_sized_new(512);
 	num_channels = g_slist_length(o->sdi->channels);
 
 	/* timestamp */
 	t = time(NULL);
 	timestamp = g_strdup(ctime(&t));
 	timestamp[strlen(timestamp) - 1] = 0;
-	g_string_printf(header, "$date %s $end\n", timestamp);
+	g_string_append_printf(header, "$date %s $end\n", timestamp);
 	g_free(timestamp);
 
 	/* generator */
@@ -154,6 +168,7 @@ static GString *gen_header(const struct sr_output *o)
 
 	/* timescale */
 	ctx->period = get_timescale_freq(ctx->samplerate);
+	update_ticks_per_sample(ctx);
 	frequency_s = sr_period_string(1, ctx->period);
 	g_string_append_printf(header, "$timescale %s $end\n", frequency_s);
 	g_free(frequency_s);
@@ -174,24 +189,247 @@ static GString *gen_header(const struct sr_output *o)
 	}
 
 	g_string_append(header, "$upscope $end\n$enddefinitions $end\n");
+}
+
+static unsigned int lowest_bit(uint64_t v)
+{
+#if defined(__GNUC__) || defined(__clang__)
+	return __builtin_ctzll(v);
+#else
+	unsigned int i;
+
+	for (i = 0; !(v & 1); i++)
+		v >>= 1;
+
+	return i;
+#endif
+}
+
+/* Little endian load of up to 8 bytes of a sample. */
+static uint64_t sample_bytes(const uint8_t *p, unsigned int len)
+{
+	uint64_t v;
+	unsigned int i;
+
+	switch (len) {
+	case 1:
+		return R8(p);
+	case 2:
+		return RL16(p);
+	case 4:
+		return RL32(p);
+	case 8:
+		return RL64(p);
+	}
+
+	v = 0;
+	for (i = 0; i < len; i++)
+		v |= (uint64_t)p[i] << (8 * i);
 
-	return header;
+	return v;
 }
 
-static int receive(const struct sr_output *o, const struct sr_datafeed_packet *packet,
-		GString **out)
+static void setup_masks(struct context *ctx, unsigned int unitsize)
+{
+	unsigned int bits, w;
+
+	/*
+	 * The data image is dense, channel bits are packed in the order
+	 * of enabled channels. Bits beyond that, or beyond the unit size,
+	 * are of no interest.
+	 */
+	bits = MIN((unsigned int)ctx->num_enabled_channels, unitsize * 8);
+	for (w = 0; w < 2; w++) {
+		if (bits >= 64)
+			ctx->mask[w] = ~(uint64_t)0;
+		else
+			ctx->mask[w] = ((uint64_t)1 << bits) - 1;
+		bits -= MIN(bits, 64);
+	}
+	ctx->unitsize = unitsize;
+}
+
+static size_t format_timestamp(const struct context *ctx, char *buf)
+{
+	char digits[20];
+	uint64_t ts;
+	size_t len, i;
+	int ret;
+
+	if (!ctx->ticks_per_sample) {
+		ret = snprintf(buf, 33, "#%.0f", (double)ctx->samplecount /
+				ctx->samplerate * ctx->period);
+		return CLAMP(ret, 0, 32);
+	}
+
+	ts = ctx->samplecount * ctx->ticks_per_sample;
+	len = 0;
+	do {
+		digits[len++] = '0' + ts % 10;
+		ts /= 10;
+	} while (ts);
+
+	buf[0] = '#';
+	for (i = 0; i < len; i++)
+		buf[1 + i] = digits[len - 1 - i];
+
+	return 1 + len;
+}
+
+/* Output which signals changed to which value, at the current sample. */
+static void emit_changes(struct context *ctx, GString *out,
+		const uint64_t *cur, const uint64_t *diff)
+{
+	char line[MAX_LINE_LEN];
+	uint64_t d;
+	size_t len;
+	unsigned int w, bit, p;
+
+	len = format_timestamp(ctx, line);
+	for (w = 0; w < 2; w++) {
+		for (d = diff[w]; d; d &= d - 1) {
+			bit = lowest_bit(d);
+			p = w * 64 + bit;
+			line[len++] = ' ';
+			line[len++] = '0' + ((cur[w] >> bit) & 1);
+			line[len++] = '!' + p;
+		}
+	}
+	line[len++] = '\n';
+
+	g_string_append_len(out, line, len);
+}
+
+static void process_logic(struct context *ctx, GString *out,
+		const struct sr_datafeed_logic *logic)
+{
+	const uint8_t *data, *sample;
+	uint64_t cur[2], diff[2], rep, prev_rep, chunk_mask;
+	uint64_t i, end, num_samples;
+	unsigned int unitsize, lo_len, hi_len, per_chunk;
+
+	unitsize = logic->unitsize;
+	if (!unitsize)
+		return;
+	if (unitsize != ctx->unitsize)
+		setup_masks(ctx, unitsize);
+
+	data = logic->data;
+	num_samples = logic->length / unitsize;
+	lo_len = MIN(unitsize, 8);
+	hi_len = (unitsize > 8) ? MIN(unitsize - 8, 8) : 0;
+
+	/*
+	 * For small unit sizes, compare 8 bytes worth of samples at once
+	 * against the previous sample replicated into every lane. This
+	 * skips over unchanged stretches of sparse signals quickly.
+	 */
+	switch (unitsize) {
+	case 1:
+		rep = 0x0101010101010101ULL;
+		break;
+	case 2:
+		rep = 0x0001000100010001ULL;
+		break;
+	case 4:
+		rep = 0x0000000100000001ULL;
+		break;
+	default:
+		rep = 0;
+		break;
+	}
+	per_chunk = rep ? 8 / unitsize : 0;
+	chunk_mask = ctx->mask[0] * rep;
+	prev_rep = ctx->prevsample[0] * rep;
+
+	i = 0;
+	while (i < num_samples) {
+		if (rep && ctx->samplecount > 0 && num_samples - i >= per_chunk) {
+			if (!((RL64(data + i * unitsize) ^ prev_rep) & chunk_mask)) {
+				i += per_chunk;
+				ctx->samplecount += per_chunk;
+				continue;
+			}
+			end = i + per_chunk;
+		} else {
+			end = rep ? i + 1 : num_samples;
+		}
+
+		for (; i < end; i++) {
+			sample = data + i * unitsize;
+			cur[0] = sample_bytes(sample, lo_len) & ctx->mask[0];
+			cur[1] = hi_len ? sample_bytes(sample + 8, hi_len) & ctx->mask[1] : 0;
+
+			/* VCD only contains deltas/changes of signals. */
+			if (ctx->samplecount > 0) {
+				diff[0] = cur[0] ^ ctx->prevsample[0];
+				diff[1] = cur[1] ^ ctx->prevsample[1];
+			} else {
+				diff[0] = ctx->mask[0];
+				diff[1] = ctx->mask[1];
+			}
+			if (diff[0] | diff[1]) {
+				emit_changes(ctx, out, cur, diff);
+				ctx->prevsample[0] = cur[0];
+				ctx->prevsample[1] = cur[1];
+				prev_rep = cur[0] * rep;
+			}
+			ctx->samplecount++;
+		}
+	}
+}
+
+/* Runs need a single comparison each, regardless of their length. */
+static void process_logic_rle(struct context *ctx, GString *out,
+		const struct sr_datafeed_logic_rle *rle)
+{
+	const uint8_t *values, *sample;
+	uint64_t cur[2], diff[2], i;
+	unsigned int unitsize, lo_len, hi_len;
+
+	unitsize = rle->unitsize;
+	if (!unitsize)
+		return;
+	if (unitsize != ctx->unitsize)
+		setup_masks(ctx, unitsize);
+
+	values = rle->values;
+	lo_len = MIN(unitsize, 8);
+	hi_len = (unitsize > 8) ? MIN(unitsize - 8, 8) : 0;
+
+	for (i = 0; i < rle->num_runs; i++) {
+		if (!rle->lengths[i])
+			continue;
+		sample = values + i * unitsize;
+		cur[0] = sample_bytes(sample, lo_len) & ctx->mask[0];
+		cur[1] = hi_len ? sample_bytes(sample + 8, hi_len) & ctx->mask[1] : 0;
+
+		if (ctx->samplecount > 0) {
+			diff[0] = cur[0] ^ ctx->prevsample[0];
+			diff[1] = cur[1] ^ ctx->prevsample[1];
+		} else {
+			diff[0] = ctx->mask[0];
+			diff[1] = ctx->mask[1];
+		}
+		if (diff[0] | diff[1]) {
+			emit_changes(ctx, out, cur, diff);
+			ctx->prevsample[0] = cur[0];
+			ctx->prevsample[1] = cur[1];
+		}
+		ctx->samplecount += rle->lengths[i];
+	}
+}
+
+static int append(const struct sr_output *o, const struct sr_datafeed_packet *packet,
+		GString *out)
 {
 	const struct sr_datafeed_meta *meta;
-	const struct sr_datafeed_logic *logic;
 	const struct sr_config *src;
 	GSList *l;
 	struct context *ctx;
-	unsigned int i;
-	int p, curbit, prevbit, index;
-	uint8_t *sample;
-	gboolean timestamp_written;
+	char line[MAX_LINE_LEN];
+	size_t len;
 
-	*out = NULL;
 	if (!o || !o->priv)
 		return SR_ERR_BUG;
 	ctx = o->priv;
@@ -204,74 +442,33 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 			if (src->key != SR_CONF_SAMPLERATE)
 				continue;
 			ctx->samplerate = g_variant_get_uint64(src->data);
+			update_ticks_per_sample(ctx);
 		}
 		break;
 	case SR_DF_LOGIC:
-		logic = packet->payload;
-
+	case SR_DF_LOGIC_RLE:
 		if (!ctx->header_done) {
-			*out = gen_header(o);
+			gen_header(o, out);
 			ctx->header_done = TRUE;
-		} else {
-			*out = g_string_sized_new(512);
 		}
 
-		if (!ctx->prevsample) {
-			/* Can't allocate this until we know the stream's unitsize. */
-			ctx->prevsample = g_malloc0(logic->unitsize);
-		}
-
-		for (i = 0; i <= logic->length - logic->unitsize; i += logic->unitsize) {
-			sample = logic->data + i;
-			timestamp_written = FALSE;
-
-			for (p = 0; p < ctx->num_enabled_channels; p++) {
-				/*
-				 * TODO Check whether the mapping from
-				 * data image positions to channel numbers
-				 * is required. Experiments suggest that
-				 * the data image "is dense", and packs
-				 * bits of enabled channels, and leaves no
-				 * room for positions of disabled channels.
-				 */
-				/* index = ctx->channel_index[p]; */
-				index = p;
-
-				curbit = ((unsigned)sample[index / 8]
-						>> (index % 8)) & 1;
-				prevbit = ((unsigned)ctx->prevsample[index / 8]
-						>> (index % 8)) & 1;
-
-				/* VCD only contains deltas/changes of signals. */
-				if (prevbit == curbit && ctx->samplecount > 0)
-					continue;
-
-				/* Output timestamp of subsequent signal changes. */
-				if (!timestamp_written)
-					g_string_append_printf(*out, "#%.0f",
-						(double)ctx->samplecount /
-							ctx->samplerate * ctx->period);
-
-				/* Output which signal changed to which value. */
-				g_string_append_c(*out, ' ');
-				g_string_append_c(*out, '0' + curbit);
-				g_string_append_c(*out, '!' + p);
-
-				timestamp_written = TRUE;
-			}
-
-			if (timestamp_written)
-				g_string_append_c(*out, '\n');
-
-			ctx->samplecount++;
-			memcpy(ctx->prevsample, sample, logic->unitsize);
-		}
+		/*
+		 * TODO Check whether the mapping from data image positions
+		 * to channel numbers (ctx->channel_index) is required.
+		 * Experiments suggest that the data image "is dense", and
+		 * packs bits of enabled channels, and leaves no room for
+		 * positions of disabled channels.
+		 */
+		if (packet->type == SR_DF_LOGIC)
+			process_logic(ctx, out, packet->payload);
+		else
+			process_logic_rle(ctx, out, packet->payload);
 		break;
 	case SR_DF_END:
 		/* Write final timestamp as length indicator. */
-		*out = g_string_sized_new(512);
-		g_string_printf(*out, "#%.0f\n",
-				(double)ctx->samplecount / ctx->samplerate * ctx->period);
+		len = format_timestamp(ctx, line);
+		line[len++] = '\n';
+		g_string_append_len(out, line, len);
 		break;
 	}
 
@@ -286,7 +483,6 @@ static int cleanup(struct sr_output *o)
 		return SR_ERR_ARG;
 
 	ctx = o->priv;
-	g_free(ctx->prevsample);
 	g_free(ctx->channel_index);
 	g_free(ctx);
 
@@ -298,9 +494,9 @@ struct sr_output_module output_vcd = {
 	.name = "VCD",
 	.desc = "Value Change Dump data",
 	.exts = (const char*[]){"vcd", NULL},
-	.flags = 0,
+	.flags = SR_OUTPUT_LOGIC_RLE,
 	.options = NULL,
 	.init = init,
-	.receive = receive,
+	.append = append,
 	.cleanup = cleanup,
 };
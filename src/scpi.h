@@ -110,6 +110,11 @@ struct sr_scpi_dev_inst {
 	int (*send)(void *priv, const char *command);
 	int (*read_begin)(void *priv);
 	int (*read_data)(void *priv, char *buf, int maxlen);
+	/*
+	 * Optional, for transports whose read_data() doesn't block. Waits
+	 * until data can be read, returns SR_ERR_TIMEOUT when none arrived.
+	 */
+	int (*wait_data)(void *priv, int timeout_ms);
 	int (*write_data)(void *priv, char *buf, int len);
 	int (*read_complete)(void *priv);
 	int (*close)(struct sr_scpi_dev_inst *scpi);
@@ -141,6 +146,7 @@ SR_PRIV int sr_scpi_send_variadic(struct sr_scpi_dev_inst *scpi,
 		const char *format, va_list args);
 SR_PRIV int sr_scpi_read_begin(struct sr_scpi_dev_inst *scpi);
 SR_PRIV int sr_scpi_read_data(struct sr_scpi_dev_inst *scpi, char *buf, int maxlen);
+SR_PRIV int sr_scpi_read_exact(struct sr_scpi_dev_inst *scpi, char *buf, int len);
 SR_PRIV int sr_scpi_write_data(struct sr_scpi_dev_inst *scpi, char *buf, int len);
 SR_PRIV int sr_scpi_read_complete(struct sr_scpi_dev_inst *scpi);
 SR_PRIV int sr_scpi_close(struct sr_scpi_dev_inst *scpi);
@@ -167,6 +173,9 @@ SR_PRIV int sr_scpi_get_data(struct sr_scpi_dev_inst *scpi,
 			const char *command, GString **scpi_response);
 SR_PRIV int sr_scpi_get_block(struct sr_scpi_dev_inst *scpi,
 			const char *command, GByteArray **scpi_response);
+SR_PRIV int sr_scpi_get_block_floatv(struct sr_scpi_dev_inst *scpi,
+			const char *command, gboolean big_endian,
+			GArray **scpi_response);
 SR_PRIV int sr_scpi_get_hw_id(struct sr_scpi_dev_inst *scpi,
 			struct sr_scpi_hw_info **scpi_response);
 SR_PRIV void sr_scpi_hw_info_free(struct sr_scpi_hw_info *hw_info);
@@ -185,6 +194,32 @@ SR_PRIV int sr_scpi_cmd_resp(const struct sr_dev_inst *sdi,
 		int channel_command, const char *channel_name,
 		GVariant **gvar, const GVariantType *gvtype, int command, ...);
 
+/*--- Pipelined block conversion (scpi_pipeline.c) --------------------------*/
+
+struct sr_scpi_block {
+	/* Block as received, owned by the pipeline. */
+	GByteArray *raw;
+	/* The driver's conversion parameters, freed by its done callback. */
+	void *priv;
+	/* Conversion result, allocated by the convert callback. */
+	float *data;
+	size_t num_samples;
+};
+
+typedef void (*sr_scpi_block_cb)(struct sr_scpi_block *block, void *cb_data);
+
+struct sr_scpi_pipeline;
+
+SR_PRIV struct sr_scpi_pipeline *sr_scpi_pipeline_new(sr_scpi_block_cb convert,
+		sr_scpi_block_cb done, void *cb_data, unsigned int depth);
+SR_PRIV void sr_scpi_pipeline_no_thread(gboolean inline_only);
+SR_PRIV void sr_scpi_pipeline_push(struct sr_scpi_pipeline *pl,
+		GByteArray *raw, void *priv);
+SR_PRIV void sr_scpi_pipeline_flush(struct sr_scpi_pipeline *pl, gboolean wait);
+SR_PRIV void sr_scpi_pipeline_frame_end(struct sr_scpi_pipeline *pl,
+		const struct sr_dev_inst *sdi);
+SR_PRIV void sr_scpi_pipeline_free(struct sr_scpi_pipeline *pl);
+
 /*--- GPIB only functions ---------------------------------------------------*/
 
 #ifdef HAVE_LIBGPIB
@@ -19,6 +19,7 @@
  */
 
 #include <config.h>
+#include <errno.h>
 #include <glib.h>
 #include <string.h>
 #include <libsigrok/libsigrok.h>
@@ -223,8 +224,73 @@ static int scpi_read_data(struct sr_scpi_dev_inst *scpi, char *buf, int maxlen)
 }
 
 /**
- * Do a non-blocking read of up to the allocated length, and
- * check if a timeout has occured, without mutex.
+ * Wait until the transport has data to read, without mutex.
+ *
+ * Transports whose read_data() blocks by itself don't provide a
+ * wait_data() routine, for them this returns immediately.
+ *
+ * @param scpi Previously initialised SCPI device structure.
+ * @param abs_timeout_us Absolute timeout in microseconds.
+ *
+ * @return SR_OK when data is available, SR_ERR_TIMEOUT or SR_ERR otherwise.
+ */
+static int scpi_wait_data(struct sr_scpi_dev_inst *scpi, gint64 abs_timeout_us)
+{
+	gint64 remaining;
+
+	if (!scpi->wait_data)
+		return SR_OK;
+
+	remaining = abs_timeout_us - g_get_monotonic_time();
+	if (remaining <= 0)
+		return SR_ERR_TIMEOUT;
+
+	/* Round up, a zero timeout would mean "forever" to some transports. */
+	return scpi->wait_data(scpi->priv, (remaining + 999) / 1000);
+}
+
+/**
+ * Wait for data and read up to the given length, and check if a timeout
+ * has occured, without mutex.
+ *
+ * @param scpi Previously initialised SCPI device structure.
+ * @param buf Buffer to store result.
+ * @param maxlen Maximum number of bytes to read.
+ * @param abs_timeout_us Absolute timeout in microseconds.
+ *
+ * @return read length on success, SR_ERR* on failure.
+ */
+static int scpi_read_chunk(struct sr_scpi_dev_inst *scpi,
+		char *buf, int maxlen, gint64 abs_timeout_us)
+{
+	int len;
+
+	len = scpi_wait_data(scpi, abs_timeout_us);
+	if (len == SR_ERR_TIMEOUT) {
+		sr_err("Timed out waiting for SCPI response.");
+		return SR_ERR_TIMEOUT;
+	} else if (len != SR_OK) {
+		return SR_ERR;
+	}
+
+	len = scpi->read_data(scpi->priv, buf, maxlen);
+
+	if (len < 0) {
+		sr_err("Incompletely read SCPI response.");
+		return SR_ERR;
+	}
+
+	if (len == 0 && g_get_monotonic_time() > abs_timeout_us) {
+		sr_err("Timed out waiting for SCPI response.");
+		return SR_ERR_TIMEOUT;
+	}
+
+	return len;
+}
+
+/**
+ * Do a read of up to the allocated length, and check if a timeout has
+ * occured, without mutex.
  *
  * @param scpi Previously initialised SCPI device structure.
  * @param response Buffer to which the response is appended.
@@ -238,24 +304,69 @@ static int scpi_read_response(struct sr_scpi_dev_inst *scpi,
 	int len, space;
 
 	space = response->allocated_len - response->len;
-	len = scpi->read_data(scpi->priv, &response->str[response->len], space);
-
-	if (len < 0) {
-		sr_err("Incompletely read SCPI response.");
-		return SR_ERR;
-	}
+	len = scpi_read_chunk(scpi, &response->str[response->len], space,
+		abs_timeout_us);
 
-	if (len > 0) {
+	if (len > 0)
 		g_string_set_size(response, response->len + len);
-		return len;
-	}
 
-	if (g_get_monotonic_time() > abs_timeout_us) {
-		sr_err("Timed out waiting for SCPI response.");
-		return SR_ERR_TIMEOUT;
+	return len;
+}
+
+/**
+ * Read exactly the given number of bytes into the caller's buffer,
+ * without mutex. The timeout restarts whenever data was received.
+ *
+ * @param scpi Previously initialised SCPI device structure.
+ * @param buf Buffer to store result.
+ * @param len Number of bytes to read.
+ * @param count Pointer where to store the number of bytes read, which
+ *              is less than len after errors.
+ *
+ * @return SR_OK on success, SR_ERR* on failure.
+ */
+static int scpi_read_exact(struct sr_scpi_dev_inst *scpi,
+		char *buf, size_t len, size_t *count)
+{
+	gint64 timeout;
+	int ret;
+
+	*count = 0;
+	timeout = g_get_monotonic_time() + scpi->read_timeout_us;
+	while (*count < len) {
+		ret = scpi_read_chunk(scpi, buf + *count,
+			MIN(len - *count, G_MAXINT), timeout);
+		if (ret < 0)
+			return ret;
+		if (ret > 0) {
+			*count += ret;
+			timeout = g_get_monotonic_time() + scpi->read_timeout_us;
+		}
 	}
 
-	return 0;
+	return SR_OK;
+}
+
+/**
+ * Drop what's left of the current response, e.g. the terminator after
+ * a binary block, without mutex. Gives up quickly when nothing arrives.
+ *
+ * @param scpi Previously initialised SCPI device structure.
+ */
+static void scpi_discard_response(struct sr_scpi_dev_inst *scpi)
+{
+	char buf[64];
+	gint64 timeout;
+
+	timeout = g_get_monotonic_time() + SCPI_READ_RETRY_TIMEOUT_US;
+	while (!sr_scpi_read_complete(scpi)) {
+		if (scpi_wait_data(scpi, timeout) != SR_OK)
+			break;
+		if (scpi->read_data(scpi->priv, buf, sizeof(buf)) < 0)
+			break;
+		if (g_get_monotonic_time() > timeout)
+			break;
+	}
 }
 
 /**
@@ -539,6 +650,34 @@ SR_PRIV int sr_scpi_read_data(struct sr_scpi_dev_inst *scpi,
 	return ret;
 }
 
+/**
+ * Read exactly the given number of bytes of a response from SCPI device.
+ *
+ * Waits for the transport instead of polling it, and reads straight into
+ * the caller's buffer, so it suits the bulk of waveform downloads.
+ *
+ * @param scpi Previously initialised SCPI device structure.
+ * @param buf Buffer to store result.
+ * @param len Number of bytes to read.
+ *
+ * @return Number of bytes read (len), or SR_ERR* upon failure or timeout.
+ */
+SR_PRIV int sr_scpi_read_exact(struct sr_scpi_dev_inst *scpi,
+			char *buf, int len)
+{
+	size_t count;
+	int ret;
+
+	if (len < 0)
+		return SR_ERR_ARG;
+
+	g_mutex_lock(&scpi->scpi_mutex);
+	ret = scpi_read_exact(scpi, buf, len, &count);
+	g_mutex_unlock(&scpi->scpi_mutex);
+
+	return (ret == SR_OK) ? len : ret;
+}
+
 /**
  * Send data to SCPI device.
  *
@@ -856,33 +995,28 @@ SR_PRIV int sr_scpi_get_floatv(struct sr_scpi_dev_inst *scpi,
 			       const char *command, GArray **scpi_response)
 {
 	int ret;
-	float tmp;
 	char *response;
-	gchar **ptr, **tokens;
+	const char *p;
+	size_t size, count;
 	GArray *response_array;
 
 	response = NULL;
-	tokens = NULL;
 
 	ret = sr_scpi_get_string(scpi, command, &response);
 	if (ret != SR_OK && !response)
 		return ret;
 
-	tokens = g_strsplit(response, ",", 0);
-	ptr = tokens;
+	/* Size the array for all values, then parse straight into it. */
+	size = 1;
+	for (p = response; (p = strchr(p, ',')); p++)
+		size++;
+	response_array = g_array_sized_new(TRUE, FALSE, sizeof(float), size);
+	g_array_set_size(response_array, size);
 
-	response_array = g_array_sized_new(TRUE, FALSE, sizeof(float), 256);
-
-	while (*ptr) {
-		if (sr_atof_ascii(*ptr, &tmp) == SR_OK)
-			response_array = g_array_append_val(response_array,
-							    tmp);
-		else
-			ret = SR_ERR_DATA;
-
-		ptr++;
-	}
-	g_strfreev(tokens);
+	if (sr_parse_float_list(response, (float *)response_array->data,
+			size, &count) != SR_OK)
+		ret = SR_ERR_DATA;
+	g_array_set_size(response_array, count);
 	g_free(response);
 
 	if (ret != SR_OK && response_array->len == 0) {
@@ -912,33 +1046,42 @@ SR_PRIV int sr_scpi_get_floatv(struct sr_scpi_dev_inst *scpi,
 SR_PRIV int sr_scpi_get_uint8v(struct sr_scpi_dev_inst *scpi,
 			       const char *command, GArray **scpi_response)
 {
-	int tmp, ret;
-	char *response;
-	gchar **ptr, **tokens;
+	int ret;
+	char *response, *p, *endptr;
+	gint64 value;
+	size_t size;
+	uint8_t *values;
 	GArray *response_array;
 
 	response = NULL;
-	tokens = NULL;
 
 	ret = sr_scpi_get_string(scpi, command, &response);
 	if (ret != SR_OK && !response)
 		return ret;
 
-	tokens = g_strsplit(response, ",", 0);
-	ptr = tokens;
-
-	response_array = g_array_sized_new(TRUE, FALSE, sizeof(uint8_t), 256);
-
-	while (*ptr) {
-		if (sr_atoi(*ptr, &tmp) == SR_OK)
-			response_array = g_array_append_val(response_array,
-							    tmp);
+	size = 1;
+	for (p = response; (p = strchr(p, ',')); p++)
+		size++;
+	response_array = g_array_sized_new(TRUE, FALSE, sizeof(uint8_t), size);
+	g_array_set_size(response_array, size);
+	values = (uint8_t *)response_array->data;
+
+	/* Single pass over the text, invalid values get skipped. */
+	size = 0;
+	for (p = response; ; p++) {
+		errno = 0;
+		value = g_ascii_strtoll(p, &endptr, 10);
+		while (g_ascii_isspace(*endptr))
+			endptr++;
+		if (endptr != p && !errno && (*endptr == ',' || !*endptr) &&
+				value >= 0 && value <= UINT8_MAX)
+			values[size++] = value;
 		else
 			ret = SR_ERR_DATA;
-
-		ptr++;
+		if (!(p = strchr(endptr, ',')))
+			break;
 	}
-	g_strfreev(tokens);
+	g_array_set_size(response_array, size);
 	g_free(response);
 
 	if (response_array->len == 0) {
@@ -952,6 +1095,97 @@ SR_PRIV int sr_scpi_get_uint8v(struct sr_scpi_dev_inst *scpi,
 	return ret;
 }
 
+/**
+ * Send a SCPI command and read the "definite length block" header of the
+ * reply, without mutex.
+ *
+ * SCPI protocol data blocks are preceeded with a length spec. The length
+ * spec consists of a '#' marker, one digit which specifies the character
+ * count of the length spec, and the respective number of characters which
+ * specify the data block's length. Raw data bytes follow (thus one must
+ * no longer assume that the received input stream would be an ASCIIZ
+ * string).
+ *
+ * Only the length spec gets read, so that the data bytes can be received
+ * into their final buffer.
+ *
+ * @param scpi Previously initialised SCPI device structure.
+ * @param command The SCPI command to send to the device (can be NULL).
+ * @param datalen Pointer where to store the data block's length.
+ *
+ * @return SR_OK on success, SR_ERR* on failure.
+ */
+static int scpi_get_block_header(struct sr_scpi_dev_inst *scpi,
+		const char *command, long *datalen)
+{
+	int ret;
+	char buf[10];
+	long llen;
+	size_t count;
+
+	if (command)
+		if (scpi_send(scpi, command) != SR_OK)
+			return SR_ERR;
+
+	if (sr_scpi_read_begin(scpi) != SR_OK)
+		return SR_ERR;
+
+	ret = scpi_read_exact(scpi, buf, 2, &count);
+	if (ret != SR_OK)
+		return ret;
+	if (buf[0] != '#')
+		return SR_ERR_DATA;
+	buf[0] = buf[1];
+	buf[1] = '\0';
+	ret = sr_atol(buf, &llen);
+	if (ret != SR_OK)
+		return ret;
+	/* Indefinite length blocks ("#0") are not supported. */
+	if (llen == 0)
+		return SR_ERR_DATA;
+
+	ret = scpi_read_exact(scpi, buf, llen, &count);
+	if (ret != SR_OK)
+		return ret;
+	buf[llen] = '\0';
+
+	return sr_atol(buf, datalen);
+}
+
+/**
+ * Read the data bytes of a "definite length block", without mutex.
+ *
+ * @param scpi Previously initialised SCPI device structure.
+ * @param buf Buffer for the data bytes.
+ * @param datalen Pointer to the data block's length. Gets reduced to
+ *                the number of bytes received when the device times out.
+ *
+ * @return SR_OK on success, also after a timeout, SR_ERR* on failure.
+ */
+static int scpi_get_block_data(struct sr_scpi_dev_inst *scpi,
+		char *buf, long *datalen)
+{
+	int ret;
+	size_t count;
+
+	ret = scpi_read_exact(scpi, buf, *datalen, &count);
+
+	/* On timeout truncate the buffer and send the partial response
+	 * instead of getting stuck on timeouts...
+	 */
+	if (ret == SR_ERR_TIMEOUT) {
+		*datalen = count;
+		return SR_OK;
+	}
+	if (ret < 0)
+		return ret;
+
+	/* Drop the terminator which follows the data block. */
+	scpi_discard_response(scpi);
+
+	return SR_OK;
+}
+
 /**
  * Send a SCPI command, read the reply, parse it as binary data with a
  * "definite length block" header and store the as an result in scpi_response.
@@ -969,125 +1203,100 @@ SR_PRIV int sr_scpi_get_block(struct sr_scpi_dev_inst *scpi,
 			       const char *command, GByteArray **scpi_response)
 {
 	int ret;
-	GString* response;
-	gsize oldlen;
-	char buf[10];
-	long llen;
 	long datalen;
-	gint64 timeout;
+	guint8 *data;
+
+	/* Prepare a NULL return value for when error paths will be taken. */
+	*scpi_response = NULL;
 
 	g_mutex_lock(&scpi->scpi_mutex);
 
-	if (command)
-		if (scpi_send(scpi, command) != SR_OK) {
-			g_mutex_unlock(&scpi->scpi_mutex);
-			return SR_ERR;
-		}
+	ret = scpi_get_block_header(scpi, command, &datalen);
+	if ((ret != SR_OK) || (datalen == 0)) {
+		g_mutex_unlock(&scpi->scpi_mutex);
+		return ret;
+	}
 
-	if (sr_scpi_read_begin(scpi) != SR_OK) {
+	if (!(data = g_try_malloc(datalen))) {
+		sr_err("Failed to allocate %ld bytes for SCPI block.", datalen);
 		g_mutex_unlock(&scpi->scpi_mutex);
-		return SR_ERR;
+		return SR_ERR_MALLOC;
 	}
 
-	/*
-	 * Assume an initial maximum length, optionally gets adjusted below.
-	 * Prepare a NULL return value for when error paths will be taken.
-	 */
-	response = g_string_sized_new(1024);
+	ret = scpi_get_block_data(scpi, (char *)data, &datalen);
 
-	timeout = g_get_monotonic_time() + scpi->read_timeout_us;
+	g_mutex_unlock(&scpi->scpi_mutex);
+
+	if (ret != SR_OK) {
+		g_free(data);
+		return ret;
+	}
+
+	*scpi_response = g_byte_array_new_take(data, datalen);
+
+	return SR_OK;
+}
+
+/**
+ * Send a SCPI command, and read the "definite length block" reply as
+ * IEEE 754 single precision floats.
+ *
+ * The values get received straight into the array, and byte swapped in
+ * place if the device's byte order differs from the host's.
+ *
+ * @param scpi Previously initialised SCPI device structure.
+ * @param command The SCPI command to send to the device (can be NULL).
+ * @param big_endian Whether the device sends big endian values.
+ * @param scpi_response Pointer where to store the GArray of float values
+ *                      in host byte order, to be freed by the caller.
+ *
+ * @return SR_OK on success, SR_ERR* on failure.
+ */
+SR_PRIV int sr_scpi_get_block_floatv(struct sr_scpi_dev_inst *scpi,
+			const char *command, gboolean big_endian,
+			GArray **scpi_response)
+{
+	int ret;
+	long datalen;
+	GArray *array;
+	uint32_t *u32;
+	guint i;
 
 	*scpi_response = NULL;
 
-	/* Get (the first chunk of) the response. */
-	do {
-		ret = scpi_read_response(scpi, response, timeout);
-		if (ret < 0) {
-			g_mutex_unlock(&scpi->scpi_mutex);
-			g_string_free(response, TRUE);
-			return ret;
-		}
-	} while (response->len < 2);
+	g_mutex_lock(&scpi->scpi_mutex);
 
-	/*
-	 * SCPI protocol data blocks are preceeded with a length spec.
-	 * The length spec consists of a '#' marker, one digit which
-	 * specifies the character count of the length spec, and the
-	 * respective number of characters which specify the data block's
-	 * length. Raw data bytes follow (thus one must no longer assume
-	 * that the received input stream would be an ASCIIZ string).
-	 *
-	 * Get the data block length, and strip off the length spec from
-	 * the input buffer, leaving just the data bytes.
-	 */
-	if (response->str[0] != '#') {
-		g_mutex_unlock(&scpi->scpi_mutex);
-		g_string_free(response, TRUE);
-		return SR_ERR_DATA;
-	}
-	buf[0] = response->str[1];
-	buf[1] = '\0';
-	ret = sr_atol(buf, &llen);
-	if ((ret != SR_OK) || (llen == 0)) {
+	ret = scpi_get_block_header(scpi, command, &datalen);
+	if (ret != SR_OK) {
 		g_mutex_unlock(&scpi->scpi_mutex);
-		g_string_free(response, TRUE);
 		return ret;
 	}
 
-	while (response->len < (unsigned long)(2 + llen)) {
-		ret = scpi_read_response(scpi, response, timeout);
-		if (ret < 0) {
-			g_mutex_unlock(&scpi->scpi_mutex);
-			g_string_free(response, TRUE);
-			return ret;
-		}
-	}
+	/* Receive straight into the array, rounded up to whole values. */
+	array = g_array_sized_new(FALSE, FALSE, sizeof(float),
+		(datalen + sizeof(float) - 1) / sizeof(float));
+	g_array_set_size(array, (datalen + sizeof(float) - 1) / sizeof(float));
+	if (datalen > 0)
+		ret = scpi_get_block_data(scpi, array->data, &datalen);
 
-	memcpy(buf, &response->str[2], llen);
-	buf[llen] = '\0';
-	ret = sr_atol(buf, &datalen);
-	if ((ret != SR_OK) || (datalen == 0)) {
-		g_mutex_unlock(&scpi->scpi_mutex);
-		g_string_free(response, TRUE);
+	g_mutex_unlock(&scpi->scpi_mutex);
+
+	if (ret != SR_OK) {
+		g_array_free(array, TRUE);
 		return ret;
 	}
-	g_string_erase(response, 0, 2 + llen);
-
-	/*
-	 * Re-allocate the buffer size to the now known length
-	 * and keep reading more chunks of response data.
-	 */
-	oldlen = response->len;
-	g_string_set_size(response, datalen);
-	g_string_set_size(response, oldlen);
-
-	if (oldlen < (unsigned long)(datalen)) {
-		do {
-			oldlen = response->len;
-			ret = scpi_read_response(scpi, response, timeout);
-
-			/* On timeout truncate the buffer and send the partial response
-			 * instead of getting stuck on timeouts...
-			 */
-			if (ret == SR_ERR_TIMEOUT) {
-				datalen = oldlen;
-				break;
-			}
-			if (ret < 0) {
-				g_mutex_unlock(&scpi->scpi_mutex);
-				g_string_free(response, TRUE);
-				return ret;
-			}
-			if (ret > 0)
-				timeout = g_get_monotonic_time() + scpi->read_timeout_us;
-		} while (response->len < (unsigned long)(datalen));
+	if (datalen % sizeof(float))
+		sr_warn("SCPI block length %ld is not a multiple of %zu.",
+			datalen, sizeof(float));
+	g_array_set_size(array, datalen / sizeof(float));
+
+	if (big_endian != (G_BYTE_ORDER == G_BIG_ENDIAN)) {
+		u32 = (uint32_t *)array->data;
+		for (i = 0; i < array->len; i++)
+			u32[i] = GUINT32_SWAP_LE_BE(u32[i]);
 	}
 
-	g_mutex_unlock(&scpi->scpi_mutex);
-
-	/* Convert received data to byte array. */
-	*scpi_response = g_byte_array_new_take(
-		(guint8*)g_string_free(response, FALSE), datalen);
+	*scpi_response = array;
 
 	return SR_OK;
 }
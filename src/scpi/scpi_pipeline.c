@@ -0,0 +1,237 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2026 The sigrok developers
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <glib.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+#include "scpi.h"
+
+#define LOG_PREFIX "scpi_pipeline"
+
+/*
+ * Oscilloscope drivers download one waveform block after the other, and
+ * each round trip leaves the link idle while the previous block gets
+ * converted. The pipeline takes received blocks, converts them on a
+ * worker thread, and hands them back to the session thread in order. The
+ * driver meanwhile sends the commands for the next block.
+ *
+ * Only the convert callback runs on the worker. The done callback, which
+ * usually submits packets to the session, runs on the caller's thread
+ * from within sr_scpi_pipeline_push(), _flush() and _free().
+ */
+
+struct sr_scpi_pipeline {
+	sr_scpi_block_cb convert;
+	sr_scpi_block_cb done;
+	void *cb_data;
+	/* Maximum number of blocks in flight, before push() waits. */
+	unsigned int depth;
+	/* Blocks pushed but not yet handed to the done callback. */
+	unsigned int pending;
+	GAsyncQueue *todo;
+	GAsyncQueue *converted;
+	GThread *thread;
+	/* Queued to the worker to have it exit. */
+	struct sr_scpi_block stop;
+};
+
+/* Set by tests, to check the fallback without a worker thread. */
+static gint no_thread;
+
+static gpointer scpi_pipeline_run(gpointer data)
+{
+	struct sr_scpi_pipeline *pl;
+	struct sr_scpi_block *block;
+
+	pl = data;
+	while ((block = g_async_queue_pop(pl->todo)) != &pl->stop) {
+		pl->convert(block, pl->cb_data);
+		g_async_queue_push(pl->converted, block);
+	}
+
+	return NULL;
+}
+
+static void scpi_pipeline_deliver(struct sr_scpi_pipeline *pl,
+		struct sr_scpi_block *block)
+{
+	pl->done(block, pl->cb_data);
+	pl->pending--;
+
+	g_byte_array_free(block->raw, TRUE);
+	g_free(block->data);
+	g_free(block);
+}
+
+/**
+ * Create a pipeline which converts received blocks on a worker thread.
+ *
+ * Without a thread, blocks get converted from within push(), so the
+ * driver works the same, just without the overlap.
+ *
+ * @param convert Called on the worker for each block. Fills in the
+ *                block's data (allocated with g_malloc()) and num_samples.
+ * @param done Called on the caller's thread for each converted block, in
+ *             the order of push() calls. Frees the block's priv data.
+ * @param cb_data Passed to both callbacks.
+ * @param depth Maximum number of blocks in flight.
+ *
+ * @return The new pipeline. Free with sr_scpi_pipeline_free().
+ *
+ * @private
+ */
+SR_PRIV struct sr_scpi_pipeline *sr_scpi_pipeline_new(sr_scpi_block_cb convert,
+		sr_scpi_block_cb done, void *cb_data, unsigned int depth)
+{
+	struct sr_scpi_pipeline *pl;
+	GError *error;
+
+	pl = g_malloc0(sizeof(*pl));
+	pl->convert = convert;
+	pl->done = done;
+	pl->cb_data = cb_data;
+	pl->depth = MAX(depth, 1);
+	pl->todo = g_async_queue_new();
+	pl->converted = g_async_queue_new();
+
+	error = NULL;
+	if (!g_atomic_int_get(&no_thread))
+		pl->thread = g_thread_try_new("sr-scpi", scpi_pipeline_run,
+			pl, &error);
+	if (error) {
+		sr_warn("No conversion thread, converting inline: %s.",
+			error->message);
+		g_error_free(error);
+	}
+
+	return pl;
+}
+
+/**
+ * Have pipelines created from now on convert inline, like when no
+ * worker thread can be started. Meant for tests.
+ *
+ * @param inline_only TRUE to not start worker threads, FALSE to restore
+ *                    the default.
+ *
+ * @private
+ */
+SR_PRIV void sr_scpi_pipeline_no_thread(gboolean inline_only)
+{
+	g_atomic_int_set(&no_thread, inline_only);
+}
+
+/**
+ * Queue a received block for conversion.
+ *
+ * Returns right away unless the pipeline is full, in which case it
+ * delivers the oldest block first.
+ *
+ * @param pl The pipeline.
+ * @param raw The block as received. The pipeline takes ownership.
+ * @param priv The driver's parameters for converting and sending.
+ *
+ * @private
+ */
+SR_PRIV void sr_scpi_pipeline_push(struct sr_scpi_pipeline *pl,
+		GByteArray *raw, void *priv)
+{
+	struct sr_scpi_block *block;
+
+	while (pl->pending >= pl->depth)
+		scpi_pipeline_deliver(pl, g_async_queue_pop(pl->converted));
+
+	block = g_malloc0(sizeof(*block));
+	block->raw = raw;
+	block->priv = priv;
+	pl->pending++;
+
+	if (pl->thread) {
+		g_async_queue_push(pl->todo, block);
+	} else {
+		pl->convert(block, pl->cb_data);
+		g_async_queue_push(pl->converted, block);
+	}
+}
+
+/**
+ * Hand converted blocks to the done callback.
+ *
+ * @param pl The pipeline.
+ * @param wait TRUE to wait for all pushed blocks, e.g. before sending
+ *             the end of a frame. FALSE to only deliver the ones which
+ *             are ready.
+ *
+ * @private
+ */
+SR_PRIV void sr_scpi_pipeline_flush(struct sr_scpi_pipeline *pl, gboolean wait)
+{
+	struct sr_scpi_block *block;
+
+	while (pl->pending > 0) {
+		if (wait)
+			block = g_async_queue_pop(pl->converted);
+		else if (!(block = g_async_queue_try_pop(pl->converted)))
+			break;
+		scpi_pipeline_deliver(pl, block);
+	}
+}
+
+/**
+ * Deliver all outstanding blocks, then end the current frame.
+ *
+ * Use this instead of std_session_send_df_frame_end() while a pipeline
+ * is active, also on error paths, so no samples of a frame arrive after
+ * its end.
+ *
+ * @param pl The pipeline.
+ * @param sdi The device instance the frame belongs to.
+ *
+ * @private
+ */
+SR_PRIV void sr_scpi_pipeline_frame_end(struct sr_scpi_pipeline *pl,
+		const struct sr_dev_inst *sdi)
+{
+	sr_scpi_pipeline_flush(pl, TRUE);
+	std_session_send_df_frame_end(sdi);
+}
+
+/**
+ * Deliver all outstanding blocks, then stop the worker and free the
+ * pipeline.
+ *
+ * @param pl The pipeline. NULL is accepted.
+ *
+ * @private
+ */
+SR_PRIV void sr_scpi_pipeline_free(struct sr_scpi_pipeline *pl)
+{
+	if (!pl)
+		return;
+
+	sr_scpi_pipeline_flush(pl, TRUE);
+	if (pl->thread) {
+		g_async_queue_push(pl->todo, &pl->stop);
+		g_thread_join(pl->thread);
+	}
+	g_async_queue_unref(pl->todo);
+	g_async_queue_unref(pl->converted);
+	g_free(pl);
+}
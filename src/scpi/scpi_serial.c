@@ -33,6 +33,9 @@
 struct scpi_serial {
 	struct sr_serial_dev_inst *serial;
 	gboolean got_newline;
+	/* Byte received while waiting for data, not yet returned. */
+	gboolean have_pending;
+	char pending;
 };
 
 /* Default serial port options for some known USB devices */
@@ -118,6 +121,7 @@ static int scpi_serial_open(struct sr_scpi_dev_inst *scpi)
 		return SR_ERR;
 
 	sscpi->got_newline = FALSE;
+	sscpi->have_pending = FALSE;
 
 	return SR_OK;
 }
@@ -176,16 +180,48 @@ static int scpi_serial_read_begin(void *priv)
 	return SR_OK;
 }
 
-static int scpi_serial_read_data(void *priv, char *buf, int maxlen)
+static int scpi_serial_wait_data(void *priv, int timeout_ms)
 {
 	struct scpi_serial *sscpi = priv;
 	int ret;
 
+	if (sscpi->have_pending)
+		return SR_OK;
+
+	/*
+	 * There is no way to poll the port without reading, so block
+	 * for the first byte, and keep it for the next read_data().
+	 */
+	ret = serial_read_blocking(sscpi->serial, &sscpi->pending, 1, timeout_ms);
+	if (ret < 0)
+		return ret;
+	if (ret == 0)
+		return SR_ERR_TIMEOUT;
+	sscpi->have_pending = TRUE;
+
+	return SR_OK;
+}
+
+static int scpi_serial_read_data(void *priv, char *buf, int maxlen)
+{
+	struct scpi_serial *sscpi = priv;
+	int ret, offset;
+
+	offset = 0;
+	if (sscpi->have_pending && maxlen > 0) {
+		buf[offset++] = sscpi->pending;
+		sscpi->have_pending = FALSE;
+	}
+
 	/* Try to read new data into the buffer. */
-	ret = serial_read_nonblocking(sscpi->serial, buf, maxlen);
+	ret = 0;
+	if (maxlen > offset)
+		ret = serial_read_nonblocking(sscpi->serial, buf + offset,
+			maxlen - offset);
 
 	if (ret < 0)
 		return ret;
+	ret += offset;
 
 	if (ret > 0) {
 		if (buf[ret - 1] == '\n') {
@@ -239,6 +275,7 @@ SR_PRIV const struct sr_scpi_dev_inst scpi_serial_dev = {
 	.send          = scpi_serial_send,
 	.read_begin    = scpi_serial_read_begin,
 	.read_data     = scpi_serial_read_data,
+	.wait_data     = scpi_serial_wait_data,
 	.read_complete = scpi_serial_read_complete,
 	.close         = scpi_serial_close,
 	.free          = scpi_serial_free,
@@ -27,6 +27,8 @@
 #define LOG_PREFIX "scpi_usbtmc"
 
 #define MAX_TRANSFER_LENGTH 2048
+/* Direct transfers must be a multiple of the bulk endpoint packet size. */
+#define DIRECT_TRANSFER_ALIGN 512
 #define TRANSFER_TIMEOUT 1000
 
 struct scpi_usbtmc_libusb {
@@ -615,6 +617,23 @@ static int scpi_usbtmc_libusb_read_data(void *priv, char *buf, int maxlen)
 	struct scpi_usbtmc_libusb *uscpi = priv;
 	int read_length;
 
+	/*
+	 * Once the buffered part is consumed, receive large reads straight
+	 * into the caller's buffer. Stay below the remaining message length
+	 * so that alignment padding at its end still goes to our buffer.
+	 */
+	if (uscpi->response_bytes_read >= uscpi->response_length &&
+	    uscpi->remaining_length > 0) {
+		read_length = MIN(maxlen, uscpi->remaining_length);
+		read_length &= ~(DIRECT_TRANSFER_ALIGN - 1);
+		if (read_length > 0) {
+			if (scpi_usbtmc_bulkin_continue(uscpi, buf, read_length) <= 0)
+				return SR_ERR;
+			uscpi->response_bytes_read = uscpi->response_length;
+			return uscpi->response_length;
+		}
+	}
+
 	if (uscpi->response_bytes_read >= uscpi->response_length) {
 		if (uscpi->remaining_length > 0) {
 			if (scpi_usbtmc_bulkin_continue(uscpi, uscpi->buffer,
@@ -40,6 +40,26 @@ struct scpi_vxi {
 	unsigned int read_complete;
 };
 
+/* Same RPC timeout as the generated client stubs use. */
+static struct timeval vxi_rpc_timeout = { 25, 0 };
+
+/* A device_read response, with the data bytes going to a given buffer. */
+struct scpi_vxi_read {
+	Device_ReadResp resp;
+	u_int maxlen;
+};
+
+static bool_t xdr_scpi_vxi_read(XDR *xdrs, struct scpi_vxi_read *read_resp)
+{
+	if (!xdr_Device_ErrorCode(xdrs, &read_resp->resp.error))
+		return FALSE;
+	if (!xdr_long(xdrs, &read_resp->resp.reason))
+		return FALSE;
+
+	return xdr_bytes(xdrs, &read_resp->resp.data.data_val,
+		&read_resp->resp.data.data_len, read_resp->maxlen);
+}
+
 static int scpi_vxi_dev_inst_new(void *priv, struct drv_context *drvc,
 		const char *resource, char **params, const char *serialcomm)
 {
@@ -173,7 +193,7 @@ static int scpi_vxi_read_data(void *priv, char *buf, int maxlen)
 {
 	struct scpi_vxi *vxi = priv;
 	Device_ReadParms read_parms;
-	Device_ReadResp *read_resp;
+	struct scpi_vxi_read read_resp;
 
 	read_parms.lid          = vxi->link;
 	read_parms.io_timeout   = VXI_DEFAULT_TIMEOUT_MS;
@@ -182,16 +202,23 @@ static int scpi_vxi_read_data(void *priv, char *buf, int maxlen)
 	read_parms.termChar     = 0;
 	read_parms.requestSize  = maxlen;
 
-	if (!(read_resp = device_read_1(&read_parms, vxi->client))
-	    || read_resp->error) {
+	/* Have the response data decoded straight into the caller's buffer. */
+	memset(&read_resp, 0, sizeof(read_resp));
+	read_resp.resp.data.data_val = buf;
+	read_resp.maxlen = maxlen;
+
+	if (clnt_call(vxi->client, device_read,
+	              (xdrproc_t)xdr_Device_ReadParms, (caddr_t)&read_parms,
+	              (xdrproc_t)xdr_scpi_vxi_read, (caddr_t)&read_resp,
+	              vxi_rpc_timeout) != RPC_SUCCESS
+	    || read_resp.resp.error) {
 		sr_err("Device read failed for %s with error %ld",
-		       vxi->address, read_resp ? read_resp->error : 0);
+		       vxi->address, read_resp.resp.error);
 		return SR_ERR;
 	}
 
-	memcpy(buf, read_resp->data.data_val, read_resp->data.data_len);
-	vxi->read_complete = read_resp->reason & (RRR_TERM | RRR_END);
-	return read_resp->data.data_len;  /* actual number of bytes received */
+	vxi->read_complete = read_resp.resp.reason & (RRR_TERM | RRR_END);
+	return read_resp.resp.data.data_len;  /* actual number of bytes received */
 }
 
 static int scpi_vxi_read_complete(void *priv)
@@ -49,8 +49,15 @@
 struct datafeed_callback {
 	sr_datafeed_callback cb;
 	void *cb_data;
+	/* Takes SR_DF_LOGIC_RLE packets as they are. */
+	gboolean rle;
+	/* Takes SR_DF_LOGIC_PLANAR packets as they are. */
+	gboolean planar;
 };
 
+/* Buffer backing the packet currently being sent by this thread. */
+static GPrivate send_buffer = G_PRIVATE_INIT(NULL);
+
 /** Custom GLib event source for generic descriptor I/O.
  * @see https://developer.gnome.org/glib/stable/glib-The-Main-Event-Loop.html
  */
@@ -254,6 +261,8 @@ SR_API int sr_session_destroy(struct sr_session *session)
 		return SR_ERR_ARG;
 	}
 
+	sr_session_dispatch_stop(session);
+
 	sr_session_dev_remove_all(session);
 	g_slist_free_full(session->owned_devs, (GDestroyNotify)sr_dev_inst_free);
 
@@ -263,6 +272,7 @@ SR_API int sr_session_destroy(struct sr_session *session)
 
 	g_mutex_clear(&session->main_mutex);
 
+	g_free(session->transform_buf);
 	g_free(session);
 
 	return SR_OK;
@@ -467,21 +477,9 @@ SR_API int sr_session_datafeed_callback_remove_all(struct sr_session *session)
 	return SR_OK;
 }
 
-/**
- * Add a datafeed callback to a session.
- *
- * @param session The session to use. Must not be NULL.
- * @param cb Function to call when a chunk of data is received.
- *           Must not be NULL.
- * @param cb_data Opaque pointer passed in by the caller.
- *
- * @retval SR_OK Success.
- * @retval SR_ERR_BUG No session exists.
- *
- * @since 0.3.0
- */
-SR_API int sr_session_datafeed_callback_add(struct sr_session *session,
-		sr_datafeed_callback cb, void *cb_data)
+static int datafeed_callback_add(struct sr_session *session,
+		sr_datafeed_callback cb, void *cb_data, gboolean rle,
+		gboolean planar)
 {
 	struct datafeed_callback *cb_struct;
 
@@ -498,6 +496,8 @@ SR_API int sr_session_datafeed_callback_add(struct sr_session *session,
 	cb_struct = g_malloc0(sizeof(struct datafeed_callback));
 	cb_struct->cb = cb;
 	cb_struct->cb_data = cb_data;
+	cb_struct->rle = rle;
+	cb_struct->planar = planar;
 
 	session->datafeed_callbacks =
 	    g_slist_append(session->datafeed_callbacks, cb_struct);
@@ -505,6 +505,72 @@ SR_API int sr_session_datafeed_callback_add(struct sr_session *session,
 	return SR_OK;
 }
 
+/**
+ * Add a datafeed callback to a session.
+ *
+ * @param session The session to use. Must not be NULL.
+ * @param cb Function to call when a chunk of data is received.
+ *           Must not be NULL.
+ * @param cb_data Opaque pointer passed in by the caller.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_BUG No session exists.
+ *
+ * @since 0.3.0
+ */
+SR_API int sr_session_datafeed_callback_add(struct sr_session *session,
+		sr_datafeed_callback cb, void *cb_data)
+{
+	return datafeed_callback_add(session, cb, cb_data, FALSE, FALSE);
+}
+
+/**
+ * Add a datafeed callback which handles run-length compressed logic data.
+ *
+ * Unlike with sr_session_datafeed_callback_add(), SR_DF_LOGIC_RLE packets
+ * are passed to the callback as they are, instead of being expanded into
+ * SR_DF_LOGIC packets.
+ *
+ * @param session The session to use. Must not be NULL.
+ * @param cb Function to call when a chunk of data is received.
+ *           Must not be NULL.
+ * @param cb_data Opaque pointer passed in by the caller.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_BUG No session exists.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_session_datafeed_rle_callback_add(struct sr_session *session,
+		sr_datafeed_callback cb, void *cb_data)
+{
+	return datafeed_callback_add(session, cb, cb_data, TRUE, FALSE);
+}
+
+/**
+ * Add a datafeed callback which handles channel-planar logic data.
+ *
+ * Unlike with sr_session_datafeed_callback_add(), SR_DF_LOGIC_PLANAR
+ * packets are passed to the callback as they are, instead of being
+ * packed into SR_DF_LOGIC packets. Sources only send them while such a
+ * callback is registered.
+ *
+ * @param session The session to use. Must not be NULL.
+ * @param cb Function to call when a chunk of data is received.
+ *           Must not be NULL.
+ * @param cb_data Opaque pointer passed in by the caller.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_BUG No session exists.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_session_datafeed_planar_callback_add(struct sr_session *session,
+		sr_datafeed_callback cb, void *cb_data)
+{
+	return datafeed_callback_add(session, cb, cb_data, FALSE, TRUE);
+}
+
 /**
  * Get the trigger assigned to this session.
  *
@@ -692,6 +758,9 @@ static gboolean delayed_stop_check(void *data)
 	session->running = FALSE;
 	unset_main_context(session);
 
+	/* Deliver whatever is still queued before reporting the stop. */
+	sr_session_dispatch_stop(session);
+
 	sr_info("Stopped.");
 
 	/* This indicates a bug in user code, since it is not valid to
@@ -806,6 +875,14 @@ SR_API int sr_session_start(struct sr_session *session)
 	if (ret != SR_OK)
 		return ret;
 
+	if (session->dispatch_depth > 0) {
+		ret = sr_session_dispatch_start(session);
+		if (ret != SR_OK) {
+			unset_main_context(session);
+			return ret;
+		}
+	}
+
 	sr_info("Starting.");
 
 	session->running = TRUE;
@@ -837,6 +914,7 @@ SR_API int sr_session_start(struct sr_session *session)
 		 * sources... */
 		session->running = FALSE;
 
+		sr_session_dispatch_stop(session);
 		unset_main_context(session);
 		return ret;
 	}
@@ -1026,6 +1104,90 @@ SR_API int sr_session_stopped_callback_set(struct sr_session *session,
 	return SR_OK;
 }
 
+/**
+ * Configure asynchronous delivery of datafeed packets.
+ *
+ * By default, datafeed callbacks run synchronously from within the code
+ * that sends the packet, which usually is a driver's receive path. With
+ * a non-zero queue depth, packets are instead put into a bounded queue
+ * after all transforms have been applied, and a dedicated thread passes
+ * them to the datafeed callbacks. A slow callback then no longer stalls
+ * the acquisition, as long as the queue does not fill up.
+ *
+ * Callbacks get invoked from the dispatch thread in this mode, and must
+ * be prepared for that. The setting takes effect with the next
+ * sr_session_start().
+ *
+ * @param session The session to use. Must not be NULL.
+ * @param depth The maximum number of queued packets, 0 to deliver
+ *              packets synchronously.
+ * @param policy What to do when a logic or analog packet is sent while
+ *               the queue is full. Other packets are never dropped.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ * @retval SR_ERR Session is running.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_session_dispatch_set(struct sr_session *session,
+		unsigned int depth, enum sr_dispatch_policy policy)
+{
+	if (!session) {
+		sr_err("%s: session was NULL", __func__);
+		return SR_ERR_ARG;
+	}
+
+	if (policy != SR_DISPATCH_BLOCK && policy != SR_DISPATCH_DROP &&
+			policy != SR_DISPATCH_ABORT) {
+		sr_err("%s: invalid policy %d", __func__, policy);
+		return SR_ERR_ARG;
+	}
+
+	if (session->running) {
+		sr_err("Cannot change dispatch mode while session is running.");
+		return SR_ERR;
+	}
+
+	session->dispatch_depth = depth;
+	session->dispatch_policy = policy;
+
+	return SR_OK;
+}
+
+/**
+ * Get the statistics of asynchronous datafeed delivery.
+ *
+ * The counters are reset when the session starts, and keep their values
+ * after the session stopped.
+ *
+ * @param session The session to use. Must not be NULL.
+ * @param high_water Pointer to store the highest number of packets that
+ *                   were queued at the same time in. May be NULL.
+ * @param dropped Pointer to store the number of dropped packets in.
+ *                May be NULL.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid session passed.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_session_dispatch_stats_get(struct sr_session *session,
+		unsigned int *high_water, uint64_t *dropped)
+{
+	if (!session) {
+		sr_err("%s: session was NULL", __func__);
+		return SR_ERR_ARG;
+	}
+
+	if (high_water)
+		*high_water = session->dispatch_high_water;
+	if (dropped)
+		*dropped = session->dispatch_dropped;
+
+	return SR_OK;
+}
+
 /**
  * Debug helper.
  *
@@ -1035,6 +1197,8 @@ static void datafeed_dump(const struct sr_datafeed_packet *packet)
 {
 	const struct sr_datafeed_logic *logic;
 	const struct sr_datafeed_analog *analog;
+	const struct sr_datafeed_logic_rle *rle;
+	const struct sr_datafeed_logic_planar *planar;
 
 	/* Please use the same order as in libsigrok.h. */
 	switch (packet->type) {
@@ -1066,6 +1230,17 @@ static void datafeed_dump(const struct sr_datafeed_packet *packet)
 		sr_dbg("bus: Received SR_DF_ANALOG packet (%d samples).",
 		       analog->num_samples);
 		break;
+	case SR_DF_LOGIC_RLE:
+		rle = packet->payload;
+		sr_dbg("bus: Received SR_DF_LOGIC_RLE packet (%" PRIu64 " runs, "
+		       "unitsize = %d).", rle->num_runs, rle->unitsize);
+		break;
+	case SR_DF_LOGIC_PLANAR:
+		planar = packet->payload;
+		sr_dbg("bus: Received SR_DF_LOGIC_PLANAR packet (%" PRIu64
+		       " samples, %u planes, unitsize = %d).", planar->num_samples,
+		       planar->num_planes, planar->unitsize);
+		break;
 	default:
 		sr_dbg("bus: Received unknown packet type: %d.", packet->type);
 		break;
@@ -1108,6 +1283,197 @@ SR_PRIV int sr_session_send_meta(const struct sr_dev_inst *sdi,
 	return ret;
 }
 
+/* Whether a callback takes a packet type without conversion. */
+static gboolean callback_takes(const struct datafeed_callback *cb_struct,
+		int type)
+{
+	if (type == SR_DF_LOGIC_RLE)
+		return cb_struct->rle;
+	if (type == SR_DF_LOGIC_PLANAR)
+		return cb_struct->planar;
+
+	return TRUE;
+}
+
+struct dense_run {
+	const struct sr_dev_inst *sdi;
+	/* Type of the packet the dense data was made from. */
+	int type;
+};
+
+/* Pass a dense chunk of RLE or planar data to the callbacks needing it. */
+static int dense_callbacks_run(const struct sr_datafeed_logic *logic,
+		void *cb_data)
+{
+	const struct dense_run *run;
+	const struct sr_dev_inst *sdi;
+	struct sr_datafeed_packet packet;
+	GSList *l;
+	struct datafeed_callback *cb_struct;
+
+	run = cb_data;
+	sdi = run->sdi;
+	packet.type = SR_DF_LOGIC;
+	packet.payload = logic;
+
+	for (l = sdi->session->datafeed_callbacks; l; l = l->next) {
+		cb_struct = l->data;
+		if (callback_takes(cb_struct, run->type))
+			continue;
+		if (sr_log_loglevel_get() >= SR_LOG_DBG)
+			datafeed_dump(&packet);
+		cb_struct->cb(sdi, &packet, cb_struct->cb_data);
+	}
+
+	return SR_OK;
+}
+
+static void datafeed_callbacks_run(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet)
+{
+	GSList *l;
+	struct datafeed_callback *cb_struct;
+	struct dense_run run;
+	gboolean need_dense;
+
+	need_dense = FALSE;
+	for (l = sdi->session->datafeed_callbacks; l; l = l->next) {
+		cb_struct = l->data;
+		if (!callback_takes(cb_struct, packet->type)) {
+			need_dense = TRUE;
+			continue;
+		}
+		if (sr_log_loglevel_get() >= SR_LOG_DBG)
+			datafeed_dump(packet);
+		cb_struct->cb(sdi, packet, cb_struct->cb_data);
+	}
+
+	if (!need_dense)
+		return;
+
+	run.sdi = sdi;
+	run.type = packet->type;
+	if (packet->type == SR_DF_LOGIC_RLE)
+		sr_logic_rle_foreach_chunk(packet->payload,
+			dense_callbacks_run, &run);
+	else
+		sr_logic_planar_foreach_chunk(packet->payload,
+			dense_callbacks_run, &run);
+}
+
+/**
+ * Check whether a source should send SR_DF_LOGIC_PLANAR packets.
+ *
+ * That's the case when a datafeed callback takes them as they are, and
+ * no transform modules (which need dense data) are in the way. Other
+ * callbacks get the planes packed by the session, so sources which
+ * have their data channel by channel anyway can skip the packing.
+ *
+ * @param sdi The device instance sending the data.
+ *
+ * @retval TRUE Planar data is welcome.
+ * @retval FALSE Send SR_DF_LOGIC packets.
+ *
+ * @private
+ */
+SR_PRIV gboolean sr_session_logic_planar_wanted(const struct sr_dev_inst *sdi)
+{
+	GSList *l;
+	struct datafeed_callback *cb_struct;
+
+	if (!sdi || !sdi->session || sdi->session->transforms)
+		return FALSE;
+
+	for (l = sdi->session->datafeed_callbacks; l; l = l->next) {
+		cb_struct = l->data;
+		if (cb_struct->planar)
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+static int dense_send(const struct sr_datafeed_logic *logic, void *cb_data)
+{
+	struct sr_datafeed_packet packet;
+
+	packet.type = SR_DF_LOGIC;
+	packet.payload = logic;
+
+	return sr_session_send(cb_data, &packet);
+}
+
+/* Storage for a packet produced by a fused transform operation. */
+struct transform_packet {
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_logic logic;
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+};
+
+/*
+ * Apply a (fused) transform operation. Logic data gets written to the
+ * session's transform buffer, analog packets get a copy of their encoding,
+ * so the sender's packet stays as it was. That matters for buffers which
+ * get shared with datafeed callbacks, see sr_session_send_buffer().
+ */
+static int transform_op_apply(struct sr_session *session,
+		const struct sr_transform_op *op, struct transform_packet *tp,
+		struct sr_datafeed_packet **packet)
+{
+	const struct sr_datafeed_logic *logic;
+	const struct sr_datafeed_analog *analog;
+	uint8_t *out;
+
+	switch ((*packet)->type) {
+	case SR_DF_LOGIC:
+		logic = (*packet)->payload;
+		out = logic->data;
+		if (out != session->transform_buf) {
+			if (logic->length > session->transform_buf_size) {
+				out = g_try_realloc(session->transform_buf,
+					logic->length);
+				if (!out) {
+					sr_err("Transform buffer malloc failed.");
+					return SR_ERR_MALLOC;
+				}
+				session->transform_buf = out;
+				session->transform_buf_size = logic->length;
+			}
+			out = session->transform_buf;
+		}
+		if (!sr_transform_op_logic(op, logic->data, out,
+				logic->length, logic->unitsize))
+			break;
+		if (logic != &tp->logic)
+			tp->logic = *logic;
+		tp->logic.data = out;
+		tp->packet.type = SR_DF_LOGIC;
+		tp->packet.payload = &tp->logic;
+		*packet = &tp->packet;
+		break;
+	case SR_DF_ANALOG:
+		analog = (*packet)->payload;
+		if (analog != &tp->analog)
+			tp->analog = *analog;
+		if (analog->encoding != &tp->encoding)
+			tp->encoding = *analog->encoding;
+		tp->analog.encoding = &tp->encoding;
+		if (sr_transform_op_analog(op, &tp->encoding) != SR_OK) {
+			sr_err("Analog scale out of range after transforms.");
+			return SR_ERR;
+		}
+		tp->packet.type = SR_DF_ANALOG;
+		tp->packet.payload = &tp->analog;
+		*packet = &tp->packet;
+		break;
+	default:
+		break;
+	}
+
+	return SR_OK;
+}
+
 /**
  * Send a packet to whatever is listening on the datafeed bus.
  *
@@ -1125,9 +1491,11 @@ SR_PRIV int sr_session_send(const struct sr_dev_inst *sdi,
 		const struct sr_datafeed_packet *packet)
 {
 	GSList *l;
-	struct datafeed_callback *cb_struct;
 	struct sr_datafeed_packet *packet_in, *packet_out;
 	struct sr_transform *t;
+	struct sr_transform_op op, next;
+	struct transform_packet tp;
+	gboolean fusing;
 	int ret;
 
 	if (!sdi) {
@@ -1145,15 +1513,50 @@ SR_PRIV int sr_session_send(const struct sr_dev_inst *sdi,
 		return SR_ERR_BUG;
 	}
 
+	/* Transform modules only handle dense logic data. */
+	if (packet->type == SR_DF_LOGIC_RLE && sdi->session->transforms)
+		return sr_logic_rle_foreach_chunk(packet->payload,
+			dense_send, (void *)sdi);
+	if (packet->type == SR_DF_LOGIC_PLANAR && sdi->session->transforms)
+		return sr_logic_planar_foreach_chunk(packet->payload,
+			dense_send, (void *)sdi);
+
 	/*
 	 * Pass the packet to the first transform module. If that returns
 	 * another packet (instead of NULL), pass that packet to the next
 	 * transform module in the list, and so on.
+	 *
+	 * Runs of modules which describe themselves with get_op() get their
+	 * operations fused, and applied in a single pass over the data.
+	 * Modules whose get_op() fails have their receive() run instead.
 	 */
 	packet_in = (struct sr_datafeed_packet *)packet;
+	fusing = FALSE;
+	if (sdi->session->transforms)
+		sr_spew("Running transform modules.");
 	for (l = sdi->session->transforms; l; l = l->next) {
 		t = l->data;
-		sr_spew("Running transform module '%s'.", t->module->id);
+		if (t->module->get_op)
+			sr_transform_op_init(&next);
+		if (t->module->get_op && t->module->get_op(t, &next) == SR_OK) {
+			if (fusing && sr_transform_op_fuse(&op, &next) == SR_OK)
+				continue;
+			if (fusing) {
+				ret = transform_op_apply(sdi->session, &op,
+					&tp, &packet_in);
+				if (ret != SR_OK)
+					return ret;
+			}
+			op = next;
+			fusing = TRUE;
+			continue;
+		}
+		if (fusing) {
+			ret = transform_op_apply(sdi->session, &op, &tp, &packet_in);
+			if (ret != SR_OK)
+				return ret;
+			fusing = FALSE;
+		}
 		ret = t->module->receive(t, packet_in, &packet_out);
 		if (ret < 0) {
 			sr_err("Error while running transform module: %d.", ret);
@@ -1174,22 +1577,76 @@ SR_PRIV int sr_session_send(const struct sr_dev_inst *sdi,
 			packet_in = packet_out;
 		}
 	}
+	if (fusing) {
+		ret = transform_op_apply(sdi->session, &op, &tp, &packet_in);
+		if (ret != SR_OK)
+			return ret;
+	}
 	packet = packet_in;
 
 	/*
 	 * If the last transform did output a packet, pass it to all datafeed
-	 * callbacks.
+	 * callbacks, or have the dispatch thread do so.
 	 */
-	for (l = sdi->session->datafeed_callbacks; l; l = l->next) {
-		if (sr_log_loglevel_get() >= SR_LOG_DBG)
-			datafeed_dump(packet);
-		cb_struct = l->data;
-		cb_struct->cb(sdi, packet, cb_struct->cb_data);
-	}
+	if (sdi->session->dispatch)
+		return sr_session_dispatch_push(sdi, packet);
+
+	datafeed_callbacks_run(sdi, packet);
 
 	return SR_OK;
 }
 
+/**
+ * Pass a packet to all datafeed callbacks of a session.
+ *
+ * This is used by the dispatch thread to deliver queued packets.
+ *
+ * @param sdi The device instance the packet originates from.
+ * @param packet The datafeed packet.
+ * @param buf The buffer backing the packet's sample data, or NULL.
+ *
+ * @private
+ */
+SR_PRIV void sr_session_datafeed_run(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, struct sr_buffer *buf)
+{
+	g_private_set(&send_buffer, buf);
+	datafeed_callbacks_run(sdi, packet);
+	g_private_set(&send_buffer, NULL);
+}
+
+/**
+ * Send a packet whose sample data lives in a reference counted buffer.
+ *
+ * This works like sr_session_send(), but allows datafeed callbacks to
+ * keep the logic or analog sample data via sr_packet_retain() without
+ * copying it. The caller keeps its own reference on @a buf and must not
+ * modify the buffer afterwards while sr_buffer_is_shared() reports it
+ * as being referenced elsewhere.
+ *
+ * @param sdi The device instance the packet originates from.
+ * @param packet The datafeed packet to send to the session bus.
+ * @param buf The buffer containing the packet's sample data.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ *
+ * @private
+ */
+SR_PRIV int sr_session_send_buffer(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, struct sr_buffer *buf)
+{
+	struct sr_buffer *prev;
+	int ret;
+
+	prev = g_private_get(&send_buffer);
+	g_private_set(&send_buffer, buf);
+	ret = sr_session_send(sdi, packet);
+	g_private_set(&send_buffer, prev);
+
+	return ret;
+}
+
 /**
  * Add an event source for a file descriptor.
  *
@@ -1487,58 +1944,91 @@ static void copy_src(struct sr_config *src, struct sr_datafeed_meta *meta_copy)
 	                                   g_memdup(src, sizeof(struct sr_config)));
 }
 
-SR_API int sr_packet_copy(const struct sr_datafeed_packet *packet,
-		struct sr_datafeed_packet **copy)
+/*
+ * Packets handed out by sr_packet_copy() and sr_packet_retain(). The
+ * buffer, if set, holds a reference on the memory backing the logic or
+ * analog sample data, which then is not owned by the copy itself.
+ */
+struct packet_copy {
+	struct sr_datafeed_packet packet;
+	struct sr_buffer *buffer;
+};
+
+static int packet_copy(const struct sr_datafeed_packet *packet,
+		struct sr_buffer *buf, struct sr_datafeed_packet **copy)
 {
+	struct packet_copy *pc;
 	const struct sr_datafeed_meta *meta;
 	struct sr_datafeed_meta *meta_copy;
 	const struct sr_datafeed_logic *logic;
 	struct sr_datafeed_logic *logic_copy;
 	const struct sr_datafeed_analog *analog;
 	struct sr_datafeed_analog *analog_copy;
+	const struct sr_datafeed_logic_rle *rle;
+	struct sr_datafeed_logic_rle *rle_copy;
+	const struct sr_datafeed_logic_planar *planar;
+	struct sr_datafeed_logic_planar *planar_copy;
+	const uint8_t *planes;
 	uint8_t *payload;
+	size_t size;
+	uint32_t i;
 
-	*copy = g_malloc0(sizeof(struct sr_datafeed_packet));
-	(*copy)->type = packet->type;
+	pc = g_malloc0(sizeof(*pc));
+	pc->packet.type = packet->type;
 
 	switch (packet->type) {
 	case SR_DF_TRIGGER:
 	case SR_DF_END:
+	case SR_DF_FRAME_BEGIN:
+	case SR_DF_FRAME_END:
 		/* No payload. */
 		break;
 	case SR_DF_HEADER:
 		payload = g_malloc(sizeof(struct sr_datafeed_header));
 		memcpy(payload, packet->payload, sizeof(struct sr_datafeed_header));
-		(*copy)->payload = payload;
+		pc->packet.payload = payload;
 		break;
 	case SR_DF_META:
 		meta = packet->payload;
 		meta_copy = g_malloc0(sizeof(struct sr_datafeed_meta));
-		g_slist_foreach(meta->config, (GFunc)copy_src, meta_copy->config);
-		(*copy)->payload = meta_copy;
+		g_slist_foreach(meta->config, (GFunc)copy_src, meta_copy);
+		pc->packet.payload = meta_copy;
 		break;
 	case SR_DF_LOGIC:
 		logic = packet->payload;
 		logic_copy = g_malloc(sizeof(*logic_copy));
-		if (!logic_copy)
-			return SR_ERR;
 		logic_copy->length = logic->length;
 		logic_copy->unitsize = logic->unitsize;
-		logic_copy->data = g_malloc(logic->length * logic->unitsize);
-		if (!logic_copy->data) {
-			g_free(logic_copy);
-			return SR_ERR;
+		if (sr_buffer_contains(buf, logic->data, logic->length)) {
+			pc->buffer = sr_buffer_ref(buf);
+			logic_copy->data = logic->data;
+		} else {
+			logic_copy->data = g_try_malloc(logic->length);
+			if (logic->length && !logic_copy->data) {
+				g_free(logic_copy);
+				g_free(pc);
+				return SR_ERR_MALLOC;
+			}
+			memcpy(logic_copy->data, logic->data, logic->length);
 		}
-		memcpy(logic_copy->data, logic->data, logic->length * logic->unitsize);
-		(*copy)->payload = logic_copy;
+		pc->packet.payload = logic_copy;
 		break;
 	case SR_DF_ANALOG:
 		analog = packet->payload;
 		analog_copy = g_malloc(sizeof(*analog_copy));
-		analog_copy->data = g_malloc(
-				analog->encoding->unitsize * analog->num_samples);
-		memcpy(analog_copy->data, analog->data,
-				analog->encoding->unitsize * analog->num_samples);
+		size = analog->encoding->unitsize * analog->num_samples;
+		if (sr_buffer_contains(buf, analog->data, size)) {
+			pc->buffer = sr_buffer_ref(buf);
+			analog_copy->data = analog->data;
+		} else {
+			analog_copy->data = g_try_malloc(size);
+			if (size && !analog_copy->data) {
+				g_free(analog_copy);
+				g_free(pc);
+				return SR_ERR_MALLOC;
+			}
+			memcpy(analog_copy->data, analog->data, size);
+		}
 		analog_copy->num_samples = analog->num_samples;
 		analog_copy->encoding = g_memdup(analog->encoding,
 				sizeof(struct sr_analog_encoding));
@@ -1548,27 +2038,149 @@ SR_API int sr_packet_copy(const struct sr_datafeed_packet *packet,
 				analog->meaning->channels);
 		analog_copy->spec = g_memdup(analog->spec,
 				sizeof(struct sr_analog_spec));
-		(*copy)->payload = analog_copy;
+		pc->packet.payload = analog_copy;
+		break;
+	case SR_DF_LOGIC_RLE:
+		rle = packet->payload;
+		rle_copy = g_malloc(sizeof(*rle_copy));
+		rle_copy->num_runs = rle->num_runs;
+		rle_copy->unitsize = rle->unitsize;
+		size = rle->num_runs * rle->unitsize;
+		rle_copy->values = g_try_malloc(size);
+		rle_copy->lengths = g_try_malloc(rle->num_runs * sizeof(uint64_t));
+		if (rle->num_runs && (!rle_copy->values || !rle_copy->lengths)) {
+			g_free(rle_copy->values);
+			g_free(rle_copy->lengths);
+			g_free(rle_copy);
+			g_free(pc);
+			return SR_ERR_MALLOC;
+		}
+		memcpy(rle_copy->values, rle->values, size);
+		memcpy(rle_copy->lengths, rle->lengths,
+			rle->num_runs * sizeof(uint64_t));
+		pc->packet.payload = rle_copy;
+		break;
+	case SR_DF_LOGIC_PLANAR:
+		/* The copy gets its planes packed back to back. */
+		planar = packet->payload;
+		planar_copy = g_malloc(sizeof(*planar_copy));
+		*planar_copy = *planar;
+		planar_copy->stride = (planar->num_samples + 7) / 8;
+		size = planar->num_planes * planar_copy->stride;
+		planar_copy->channels = g_memdup(planar->channels,
+			planar->num_planes * sizeof(uint32_t));
+		planar_copy->data = g_try_malloc(size);
+		if (size && !planar_copy->data) {
+			g_free(planar_copy->channels);
+			g_free(planar_copy);
+			g_free(pc);
+			return SR_ERR_MALLOC;
+		}
+		planes = planar->data;
+		for (i = 0; i < planar->num_planes; i++)
+			memcpy((uint8_t *)planar_copy->data + i * planar_copy->stride,
+				planes + i * planar->stride, planar_copy->stride);
+		pc->packet.payload = planar_copy;
 		break;
 	default:
 		sr_err("Unknown packet type %d", packet->type);
+		g_free(pc);
 		return SR_ERR;
 	}
 
+	*copy = &pc->packet;
+
 	return SR_OK;
 }
 
+/**
+ * Create a deep copy of a datafeed packet.
+ *
+ * @param packet The packet to copy. Must not be NULL.
+ * @param copy Pointer to store the copy in. Must not be NULL.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_MALLOC Memory allocation failure.
+ * @retval SR_ERR Unknown packet type.
+ *
+ * @see sr_packet_free(), sr_packet_retain().
+ *
+ * @since 0.4.0
+ */
+SR_API int sr_packet_copy(const struct sr_datafeed_packet *packet,
+		struct sr_datafeed_packet **copy)
+{
+	return packet_copy(packet, NULL, copy);
+}
+
+/**
+ * Keep a datafeed packet beyond the datafeed callback it was passed to.
+ *
+ * This must be called from within the datafeed callback. If the sample
+ * data of a logic or analog packet lives in a reference counted buffer
+ * (see sr_session_send_buffer()), the copy shares that data by taking a
+ * reference on the buffer. Otherwise the data is copied like
+ * sr_packet_copy() does. Either way, the copy must be treated as
+ * read-only and be released with sr_packet_free().
+ *
+ * @param packet The packet passed to the datafeed callback.
+ * @param copy Pointer to store the copy in. Must not be NULL.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ * @retval SR_ERR_MALLOC Memory allocation failure.
+ * @retval SR_ERR Unknown packet type.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_packet_retain(const struct sr_datafeed_packet *packet,
+		struct sr_datafeed_packet **copy)
+{
+	if (!packet || !copy)
+		return SR_ERR_ARG;
+
+	return packet_copy(packet, g_private_get(&send_buffer), copy);
+}
+
+/**
+ * Get the buffer backing the sample data of a copied packet.
+ *
+ * @param packet A packet created by sr_packet_copy() or sr_packet_retain().
+ *
+ * @return The buffer, or NULL if the packet owns its sample data.
+ *
+ * @private
+ */
+SR_PRIV struct sr_buffer *sr_packet_buffer(const struct sr_datafeed_packet *packet)
+{
+	return ((const struct packet_copy *)packet)->buffer;
+}
+
+/**
+ * Free a packet created by sr_packet_copy() or sr_packet_retain().
+ *
+ * @param packet The packet to free.
+ *
+ * @since 0.4.0
+ */
 SR_API void sr_packet_free(struct sr_datafeed_packet *packet)
 {
+	struct packet_copy *pc;
 	const struct sr_datafeed_meta *meta;
 	const struct sr_datafeed_logic *logic;
 	const struct sr_datafeed_analog *analog;
+	const struct sr_datafeed_logic_rle *rle;
+	const struct sr_datafeed_logic_planar *planar;
 	struct sr_config *src;
 	GSList *l;
 
+	pc = (struct packet_copy *)packet;
+
 	switch (packet->type) {
 	case SR_DF_TRIGGER:
 	case SR_DF_END:
+	case SR_DF_FRAME_BEGIN:
+	case SR_DF_FRAME_END:
 		/* No payload. */
 		break;
 	case SR_DF_HEADER:
@@ -1587,22 +2199,40 @@ SR_API void sr_packet_free(struct sr_datafeed_packet *packet)
 		break;
 	case SR_DF_LOGIC:
 		logic = packet->payload;
-		g_free(logic->data);
+		if (pc->buffer)
+			sr_buffer_unref(pc->buffer);
+		else
+			g_free(logic->data);
 		g_free((void *)packet->payload);
 		break;
 	case SR_DF_ANALOG:
 		analog = packet->payload;
-		g_free(analog->data);
+		if (pc->buffer)
+			sr_buffer_unref(pc->buffer);
+		else
+			g_free(analog->data);
 		g_free(analog->encoding);
 		g_slist_free(analog->meaning->channels);
 		g_free(analog->meaning);
 		g_free(analog->spec);
 		g_free((void *)packet->payload);
 		break;
+	case SR_DF_LOGIC_RLE:
+		rle = packet->payload;
+		g_free(rle->values);
+		g_free(rle->lengths);
+		g_free((void *)packet->payload);
+		break;
+	case SR_DF_LOGIC_PLANAR:
+		planar = packet->payload;
+		g_free(planar->channels);
+		g_free(planar->data);
+		g_free((void *)packet->payload);
+		break;
 	default:
 		sr_err("Unknown packet type %d", packet->type);
 	}
-	g_free(packet);
+	g_free(pc);
 }
 
 /** @} */
@@ -0,0 +1,309 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2026 The sigrok developers
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <glib.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+
+/** @cond PRIVATE */
+#define LOG_PREFIX "session"
+/** @endcond */
+
+/**
+ * @file
+ *
+ * Asynchronous delivery of datafeed packets.
+ *
+ * Packets sent to the session bus are copied into a bounded ring after
+ * the transforms ran, and a dedicated thread passes them on to the
+ * datafeed callbacks. Sample data in reference counted buffers is not
+ * copied, see sr_packet_retain().
+ *
+ * The ring has a single producer (the thread running the session) and
+ * a single consumer (the dispatch thread). Both sides only touch the
+ * mutex and condition when the ring runs full or empty, respectively.
+ */
+
+struct dispatch_item {
+	const struct sr_dev_inst *sdi;
+	struct sr_datafeed_packet *packet;
+};
+
+struct sr_dispatch {
+	struct sr_session *session;
+	GThread *thread;
+	struct dispatch_item *ring;
+	/* Ring size is a power of two, at least depth. */
+	guint mask;
+	guint depth;
+	/* Free running indices, only ever advanced by consumer/producer. */
+	gint head;
+	gint tail;
+	/* Set while either side sleeps on the condition. */
+	gint consumer_waiting;
+	gint producer_waiting;
+	gint quit;
+	/* Set after an overflow with SR_DISPATCH_ABORT. */
+	gboolean aborted;
+	GMutex mutex;
+	GCond cond;
+};
+
+static guint ring_fill(struct sr_dispatch *d)
+{
+	return (guint)g_atomic_int_get(&d->tail) - (guint)g_atomic_int_get(&d->head);
+}
+
+static void wake(struct sr_dispatch *d, gint *waiting)
+{
+	if (!g_atomic_int_get(waiting))
+		return;
+
+	g_mutex_lock(&d->mutex);
+	g_cond_broadcast(&d->cond);
+	g_mutex_unlock(&d->mutex);
+}
+
+static gpointer dispatch_thread(gpointer data)
+{
+	struct sr_dispatch *d;
+	struct dispatch_item *item;
+	guint head;
+	gboolean quit;
+
+	d = data;
+
+	for (;;) {
+		head = g_atomic_int_get(&d->head);
+		if (head != (guint)g_atomic_int_get(&d->tail)) {
+			item = &d->ring[head & d->mask];
+			sr_session_datafeed_run(item->sdi, item->packet,
+				sr_packet_buffer(item->packet));
+			sr_packet_free(item->packet);
+			g_atomic_int_set(&d->head, head + 1);
+			wake(d, &d->producer_waiting);
+			continue;
+		}
+
+		/* All items are pushed before quit gets set. */
+		quit = g_atomic_int_get(&d->quit);
+		if (quit && head == (guint)g_atomic_int_get(&d->tail))
+			break;
+		if (quit)
+			continue;
+
+		g_mutex_lock(&d->mutex);
+		g_atomic_int_set(&d->consumer_waiting, 1);
+		while (head == (guint)g_atomic_int_get(&d->tail) &&
+				!g_atomic_int_get(&d->quit))
+			g_cond_wait(&d->cond, &d->mutex);
+		g_atomic_int_set(&d->consumer_waiting, 0);
+		g_mutex_unlock(&d->mutex);
+	}
+
+	return NULL;
+}
+
+static gboolean abort_session(gpointer data)
+{
+	sr_session_stop(data);
+
+	return G_SOURCE_REMOVE;
+}
+
+/*
+ * Stopping the session right away would re-enter the driver which is
+ * currently sending, defer that to the session's main loop instead.
+ */
+static void schedule_abort(struct sr_session *session)
+{
+	GSource *source;
+
+	g_mutex_lock(&session->main_mutex);
+	if (session->main_context) {
+		source = g_idle_source_new();
+		g_source_set_callback(source, abort_session, session, NULL);
+		g_source_attach(source, session->main_context);
+		g_source_unref(source);
+	}
+	g_mutex_unlock(&session->main_mutex);
+}
+
+/**
+ * Start the dispatch thread of a session.
+ *
+ * @param session The session. Must not be NULL.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_MALLOC Memory allocation failure.
+ * @retval SR_ERR Thread creation failure.
+ *
+ * @private
+ */
+SR_PRIV int sr_session_dispatch_start(struct sr_session *session)
+{
+	struct sr_dispatch *d;
+	GError *error;
+	guint size;
+
+	session->dispatch_high_water = 0;
+	session->dispatch_dropped = 0;
+
+	d = g_malloc0(sizeof(*d));
+	d->session = session;
+	d->depth = session->dispatch_depth;
+	size = 1;
+	while (size < d->depth)
+		size <<= 1;
+	d->mask = size - 1;
+	d->ring = g_try_malloc(size * sizeof(*d->ring));
+	if (!d->ring) {
+		sr_err("Dispatch queue malloc failed.");
+		g_free(d);
+		return SR_ERR_MALLOC;
+	}
+	g_mutex_init(&d->mutex);
+	g_cond_init(&d->cond);
+
+	error = NULL;
+	d->thread = g_thread_try_new("sr-dispatch", dispatch_thread, d, &error);
+	if (!d->thread) {
+		sr_err("Failed to create dispatch thread: %s.", error->message);
+		g_error_free(error);
+		g_cond_clear(&d->cond);
+		g_mutex_clear(&d->mutex);
+		g_free(d->ring);
+		g_free(d);
+		return SR_ERR;
+	}
+
+	sr_dbg("Dispatching datafeed asynchronously, queue depth %u.", d->depth);
+	session->dispatch = d;
+
+	return SR_OK;
+}
+
+/**
+ * Deliver all queued packets and stop the dispatch thread of a session.
+ *
+ * Does nothing if the session dispatches packets synchronously.
+ *
+ * @param session The session. Must not be NULL.
+ *
+ * @private
+ */
+SR_PRIV void sr_session_dispatch_stop(struct sr_session *session)
+{
+	struct sr_dispatch *d;
+
+	if (!(d = session->dispatch))
+		return;
+
+	g_atomic_int_set(&d->quit, 1);
+	g_mutex_lock(&d->mutex);
+	g_cond_broadcast(&d->cond);
+	g_mutex_unlock(&d->mutex);
+	g_thread_join(d->thread);
+	session->dispatch = NULL;
+
+	sr_dbg("Dispatch queue high-water mark %u of %u, %" PRIu64
+		" packets dropped.", session->dispatch_high_water, d->depth,
+		session->dispatch_dropped);
+
+	g_cond_clear(&d->cond);
+	g_mutex_clear(&d->mutex);
+	g_free(d->ring);
+	g_free(d);
+}
+
+/**
+ * Queue a packet for delivery by the dispatch thread.
+ *
+ * The packet is copied, except for sample data in a buffer passed to
+ * sr_session_send_buffer().
+ *
+ * @param sdi The device instance the packet originates from.
+ * @param packet The datafeed packet.
+ *
+ * @retval SR_OK Success, or packet dropped according to the policy.
+ * @retval SR_ERR Queue overflow with SR_DISPATCH_ABORT.
+ * @retval other Packet copy failure.
+ *
+ * @private
+ */
+SR_PRIV int sr_session_dispatch_push(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet)
+{
+	struct sr_session *session;
+	struct sr_dispatch *d;
+	struct dispatch_item *item;
+	struct sr_datafeed_packet *copy;
+	gboolean is_data;
+	guint tail, fill;
+	int ret;
+
+	session = sdi->session;
+	d = session->dispatch;
+	is_data = packet->type == SR_DF_LOGIC ||
+		packet->type == SR_DF_LOGIC_RLE ||
+		packet->type == SR_DF_LOGIC_PLANAR || packet->type == SR_DF_ANALOG;
+
+	if (is_data && d->aborted) {
+		session->dispatch_dropped++;
+		return SR_ERR;
+	}
+
+	if (ring_fill(d) >= d->depth) {
+		if (is_data && session->dispatch_policy == SR_DISPATCH_DROP) {
+			session->dispatch_dropped++;
+			return SR_OK;
+		}
+		if (is_data && session->dispatch_policy == SR_DISPATCH_ABORT) {
+			sr_err("Datafeed dispatch queue overflow, stopping.");
+			session->dispatch_dropped++;
+			d->aborted = TRUE;
+			schedule_abort(session);
+			return SR_ERR;
+		}
+		g_mutex_lock(&d->mutex);
+		g_atomic_int_set(&d->producer_waiting, 1);
+		while (ring_fill(d) >= d->depth)
+			g_cond_wait(&d->cond, &d->mutex);
+		g_atomic_int_set(&d->producer_waiting, 0);
+		g_mutex_unlock(&d->mutex);
+	}
+
+	if ((ret = sr_packet_retain(packet, &copy)) != SR_OK)
+		return ret;
+
+	tail = g_atomic_int_get(&d->tail);
+	item = &d->ring[tail & d->mask];
+	item->sdi = sdi;
+	item->packet = copy;
+	g_atomic_int_set(&d->tail, tail + 1);
+
+	fill = ring_fill(d);
+	if (fill > session->dispatch_high_water)
+		session->dispatch_high_water = fill;
+
+	wake(d, &d->consumer_waiting);
+
+	return SR_OK;
+}
@@ -23,6 +23,7 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <sys/time.h>
+#include <string.h>
 #include <zip.h>
 #include <libsigrok/libsigrok.h>
 #include "libsigrok-internal.h"
@@ -34,22 +35,69 @@
 #define CHUNKSIZE (4 * 1024 * 1024)
 /** @endcond */
 
+/* Upper limit for the number of decompression threads. */
+#define MAX_READ_THREADS 8
+
 SR_PRIV struct sr_dev_driver session_driver_info;
 
+/*
+ * An archive member to stream ("logic-1", "logic-1-N", "analog-1-M-N").
+ * Members get decompressed in worker threads ahead of time, in pieces
+ * of at most CHUNKSIZE bytes, which are sent in order from the main loop.
+ */
+struct read_job {
+	zip_uint64_t index;
+	size_t size;
+	/* Byte range of the member's data within the requested samples. */
+	size_t start;
+	size_t end;
+	/* Size of each piece, a multiple of the sample size. */
+	size_t piece;
+	/* Number of the analog channel (starting at 1), 0 for logic data. */
+	int analog_channel;
+	/* Decompressed pieces (struct sr_buffer) which are yet to be sent. */
+	GQueue pieces;
+	gboolean failed;
+};
+
 struct session_vdev {
 	char *sessionfile;
 	char *capturefile;
-	struct zip *archive;
-	struct zip_file *capfile;
 	int bytes_read;
 	uint64_t samplerate;
+	uint64_t sample_offset;
+	uint64_t limit_samples;
 	int unitsize;
 	int num_logic_channels;
 	int num_analog_channels;
-	int cur_analog_channel;
 	GArray *analog_channels;
-	int cur_chunk;
 	gboolean finished;
+	struct read_job *jobs;
+	unsigned int num_jobs;
+	/* Job whose data is being sent, and the position past its start. */
+	unsigned int cur_job;
+	size_t cur_offset;
+	/* Job the next idle worker thread picks up. */
+	unsigned int next_job;
+	/* Maximum number of jobs, and of pieces, read ahead of cur_job. */
+	unsigned int readahead;
+	/* Number of pieces decompressed but not sent yet. */
+	unsigned int pieces_ahead;
+	GThread **threads;
+	unsigned int num_threads;
+	gboolean quit;
+	GMutex mutex;
+	GCond cond;
+	struct sr_buffer_pool *pool;
+	/* Main context to wake up when a piece is ready. */
+	GMainContext *main_context;
+};
+
+/* Event source which fires when the next piece can be sent. */
+struct read_source {
+	GSource base;
+	struct sr_session *session;
+	struct session_vdev *vdev;
 };
 
 static const uint32_t devopts[] = {
@@ -59,98 +107,450 @@ static const uint32_t devopts[] = {
 	SR_CONF_NUM_ANALOG_CHANNELS | SR_CONF_SET,
 	SR_CONF_SAMPLERATE | SR_CONF_GET | SR_CONF_SET,
 	SR_CONF_SESSIONFILE | SR_CONF_SET,
+	SR_CONF_LIMIT_SAMPLES | SR_CONF_GET | SR_CONF_SET,
+	SR_CONF_SAMPLE_OFFSET | SR_CONF_GET | SR_CONF_SET,
 };
 
+/*
+ * Check which part of a member starting at sample first_sample lies
+ * within the requested samples, and set the job's byte range to it.
+ */
+static gboolean job_window(const struct session_vdev *vdev,
+		struct read_job *job, uint64_t first_sample,
+		uint64_t num_samples, size_t itemsize)
+{
+	uint64_t start, end;
+
+	start = MAX(vdev->sample_offset, first_sample);
+	end = first_sample + num_samples;
+	if (vdev->limit_samples &&
+			vdev->limit_samples < G_MAXUINT64 - vdev->sample_offset)
+		end = MIN(end, vdev->sample_offset + vdev->limit_samples);
+	if (start >= end)
+		return FALSE;
+
+	job->start = (start - first_sample) * itemsize;
+	job->end = (end - first_sample) * itemsize;
+
+	return TRUE;
+}
+
+/* The sample following the last requested one, or 0 if unlimited. */
+static uint64_t window_end(const struct session_vdev *vdev)
+{
+	if (!vdev->limit_samples ||
+			vdev->limit_samples >= G_MAXUINT64 - vdev->sample_offset)
+		return 0;
+
+	return vdev->sample_offset + vdev->limit_samples;
+}
+
+/*
+ * Queue the chunks listed in the session file's index: The metadata
+ * keys "index logic-1", "index analog-1-M" and so on hold the number
+ * of samples in each chunk. Only the chunks which hold requested
+ * samples get looked up in the archive.
+ */
+static int add_indexed_jobs(const struct session_vdev *vdev,
+		struct zip *archive, GKeyFile *meta, GArray *jobs,
+		const char *basename, struct read_job *job, size_t itemsize)
+{
+	struct zip_stat zs;
+	char name[128], *key, **counts;
+	gsize num_counts, i;
+	uint64_t pos, num_samples, last;
+	int ret;
+
+	key = g_strdup_printf("index %s", basename);
+	counts = g_key_file_get_string_list(meta, "device 1", key,
+		&num_counts, NULL);
+	g_free(key);
+	if (!counts)
+		return SR_ERR_NA;
+
+	ret = SR_OK;
+	pos = 0;
+	last = window_end(vdev);
+	for (i = 0; i < num_counts && (!last || pos < last); i++) {
+		num_samples = g_ascii_strtoull(counts[i], NULL, 10);
+		if (job_window(vdev, job, pos, num_samples, itemsize)) {
+			snprintf(name, sizeof(name), "%s-%" G_GSIZE_FORMAT,
+				basename, i + 1);
+			if (zip_stat(archive, name, 0, &zs) == -1 ||
+					zs.size != num_samples * itemsize) {
+				ret = SR_ERR_DATA;
+				break;
+			}
+			job->index = zs.index;
+			job->size = zs.size;
+			g_array_append_val(jobs, *job);
+		}
+		pos += num_samples;
+	}
+	g_strfreev(counts);
+
+	return ret;
+}
+
+/*
+ * Queue the members for one stream of sample data: Either a single
+ * unchunked member, or "<basename>-1", "<basename>-2", and so on.
+ * Members outside of the requested samples are skipped.
+ */
+static int add_jobs(const struct session_vdev *vdev, struct zip *archive,
+		GKeyFile *meta, GArray *jobs, const char *basename,
+		int analog_channel)
+{
+	struct read_job job;
+	struct zip_stat zs;
+	char name[128];
+	uint64_t pos, last;
+	size_t itemsize;
+	guint num_jobs;
+	int chunk, ret;
+
+	memset(&job, 0, sizeof(job));
+	job.analog_channel = analog_channel;
+	itemsize = analog_channel ? sizeof(float) : (size_t)vdev->unitsize;
+	if (!itemsize) {
+		sr_warn("Unknown unit size, ignoring '%s'.", basename);
+		return SR_OK;
+	}
+	job.piece = CHUNKSIZE / itemsize * itemsize;
+
+	if (zip_stat(archive, basename, 0, &zs) != -1) {
+		job.index = zs.index;
+		job.size = zs.size;
+		if (job_window(vdev, &job, 0, zs.size / itemsize, itemsize))
+			g_array_append_val(jobs, job);
+		return SR_OK;
+	}
+
+	num_jobs = jobs->len;
+	if (meta) {
+		ret = add_indexed_jobs(vdev, archive, meta, jobs, basename,
+			&job, itemsize);
+		if (ret == SR_OK)
+			return SR_OK;
+		if (ret != SR_ERR_NA) {
+			sr_warn("Chunk index of '%s' doesn't match the "
+				"archive, ignoring it.", basename);
+			g_array_set_size(jobs, num_jobs);
+		}
+	}
+
+	/* No index, the chunk sizes tell where each chunk starts. */
+	pos = 0;
+	last = window_end(vdev);
+	for (chunk = 1; !last || pos < last; chunk++) {
+		snprintf(name, sizeof(name), "%s-%d", basename, chunk);
+		if (zip_stat(archive, name, 0, &zs) == -1)
+			break;
+		job.index = zs.index;
+		job.size = zs.size;
+		if (job_window(vdev, &job, pos, zs.size / itemsize, itemsize))
+			g_array_append_val(jobs, job);
+		pos += zs.size / itemsize;
+	}
+
+	return (chunk > 1) ? SR_OK : SR_ERR;
+}
+
+/* Wake up the main loop when the state of the current job changed. */
+static void wake_main_loop(struct session_vdev *vdev)
+{
+	if (vdev->main_context)
+		g_main_context_wakeup(vdev->main_context);
+}
+
+/*
+ * Bound the memory used for reading ahead: The member which is being
+ * sent must never wait for the ones behind it, but needn't get more
+ * than one piece ahead of the main loop either.
+ */
+static gboolean may_read_piece(const struct session_vdev *vdev,
+		const struct read_job *job)
+{
+	if (job == &vdev->jobs[vdev->cur_job])
+		return g_queue_get_length((GQueue *)&job->pieces) < 2;
+
+	return vdev->pieces_ahead < vdev->readahead;
+}
+
+/* Read exactly len bytes of an archive member. */
+static gboolean read_exact(struct zip_file *zf, uint8_t *data, size_t len)
+{
+	zip_int64_t ret;
+	size_t done;
+
+	done = 0;
+	while (done < len && (ret = zip_fread(zf, data + done, len - done)) > 0)
+		done += ret;
+
+	return done == len;
+}
+
+/* Decompress an archive member, and queue its data piece by piece. */
+static gboolean read_member(struct session_vdev *vdev, struct zip *archive,
+		struct read_job *job)
+{
+	struct zip_file *zf;
+	struct sr_buffer *buf;
+	size_t pos, len;
+	gboolean ok, quit;
+
+	if (!archive)
+		return FALSE;
+
+	if (!(zf = zip_fopen_index(archive, job->index, 0))) {
+		sr_err("Failed to open capture file member %" PRIu64 ": %s.",
+			(uint64_t)job->index, zip_strerror(archive));
+		return FALSE;
+	}
+
+	/* Data before the requested samples gets decompressed and dropped. */
+	ok = TRUE;
+	pos = 0;
+	if (job->start > 0) {
+		if (!(buf = sr_buffer_pool_get(vdev->pool)))
+			ok = FALSE;
+		while (ok && pos < job->start) {
+			len = MIN(job->start - pos, CHUNKSIZE);
+			ok = read_exact(zf, sr_buffer_data(buf), len);
+			pos += len;
+		}
+		sr_buffer_unref(buf);
+	}
+
+	/* Data past the requested samples needn't be decompressed. */
+	while (ok && pos < job->end) {
+		g_mutex_lock(&vdev->mutex);
+		while (!vdev->quit && !may_read_piece(vdev, job))
+			g_cond_wait(&vdev->cond, &vdev->mutex);
+		quit = vdev->quit;
+		g_mutex_unlock(&vdev->mutex);
+		if (quit)
+			break;
+
+		if (!(buf = sr_buffer_pool_get(vdev->pool))) {
+			ok = FALSE;
+			break;
+		}
+		len = MIN(job->piece, job->end - pos);
+		if (!(ok = read_exact(zf, sr_buffer_data(buf), len))) {
+			sr_buffer_unref(buf);
+			break;
+		}
+		pos += len;
+
+		g_mutex_lock(&vdev->mutex);
+		g_queue_push_tail(&job->pieces, buf);
+		vdev->pieces_ahead++;
+		wake_main_loop(vdev);
+		g_mutex_unlock(&vdev->mutex);
+	}
+	zip_fclose(zf);
+
+	if (!ok)
+		sr_err("Short read of capture file member %" PRIu64 ".",
+			(uint64_t)job->index);
+
+	return ok;
+}
+
+/*
+ * libzip archive handles must not be shared across threads, each
+ * worker opens the session file for itself.
+ */
+static gpointer read_thread(gpointer data)
+{
+	struct session_vdev *vdev;
+	struct zip *archive;
+	struct read_job *job;
+	gboolean ok;
+	int ret;
+
+	vdev = data;
+
+	if (!(archive = zip_open(vdev->sessionfile, 0, &ret)))
+		sr_err("Failed to open session file '%s': "
+		       "zip error %d.", vdev->sessionfile, ret);
+
+	for (;;) {
+		g_mutex_lock(&vdev->mutex);
+		while (!vdev->quit && vdev->next_job < vdev->num_jobs &&
+				vdev->next_job - vdev->cur_job >= vdev->readahead)
+			g_cond_wait(&vdev->cond, &vdev->mutex);
+		if (vdev->quit || vdev->next_job >= vdev->num_jobs) {
+			g_mutex_unlock(&vdev->mutex);
+			break;
+		}
+		job = &vdev->jobs[vdev->next_job++];
+		g_mutex_unlock(&vdev->mutex);
+
+		ok = read_member(vdev, archive, job);
+
+		g_mutex_lock(&vdev->mutex);
+		job->failed = !ok;
+		wake_main_loop(vdev);
+		g_mutex_unlock(&vdev->mutex);
+	}
+
+	if (archive)
+		zip_discard(archive);
+
+	return NULL;
+}
+
+static int reader_start(struct session_vdev *vdev, struct zip *archive)
+{
+	GArray *jobs;
+	GError *error;
+	GKeyFile *meta;
+	struct zip_stat zs;
+	char *basename;
+	unsigned int i, num_threads;
+	int ret;
+
+	meta = NULL;
+	if (zip_stat(archive, "metadata", 0, &zs) != -1)
+		meta = sr_sessionfile_read_metadata(archive, &zs);
+
+	/* Logic data comes first, followed by each analog channel. */
+	jobs = g_array_new(FALSE, FALSE, sizeof(struct read_job));
+	ret = SR_OK;
+	if (vdev->capturefile) {
+		ret = add_jobs(vdev, archive, meta, jobs, vdev->capturefile, 0);
+		if (ret != SR_OK)
+			sr_err("No capture file '%s' in session file '%s'.",
+				vdev->capturefile, vdev->sessionfile);
+	}
+	for (i = 0; ret == SR_OK && i < (unsigned int)vdev->num_analog_channels; i++) {
+		basename = g_strdup_printf("analog-1-%d",
+			vdev->num_logic_channels + i + 1);
+		ret = add_jobs(vdev, archive, meta, jobs, basename, i + 1);
+		if (ret != SR_OK)
+			sr_err("No capture file '%s' in session file '%s'.",
+				basename, vdev->sessionfile);
+		g_free(basename);
+	}
+	if (meta)
+		g_key_file_free(meta);
+	vdev->num_jobs = jobs->len;
+	vdev->jobs = (struct read_job *)g_array_free(jobs, FALSE);
+	vdev->cur_job = 0;
+	vdev->cur_offset = 0;
+	vdev->next_job = 0;
+	vdev->pieces_ahead = 0;
+	vdev->quit = FALSE;
+
+#if GLIB_CHECK_VERSION(2, 36, 0)
+	num_threads = g_get_num_processors();
+#else
+	num_threads = 2;
+#endif
+	num_threads = CLAMP(num_threads, 1, MAX_READ_THREADS);
+	num_threads = MIN(num_threads, MAX(vdev->num_jobs, 1));
+	vdev->readahead = 2 * num_threads;
+	vdev->pool = sr_buffer_pool_new(CHUNKSIZE, vdev->readahead + 3);
+	g_mutex_init(&vdev->mutex);
+	g_cond_init(&vdev->cond);
+
+	vdev->threads = g_malloc0(num_threads * sizeof(GThread *));
+	vdev->num_threads = 0;
+	for (i = 0; i < num_threads; i++) {
+		error = NULL;
+		vdev->threads[i] = g_thread_try_new("sr-session-read",
+			read_thread, vdev, &error);
+		if (!vdev->threads[i]) {
+			sr_warn("Failed to create read thread: %s.", error->message);
+			g_error_free(error);
+			break;
+		}
+		vdev->num_threads++;
+	}
+	if (!vdev->num_threads)
+		return SR_ERR;
+
+	sr_dbg("Reading %u capture file members with %u threads.",
+		vdev->num_jobs, vdev->num_threads);
+
+	return SR_OK;
+}
+
+static void reader_stop(struct session_vdev *vdev)
+{
+	struct sr_buffer *buf;
+	unsigned int i;
+
+	if (!vdev->threads)
+		return;
+
+	g_mutex_lock(&vdev->mutex);
+	vdev->quit = TRUE;
+	g_cond_broadcast(&vdev->cond);
+	g_mutex_unlock(&vdev->mutex);
+	for (i = 0; i < vdev->num_threads; i++)
+		g_thread_join(vdev->threads[i]);
+	g_free(vdev->threads);
+	vdev->threads = NULL;
+
+	for (i = 0; i < vdev->num_jobs; i++) {
+		while ((buf = g_queue_pop_head(&vdev->jobs[i].pieces)))
+			sr_buffer_unref(buf);
+	}
+	g_free(vdev->jobs);
+	vdev->jobs = NULL;
+	vdev->num_jobs = 0;
+	sr_buffer_pool_free(vdev->pool);
+	vdev->pool = NULL;
+	if (vdev->main_context)
+		g_main_context_unref(vdev->main_context);
+	vdev->main_context = NULL;
+	g_cond_clear(&vdev->cond);
+	g_mutex_clear(&vdev->mutex);
+}
+
 static gboolean stream_session_data(struct sr_dev_inst *sdi)
 {
 	struct session_vdev *vdev;
+	struct read_job *job;
 	struct sr_datafeed_packet packet;
 	struct sr_datafeed_logic logic;
 	struct sr_datafeed_analog analog;
 	struct sr_analog_encoding encoding;
 	struct sr_analog_meaning meaning;
 	struct sr_analog_spec spec;
-	struct zip_stat zs;
-	int ret, got_data;
-	char capturefile[128];
-	void *buf;
+	struct sr_buffer *piece;
+	gboolean failed, got_data;
+	size_t len;
+	uint8_t *buf;
 
 	got_data = FALSE;
 	vdev = sdi->priv;
 
-	if (!vdev->capfile) {
-		/* No capture file opened yet, or finished with the last
-		 * chunked one. */
-		if (vdev->capturefile && (vdev->cur_chunk == 0)) {
-			/* capturefile is always the unchunked base name. */
-			if (zip_stat(vdev->archive, vdev->capturefile, 0, &zs) != -1) {
-				/* No chunks, just a single capture file. */
-				vdev->cur_chunk = 0;
-				if (!(vdev->capfile = zip_fopen(vdev->archive,
-						vdev->capturefile, 0)))
-					return FALSE;
-				sr_dbg("Opened %s.", vdev->capturefile);
-			} else {
-				/* Try as first chunk filename. */
-				snprintf(capturefile, sizeof(capturefile) - 1, "%s-1", vdev->capturefile);
-				if (zip_stat(vdev->archive, capturefile, 0, &zs) != -1) {
-					vdev->cur_chunk = 1;
-					if (!(vdev->capfile = zip_fopen(vdev->archive,
-							capturefile, 0)))
-						return FALSE;
-					sr_dbg("Opened %s.", capturefile);
-				} else {
-					sr_err("No capture file '%s' in " "session file '%s'.",
-							vdev->capturefile, vdev->sessionfile);
-					return FALSE;
-				}
-			}
-		} else {
-			/* Capture data is chunked, advance to the next chunk. */
-			vdev->cur_chunk++;
-			snprintf(capturefile, sizeof(capturefile) - 1, "%s-%d", vdev->capturefile,
-					vdev->cur_chunk);
-			if (zip_stat(vdev->archive, capturefile, 0, &zs) != -1) {
-				if (!(vdev->capfile = zip_fopen(vdev->archive,
-						capturefile, 0)))
-					return FALSE;
-				sr_dbg("Opened %s.", capturefile);
-			} else if (vdev->cur_analog_channel < vdev->num_analog_channels) {
-				vdev->capturefile = g_strdup_printf("analog-1-%d",
-						vdev->num_logic_channels + vdev->cur_analog_channel + 1);
-				vdev->cur_analog_channel++;
-				vdev->cur_chunk = 0;
-				return TRUE;
-			} else {
-				/* We got all the chunks, finish up. */
-				g_free(vdev->capturefile);
-
-				/* If the file has logic channels, the initial value for
-				 * capturefile is set by stream_session_data() - however only
-				 * once. In order to not mess this mechanism up, we simulate
-				 * this here if needed. For purely analog files, capturefile
-				 * is not set.
-				 */
-				if (vdev->num_logic_channels)
-					vdev->capturefile = g_strdup("logic-1");
-				else
-					vdev->capturefile = NULL;
-				return FALSE;
-			}
-		}
+	if (vdev->cur_job >= vdev->num_jobs)
+		return FALSE;
+	job = &vdev->jobs[vdev->cur_job];
+
+	g_mutex_lock(&vdev->mutex);
+	if ((piece = g_queue_pop_head(&job->pieces))) {
+		vdev->pieces_ahead--;
+		g_cond_broadcast(&vdev->cond);
 	}
+	failed = job->failed;
+	g_mutex_unlock(&vdev->mutex);
 
-	buf = g_malloc(CHUNKSIZE);
+	/* Still being read, the event source fires again once it is ready. */
+	if (!piece)
+		return !failed;
 
-	/* unitsize is not defined for purely analog session files. */
-	if (vdev->unitsize)
-		ret = zip_fread(vdev->capfile, buf,
-				CHUNKSIZE / vdev->unitsize * vdev->unitsize);
-	else
-		ret = zip_fread(vdev->capfile, buf, CHUNKSIZE);
+	/* Each piece gets sent in a packet of its own. */
+	len = MIN(job->piece, job->end - job->start - vdev->cur_offset);
+	buf = sr_buffer_data(piece);
 
-	if (ret > 0) {
-		if (vdev->cur_analog_channel != 0) {
+	if (len > 0) {
+		if (job->analog_channel != 0) {
 			got_data = TRUE;
 			packet.type = SR_DF_ANALOG;
 			packet.payload = &analog;
@@ -158,20 +558,20 @@ static gboolean stream_session_data(struct sr_dev_inst *sdi)
 			sr_analog_init(&analog, &encoding, &meaning, &spec, 2);
 			analog.meaning->channels = g_slist_prepend(NULL,
 					g_array_index(vdev->analog_channels,
-						struct sr_channel *, vdev->cur_analog_channel - 1));
-			analog.num_samples = ret / sizeof(float);
+						struct sr_channel *, job->analog_channel - 1));
+			analog.num_samples = len / sizeof(float);
 			analog.meaning->mq = SR_MQ_VOLTAGE;
 			analog.meaning->unit = SR_UNIT_VOLT;
 			analog.meaning->mqflags = SR_MQFLAG_DC;
 			analog.data = (float *) buf;
 		} else if (vdev->unitsize) {
 			got_data = TRUE;
-			if (ret % vdev->unitsize != 0)
-				sr_warn("Read size %d not a multiple of the"
-					" unit size %d.", ret, vdev->unitsize);
+			if (len % vdev->unitsize != 0)
+				sr_warn("Read size %zu not a multiple of the"
+					" unit size %d.", len, vdev->unitsize);
 			packet.type = SR_DF_LOGIC;
 			packet.payload = &logic;
-			logic.length = ret;
+			logic.length = len;
 			logic.unitsize = vdev->unitsize;
 			logic.data = buf;
 		} else {
@@ -182,22 +582,25 @@ static gboolean stream_session_data(struct sr_dev_inst *sdi)
 			sr_warn("Neither analog nor logic data. Ignoring.");
 		}
 		if (got_data) {
-			vdev->bytes_read += ret;
-			sr_session_send(sdi, &packet);
-		}
-	} else {
-		/* done with this capture file */
-		zip_fclose(vdev->capfile);
-		vdev->capfile = NULL;
-		if (vdev->cur_chunk != 0) {
-			/* There might be more chunks, so don't fall through
-			 * to the SR_DF_END here. */
-			got_data = TRUE;
+			vdev->bytes_read += len;
+			sr_session_send_buffer(sdi, &packet, piece);
 		}
+		if (job->analog_channel != 0)
+			g_slist_free(analog.meaning->channels);
+		vdev->cur_offset += len;
+	}
+	sr_buffer_unref(piece);
+
+	/* Done with this member, let the workers read further ahead. */
+	if (vdev->cur_offset >= job->end - job->start) {
+		g_mutex_lock(&vdev->mutex);
+		vdev->cur_job++;
+		vdev->cur_offset = 0;
+		g_cond_broadcast(&vdev->cond);
+		g_mutex_unlock(&vdev->mutex);
 	}
-	g_free(buf);
 
-	return got_data;
+	return TRUE;
 }
 
 static int receive_data(int fd, int revents, void *cb_data)
@@ -216,20 +619,109 @@ static int receive_data(int fd, int revents, void *cb_data)
 	if (!vdev->finished)
 		return G_SOURCE_CONTINUE;
 
-	if (vdev->capfile) {
-		zip_fclose(vdev->capfile);
-		vdev->capfile = NULL;
-	}
-	if (vdev->archive) {
-		zip_discard(vdev->archive);
-		vdev->archive = NULL;
-	}
+	reader_stop(vdev);
 
 	std_session_send_df_end(sdi);
 
 	return G_SOURCE_REMOVE;
 }
 
+/* Whether receive_data() can make progress without blocking. */
+static gboolean read_source_ready(struct session_vdev *vdev)
+{
+	struct read_job *job;
+	gboolean ready;
+
+	if (vdev->finished || vdev->cur_job >= vdev->num_jobs)
+		return TRUE;
+
+	job = &vdev->jobs[vdev->cur_job];
+	g_mutex_lock(&vdev->mutex);
+	ready = !g_queue_is_empty(&job->pieces) || job->failed;
+	g_mutex_unlock(&vdev->mutex);
+
+	return ready;
+}
+
+/** Read event source prepare() method.
+ */
+static gboolean read_source_prepare(GSource *source, int *timeout)
+{
+	*timeout = -1;
+
+	return read_source_ready(((struct read_source *)source)->vdev);
+}
+
+/** Read event source check() method.
+ */
+static gboolean read_source_check(GSource *source)
+{
+	return read_source_ready(((struct read_source *)source)->vdev);
+}
+
+/** Read event source dispatch() method.
+ */
+static gboolean read_source_dispatch(GSource *source,
+		GSourceFunc callback, void *user_data)
+{
+	(void)source;
+
+	if (!callback) {
+		sr_err("Callback not set, cannot dispatch event.");
+		return G_SOURCE_REMOVE;
+	}
+
+	return (*SR_RECEIVE_DATA_CALLBACK(callback))(-1, G_IO_IN, user_data);
+}
+
+/** Read event source finalize() method.
+ */
+static void read_source_finalize(GSource *source)
+{
+	struct read_source *rsource;
+
+	rsource = (struct read_source *)source;
+	sr_session_source_destroyed(rsource->session, rsource->vdev, source);
+}
+
+/*
+ * Have receive_data() run whenever the worker threads have decompressed
+ * the next piece, instead of polling for it from the main loop.
+ */
+static int read_source_add(const struct sr_dev_inst *sdi)
+{
+	static GSourceFuncs read_source_funcs = {
+		.prepare  = &read_source_prepare,
+		.check    = &read_source_check,
+		.dispatch = &read_source_dispatch,
+		.finalize = &read_source_finalize
+	};
+	GSource *source;
+	struct read_source *rsource;
+	struct session_vdev *vdev;
+	GMainContext *main_context;
+	int ret;
+
+	vdev = sdi->priv;
+	source = g_source_new(&read_source_funcs, sizeof(struct read_source));
+	rsource = (struct read_source *)source;
+	g_source_set_name(source, "session-read");
+	rsource->session = sdi->session;
+	rsource->vdev = vdev;
+	g_source_set_callback(source, G_SOURCE_FUNC(receive_data),
+		(void *)sdi, NULL);
+
+	ret = sr_session_source_add_internal(sdi->session, vdev, source);
+	if (ret == SR_OK && (main_context = g_source_get_context(source))) {
+		g_mutex_lock(&vdev->mutex);
+		vdev->main_context = g_main_context_ref(main_context);
+		g_mutex_unlock(&vdev->mutex);
+	}
+	g_source_unref(source);
+
+	return ret;
+}
+
 /* driver callbacks */
 
 static int dev_open(struct sr_dev_inst *sdi)
@@ -249,7 +741,10 @@ static int dev_open(struct sr_dev_inst *sdi)
 
 static int dev_close(struct sr_dev_inst *sdi)
 {
-	const struct session_vdev *const vdev = sdi->priv;
+	struct session_vdev *vdev;
+
+	vdev = sdi->priv;
+	reader_stop(vdev);
 	g_free(vdev->sessionfile);
 	g_free(vdev->capturefile);
 
@@ -278,6 +773,12 @@ static int config_get(uint32_t key, GVariant **data,
 	case SR_CONF_CAPTURE_UNITSIZE:
 		*data = g_variant_new_uint64(vdev->unitsize);
 		break;
+	case SR_CONF_LIMIT_SAMPLES:
+		*data = g_variant_new_uint64(vdev->limit_samples);
+		break;
+	case SR_CONF_SAMPLE_OFFSET:
+		*data = g_variant_new_uint64(vdev->sample_offset);
+		break;
 	default:
 		return SR_ERR_NA;
 	}
@@ -318,6 +819,12 @@ static int config_set(uint32_t key, GVariant *data,
 	case SR_CONF_NUM_ANALOG_CHANNELS:
 		vdev->num_analog_channels = g_variant_get_int32(data);
 		break;
+	case SR_CONF_LIMIT_SAMPLES:
+		vdev->limit_samples = g_variant_get_uint64(data);
+		break;
+	case SR_CONF_SAMPLE_OFFSET:
+		vdev->sample_offset = g_variant_get_uint64(data);
+		break;
 	default:
 		return SR_ERR_NA;
 	}
@@ -334,13 +841,13 @@ static int config_list(uint32_t key, GVariant **data,
 static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 {
 	struct session_vdev *vdev;
+	struct zip *archive;
 	int ret;
 	GSList *l;
 	struct sr_channel *ch;
 
 	vdev = sdi->priv;
 	vdev->bytes_read = 0;
-	vdev->cur_analog_channel = 0;
 	vdev->analog_channels = g_array_sized_new(FALSE, FALSE,
 			sizeof(struct sr_channel *), vdev->num_analog_channels);
 	for (l = sdi->channels; l; l = l->next) {
@@ -348,22 +855,29 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 		if (ch->type == SR_CHANNEL_ANALOG)
 			g_array_append_val(vdev->analog_channels, ch);
 	}
-	vdev->cur_chunk = 0;
 	vdev->finished = FALSE;
 
 	sr_info("Opening archive %s file %s", vdev->sessionfile,
 		vdev->capturefile);
 
-	if (!(vdev->archive = zip_open(vdev->sessionfile, 0, &ret))) {
+	if (!(archive = zip_open(vdev->sessionfile, 0, &ret))) {
 		sr_err("Failed to open session file '%s': "
 		       "zip error %d.", vdev->sessionfile, ret);
 		return SR_ERR;
 	}
+	ret = reader_start(vdev, archive);
+	zip_discard(archive);
+	if (ret != SR_OK) {
+		reader_stop(vdev);
+		return ret;
+	}
 
 	std_session_send_df_header(sdi);
 
-	/* freewheeling source */
-	sr_session_source_add(sdi->session, -1, 0, 0, receive_data, (void *)sdi);
+	if ((ret = read_source_add(sdi)) != SR_OK) {
+		reader_stop(vdev);
+		return ret;
+	}
 
 	return SR_OK;
 }
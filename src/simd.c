@@ -0,0 +1,95 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2026 The sigrok developers
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file
+ * Run-time detection of SIMD instruction set extensions.
+ */
+
+#include <config.h>
+#include <glib.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+
+#define LOG_PREFIX "simd"
+
+/* Marks the cached value as valid, g_once_init_leave() wants non-zero. */
+#define SIMD_DETECTED (1UL << 31)
+
+/* Extensions which may be used, see sr_simd_features_limit(). */
+static gint simd_limit = -1;
+
+/**
+ * Determine the SIMD instruction set extensions usable on this machine.
+ *
+ * Only extensions for which the library has code paths are reported.
+ * The result is determined once and cached. Setting the environment
+ * variable SIGROK_NO_SIMD disables all vectorized code paths, which
+ * is useful to compare against the portable implementations.
+ *
+ * @return A bitmask of SR_SIMD_* flags.
+ *
+ * @private
+ */
+SR_PRIV unsigned int sr_simd_features(void)
+{
+	static gsize cached;
+	unsigned int features;
+
+	if (!g_once_init_enter(&cached))
+		return cached & ~SIMD_DETECTED & (guint)g_atomic_int_get(&simd_limit);
+
+	features = 0;
+	if (!g_getenv("SIGROK_NO_SIMD")) {
+#ifdef SR_SIMD_X86
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("sse2"))
+			features |= SR_SIMD_SSE2;
+		if (__builtin_cpu_supports("avx2"))
+			features |= SR_SIMD_AVX2;
+#endif
+#ifdef SR_SIMD_ARM_NEON
+		/* NEON presence is a compile time property. */
+		features |= SR_SIMD_NEON;
+#endif
+	}
+	sr_dbg("SIMD features:%s%s%s%s.",
+		(features & SR_SIMD_SSE2) ? " SSE2" : "",
+		(features & SR_SIMD_AVX2) ? " AVX2" : "",
+		(features & SR_SIMD_NEON) ? " NEON" : "",
+		features ? "" : " none");
+	g_once_init_leave(&cached, features | SIMD_DETECTED);
+
+	return features & (guint)g_atomic_int_get(&simd_limit);
+}
+
+/**
+ * Restrict the vectorized code paths to some of the extensions which
+ * sr_simd_features() detected, so that tests can compare them against
+ * each other and against the portable code.
+ *
+ * @param features A bitmask of SR_SIMD_* flags, 0 for the portable code
+ *                 only, ~0 to lift the restriction again.
+ *
+ * @private
+ */
+SR_PRIV void sr_simd_features_limit(unsigned int features)
+{
+	g_atomic_int_set(&simd_limit, (gint)features);
+}
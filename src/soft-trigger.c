@@ -21,6 +21,9 @@
 #include <string.h>
 #include <libsigrok/libsigrok.h>
 #include "libsigrok-internal.h"
+#ifdef SR_SIMD_X86
+#include <immintrin.h>
+#endif
 
 /** @cond PRIVATE */
 #define LOG_PREFIX "soft-trigger"
@@ -41,11 +44,103 @@ SR_PRIV int logic_channel_unitsize(GSList *channels)
 	return (number + 7) / 8;
 }
 
+/*
+ * A trigger stage compiled into bit masks over the sample data. Bit n of
+ * word w corresponds to logic channel index 64 * w + n, which matches the
+ * little endian layout of logic samples. A sample matches the stage when
+ * all of the following hold:
+ * - (cur ^ level_value) & level_mask == 0
+ * - rising edges: ~prev & cur covers rise_mask
+ * - falling edges: prev & ~cur covers fall_mask
+ * - any edge: prev ^ cur covers edge_mask
+ */
+struct soft_trigger_stage {
+	uint64_t *level_mask;
+	uint64_t *level_value;
+	uint64_t *rise_mask;
+	uint64_t *fall_mask;
+	uint64_t *edge_mask;
+	gboolean has_edges;
+	gboolean never;
+	gboolean empty;
+};
+
+static void soft_trigger_compile_stage(struct soft_trigger_logic *stl,
+		struct sr_trigger_stage *tstage, struct soft_trigger_stage *stage)
+{
+	struct sr_trigger_match *match;
+	GSList *l;
+	uint64_t bit;
+	int idx, w;
+
+	stage->level_mask = g_malloc0(5 * stl->num_words * sizeof(uint64_t));
+	stage->level_value = stage->level_mask + stl->num_words;
+	stage->rise_mask = stage->level_value + stl->num_words;
+	stage->fall_mask = stage->rise_mask + stl->num_words;
+	stage->edge_mask = stage->fall_mask + stl->num_words;
+
+	/* No matches supplied, client error. */
+	stage->empty = !tstage->matches;
+
+	for (l = tstage->matches; l; l = l->next) {
+		match = l->data;
+		if (!match->channel->enabled)
+			/* Ignore disabled channels with a trigger. */
+			continue;
+		idx = match->channel->index;
+		if (match->channel->type != SR_CHANNEL_LOGIC
+				|| idx >= stl->unitsize * 8) {
+			sr_warn("Ignoring trigger on non-logic channel %s.",
+				match->channel->name);
+			continue;
+		}
+		w = idx / 64;
+		bit = UINT64_C(1) << (idx % 64);
+		switch (match->match) {
+		case SR_TRIGGER_ZERO:
+			if (stage->level_value[w] & bit)
+				/* Both levels requested at the same time. */
+				stage->never = TRUE;
+			stage->level_mask[w] |= bit;
+			break;
+		case SR_TRIGGER_ONE:
+			if ((stage->level_mask[w] & bit)
+					&& !(stage->level_value[w] & bit))
+				stage->never = TRUE;
+			stage->level_mask[w] |= bit;
+			stage->level_value[w] |= bit;
+			break;
+		case SR_TRIGGER_RISING:
+			stage->rise_mask[w] |= bit;
+			stage->has_edges = TRUE;
+			break;
+		case SR_TRIGGER_FALLING:
+			stage->fall_mask[w] |= bit;
+			stage->has_edges = TRUE;
+			break;
+		case SR_TRIGGER_EDGE:
+			stage->edge_mask[w] |= bit;
+			stage->has_edges = TRUE;
+			break;
+		default:
+			/* Analog conditions never match logic data. */
+			stage->never = TRUE;
+			break;
+		}
+	}
+	for (w = 0; w < stl->num_words; w++) {
+		if (stage->rise_mask[w] & stage->fall_mask[w])
+			stage->never = TRUE;
+	}
+}
+
 SR_PRIV struct soft_trigger_logic *soft_trigger_logic_new(
 		const struct sr_dev_inst *sdi, struct sr_trigger *trigger,
 		int pre_trigger_samples)
 {
 	struct soft_trigger_logic *stl;
+	GSList *l;
+	int i;
 
 	stl = g_malloc0(sizeof(struct soft_trigger_logic));
 	stl->sdi = sdi;
@@ -70,11 +165,23 @@ SR_PRIV struct soft_trigger_logic *soft_trigger_logic_new(
 		return NULL;
 	}
 
+	/* Compile the trigger stages into match masks. */
+	stl->num_words = (stl->unitsize + 7) / 8;
+	stl->num_stages = g_slist_length(trigger->stages);
+	stl->stages = g_malloc0(stl->num_stages * sizeof(struct soft_trigger_stage));
+	for (l = trigger->stages, i = 0; l; l = l->next, i++)
+		soft_trigger_compile_stage(stl, l->data, &stl->stages[i]);
+
 	return stl;
 }
 
 SR_PRIV void soft_trigger_logic_free(struct soft_trigger_logic *stl)
 {
+	int i;
+
+	for (i = 0; i < stl->num_stages; i++)
+		g_free(stl->stages[i].level_mask);
+	g_free(stl->stages);
 	g_free(stl->pre_trigger_buffer);
 	g_free(stl->prev_sample);
 	g_free(stl);
@@ -138,36 +245,212 @@ static void pre_trigger_send(struct soft_trigger_logic *stl,
 	}
 }
 
-static gboolean logic_check_match(struct soft_trigger_logic *stl,
-		uint8_t *sample, struct sr_trigger_match *match)
+/* Read (up to) 64 bits of a logic sample, in little endian order. */
+static inline uint64_t sample_word(const uint8_t *p, int bytes)
 {
-	int bit, prev_bit;
-	gboolean result;
-
-	stl->count++;
-	result = FALSE;
-	bit = *(sample + match->channel->index / 8)
-			& (1 << (match->channel->index % 8));
-	if (match->match == SR_TRIGGER_ZERO)
-		result = bit == 0;
-	else if (match->match == SR_TRIGGER_ONE)
-		result = bit != 0;
-	else {
-		/* Edge matches. */
-		if (stl->count == 1)
-			/* First sample, don't have enough for an edge match yet. */
+	uint64_t word;
+	int i;
+
+	switch (bytes) {
+	case 1:
+		return R8(p);
+	case 2:
+		return RL16(p);
+	case 4:
+		return RL32(p);
+	case 8:
+		return RL64(p);
+	default:
+		word = 0;
+		for (i = bytes - 1; i >= 0; i--)
+			word = (word << 8) | p[i];
+		return word;
+	}
+}
+
+/* Check a single sample against a stage, prev is NULL if unknown. */
+static gboolean stage_match(const struct soft_trigger_logic *stl,
+		const struct soft_trigger_stage *stage,
+		const uint8_t *cur, const uint8_t *prev)
+{
+	uint64_t c, p;
+	int w, bytes;
+
+	if (stage->never || (stage->has_edges && !prev))
+		return FALSE;
+
+	for (w = 0; w < stl->num_words; w++) {
+		bytes = MIN(8, stl->unitsize - 8 * w);
+		c = sample_word(cur + 8 * w, bytes);
+		if ((c ^ stage->level_value[w]) & stage->level_mask[w])
+			return FALSE;
+		if (!stage->has_edges)
+			continue;
+		p = sample_word(prev + 8 * w, bytes);
+		if ((~p & c & stage->rise_mask[w]) != stage->rise_mask[w]
+				|| (p & ~c & stage->fall_mask[w]) != stage->fall_mask[w]
+				|| ((p ^ c) & stage->edge_mask[w]) != stage->edge_mask[w])
 			return FALSE;
-		prev_bit = *(stl->prev_sample + match->channel->index / 8)
-				& (1 << (match->channel->index % 8));
-		if (match->match == SR_TRIGGER_RISING)
-			result = prev_bit == 0 && bit != 0;
-		else if (match->match == SR_TRIGGER_FALLING)
-			result = prev_bit != 0 && bit == 0;
-		else if (match->match == SR_TRIGGER_EDGE)
-			result = prev_bit != bit;
 	}
 
-	return result;
+	return TRUE;
+}
+
+/* The sample preceding sample i of buf, or NULL if there is none. */
+static const uint8_t *sample_prev(const struct soft_trigger_logic *stl,
+		const uint8_t *buf, int i)
+{
+	if (i > 0)
+		return buf + (i - 1) * stl->unitsize;
+
+	return stl->have_prev ? stl->prev_sample : NULL;
+}
+
+/* Match all samples in one go, for all single-word sample sizes. */
+#define SCAN_WORDS(load) \
+	for (; i < n; i++) { \
+		c = load(buf + i * stl->unitsize); \
+		if (!((c ^ lv) & lm) && (~p & c & rm) == rm \
+				&& (p & ~c & fm) == fm && ((p ^ c) & em) == em) \
+			return i; \
+		p = c; \
+	}
+
+#define SCAN_LOAD_ANY(q) sample_word(q, stl->unitsize)
+
+#ifdef SR_SIMD_X86
+
+/*
+ * Match 16 (unitsize 1) or 8 (unitsize 2) samples per iteration.
+ * Returns the index of the first matching sample, or the index where
+ * the scalar code should continue if there was no match.
+ */
+static SR_SIMD_TARGET_SSE2 int stage_scan_sse2(const struct soft_trigger_logic *stl,
+		const struct soft_trigger_stage *stage, const uint8_t *buf,
+		int i, int n, gboolean *found)
+{
+	__m128i lm, lv, rm, fm, em, c, p, ok;
+	int step, mask;
+
+	*found = FALSE;
+	if (stl->unitsize == 1) {
+		lm = _mm_set1_epi8((char)stage->level_mask[0]);
+		lv = _mm_set1_epi8((char)stage->level_value[0]);
+		rm = _mm_set1_epi8((char)stage->rise_mask[0]);
+		fm = _mm_set1_epi8((char)stage->fall_mask[0]);
+		em = _mm_set1_epi8((char)stage->edge_mask[0]);
+		step = 16;
+	} else {
+		lm = _mm_set1_epi16((short)stage->level_mask[0]);
+		lv = _mm_set1_epi16((short)stage->level_value[0]);
+		rm = _mm_set1_epi16((short)stage->rise_mask[0]);
+		fm = _mm_set1_epi16((short)stage->fall_mask[0]);
+		em = _mm_set1_epi16((short)stage->edge_mask[0]);
+		step = 8;
+	}
+
+	/* The previous sample is read from buf, so start at sample 1. */
+	for (i = MAX(i, 1); i + step <= n; i += step) {
+		c = _mm_loadu_si128((const __m128i *)(buf + i * stl->unitsize));
+		p = _mm_loadu_si128((const __m128i *)(buf + (i - 1) * stl->unitsize));
+		if (stl->unitsize == 1) {
+			ok = _mm_cmpeq_epi8(_mm_and_si128(c, lm), lv);
+			ok = _mm_and_si128(ok, _mm_cmpeq_epi8(_mm_and_si128(
+				_mm_andnot_si128(p, c), rm), rm));
+			ok = _mm_and_si128(ok, _mm_cmpeq_epi8(_mm_and_si128(
+				_mm_andnot_si128(c, p), fm), fm));
+			ok = _mm_and_si128(ok, _mm_cmpeq_epi8(_mm_and_si128(
+				_mm_xor_si128(p, c), em), em));
+		} else {
+			ok = _mm_cmpeq_epi16(_mm_and_si128(c, lm), lv);
+			ok = _mm_and_si128(ok, _mm_cmpeq_epi16(_mm_and_si128(
+				_mm_andnot_si128(p, c), rm), rm));
+			ok = _mm_and_si128(ok, _mm_cmpeq_epi16(_mm_and_si128(
+				_mm_andnot_si128(c, p), fm), fm));
+			ok = _mm_and_si128(ok, _mm_cmpeq_epi16(_mm_and_si128(
+				_mm_xor_si128(p, c), em), em));
+		}
+		mask = _mm_movemask_epi8(ok);
+		if (mask) {
+			*found = TRUE;
+			return i + __builtin_ctz(mask) / stl->unitsize;
+		}
+	}
+
+	return i;
+}
+
+#endif
+
+/*
+ * Find the first sample at or after index i which matches the stage.
+ * Returns its index, or -1 if there is none in the buffer.
+ */
+static int stage_scan(const struct soft_trigger_logic *stl,
+		const struct soft_trigger_stage *stage,
+		const uint8_t *buf, int i, int n)
+{
+	uint64_t c, p, lm, lv, rm, fm, em;
+#ifdef SR_SIMD_X86
+	gboolean found;
+#endif
+
+	if (stage->never)
+		return -1;
+
+	/* The very first sample uses the one from the previous buffer. */
+	if (i == 0 && n > 0) {
+		if (stage_match(stl, stage, buf, sample_prev(stl, buf, 0)))
+			return 0;
+		i = 1;
+	}
+	if (i >= n)
+		return -1;
+
+	if (stl->num_words > 1) {
+		for (; i < n; i++) {
+			if (stage_match(stl, stage, buf + i * stl->unitsize,
+					buf + (i - 1) * stl->unitsize))
+				return i;
+		}
+		return -1;
+	}
+
+#ifdef SR_SIMD_X86
+	if ((stl->unitsize == 1 || stl->unitsize == 2)
+			&& (sr_simd_features() & SR_SIMD_SSE2)) {
+		i = stage_scan_sse2(stl, stage, buf, i, n, &found);
+		if (found)
+			return i;
+	}
+#endif
+
+	lm = stage->level_mask[0];
+	lv = stage->level_value[0];
+	rm = stage->rise_mask[0];
+	fm = stage->fall_mask[0];
+	em = stage->edge_mask[0];
+	p = sample_word(buf + (i - 1) * stl->unitsize, stl->unitsize);
+
+	switch (stl->unitsize) {
+	case 1:
+		SCAN_WORDS(R8)
+		break;
+	case 2:
+		SCAN_WORDS(RL16)
+		break;
+	case 4:
+		SCAN_WORDS(RL32)
+		break;
+	case 8:
+		SCAN_WORDS(RL64)
+		break;
+	default:
+		SCAN_WORDS(SCAN_LOAD_ANY)
+		break;
+	}
+
+	return -1;
 }
 
 /* Returns the offset (in samples) within buf of where the trigger
@@ -175,65 +458,67 @@ static gboolean logic_check_match(struct soft_trigger_logic *stl,
 SR_PRIV int soft_trigger_logic_check(struct soft_trigger_logic *stl,
 		uint8_t *buf, int len, int *pre_trigger_samples)
 {
-	struct sr_trigger_stage *stage;
-	struct sr_trigger_match *match;
-	GSList *l, *l_stage;
+	struct soft_trigger_stage *stage;
 	int offset;
-	int i;
+	int i, n;
 	gboolean match_found;
 
 	offset = -1;
-	for (i = 0; i < len; i += stl->unitsize) {
-		l_stage = g_slist_nth(stl->trigger->stages, stl->cur_stage);
-		stage = l_stage->data;
-		if (!stage->matches)
+	n = len / stl->unitsize;
+	i = 0;
+	while (i < n) {
+		stage = &stl->stages[stl->cur_stage];
+		if (stage->empty)
 			/* No matches supplied, client error. */
 			return SR_ERR_ARG;
 
-		match_found = TRUE;
-		for (l = stage->matches; l; l = l->next) {
-			match = l->data;
-			if (!match->channel->enabled)
-				/* Ignore disabled channels with a trigger. */
-				continue;
-			if (!logic_check_match(stl, buf + i, match)) {
-				match_found = FALSE;
+		if (stl->cur_stage == 0) {
+			/* Skip ahead to the next sample matching the first stage. */
+			i = stage_scan(stl, stage, buf, i, n);
+			if (i < 0)
 				break;
-			}
+			match_found = TRUE;
+		} else {
+			match_found = stage_match(stl, stage,
+				buf + i * stl->unitsize, sample_prev(stl, buf, i));
 		}
-		memcpy(stl->prev_sample, buf + i, stl->unitsize);
+
 		if (match_found) {
 			/* Matched on the current stage. */
-			if (l_stage->next) {
+			if (stl->cur_stage + 1 < stl->num_stages) {
 				/* Advance to next stage. */
 				stl->cur_stage++;
-			} else {
-				/* Matched on last stage, send pre-trigger data. */
-				pre_trigger_append(stl, buf, i);
-				pre_trigger_send(stl, pre_trigger_samples);
+				i++;
+				continue;
+			}
+			/* Matched on last stage, send pre-trigger data. */
+			pre_trigger_append(stl, buf, i * stl->unitsize);
+			pre_trigger_send(stl, pre_trigger_samples);
 
-				/* Fire trigger. */
-				offset = i / stl->unitsize;
+			/* Fire trigger. */
+			offset = i;
 
-				std_session_send_df_trigger(stl->sdi);
-				break;
-			}
-		} else if (stl->cur_stage > 0) {
-			/*
-			 * We had a match at an earlier stage, but failed on the
-			 * current stage. However, we may have a match on this
-			 * stage in the next bit -- trigger on 0001 will fail on
-			 * seeing 00001, so we need to go back to stage 0 -- but
-			 * at the next sample from the one that matched originally,
-			 * which the counter increment at the end of the loop
-			 * takes care of.
-			 */
-			i -= stl->cur_stage * stl->unitsize;
-			if (i < -1)
-				i = -1; /* Oops, went back past this buffer. */
-			/* Reset trigger stage. */
-			stl->cur_stage = 0;
+			std_session_send_df_trigger(stl->sdi);
+			break;
 		}
+
+		/*
+		 * We had a match at an earlier stage, but failed on the
+		 * current stage. However, we may have a match on this
+		 * stage in the next bit -- trigger on 0001 will fail on
+		 * seeing 00001, so we need to go back to stage 0 -- but
+		 * at the next sample from the one that matched originally.
+		 */
+		i = MAX(i - stl->cur_stage + 1, 0);
+		/* Reset trigger stage. */
+		stl->cur_stage = 0;
+	}
+
+	/* Keep the last inspected sample for edge matches. */
+	if (n > 0) {
+		memcpy(stl->prev_sample, buf + (offset >= 0 ? offset : n - 1)
+			* stl->unitsize, stl->unitsize);
+		stl->have_prev = TRUE;
 	}
 
 	if (offset == -1)
@@ -786,6 +786,162 @@ SR_API int sr_parse_rational(const char *str, struct sr_rational *ret)
 	return SR_OK;
 }
 
+/* Powers of ten which are exact in a double. */
+static const double pow10_exact[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+/*
+ * Parse one number of a comma separated list. Numbers with at most 15
+ * significant digits and small exponents take a fast path which is
+ * exact: both the mantissa and the power of ten are exact doubles, so
+ * the one multiplication or division rounds correctly. Anything else
+ * (NaN, Inf, long mantissas) goes through g_ascii_strtod().
+ *
+ * Leaves *pos at the ',' or NUL after the number, also on failure.
+ */
+static int parse_list_number(const char **pos, double *ret)
+{
+	const char *p, *start;
+	char buf[64], *endptr;
+	uint64_t mantissa;
+	int digits, exponent, exp_value;
+	gboolean negative, exp_negative, seen_digit, exact;
+	size_t len;
+
+	p = *pos;
+	while (g_ascii_isspace(*p))
+		p++;
+	start = p;
+
+	negative = FALSE;
+	if (*p == '+' || *p == '-')
+		negative = *p++ == '-';
+
+	mantissa = 0;
+	digits = 0;
+	exponent = 0;
+	seen_digit = FALSE;
+	exact = TRUE;
+	for (; g_ascii_isdigit(*p); p++) {
+		seen_digit = TRUE;
+		if (digits < 15) {
+			mantissa = mantissa * 10 + (*p - '0');
+			digits += mantissa != 0;
+		} else {
+			exact = FALSE;
+		}
+	}
+	if (*p == '.') {
+		for (p++; g_ascii_isdigit(*p); p++) {
+			seen_digit = TRUE;
+			if (digits < 15) {
+				mantissa = mantissa * 10 + (*p - '0');
+				digits += mantissa != 0;
+				exponent--;
+			} else {
+				exact = FALSE;
+			}
+		}
+	}
+	if (seen_digit && (*p == 'e' || *p == 'E')) {
+		p++;
+		exp_negative = FALSE;
+		if (*p == '+' || *p == '-')
+			exp_negative = *p++ == '-';
+		if (!g_ascii_isdigit(*p))
+			exact = FALSE;
+		for (exp_value = 0; g_ascii_isdigit(*p); p++) {
+			if (exp_value < 10000)
+				exp_value = exp_value * 10 + (*p - '0');
+		}
+		exponent += exp_negative ? -exp_value : exp_value;
+	}
+	while (g_ascii_isspace(*p))
+		p++;
+
+	if (seen_digit && exact && (*p == ',' || *p == '\0') &&
+			exponent >= -22 && exponent <= 22) {
+		*ret = (exponent < 0) ? mantissa / pow10_exact[-exponent]
+			: mantissa * pow10_exact[exponent];
+		if (negative)
+			*ret = -*ret;
+		*pos = p;
+		return SR_OK;
+	}
+
+	/* Slow path, on a copy of the token. */
+	while (*p && *p != ',')
+		p++;
+	*pos = p;
+	len = p - start;
+	if (len == 0 || len >= sizeof(buf))
+		return SR_ERR;
+	memcpy(buf, start, len);
+	buf[len] = '\0';
+	g_strchomp(buf);
+
+	errno = 0;
+	*ret = g_ascii_strtod(buf, &endptr);
+	if (endptr == buf || *endptr || errno)
+		return SR_ERR;
+
+	return SR_OK;
+}
+
+/**
+ * Parse a comma separated list of numbers, like SCPI devices return them.
+ *
+ * The parser makes a single pass over the text and doesn't allocate
+ * memory. It ignores the locale. Whitespace around numbers is accepted.
+ * Invalid numbers are skipped, the valid ones are still stored. An empty
+ * string is an empty list.
+ *
+ * @param str The text to parse, NUL terminated.
+ * @param values Array where to store the numbers. Can be NULL to only
+ *               count them.
+ * @param size The number of elements in values. Numbers beyond that
+ *             are counted but not stored.
+ * @param count Pointer where to store the number of valid numbers.
+ *
+ * @retval SR_OK All numbers were valid.
+ * @retval SR_ERR_DATA Some numbers were invalid.
+ * @retval SR_ERR_ARG Invalid argument.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_parse_float_list(const char *str, float *values, size_t size,
+		size_t *count)
+{
+	const char *p;
+	double value;
+	size_t n;
+	int ret;
+
+	if (!str || !count)
+		return SR_ERR_ARG;
+
+	n = 0;
+	ret = SR_OK;
+	p = str;
+	while (*str) {
+		if (parse_list_number(&p, &value) == SR_OK) {
+			if (values && n < size)
+				values[n] = value;
+			n++;
+		} else {
+			ret = SR_ERR_DATA;
+		}
+		if (*p != ',')
+			break;
+		p++;
+	}
+	*count = n;
+
+	return ret;
+}
+
 /**
  * Convert a numeric value value to its "natural" string representation
  * in SI units.
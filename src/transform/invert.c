@@ -24,46 +24,15 @@
 
 #define LOG_PREFIX "transform/invert"
 
-static int receive(const struct sr_transform *t,
-		struct sr_datafeed_packet *packet_in,
-		struct sr_datafeed_packet **packet_out)
+static int get_op(const struct sr_transform *t, struct sr_transform_op *op)
 {
-	const struct sr_datafeed_logic *logic;
-	const struct sr_datafeed_analog *analog;
-	uint8_t *b;
-	int64_t p;
-	uint64_t i, j, q;
-
-	if (!t || !t->sdi || !packet_in || !packet_out)
+	if (!t || !t->sdi || !op)
 		return SR_ERR_ARG;
 
-	switch (packet_in->type) {
-	case SR_DF_LOGIC:
-		logic = packet_in->payload;
-		for (i = 0; i <= logic->length - logic->unitsize; i += logic->unitsize) {
-			for (j = 0; j < logic->unitsize; j++) {
-				/* For now invert every bit in every byte. */
-				b = (uint8_t *)logic->data + i + logic->unitsize - 1 - j;
-				*b = ~(*b);
-			}
-		}
-		break;
-	case SR_DF_ANALOG:
-		analog = packet_in->payload;
-		p = analog->encoding->scale.p;
-		q = analog->encoding->scale.q;
-		if (q > INT64_MAX)
-			return SR_ERR;
-		analog->encoding->scale.p = (p < 0) ? -q : q;
-		analog->encoding->scale.q = (p < 0) ? -p : p;
-		break;
-	default:
-		sr_spew("Unsupported packet type %d, ignoring.", packet_in->type);
-		break;
-	}
-
-	/* Return the in-place-modified packet. */
-	*packet_out = packet_in;
+	/* For now invert every bit in every byte. */
+	op->logic_xor = UINT64_MAX;
+	op->logic_xor_high = 0xff;
+	op->analog_reciprocal = TRUE;
 
 	return SR_OK;
 }
@@ -74,6 +43,7 @@ SR_PRIV struct sr_transform_module transform_invert = {
 	.desc = "Invert values",
 	.options = NULL,
 	.init = NULL,
-	.receive = receive,
+	.receive = sr_transform_op_receive,
+	.get_op = get_op,
 	.cleanup = NULL,
 };
@@ -0,0 +1,97 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2026 The sigrok developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <string.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+
+#define LOG_PREFIX "transform/mask"
+
+struct context {
+	uint64_t channels;
+};
+
+static int init(struct sr_transform *t, GHashTable *options)
+{
+	struct context *ctx;
+
+	if (!t || !t->sdi || !options)
+		return SR_ERR_ARG;
+
+	t->priv = ctx = g_malloc0(sizeof(struct context));
+
+	ctx->channels = g_variant_get_uint64(g_hash_table_lookup(options,
+			"channels"));
+
+	return SR_OK;
+}
+
+static int get_op(const struct sr_transform *t, struct sr_transform_op *op)
+{
+	struct context *ctx;
+
+	if (!t || !t->sdi || !op)
+		return SR_ERR_ARG;
+	ctx = t->priv;
+
+	/* Channels beyond the first 64 are left alone. */
+	op->logic_and = ctx->channels;
+
+	return SR_OK;
+}
+
+static int cleanup(struct sr_transform *t)
+{
+	struct context *ctx;
+
+	if (!t || !t->sdi)
+		return SR_ERR_ARG;
+	ctx = t->priv;
+
+	g_free(ctx);
+	t->priv = NULL;
+
+	return SR_OK;
+}
+
+static struct sr_option options[] = {
+	{ "channels", "Channels", "Bit mask of the logic channels to keep, the others read as low", NULL, NULL },
+	ALL_ZERO
+};
+
+static const struct sr_option *get_options(void)
+{
+	/* Default to keeping all channels. */
+	if (!options[0].def)
+		options[0].def = g_variant_ref_sink(g_variant_new_uint64(UINT64_MAX));
+
+	return options;
+}
+
+SR_PRIV struct sr_transform_module transform_mask = {
+	.id = "mask",
+	.name = "Mask",
+	.desc = "Clear logic channels which are not selected",
+	.options = get_options,
+	.init = init,
+	.receive = sr_transform_op_receive,
+	.get_op = get_op,
+	.cleanup = cleanup,
+};
@@ -38,6 +38,15 @@ static int receive(const struct sr_transform *t,
 	return SR_OK;
 }
 
+static int get_op(const struct sr_transform *t, struct sr_transform_op *op)
+{
+	if (!t || !t->sdi || !op)
+		return SR_ERR_ARG;
+
+	/* Leave the operation as is, i.e. don't modify anything. */
+	return SR_OK;
+}
+
 SR_PRIV struct sr_transform_module transform_nop = {
 	.id = "nop",
 	.name = "NOP",
@@ -45,5 +54,6 @@ SR_PRIV struct sr_transform_module transform_nop = {
 	.options = NULL,
 	.init = NULL,
 	.receive = receive,
+	.get_op = get_op,
 	.cleanup = NULL,
 };
@@ -43,30 +43,15 @@ static int init(struct sr_transform *t, GHashTable *options)
 	return SR_OK;
 }
 
-static int receive(const struct sr_transform *t,
-		struct sr_datafeed_packet *packet_in,
-		struct sr_datafeed_packet **packet_out)
+static int get_op(const struct sr_transform *t, struct sr_transform_op *op)
 {
 	struct context *ctx;
-	const struct sr_datafeed_analog *analog;
 
-	if (!t || !t->sdi || !packet_in || !packet_out)
+	if (!t || !t->sdi || !op)
 		return SR_ERR_ARG;
 	ctx = t->priv;
 
-	switch (packet_in->type) {
-	case SR_DF_ANALOG:
-		analog = packet_in->payload;
-		analog->encoding->scale.p *= ctx->factor.p;
-		analog->encoding->scale.q *= ctx->factor.q;
-		break;
-	default:
-		sr_spew("Unsupported packet type %d, ignoring.", packet_in->type);
-		break;
-	}
-
-	/* Return the in-place-modified packet. */
-	*packet_out = packet_in;
+	op->analog_factor = ctx->factor;
 
 	return SR_OK;
 }
@@ -108,6 +93,7 @@ SR_PRIV struct sr_transform_module transform_scale = {
 	.desc = "Scale analog values by a specified factor",
 	.options = get_options,
 	.init = init,
-	.receive = receive,
+	.receive = sr_transform_op_receive,
+	.get_op = get_op,
 	.cleanup = cleanup,
 };
@@ -22,6 +22,12 @@
 #include <string.h>
 #include <libsigrok/libsigrok.h>
 #include "libsigrok-internal.h"
+#ifdef SR_SIMD_X86
+#include <immintrin.h>
+#endif
+#ifdef SR_SIMD_ARM_NEON
+#include <arm_neon.h>
+#endif
 
 /** @cond PRIVATE */
 #define LOG_PREFIX "transform"
@@ -45,12 +51,14 @@
 extern SR_PRIV struct sr_transform_module transform_nop;
 extern SR_PRIV struct sr_transform_module transform_scale;
 extern SR_PRIV struct sr_transform_module transform_invert;
+extern SR_PRIV struct sr_transform_module transform_mask;
 /** @endcond */
 
 static const struct sr_transform_module *transform_module_list[] = {
 	&transform_nop,
 	&transform_scale,
 	&transform_invert,
+	&transform_mask,
 	NULL,
 };
 
@@ -284,4 +292,283 @@ SR_API int sr_transform_free(const struct sr_transform *t)
 	return ret;
 }
 
+/**
+ * Initialize a transform operation to leave packets unchanged.
+ *
+ * @param op The operation.
+ *
+ * @private
+ */
+SR_PRIV void sr_transform_op_init(struct sr_transform_op *op)
+{
+	memset(op, 0, sizeof(*op));
+	op->logic_and = UINT64_MAX;
+	op->logic_and_high = 0xff;
+	sr_rational_set(&op->analog_factor, 1, 1);
+}
+
+/**
+ * Fuse a transform operation with the one of the next transform.
+ *
+ * @param op The operation, which becomes the combination of both.
+ * @param next The operation to apply after op.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG The combined analog factor doesn't fit, op is
+ *                    unchanged. Apply both separately.
+ *
+ * @private
+ */
+SR_PRIV int sr_transform_op_fuse(struct sr_transform_op *op,
+		const struct sr_transform_op *next)
+{
+	struct sr_rational factor;
+	int ret;
+
+	/*
+	 * A reciprocal after a factor turns the factor into a divisor:
+	 * 1 / (s * f1) * f2 = (1 / s) * (f2 / f1).
+	 */
+	if (next->analog_reciprocal)
+		ret = sr_rational_div(&factor, &next->analog_factor,
+			&op->analog_factor);
+	else
+		ret = sr_rational_mult(&factor, &op->analog_factor,
+			&next->analog_factor);
+	if (ret != SR_OK)
+		return ret;
+
+	op->analog_factor = factor;
+	op->analog_reciprocal ^= next->analog_reciprocal;
+	op->logic_xor = (op->logic_xor & next->logic_and) ^ next->logic_xor;
+	op->logic_and &= next->logic_and;
+	op->logic_xor_high = (op->logic_xor_high & next->logic_and_high)
+		^ next->logic_xor_high;
+	op->logic_and_high &= next->logic_and_high;
+
+	return SR_OK;
+}
+
+/*
+ * Unit sizes which divide 32 get the masks repeated over 32 bytes, and
+ * the data processed in such blocks. Returns the number of bytes done.
+ */
+
+#ifdef SR_SIMD_X86
+
+static SR_SIMD_TARGET_SSE2 uint64_t op_logic_sse2(const uint8_t *and_mask,
+		const uint8_t *xor_mask, const uint8_t *in, uint8_t *out,
+		uint64_t length)
+{
+	__m128i a0, a1, x0, x1, v0, v1;
+	uint64_t i;
+
+	a0 = _mm_loadu_si128((const __m128i *)and_mask);
+	a1 = _mm_loadu_si128((const __m128i *)(and_mask + 16));
+	x0 = _mm_loadu_si128((const __m128i *)xor_mask);
+	x1 = _mm_loadu_si128((const __m128i *)(xor_mask + 16));
+	for (i = 0; i + 32 <= length; i += 32) {
+		v0 = _mm_loadu_si128((const __m128i *)&in[i]);
+		v1 = _mm_loadu_si128((const __m128i *)&in[i + 16]);
+		_mm_storeu_si128((__m128i *)&out[i],
+			_mm_xor_si128(_mm_and_si128(v0, a0), x0));
+		_mm_storeu_si128((__m128i *)&out[i + 16],
+			_mm_xor_si128(_mm_and_si128(v1, a1), x1));
+	}
+
+	return i;
+}
+
+static SR_SIMD_TARGET_AVX2 uint64_t op_logic_avx2(const uint8_t *and_mask,
+		const uint8_t *xor_mask, const uint8_t *in, uint8_t *out,
+		uint64_t length)
+{
+	__m256i a, x, v0, v1;
+	uint64_t i;
+
+	a = _mm256_loadu_si256((const __m256i *)and_mask);
+	x = _mm256_loadu_si256((const __m256i *)xor_mask);
+	for (i = 0; i + 64 <= length; i += 64) {
+		v0 = _mm256_loadu_si256((const __m256i *)&in[i]);
+		v1 = _mm256_loadu_si256((const __m256i *)&in[i + 32]);
+		_mm256_storeu_si256((__m256i *)&out[i],
+			_mm256_xor_si256(_mm256_and_si256(v0, a), x));
+		_mm256_storeu_si256((__m256i *)&out[i + 32],
+			_mm256_xor_si256(_mm256_and_si256(v1, a), x));
+	}
+
+	return i;
+}
+
+#endif
+
+#ifdef SR_SIMD_ARM_NEON
+
+static uint64_t op_logic_neon(const uint8_t *and_mask,
+		const uint8_t *xor_mask, const uint8_t *in, uint8_t *out,
+		uint64_t length)
+{
+	uint8x16_t a0, a1, x0, x1;
+	uint64_t i;
+
+	a0 = vld1q_u8(and_mask);
+	a1 = vld1q_u8(and_mask + 16);
+	x0 = vld1q_u8(xor_mask);
+	x1 = vld1q_u8(xor_mask + 16);
+	for (i = 0; i + 32 <= length; i += 32) {
+		vst1q_u8(&out[i], veorq_u8(vandq_u8(vld1q_u8(&in[i]), a0), x0));
+		vst1q_u8(&out[i + 16],
+			veorq_u8(vandq_u8(vld1q_u8(&in[i + 16]), a1), x1));
+	}
+
+	return i;
+}
+
+#endif
+
+/**
+ * Apply a transform operation to logic sample data.
+ *
+ * @param op The operation.
+ * @param in The input samples.
+ * @param out Where to store the output samples. Can be the same as in.
+ * @param length The number of bytes.
+ * @param unitsize The number of bytes per sample.
+ *
+ * @return FALSE if the operation leaves logic data unchanged, in which
+ *         case nothing got written. TRUE otherwise.
+ *
+ * @private
+ */
+SR_PRIV gboolean sr_transform_op_logic(const struct sr_transform_op *op,
+		const uint8_t *in, uint8_t *out, uint64_t length, uint16_t unitsize)
+{
+	uint8_t and_mask[32], xor_mask[32];
+	unsigned int features;
+	uint64_t i, done;
+	unsigned int b;
+
+	if (op->logic_and == UINT64_MAX && !op->logic_xor && (unitsize <= 8
+			|| (op->logic_and_high == 0xff && !op->logic_xor_high)))
+		return FALSE;
+
+	done = 0;
+	if (unitsize && 32 % unitsize == 0) {
+		for (b = 0; b < 32; b++) {
+			i = b % unitsize;
+			and_mask[b] = i < 8 ? op->logic_and >> (8 * i)
+				: op->logic_and_high;
+			xor_mask[b] = i < 8 ? op->logic_xor >> (8 * i)
+				: op->logic_xor_high;
+		}
+		features = sr_simd_features();
+#ifdef SR_SIMD_X86
+		if (features & SR_SIMD_AVX2)
+			done = op_logic_avx2(and_mask, xor_mask, in, out, length);
+		else if (features & SR_SIMD_SSE2)
+			done = op_logic_sse2(and_mask, xor_mask, in, out, length);
+#endif
+#ifdef SR_SIMD_ARM_NEON
+		if (features & SR_SIMD_NEON)
+			done = op_logic_neon(and_mask, xor_mask, in, out, length);
+#endif
+		(void)features;
+		for (i = done; i < length; i++)
+			out[i] = (in[i] & and_mask[i % 32]) ^ xor_mask[i % 32];
+		return TRUE;
+	}
+
+	for (i = 0; i < length; i++) {
+		b = i % unitsize;
+		if (b < 8)
+			out[i] = (in[i] & (op->logic_and >> (8 * b)))
+				^ (op->logic_xor >> (8 * b));
+		else
+			out[i] = (in[i] & op->logic_and_high) ^ op->logic_xor_high;
+	}
+
+	return TRUE;
+}
+
+/**
+ * Apply a transform operation to an analog encoding.
+ *
+ * @param op The operation.
+ * @param encoding The encoding to update.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR The resulting scale doesn't fit.
+ *
+ * @private
+ */
+SR_PRIV int sr_transform_op_analog(const struct sr_transform_op *op,
+		struct sr_analog_encoding *encoding)
+{
+	struct sr_rational scale;
+	int64_t p;
+	uint64_t q;
+
+	scale = encoding->scale;
+	if (op->analog_reciprocal) {
+		p = scale.p;
+		q = scale.q;
+		if (q > INT64_MAX || !p)
+			return SR_ERR;
+		scale.p = (p < 0) ? -(int64_t)q : (int64_t)q;
+		scale.q = (p < 0) ? -p : p;
+	}
+	if (op->analog_factor.p != 1 || op->analog_factor.q != 1) {
+		if (sr_rational_mult(&scale, &scale, &op->analog_factor) != SR_OK)
+			return SR_ERR;
+	}
+	encoding->scale = scale;
+
+	return SR_OK;
+}
+
+/**
+ * Receive function for transform modules which implement get_op().
+ *
+ * This modifies the packet in place, for callers which run transform
+ * modules one by one. The session fuses the operations instead.
+ *
+ * @private
+ */
+SR_PRIV int sr_transform_op_receive(const struct sr_transform *t,
+		struct sr_datafeed_packet *packet_in,
+		struct sr_datafeed_packet **packet_out)
+{
+	struct sr_transform_op op;
+	const struct sr_datafeed_logic *logic;
+	const struct sr_datafeed_analog *analog;
+	int ret;
+
+	if (!t || !t->sdi || !packet_in || !packet_out)
+		return SR_ERR_ARG;
+
+	sr_transform_op_init(&op);
+	if ((ret = t->module->get_op(t, &op)) != SR_OK)
+		return ret;
+
+	switch (packet_in->type) {
+	case SR_DF_LOGIC:
+		logic = packet_in->payload;
+		sr_transform_op_logic(&op, logic->data, logic->data,
+			logic->length, logic->unitsize);
+		break;
+	case SR_DF_ANALOG:
+		analog = packet_in->payload;
+		if ((ret = sr_transform_op_analog(&op, analog->encoding)) != SR_OK)
+			return ret;
+		break;
+	default:
+		break;
+	}
+
+	/* Return the in-place-modified packet. */
+	*packet_out = packet_in;
+
+	return SR_OK;
+}
+
 /** @} */
@@ -468,6 +468,543 @@ SR_PRIV int usb_source_remove(struct sr_session *session, struct sr_context *ctx
 	return sr_session_source_remove_internal(session, ctx->libusb_ctx);
 }
 
+/** Thread which handles libusb events, shared by all acquisitions of a
+ * libsigrok context which use it.
+ */
+struct usb_event_thread {
+	libusb_context *usb_ctx;
+	GThread *thread;
+	unsigned int users;
+	int quit;
+};
+
+/** Bounded single producer, single consumer queue of transfer completions.
+ *
+ * The producer is the libusb event thread, the consumer is the session.
+ * Plain completions are limited to the queue depth, completions which
+ * hand back their transfer may also use the reserve. That way a stalled
+ * session can lose data, but never transfers.
+ */
+struct usb_queue {
+	struct usb_completion *ring;
+	struct usb_ring index;
+	/* Main context to wake up after adding an item. */
+	GMainContext *main_context;
+};
+
+/** GLib event source dispatching the completions in a queue.
+ */
+struct usb_queue_source {
+	GSource base;
+
+	int64_t timeout_us;
+	int64_t due_us;
+
+	/* Needed to keep track of installed sources */
+	struct sr_session *session;
+
+	struct sr_context *ctx;
+	struct usb_queue *queue;
+};
+
+/* Statically allocated, no initialization needed. */
+static GMutex usb_thread_mutex;
+
+static gpointer usb_event_thread_run(gpointer data)
+{
+	struct usb_event_thread *t;
+	struct timeval tv;
+	int ret;
+
+	t = data;
+
+	while (!g_atomic_int_get(&t->quit)) {
+		/* Don't rely on being interrupted, libusb may be too old. */
+		tv.tv_sec = 0;
+		tv.tv_usec = 100 * 1000;
+		ret = libusb_handle_events_timeout_completed(t->usb_ctx,
+				&tv, &t->quit);
+		if (ret < 0 && ret != LIBUSB_ERROR_INTERRUPTED) {
+			sr_err("Failed to handle libusb events: %s.",
+				libusb_error_name(ret));
+			g_usleep(tv.tv_usec);
+		}
+	}
+
+	return NULL;
+}
+
+static int usb_event_thread_ref(struct sr_context *ctx)
+{
+	struct usb_event_thread *t;
+	GError *error;
+
+	g_mutex_lock(&usb_thread_mutex);
+	if ((t = ctx->usb_thread)) {
+		t->users++;
+		g_mutex_unlock(&usb_thread_mutex);
+		return SR_OK;
+	}
+
+	t = g_malloc0(sizeof(*t));
+	t->usb_ctx = ctx->libusb_ctx;
+	t->users = 1;
+	error = NULL;
+	t->thread = g_thread_try_new("sr-usb", usb_event_thread_run, t, &error);
+	if (!t->thread) {
+		g_mutex_unlock(&usb_thread_mutex);
+		sr_err("Failed to create libusb event thread: %s.",
+			error->message);
+		g_error_free(error);
+		g_free(t);
+		return SR_ERR;
+	}
+	ctx->usb_thread = t;
+	g_mutex_unlock(&usb_thread_mutex);
+
+	sr_dbg("Started libusb event thread.");
+
+	return SR_OK;
+}
+
+static void usb_event_thread_unref(struct sr_context *ctx)
+{
+	struct usb_event_thread *t;
+
+	g_mutex_lock(&usb_thread_mutex);
+	t = ctx->usb_thread;
+	if (!t || --t->users > 0) {
+		g_mutex_unlock(&usb_thread_mutex);
+		return;
+	}
+	ctx->usb_thread = NULL;
+	g_mutex_unlock(&usb_thread_mutex);
+
+	g_atomic_int_set(&t->quit, 1);
+#if (LIBUSB_API_VERSION >= 0x01000105)
+	libusb_interrupt_event_handler(t->usb_ctx);
+#endif
+	g_thread_join(t->thread);
+	g_free(t);
+
+	sr_dbg("Stopped libusb event thread.");
+}
+
+/**
+ * Create a queue which passes transfer completions from the libusb
+ * event thread to the session.
+ *
+ * @param depth The maximum number of queued completions which keep
+ *              their transfer in flight.
+ * @param reserve Additional room for completions which hand back their
+ *                transfer, usually the number of transfers.
+ *
+ * @return The new queue, or NULL on allocation failure.
+ *
+ * @private
+ */
+SR_PRIV struct usb_queue *usb_queue_new(unsigned int depth,
+		unsigned int reserve)
+{
+	struct usb_queue *q;
+	guint size;
+
+	q = g_malloc0(sizeof(*q));
+	size = usb_ring_init(&q->index, depth, reserve);
+	if (!(q->ring = g_try_malloc(size * sizeof(*q->ring)))) {
+		sr_err("USB completion queue malloc failed.");
+		g_free(q);
+		return NULL;
+	}
+
+	return q;
+}
+
+/**
+ * Release a completion queue.
+ *
+ * The queue's event source must have been removed. Sample data of
+ * completions which were not taken out of the queue is discarded.
+ *
+ * @param q The queue. NULL is silently ignored.
+ *
+ * @private
+ */
+SR_PRIV void usb_queue_free(struct usb_queue *q)
+{
+	struct usb_completion c;
+
+	if (!q)
+		return;
+
+	while (usb_queue_pop(q, &c))
+		sr_buffer_unref(c.buf);
+	if (q->main_context)
+		g_main_context_unref(q->main_context);
+	g_free(q->ring);
+	g_free(q);
+}
+
+/**
+ * Add a transfer completion to a queue. Only call this from the libusb
+ * event thread, typically from a transfer's callback.
+ *
+ * @param q The queue. Must not be NULL.
+ * @param c The completion. The queue takes over its buffer reference.
+ *
+ * @return TRUE on success, FALSE if the queue is full. The completion
+ *         is not queued in that case, and the caller keeps the buffer.
+ *
+ * @private
+ */
+SR_PRIV gboolean usb_queue_push(struct usb_queue *q,
+		const struct usb_completion *c)
+{
+	GMainContext *main_context;
+	guint slot;
+
+	if (!usb_ring_push_slot(&q->index, c->transfer != NULL, &slot))
+		return FALSE;
+
+	q->ring[slot] = *c;
+
+	/* The queue may be gone as soon as the session sees the item. */
+	main_context = q->main_context;
+	if (main_context)
+		g_main_context_ref(main_context);
+	usb_ring_push_done(&q->index);
+	if (main_context) {
+		g_main_context_wakeup(main_context);
+		g_main_context_unref(main_context);
+	}
+
+	return TRUE;
+}
+
+/**
+ * Take the oldest transfer completion out of a queue. Only call this
+ * from the session which the queue's event source belongs to.
+ *
+ * @param q The queue. Must not be NULL.
+ * @param c The completion, with a buffer reference which the caller
+ *          must release.
+ *
+ * @return TRUE on success, FALSE if the queue is empty.
+ *
+ * @private
+ */
+SR_PRIV gboolean usb_queue_pop(struct usb_queue *q, struct usb_completion *c)
+{
+	guint slot;
+
+	if (!usb_ring_pop_slot(&q->index, &slot))
+		return FALSE;
+
+	*c = q->ring[slot];
+	usb_ring_pop_done(&q->index);
+
+	return TRUE;
+}
+
+/** Queue event source prepare() method.
+ */
+static gboolean usb_queue_source_prepare(GSource *source, int *timeout)
+{
+	struct usb_queue_source *qsource;
+	int64_t now_us;
+
+	qsource = (struct usb_queue_source *)source;
+
+	if (usb_ring_fill(&qsource->queue->index) > 0) {
+		*timeout = 0;
+		return TRUE;
+	}
+	if (qsource->timeout_us < 0) {
+		*timeout = -1;
+		return FALSE;
+	}
+
+	now_us = g_source_get_time(source);
+	if (qsource->due_us == 0)
+		qsource->due_us = now_us + qsource->timeout_us;
+	*timeout = (MAX(0, qsource->due_us - now_us) + 999) / 1000;
+
+	return (*timeout == 0);
+}
+
+/** Queue event source check() method.
+ */
+static gboolean usb_queue_source_check(GSource *source)
+{
+	struct usb_queue_source *qsource;
+
+	qsource = (struct usb_queue_source *)source;
+
+	return (usb_ring_fill(&qsource->queue->index) > 0
+		|| (qsource->timeout_us >= 0
+			&& qsource->due_us <= g_source_get_time(source)));
+}
+
+/** Queue event source dispatch() method.
+ */
+static gboolean usb_queue_source_dispatch(GSource *source,
+		GSourceFunc callback, void *user_data)
+{
+	struct usb_queue_source *qsource;
+	int revents;
+	gboolean keep;
+
+	qsource = (struct usb_queue_source *)source;
+
+	if (!callback) {
+		sr_err("Callback not set, cannot dispatch event.");
+		return G_SOURCE_REMOVE;
+	}
+	revents = (usb_ring_fill(&qsource->queue->index) > 0) ? G_IO_IN : 0;
+	keep = (*SR_RECEIVE_DATA_CALLBACK(callback))(-1, revents, user_data);
+
+	if (G_LIKELY(keep) && G_LIKELY(!g_source_is_destroyed(source))
+			&& qsource->timeout_us >= 0)
+		qsource->due_us = g_source_get_time(source)
+				+ qsource->timeout_us;
+
+	return keep;
+}
+
+/** Queue event source finalize() method.
+ */
+static void usb_queue_source_finalize(GSource *source)
+{
+	struct usb_queue_source *qsource;
+
+	qsource = (struct usb_queue_source *)source;
+
+	sr_spew("%s", __func__);
+
+	usb_event_thread_unref(qsource->ctx);
+
+	sr_session_source_destroyed(qsource->session,
+			qsource->queue, source);
+}
+
+/**
+ * Start handling libusb events on the event thread, and dispatch the
+ * completions in a queue from the session's main loop.
+ *
+ * The callback gets invoked when completions are queued (with revents
+ * set to G_IO_IN), or after the timeout has passed without any.
+ *
+ * @param session The session.
+ * @param ctx The libsigrok context whose libusb events to handle.
+ * @param q The completion queue which the driver's transfer callbacks
+ *          push to.
+ * @param timeout_ms The timeout interval in ms, or -1 to wait indefinitely.
+ * @param cb The session side callback.
+ * @param cb_data Opaque pointer passed to @a cb.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR Thread or event source creation failure.
+ *
+ * @private
+ */
+SR_PRIV int usb_queue_source_add(struct sr_session *session,
+		struct sr_context *ctx, struct usb_queue *q, int timeout_ms,
+		sr_receive_data_callback cb, void *cb_data)
+{
+	static GSourceFuncs usb_queue_source_funcs = {
+		.prepare  = &usb_queue_source_prepare,
+		.check    = &usb_queue_source_check,
+		.dispatch = &usb_queue_source_dispatch,
+		.finalize = &usb_queue_source_finalize
+	};
+	GSource *source;
+	struct usb_queue_source *qsource;
+	GMainContext *main_context;
+	int ret;
+
+	if ((ret = usb_event_thread_ref(ctx)) != SR_OK)
+		return ret;
+
+	/* From here on the source's finalize() releases the thread. */
+	source = g_source_new(&usb_queue_source_funcs,
+			sizeof(struct usb_queue_source));
+	qsource = (struct usb_queue_source *)source;
+
+	g_source_set_name(source, "usb-queue");
+	qsource->timeout_us = (timeout_ms >= 0) ? 1000 * (int64_t)timeout_ms : -1;
+	qsource->due_us = 0;
+	qsource->session = session;
+	qsource->ctx = ctx;
+	qsource->queue = q;
+
+	g_source_set_callback(source, G_SOURCE_FUNC(cb), cb_data, NULL);
+
+	ret = sr_session_source_add_internal(session, q, source);
+	if (ret == SR_OK && !q->main_context
+			&& (main_context = g_source_get_context(source)))
+		q->main_context = g_main_context_ref(main_context);
+	g_source_unref(source);
+
+	return ret;
+}
+
+/**
+ * Remove the event source of a completion queue.
+ *
+ * @param session The session.
+ * @param q The completion queue.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_BUG No event source for the queue.
+ *
+ * @private
+ */
+SR_PRIV int usb_queue_source_remove(struct sr_session *session,
+		struct usb_queue *q)
+{
+	return sr_session_source_remove_internal(session, q);
+}
+
+/**
+ * Size the bulk transfers of a streaming acquisition, and reset the
+ * statistics.
+ *
+ * Each buffer holds about @a buffer_ms of sample data, and the transfers
+ * in flight hold about @a total_ms initially. The pool may grow to
+ * @a max_transfers when completions arrive late, see usb_stream_completed().
+ *
+ * @param s The stream state.
+ * @param bytes_per_sec The rate at which the device sends data.
+ * @param block_size Buffer sizes are rounded up to a multiple of this.
+ * @param buffer_ms Duration of the data held by one buffer.
+ * @param total_ms Duration of the data held by all transfers.
+ * @param num_transfers Initial maximum number of transfers.
+ * @param max_transfers Maximum number of transfers when growing.
+ *
+ * @private
+ */
+SR_PRIV void usb_stream_init(struct usb_stream *s, uint64_t bytes_per_sec,
+		size_t block_size, unsigned int buffer_ms, unsigned int total_ms,
+		unsigned int num_transfers, unsigned int max_transfers)
+{
+	uint64_t bytes_per_ms, size, n;
+
+	memset(s, 0, sizeof(*s));
+
+	bytes_per_ms = MAX(bytes_per_sec / 1000, 1);
+	block_size = MAX(block_size, 1);
+	size = buffer_ms * bytes_per_ms;
+	size = (size + block_size - 1) / block_size * block_size;
+	n = (total_ms * bytes_per_ms + size - 1) / size;
+
+	s->buffer_size = size;
+	s->max_transfers = MAX(max_transfers, 1);
+	s->num_transfers = CLAMP(n, 1, MIN(num_transfers, s->max_transfers));
+	s->buffer_us = MAX(size * G_USEC_PER_SEC / MAX(bytes_per_sec, 1), 1);
+	/* Leave a headroom of 25% for the whole pool to complete. */
+	s->timeout = s->num_transfers * s->buffer_us / 1000;
+	s->timeout += s->timeout / 4 + 1;
+
+	sr_dbg("Using %u transfers of %zu bytes, up to %u.",
+		s->num_transfers, s->buffer_size, s->max_transfers);
+}
+
+/**
+ * Submit a transfer of a stream.
+ *
+ * @param s The stream state.
+ * @param transfer The transfer.
+ *
+ * @return The result of libusb_submit_transfer().
+ *
+ * @private
+ */
+SR_PRIV int usb_stream_submit(struct usb_stream *s,
+		struct libusb_transfer *transfer)
+{
+	int ret;
+
+	/* The transfer may complete before libusb_submit_transfer() returns. */
+	g_atomic_int_inc(&s->in_flight);
+	if ((ret = libusb_submit_transfer(transfer)) != LIBUSB_SUCCESS)
+		g_atomic_int_add(&s->in_flight, -1);
+
+	return ret;
+}
+
+/**
+ * Account for a completed transfer, and decide whether to grow the pool.
+ *
+ * Transfers complete one after another, about every buffer_us. If the
+ * gap since the previous completion exceeds that by more than half of
+ * the data that all transfers hold, the host was late to handle events
+ * and the device came close to overrunning its FIFO. Add transfers then,
+ * to get more headroom.
+ *
+ * @param s The stream state.
+ * @param transfer The completed transfer.
+ *
+ * @return The number of transfers the caller should add to the pool.
+ *
+ * @private
+ */
+SR_PRIV unsigned int usb_stream_completed(struct usb_stream *s,
+		const struct libusb_transfer *transfer)
+{
+	int64_t now_us, gap_us;
+	unsigned int add;
+
+	g_atomic_int_add(&s->in_flight, -1);
+	if (transfer->status == LIBUSB_TRANSFER_CANCELLED)
+		return 0;
+
+	s->completions++;
+	if (transfer->actual_length == 0 ||
+			(transfer->status != LIBUSB_TRANSFER_COMPLETED &&
+			 transfer->status != LIBUSB_TRANSFER_TIMED_OUT)) {
+		s->empty_transfers++;
+		return 0;
+	}
+
+	now_us = g_get_monotonic_time();
+	gap_us = s->last_completion_us ? now_us - s->last_completion_us : 0;
+	s->last_completion_us = now_us;
+	if (gap_us <= s->buffer_us + s->num_transfers * s->buffer_us / 2)
+		return 0;
+
+	s->late_completions++;
+	add = MIN(MAX(s->num_transfers / 4, 1),
+		s->max_transfers - s->num_transfers);
+	if (!add) {
+		sr_warn("Late USB transfer completion after %" PRId64 " ms.",
+			gap_us / 1000);
+		return 0;
+	}
+
+	s->num_transfers += add;
+	s->timeout = s->num_transfers * s->buffer_us / 1000;
+	s->timeout += s->timeout / 4 + 1;
+	sr_info("Late USB transfer completion after %" PRId64 " ms, "
+		"growing to %u transfers.", gap_us / 1000, s->num_transfers);
+
+	return add;
+}
+
+/**
+ * Log the statistics of a stream, at the end of an acquisition.
+ *
+ * @param s The stream state.
+ *
+ * @private
+ */
+SR_PRIV void usb_stream_log(const struct usb_stream *s)
+{
+	sr_info("%" PRIu64 " transfers completed, %" PRIu64 " late, %"
+		PRIu64 " empty, using %u transfers of %zu bytes.",
+		s->completions, s->late_completions, s->empty_transfers,
+		s->num_transfers, s->buffer_size);
+}
+
 SR_PRIV int usb_get_port_path(libusb_device *dev, char *path, int path_len)
 {
 	uint8_t port_numbers[8];
@@ -123,6 +123,136 @@ START_TEST(test_analog_to_float_null)
 }
 END_TEST
 
+struct analog_test_encoding {
+	const char *name;
+	int unitsize;
+	gboolean is_signed;
+	gboolean is_float;
+	gboolean is_bigendian;
+};
+
+static const struct analog_test_encoding analog_test_encodings[] = {
+	{ "s8", 1, TRUE, FALSE, FALSE },
+	{ "u8", 1, FALSE, FALSE, FALSE },
+	{ "s16le", 2, TRUE, FALSE, FALSE },
+	{ "u16le", 2, FALSE, FALSE, FALSE },
+	{ "s16be", 2, TRUE, FALSE, TRUE },
+	{ "u16be", 2, FALSE, FALSE, TRUE },
+	{ "s32le", 4, TRUE, FALSE, FALSE },
+	{ "u32le", 4, FALSE, FALSE, FALSE },
+	{ "s32be", 4, TRUE, FALSE, TRUE },
+	{ "u32be", 4, FALSE, FALSE, TRUE },
+	{ "f32le", 4, TRUE, TRUE, FALSE },
+	{ "f32be", 4, TRUE, TRUE, TRUE },
+};
+
+/* Fill a buffer with samples in the given encoding. */
+static void analog_test_fill(const struct analog_test_encoding *e,
+		uint8_t *buf, unsigned int count)
+{
+	unsigned int i, b;
+	union { uint32_t u32; float flt; } u;
+
+	for (i = 0; i < count; i++) {
+		if (e->is_float) {
+			u.flt = ((int)i - (int)count / 2) * 0.25f;
+			for (b = 0; b < 4; b++)
+				buf[4 * i + (e->is_bigendian ? 3 - b : b)] =
+					(u.u32 >> (8 * b)) & 0xff;
+		} else {
+			for (b = 0; b < (unsigned int)e->unitsize; b++)
+				buf[e->unitsize * i + b] = (i * 37 + b * 101 + 11) & 0xff;
+		}
+	}
+}
+
+/* Independent reading of a single sample, for reference. */
+static double analog_test_value(const struct analog_test_encoding *e,
+		const uint8_t *buf, unsigned int idx)
+{
+	const uint8_t *p;
+	uint32_t u;
+	int b;
+	union { uint32_t u32; float flt; } f;
+
+	p = buf + idx * e->unitsize;
+	u = 0;
+	for (b = 0; b < e->unitsize; b++)
+		u = (u << 8) | p[e->is_bigendian ? b : e->unitsize - 1 - b];
+
+	if (e->is_float) {
+		f.u32 = u;
+		return f.flt;
+	}
+	if (!e->is_signed)
+		return u;
+	if (e->unitsize == 1)
+		return (int8_t)u;
+	if (e->unitsize == 2)
+		return (int16_t)u;
+	return (int32_t)u;
+}
+
+static void analog_test_setup(const struct analog_test_encoding *e,
+		struct sr_datafeed_analog *analog,
+		struct sr_analog_encoding *encoding,
+		struct sr_analog_meaning *meaning,
+		struct sr_analog_spec *spec)
+{
+	sr_analog_init_(analog, encoding, meaning, spec, 3);
+	encoding->unitsize = e->unitsize;
+	encoding->is_signed = e->is_signed;
+	encoding->is_float = e->is_float;
+	encoding->is_bigendian = e->is_bigendian;
+	encoding->scale.p = 3;
+	encoding->scale.q = 8;
+	encoding->offset.p = -5;
+	encoding->offset.q = 4;
+}
+
+/* Check all supported encodings, including odd lengths (vector tails). */
+START_TEST(test_analog_to_float_encodings)
+{
+	int ret;
+	unsigned int i, e, count;
+	uint8_t *buf;
+	float *fout;
+	double expected;
+	struct sr_channel ch;
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
+
+	buf = g_malloc(4 * 1024);
+	fout = g_malloc(sizeof(float) * 1024);
+
+	for (e = 0; e < ARRAY_SIZE(analog_test_encodings); e++) {
+		for (count = 0; count < 1024; count = count * 2 + 1) {
+			analog_test_setup(&analog_test_encodings[e], &analog,
+				&encoding, &meaning, &spec);
+			meaning.channels = g_slist_append(NULL, &ch);
+			analog.num_samples = count;
+			analog.data = buf;
+			analog_test_fill(&analog_test_encodings[e], buf, count);
+			ret = sr_analog_to_float(&analog, fout);
+			fail_unless(ret == SR_OK, "sr_analog_to_float() failed: %d.", ret);
+			for (i = 0; i < count; i++) {
+				expected = analog_test_value(&analog_test_encodings[e],
+					buf, i) * 3 / 8.0 - 5 / 4.0;
+				fail_unless(fabs(expected - fout[i]) <= 1e-6 * fabs(expected) + 1e-6,
+					"%s[%u]: %f != %f", analog_test_encodings[e].name,
+					i, expected, fout[i]);
+			}
+			g_slist_free(meaning.channels);
+		}
+	}
+
+	g_free(fout);
+	g_free(buf);
+}
+END_TEST
+
 START_TEST(test_analog_si_prefix)
 {
 	struct {
@@ -386,6 +516,7 @@ Suite *suite_analog(void)
 	tc = tcase_create("analog_to_float");
 	tcase_add_test(tc, test_analog_to_float);
 	tcase_add_test(tc, test_analog_to_float_null);
+	tcase_add_test(tc, test_analog_to_float_encodings);
 	tcase_add_test(tc, test_analog_si_prefix);
 	tcase_add_test(tc, test_analog_si_prefix_null);
 	tcase_add_test(tc, test_analog_unit_to_string);
@@ -0,0 +1,1300 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2026 The sigrok developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Throughput benchmarks for the datafeed pipeline ("make bench").
+ *
+ * Every benchmark prints one tab separated line:
+ *
+ *   category  module  variant  samples  bytes  seconds  MB/s  Msamples/s
+ *
+ * Categories:
+ *  - output: Synthetic packets passed to each output module.
+ *  - analog: sr_analog_to_float() for several sample encodings, and the
+ *    analog to logic conversions (samples count per analog channel).
+ *  - logic: Bit matrix transposes, the conversion of channel-planar
+ *    data as some USB logic analyzers send it, and the conversion between
+ *    SR_DF_LOGIC and SR_DF_LOGIC_PLANAR payloads.
+ *  - strutil: sr_parse_float_list() on number lists like SCPI devices
+ *    return them for ASCII waveforms.
+ *  - input: Synthetic files fed to input modules, which send their
+ *    packets through the session (and thus sr_session_send()). The
+ *    "-mapped" variants load them with sr_input_load_file().
+ *  - transform: Binary or raw analog input through each transform module,
+ *    and through chains of them.
+ *  - session: The demo driver running a session.
+ *
+ * The bytes are those of the sample data (of the input text for input
+ * modules). The CSV input gets one sample per text line, so its sample
+ * rate is the line rate. Each benchmark runs several rounds, the fastest
+ * one counts.
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <libsigrok/libsigrok.h>
+
+/* Size of the packets (or input buffers) sent at a time. */
+#define BENCH_CHUNK_SIZE (1024 * 1024)
+
+static const uint16_t unitsizes[] = { 1, 2, 4, 8 };
+
+/* Output modules which handle analog data. */
+static const char *analog_outputs[] = { "analog", "csv", "srzip", "wav" };
+
+static const struct {
+	const char *name;
+	uint8_t unitsize;
+	gboolean is_signed;
+	gboolean is_float;
+	/* Opposite of the host's byte order. */
+	gboolean swapped;
+	int64_t scale_p;
+	uint64_t scale_q;
+} analog_formats[] = {
+	{ "f32", 4, TRUE, TRUE, FALSE, 1, 1 },
+	{ "f32-scaled", 4, TRUE, TRUE, FALSE, 1, 1000 },
+	{ "f32-swapped", 4, TRUE, TRUE, TRUE, 1, 1 },
+	{ "f64", 8, TRUE, TRUE, FALSE, 1, 1 },
+	{ "s8", 1, TRUE, FALSE, FALSE, 1, 128 },
+	{ "u8", 1, FALSE, FALSE, FALSE, 1, 255 },
+	{ "s16", 2, TRUE, FALSE, FALSE, 1, 32768 },
+	{ "s16-swapped", 2, TRUE, FALSE, TRUE, 1, 32768 },
+	{ "u16", 2, FALSE, FALSE, FALSE, 1, 65535 },
+	{ "u16-swapped", 2, FALSE, FALSE, TRUE, 1, 65535 },
+	{ "s32", 4, TRUE, FALSE, FALSE, 1, 2147483648ULL },
+	{ "s32-swapped", 4, TRUE, FALSE, TRUE, 1, 2147483648ULL },
+	{ "u32", 4, FALSE, FALSE, FALSE, 1, 4294967295ULL },
+	{ "u32-swapped", 4, FALSE, FALSE, TRUE, 1, 4294967295ULL },
+};
+
+static struct sr_context *ctx;
+static gint num_samples = 1024 * 1024;
+static gint num_rounds = 3;
+static gchar **filters;
+
+static GOptionEntry entries[] = {
+	{ "samples", 'n', 0, G_OPTION_ARG_INT, &num_samples,
+		"Number of samples per benchmark round", "N" },
+	{ "rounds", 'r', 0, G_OPTION_ARG_INT, &num_rounds,
+		"Number of rounds per benchmark", "N" },
+	{ G_OPTION_REMAINING, 0, 0, G_OPTION_ARG_STRING_ARRAY, &filters,
+		NULL, "[category/module ...]" },
+	{ NULL, 0, 0, 0, NULL, NULL, NULL },
+};
+
+/* Counts what arrives at the end of the session's datafeed. */
+struct feed_stats {
+	uint64_t samples;
+	uint64_t bytes;
+};
+
+static gboolean selected(const char *category, const char *module)
+{
+	char *name;
+	gboolean ret;
+	int i;
+
+	if (!filters)
+		return TRUE;
+
+	name = g_strdup_printf("%s/%s", category, module);
+	ret = FALSE;
+	for (i = 0; filters[i] && !ret; i++)
+		ret = strstr(name, filters[i]) != NULL;
+	g_free(name);
+
+	return ret;
+}
+
+static void report(const char *category, const char *module,
+		const char *variant, uint64_t samples, uint64_t bytes,
+		gint64 elapsed)
+{
+	double seconds;
+
+	seconds = MAX(elapsed, 1) / (double)G_USEC_PER_SEC;
+	printf("%s\t%s\t%s\t%" PRIu64 "\t%" PRIu64 "\t%.6f\t%.1f\t%.2f\n",
+		category, module, variant, samples, bytes, seconds,
+		bytes / seconds / (1024 * 1024), samples / seconds / 1e6);
+	fflush(stdout);
+}
+
+/*
+ * Logic data in which the low channels toggle often and the high ones
+ * rarely, like a counter running at an eighth of the samplerate.
+ */
+static uint8_t *logic_data_new(uint16_t unitsize)
+{
+	uint8_t *data;
+	uint64_t i, value;
+	uint16_t j;
+
+	data = g_malloc((size_t)num_samples * unitsize);
+	for (i = 0; i < (uint64_t)num_samples; i++) {
+		value = i / 8;
+		for (j = 0; j < unitsize; j++)
+			data[i * unitsize + j] = j < 8 ? value >> (8 * j) : 0;
+	}
+
+	return data;
+}
+
+static struct sr_dev_inst *logic_dev_new(unsigned int num_channels)
+{
+	struct sr_dev_inst *sdi;
+	unsigned int i;
+	char name[8];
+
+	sdi = sr_dev_inst_user_new("sigrok", "Benchmark", NULL);
+	for (i = 0; i < num_channels; i++) {
+		snprintf(name, sizeof(name), "D%u", i);
+		sr_dev_inst_channel_add(sdi, i, SR_CHANNEL_LOGIC, name);
+	}
+
+	return sdi;
+}
+
+static void analog_packet_init(struct sr_datafeed_analog *analog,
+		struct sr_analog_encoding *encoding,
+		struct sr_analog_meaning *meaning, struct sr_analog_spec *spec,
+		GSList *channels)
+{
+	memset(analog, 0, sizeof(*analog));
+	memset(encoding, 0, sizeof(*encoding));
+	memset(meaning, 0, sizeof(*meaning));
+	memset(spec, 0, sizeof(*spec));
+	encoding->unitsize = sizeof(float);
+	encoding->is_signed = TRUE;
+	encoding->is_float = TRUE;
+	encoding->is_bigendian = G_BYTE_ORDER == G_BIG_ENDIAN;
+	encoding->digits = 6;
+	encoding->is_digits_decimal = TRUE;
+	sr_rational_set(&encoding->scale, 1, 1);
+	sr_rational_set(&encoding->offset, 0, 1);
+	meaning->mq = SR_MQ_VOLTAGE;
+	meaning->unit = SR_UNIT_VOLT;
+	meaning->channels = channels;
+	spec->spec_digits = 6;
+	analog->encoding = encoding;
+	analog->meaning = meaning;
+	analog->spec = spec;
+}
+
+static int output_send_meta(const struct sr_output *o)
+{
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_meta meta;
+	struct sr_config src;
+	GString *out;
+	int ret;
+
+	src.key = SR_CONF_SAMPLERATE;
+	src.data = g_variant_new_uint64(SR_MHZ(100));
+	meta.config = g_slist_append(NULL, &src);
+	packet.type = SR_DF_META;
+	packet.payload = &meta;
+	ret = sr_output_send(o, &packet, &out);
+	if (out)
+		g_string_free(out, TRUE);
+	g_slist_free(meta.config);
+	g_variant_unref(src.data);
+
+	return ret;
+}
+
+static int output_send(const struct sr_output *o,
+		const struct sr_datafeed_packet *packet)
+{
+	GString *out;
+	int ret;
+
+	out = NULL;
+	ret = sr_output_send(o, packet, &out);
+	if (out)
+		g_string_free(out, TRUE);
+
+	return ret;
+}
+
+/*
+ * Run one round of packets through a new output instance, return the
+ * elapsed time or -1 if the module refused the data.
+ */
+static gint64 output_round(const struct sr_output_module *omod,
+		const struct sr_dev_inst *sdi, const char *filename,
+		struct sr_datafeed_packet *packet, uint64_t bytes,
+		void (*advance)(struct sr_datafeed_packet *, uint64_t offset))
+{
+	const struct sr_output *o;
+	struct sr_datafeed_packet end;
+	uint64_t offset;
+	gint64 start, elapsed;
+
+	if (!(o = sr_output_new(omod, NULL, sdi, filename)))
+		return -1;
+	if (output_send_meta(o) != SR_OK) {
+		sr_output_free(o);
+		return -1;
+	}
+
+	start = g_get_monotonic_time();
+	for (offset = 0; offset < bytes; offset += BENCH_CHUNK_SIZE) {
+		advance(packet, offset);
+		if (output_send(o, packet) != SR_OK) {
+			sr_output_free(o);
+			return -1;
+		}
+	}
+	end.type = SR_DF_END;
+	end.payload = NULL;
+	output_send(o, &end);
+	sr_output_free(o);
+	elapsed = g_get_monotonic_time() - start;
+
+	return elapsed;
+}
+
+static const uint8_t *advance_base;
+static uint64_t advance_bytes;
+
+static void advance_logic(struct sr_datafeed_packet *packet, uint64_t offset)
+{
+	struct sr_datafeed_logic *logic;
+
+	logic = (struct sr_datafeed_logic *)packet->payload;
+	logic->data = (void *)(advance_base + offset);
+	logic->length = MIN(BENCH_CHUNK_SIZE, advance_bytes - offset);
+}
+
+static void advance_analog(struct sr_datafeed_packet *packet, uint64_t offset)
+{
+	struct sr_datafeed_analog *analog;
+
+	analog = (struct sr_datafeed_analog *)packet->payload;
+	analog->data = (void *)(advance_base + offset);
+	analog->num_samples = MIN(BENCH_CHUNK_SIZE,
+		advance_bytes - offset) / sizeof(float);
+}
+
+static char *output_filename(const struct sr_output_module *omod)
+{
+	char *filename;
+	int fd;
+
+	if (!sr_output_test_flag(omod, SR_OUTPUT_INTERNAL_IO_HANDLING))
+		return NULL;
+
+	fd = g_file_open_tmp("libsigrok-bench-XXXXXX", &filename, NULL);
+	if (fd < 0)
+		return NULL;
+	close(fd);
+
+	return filename;
+}
+
+static void bench_output_module(const struct sr_output_module *omod)
+{
+	struct sr_dev_inst *sdi;
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_logic logic;
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
+	GSList *channels;
+	const char *id;
+	char *filename, variant[32];
+	uint8_t *data;
+	float *fdata;
+	uint64_t bytes;
+	gint64 elapsed, best;
+	unsigned int u, i;
+	int r;
+
+	id = sr_output_id_get(omod);
+	filename = output_filename(omod);
+
+	for (u = 0; u < G_N_ELEMENTS(unitsizes); u++) {
+		sdi = logic_dev_new(unitsizes[u] * 8);
+		data = logic_data_new(unitsizes[u]);
+		bytes = (uint64_t)num_samples * unitsizes[u];
+		advance_base = data;
+		advance_bytes = bytes;
+		logic.unitsize = unitsizes[u];
+		packet.type = SR_DF_LOGIC;
+		packet.payload = &logic;
+		best = G_MAXINT64;
+		for (r = 0; r < num_rounds; r++) {
+			elapsed = output_round(omod, sdi, filename, &packet,
+				bytes, advance_logic);
+			if (elapsed < 0)
+				break;
+			best = MIN(best, elapsed);
+		}
+		g_free(data);
+		if (best == G_MAXINT64)
+			continue;
+		snprintf(variant, sizeof(variant), "logic-u%u", unitsizes[u]);
+		report("output", id, variant, num_samples, bytes, best);
+	}
+
+	for (i = 0; i < G_N_ELEMENTS(analog_outputs); i++) {
+		if (!strcmp(id, analog_outputs[i]))
+			break;
+	}
+	if (i < G_N_ELEMENTS(analog_outputs)) {
+		sdi = sr_dev_inst_user_new("sigrok", "Benchmark", NULL);
+		sr_dev_inst_channel_add(sdi, 0, SR_CHANNEL_ANALOG, "A0");
+		channels = g_slist_append(NULL,
+			g_slist_nth_data(sr_dev_inst_channels_get(sdi), 0));
+		fdata = g_malloc(num_samples * sizeof(float));
+		for (i = 0; i < (unsigned int)num_samples; i++)
+			fdata[i] = (i % 1000) / 100.0;
+		bytes = (uint64_t)num_samples * sizeof(float);
+		advance_base = (const uint8_t *)fdata;
+		advance_bytes = bytes;
+		analog_packet_init(&analog, &encoding, &meaning, &spec, channels);
+		packet.type = SR_DF_ANALOG;
+		packet.payload = &analog;
+		best = G_MAXINT64;
+		for (r = 0; r < num_rounds; r++) {
+			elapsed = output_round(omod, sdi, filename, &packet,
+				bytes, advance_analog);
+			if (elapsed < 0)
+				break;
+			best = MIN(best, elapsed);
+		}
+		if (best != G_MAXINT64)
+			report("output", id, "analog-f32", num_samples, bytes, best);
+		g_slist_free(channels);
+		g_free(fdata);
+	}
+
+	if (filename) {
+		g_unlink(filename);
+		g_free(filename);
+	}
+}
+
+/*
+ * VCD output of sparse signals, where one bit flips every so many
+ * samples. Its cost depends on the rate of changes more than on the
+ * number of samples.
+ */
+static void bench_vcd_sparse(const struct sr_output_module *omod)
+{
+	const uint16_t vcd_unitsizes[] = { 1, 2, 4 };
+	const unsigned int intervals[] = { 1000, 10 };
+	struct sr_dev_inst *sdi;
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_logic logic;
+	char variant[32];
+	uint8_t *data;
+	uint64_t i, bytes;
+	gint64 elapsed, best;
+	unsigned int u, c;
+	uint16_t unitsize;
+	int r;
+
+	for (u = 0; u < G_N_ELEMENTS(vcd_unitsizes); u++) {
+		unitsize = vcd_unitsizes[u];
+		sdi = logic_dev_new(unitsize * 8);
+		bytes = (uint64_t)num_samples * unitsize;
+		data = g_malloc(bytes);
+		for (c = 0; c < G_N_ELEMENTS(intervals); c++) {
+			memset(data, 0, unitsize);
+			for (i = 1; i < (uint64_t)num_samples; i++) {
+				memcpy(data + i * unitsize,
+					data + (i - 1) * unitsize, unitsize);
+				if (i % intervals[c] == 0)
+					data[i * unitsize + i % unitsize] ^=
+						1 << (i % 7);
+			}
+			advance_base = data;
+			advance_bytes = bytes;
+			logic.unitsize = unitsize;
+			packet.type = SR_DF_LOGIC;
+			packet.payload = &logic;
+			best = G_MAXINT64;
+			for (r = 0; r < num_rounds; r++) {
+				elapsed = output_round(omod, sdi, NULL, &packet,
+					bytes, advance_logic);
+				if (elapsed < 0)
+					break;
+				best = MIN(best, elapsed);
+			}
+			if (best == G_MAXINT64)
+				continue;
+			snprintf(variant, sizeof(variant), "sparse%u-u%u",
+				intervals[c], unitsize);
+			report("output", "vcd", variant, num_samples, bytes, best);
+		}
+		g_free(data);
+	}
+}
+
+static void bench_outputs(void)
+{
+	const struct sr_output_module **omods;
+	int i;
+
+	omods = sr_output_list();
+	for (i = 0; omods[i]; i++) {
+		if (!selected("output", sr_output_id_get(omods[i])))
+			continue;
+		bench_output_module(omods[i]);
+		if (!strcmp(sr_output_id_get(omods[i]), "vcd"))
+			bench_vcd_sparse(omods[i]);
+	}
+}
+
+static void bench_analog_to_float(void)
+{
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
+	uint8_t *data;
+	float *outbuf;
+	uint64_t i, offset, bytes, count;
+	gint64 start, elapsed, best;
+	unsigned int f;
+	int r;
+
+	if (!selected("analog", "sr_analog_to_float"))
+		return;
+
+	data = g_malloc((size_t)num_samples * 8);
+	for (i = 0; i < (uint64_t)num_samples * 8; i++)
+		data[i] = i * 13;
+	outbuf = g_malloc(BENCH_CHUNK_SIZE * sizeof(float));
+
+	for (f = 0; f < G_N_ELEMENTS(analog_formats); f++) {
+		analog_packet_init(&analog, &encoding, &meaning, &spec, NULL);
+		encoding.unitsize = analog_formats[f].unitsize;
+		encoding.is_signed = analog_formats[f].is_signed;
+		encoding.is_float = analog_formats[f].is_float;
+		encoding.is_bigendian = (G_BYTE_ORDER == G_BIG_ENDIAN) !=
+			analog_formats[f].swapped;
+		sr_rational_set(&encoding.scale, analog_formats[f].scale_p,
+			analog_formats[f].scale_q);
+		if (encoding.is_float) {
+			/* Keep the input free of NaNs and denormals. */
+			for (i = 0; i < (uint64_t)num_samples; i++) {
+				if (encoding.unitsize == 4)
+					((float *)data)[i] = (i % 1000) / 100.0;
+				else
+					((double *)data)[i] = (i % 1000) / 100.0;
+			}
+			if (analog_formats[f].swapped) {
+				for (i = 0; i < (uint64_t)num_samples; i++)
+					((uint32_t *)data)[i] = GUINT32_SWAP_LE_BE(
+						((uint32_t *)data)[i]);
+			}
+		}
+		bytes = (uint64_t)num_samples * encoding.unitsize;
+		best = G_MAXINT64;
+		for (r = 0; r < num_rounds; r++) {
+			start = g_get_monotonic_time();
+			for (offset = 0; offset < (uint64_t)num_samples;
+					offset += count) {
+				count = MIN(BENCH_CHUNK_SIZE,
+					(uint64_t)num_samples - offset);
+				analog.data = data + offset * encoding.unitsize;
+				analog.num_samples = count;
+				sr_analog_to_float(&analog, outbuf);
+			}
+			elapsed = g_get_monotonic_time() - start;
+			best = MIN(best, elapsed);
+		}
+		report("analog", "sr_analog_to_float", analog_formats[f].name,
+			num_samples, bytes, best);
+	}
+
+	g_free(outbuf);
+	g_free(data);
+}
+
+/*
+ * Analog to logic conversion of 16bit samples: one channel to bytes,
+ * with a threshold or a Schmitt-trigger, and eight channels to the
+ * bits of a logic payload.
+ */
+static void bench_a2l(void)
+{
+	static const char *variants[] = { "threshold", "schmitt", "logic-8ch" };
+	struct sr_datafeed_analog analog[8];
+	const struct sr_datafeed_analog *channels[8];
+	struct sr_analog_encoding encoding[8];
+	struct sr_analog_meaning meaning[8];
+	struct sr_analog_spec spec[8];
+	struct sr_datafeed_logic logic;
+	float lo[8], hi[8];
+	int16_t *data;
+	uint8_t *output, states[8];
+	uint64_t i, offset, count, samples;
+	gint64 start, elapsed, best;
+	unsigned int v, c;
+	int r;
+
+	if (!selected("analog", "sr_a2l"))
+		return;
+
+	data = g_malloc((size_t)num_samples * sizeof(int16_t));
+	for (i = 0; i < (uint64_t)num_samples; i++)
+		data[i] = (i % 1000) * 64 - 32000;
+	output = g_malloc(BENCH_CHUNK_SIZE);
+	for (c = 0; c < G_N_ELEMENTS(analog); c++) {
+		analog_packet_init(&analog[c], &encoding[c], &meaning[c],
+			&spec[c], NULL);
+		encoding[c].unitsize = sizeof(int16_t);
+		encoding[c].is_float = FALSE;
+		sr_rational_set(&encoding[c].scale, 1, 32768);
+		channels[c] = &analog[c];
+		lo[c] = c * 0.1 - 0.5;
+		hi[c] = lo[c] + 0.1;
+		states[c] = 0;
+	}
+
+	for (v = 0; v < G_N_ELEMENTS(variants); v++) {
+		best = G_MAXINT64;
+		for (r = 0; r < num_rounds; r++) {
+			start = g_get_monotonic_time();
+			for (offset = 0; offset < (uint64_t)num_samples;
+					offset += count) {
+				count = MIN(BENCH_CHUNK_SIZE,
+					(uint64_t)num_samples - offset);
+				for (c = 0; c < G_N_ELEMENTS(analog); c++) {
+					analog[c].data = data + offset;
+					analog[c].num_samples = count;
+				}
+				if (v == 0) {
+					sr_a2l_threshold(&analog[0], hi[0],
+						output, count);
+				} else if (v == 1) {
+					sr_a2l_schmitt_trigger(&analog[0], lo[0],
+						hi[0], &states[0], output, count);
+				} else {
+					logic.data = output;
+					logic.unitsize = 1;
+					sr_a2l_threshold_logic(channels, hi,
+						G_N_ELEMENTS(analog), &logic);
+				}
+			}
+			elapsed = g_get_monotonic_time() - start;
+			best = MIN(best, elapsed);
+		}
+		samples = (uint64_t)num_samples * (v == 2 ? G_N_ELEMENTS(analog) : 1);
+		report("analog", "sr_a2l", variants[v], samples,
+			samples * sizeof(int16_t), best);
+	}
+
+	g_free(output);
+	g_free(data);
+}
+
+static void bench_transpose(void)
+{
+	static const struct {
+		const char *variant;
+		unsigned int bits;
+		gboolean msb_first;
+		uint16_t channel_mask;
+	} planar[] = {
+		{ "16ch-16bit-msb", 16, TRUE, 0xffff },
+		{ "8ch-32bit-msb", 32, TRUE, 0x00ff },
+		{ "16ch-64bit-lsb", 64, FALSE, 0xffff },
+	};
+	static const unsigned int sizes[] = { 8, 16, 32, 64 };
+	struct sr_datafeed_logic logic, dense;
+	struct sr_datafeed_logic_planar planes;
+	uint32_t channels[16];
+	uint8_t *in, *out;
+	char variant[16];
+	uint64_t bytes, count, samples;
+	gint64 start, elapsed, best;
+	unsigned int v, n;
+	size_t i;
+	int r;
+
+	bytes = (uint64_t)num_samples * 2;
+	in = g_malloc(bytes + 512);
+	/* Planar data of eight channels turns into twice as many bytes. */
+	out = g_malloc(2 * bytes + 512);
+	for (i = 0; i < bytes; i++)
+		in[i] = (i * 37) ^ (i >> 9);
+
+	if (selected("logic", "sr_transpose")) {
+		for (v = 0; v < G_N_ELEMENTS(sizes); v++) {
+			n = sizes[v];
+			count = bytes / (n * n / 8);
+			best = G_MAXINT64;
+			for (r = 0; r < num_rounds; r++) {
+				start = g_get_monotonic_time();
+				if (n == 8)
+					sr_transpose_8x8(in, out, count);
+				else if (n == 16)
+					sr_transpose_16x16((void *)in, (void *)out, count);
+				else if (n == 32)
+					sr_transpose_32x32((void *)in, (void *)out, count);
+				else
+					sr_transpose_64x64((void *)in, (void *)out, count);
+				elapsed = g_get_monotonic_time() - start;
+				best = MIN(best, elapsed);
+			}
+			/* Each row becomes a sample of n channels. */
+			snprintf(variant, sizeof(variant), "%ux%u", n, n);
+			report("logic", "sr_transpose", variant, count * n,
+				count * n * n / 8, best);
+		}
+	}
+
+	if (selected("logic", "sr_logic_from_planar")) {
+		for (v = 0; v < G_N_ELEMENTS(planar); v++) {
+			n = 0;
+			for (i = 0; i < 16; i++)
+				n += (planar[v].channel_mask >> i) & 1;
+			count = bytes / (n * planar[v].bits / 8);
+			samples = count * planar[v].bits;
+			best = G_MAXINT64;
+			for (r = 0; r < num_rounds; r++) {
+				start = g_get_monotonic_time();
+				sr_logic_from_planar(in, count, planar[v].bits,
+					planar[v].msb_first, planar[v].channel_mask, out);
+				elapsed = g_get_monotonic_time() - start;
+				best = MIN(best, elapsed);
+			}
+			report("logic", "sr_logic_from_planar", planar[v].variant,
+				samples, samples * 2, best);
+		}
+	}
+
+	if (selected("logic", "sr_logic_planar")) {
+		/* All 16 channels of 2 byte samples, both directions. */
+		for (i = 0; i < 16; i++)
+			channels[i] = i;
+		logic.length = bytes;
+		logic.unitsize = 2;
+		logic.data = in;
+		best = G_MAXINT64;
+		for (r = 0; r < num_rounds; r++) {
+			start = g_get_monotonic_time();
+			sr_logic_planar_split(&logic, channels, 16, &planes);
+			elapsed = g_get_monotonic_time() - start;
+			best = MIN(best, elapsed);
+			g_free(planes.data);
+		}
+		report("logic", "sr_logic_planar", "split-16ch",
+			num_samples, bytes, best);
+
+		sr_logic_planar_split(&logic, channels, 16, &planes);
+		best = G_MAXINT64;
+		for (r = 0; r < num_rounds; r++) {
+			start = g_get_monotonic_time();
+			sr_logic_planar_densify(&planes, &dense);
+			elapsed = g_get_monotonic_time() - start;
+			best = MIN(best, elapsed);
+			g_free(dense.data);
+		}
+		g_free(planes.data);
+		report("logic", "sr_logic_planar", "densify-16ch",
+			num_samples, bytes, best);
+	}
+
+	g_free(out);
+	g_free(in);
+}
+
+static void bench_float_list(void)
+{
+	const char *variants[] = { "fixed", "scientific" };
+	GString *text;
+	float *values;
+	size_t count;
+	gint64 start, elapsed, best;
+	unsigned int v;
+	int i, r;
+
+	if (!selected("strutil", "sr_parse_float_list"))
+		return;
+
+	values = g_malloc((size_t)num_samples * sizeof(float));
+	for (v = 0; v < G_N_ELEMENTS(variants); v++) {
+		text = g_string_sized_new((size_t)num_samples * 16);
+		for (i = 0; i < num_samples; i++) {
+			if (v == 0)
+				g_string_append_printf(text, "%s%d.%03d",
+					i ? "," : "", i % 200 - 100, i % 1000);
+			else
+				g_string_append_printf(text, "%s%+.6E",
+					i ? "," : "", (i % 2000 - 1000) * 1.25e-4);
+		}
+		best = G_MAXINT64;
+		count = 0;
+		for (r = 0; r < num_rounds; r++) {
+			start = g_get_monotonic_time();
+			sr_parse_float_list(text->str, values, num_samples, &count);
+			elapsed = g_get_monotonic_time() - start;
+			best = MIN(best, elapsed);
+		}
+		report("strutil", "sr_parse_float_list", variants[v],
+			count, text->len, best);
+		g_string_free(text, TRUE);
+	}
+	g_free(values);
+}
+
+static void datafeed_count(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	struct feed_stats *stats;
+	const struct sr_datafeed_logic *logic;
+	const struct sr_datafeed_analog *analog;
+
+	(void)sdi;
+
+	stats = cb_data;
+	switch (packet->type) {
+	case SR_DF_LOGIC:
+		logic = packet->payload;
+		stats->samples += logic->length / logic->unitsize;
+		stats->bytes += logic->length;
+		break;
+	case SR_DF_LOGIC_RLE:
+		stats->samples += sr_logic_rle_num_samples(packet->payload);
+		break;
+	case SR_DF_ANALOG:
+		analog = packet->payload;
+		stats->samples += analog->num_samples;
+		stats->bytes += analog->num_samples * analog->encoding->unitsize;
+		break;
+	}
+}
+
+/*
+ * Feed a buffer to an input module in chunks (or the file it was saved
+ * to, if given), with the datafeed going to a session (and optionally
+ * through a chain of transform modules, given as their IDs separated
+ * by '+').
+ */
+static gint64 input_round(const char *id, GHashTable *options,
+		const GString *text, const char *filename,
+		const char *transform, struct feed_stats *stats)
+{
+	const struct sr_input_module *imod;
+	const struct sr_transform *t;
+	GSList *transforms, *l;
+	char **tids;
+	struct sr_input *in;
+	struct sr_session *session;
+	struct sr_dev_inst *sdi;
+	GString *chunk;
+	gsize offset, len;
+	gint64 start, elapsed;
+	int ret, i;
+
+	if (!(imod = sr_input_find((char *)id)))
+		return -1;
+	if (!(in = sr_input_new(imod, options)))
+		return -1;
+	tids = transform ? g_strsplit(transform, "+", 0) : NULL;
+
+	sr_session_new(ctx, &session);
+	sr_session_datafeed_callback_add(session, datafeed_count, stats);
+	memset(stats, 0, sizeof(*stats));
+
+	ret = SR_OK;
+	transforms = NULL;
+	sdi = NULL;
+	chunk = g_string_sized_new(BENCH_CHUNK_SIZE);
+	start = g_get_monotonic_time();
+	for (offset = 0; offset < text->len && ret == SR_OK; offset += len) {
+		if (filename) {
+			/* Returns once the device is ready, see below. */
+			len = text->len;
+			ret = sr_input_load_file(in, filename);
+		} else {
+			len = MIN(BENCH_CHUNK_SIZE, text->len - offset);
+			g_string_truncate(chunk, 0);
+			g_string_append_len(chunk, text->str + offset, len);
+			ret = sr_input_send(in, chunk);
+		}
+		/* Modules announce their device before sending any data. */
+		if (!sdi && (sdi = sr_input_dev_inst_get(in))) {
+			sr_session_dev_add(session, sdi);
+			for (i = 0; tids && tids[i]; i++) {
+				t = sr_transform_new(sr_transform_find(tids[i]),
+					NULL, sdi);
+				transforms = g_slist_append(transforms, (void *)t);
+			}
+		}
+		/* Send the rest of the file. */
+		if (filename && ret == SR_OK)
+			ret = sr_input_load_file(in, filename);
+	}
+	if (ret == SR_OK)
+		ret = sr_input_end(in);
+	elapsed = g_get_monotonic_time() - start;
+	g_string_free(chunk, TRUE);
+
+	sr_session_dev_remove_all(session);
+	for (l = transforms; l; l = l->next)
+		sr_transform_free(l->data);
+	g_slist_free(transforms);
+	g_strfreev(tids);
+	sr_input_free(in);
+	sr_session_destroy(session);
+
+	return ret == SR_OK ? elapsed : -1;
+}
+
+static void bench_input(const char *category, const char *id,
+		const char *variant, GHashTable *options, const GString *text,
+		const char *transform)
+{
+	struct feed_stats stats;
+	gint64 elapsed, best;
+	uint64_t bytes;
+	int r;
+
+	best = G_MAXINT64;
+	for (r = 0; r < num_rounds; r++) {
+		elapsed = input_round(id, options, text, NULL, transform,
+			&stats);
+		if (elapsed < 0) {
+			fprintf(stderr, "%s/%s %s failed.\n", category,
+				transform ? transform : id, variant);
+			return;
+		}
+		best = MIN(best, elapsed);
+	}
+
+	/* Transforms are about the samples, inputs about the text. */
+	bytes = transform ? stats.bytes : text->len;
+	report(category, transform ? transform : id, variant,
+		stats.samples, bytes, best);
+}
+
+/* Like bench_input(), but with the text loaded from a file. */
+static void bench_input_file(const char *category, const char *id,
+		const char *variant, GHashTable *options, const GString *text)
+{
+	struct feed_stats stats;
+	gint64 elapsed, best;
+	char *filename;
+	int fd, r;
+
+	fd = g_file_open_tmp("libsigrok-bench-XXXXXX", &filename, NULL);
+	if (fd < 0)
+		return;
+	close(fd);
+	if (!g_file_set_contents(filename, text->str, text->len, NULL)) {
+		g_unlink(filename);
+		g_free(filename);
+		return;
+	}
+
+	best = G_MAXINT64;
+	for (r = 0; r < num_rounds; r++) {
+		elapsed = input_round(id, options, text, filename, NULL, &stats);
+		if (elapsed < 0) {
+			fprintf(stderr, "%s/%s %s failed.\n", category, id, variant);
+			break;
+		}
+		best = MIN(best, elapsed);
+	}
+	if (best != G_MAXINT64)
+		report(category, id, variant, stats.samples, text->len, best);
+
+	g_unlink(filename);
+	g_free(filename);
+}
+
+static GHashTable *options_new(void)
+{
+	return g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+		(GDestroyNotify)g_variant_unref);
+}
+
+static void option_set(GHashTable *options, const char *key, GVariant *value)
+{
+	g_hash_table_insert(options, g_strdup(key), g_variant_ref_sink(value));
+}
+
+static GString *binary_text_new(uint16_t unitsize)
+{
+	uint8_t *data;
+
+	data = logic_data_new(unitsize);
+
+	return g_string_new_len((const char *)data,
+		(gssize)num_samples * unitsize);
+}
+
+static GString *raw_analog_text_new(void)
+{
+	GString *text;
+	float value;
+	gint i;
+
+	text = g_string_sized_new(num_samples * sizeof(float));
+	for (i = 0; i < num_samples; i++) {
+		value = (i % 1000) / 100.0;
+		g_string_append_len(text, (const char *)&value, sizeof(value));
+	}
+
+	return text;
+}
+
+/* One hex value per line, of the same counter as logic_data_new(). */
+static GString *csv_text_new(uint16_t unitsize)
+{
+	GString *text;
+	uint64_t value, mask;
+	gint i;
+
+	mask = unitsize < 8 ? (1ULL << (8 * unitsize)) - 1 : G_MAXUINT64;
+	text = g_string_sized_new(num_samples * (2 * unitsize + 1));
+	for (i = 0; i < num_samples; i++) {
+		value = (i / 8) & mask;
+		g_string_append_printf(text, "%0*" PRIx64 "\n",
+			2 * unitsize, value);
+	}
+
+	return text;
+}
+
+/*
+ * A timestamp, eight single-bit columns of the same counter and two
+ * trailing (unused) analog values per line, which stresses the column
+ * splitting.
+ */
+static GString *csv_columns_text_new(void)
+{
+	GString *text;
+	unsigned int ch, value;
+	gint i;
+
+	text = g_string_sized_new(num_samples * 40);
+	for (i = 0; i < num_samples; i++) {
+		value = i / 8;
+		g_string_append_printf(text, "%.7f", i * 1e-6);
+		for (ch = 0; ch < 8; ch++)
+			g_string_append_printf(text, ",%u", (value >> ch) & 1);
+		g_string_append_printf(text, ",%.3f,%.3f\n",
+			(i % 1000) / 100.0, (i % 500) / -50.0);
+	}
+
+	return text;
+}
+
+/* Changes at the counter's rate, one timestamp per change. */
+static GString *vcd_text_new(uint16_t unitsize)
+{
+	GString *text;
+	uint64_t prev, value, changed;
+	unsigned int num_channels, ch;
+	gint i;
+
+	num_channels = unitsize * 8;
+	text = g_string_new("$timescale 10 ns $end\n$scope module bench $end\n");
+	for (ch = 0; ch < num_channels; ch++)
+		g_string_append_printf(text, "$var wire 1 %c D%u $end\n",
+			'!' + ch, ch);
+	g_string_append(text, "$upscope $end\n$enddefinitions $end\n");
+
+	prev = 0;
+	for (i = 0; i < num_samples; i += 8) {
+		value = i / 8;
+		changed = i ? prev ^ value : G_MAXUINT64;
+		g_string_append_printf(text, "#%d", i);
+		for (ch = 0; ch < num_channels && ch < 64; ch++) {
+			if (changed & (1ULL << ch))
+				g_string_append_printf(text, " %c%c",
+					(value & (1ULL << ch)) ? '1' : '0',
+					'!' + ch);
+		}
+		g_string_append_c(text, '\n');
+		prev = value;
+	}
+	g_string_append_printf(text, "#%d\n", num_samples);
+
+	return text;
+}
+
+static void bench_inputs(void)
+{
+	GHashTable *options;
+	GString *text;
+	char variant[32], mapped[40], fmt[16];
+	unsigned int u;
+
+	for (u = 0; u < G_N_ELEMENTS(unitsizes); u++) {
+		snprintf(variant, sizeof(variant), "logic-u%u", unitsizes[u]);
+
+		if (selected("input", "binary")) {
+			options = options_new();
+			option_set(options, "numchannels",
+				g_variant_new_int32(unitsizes[u] * 8));
+			text = binary_text_new(unitsizes[u]);
+			bench_input("input", "binary", variant, options, text, NULL);
+			snprintf(mapped, sizeof(mapped), "%s-mapped", variant);
+			bench_input_file("input", "binary", mapped, options, text);
+			g_string_free(text, TRUE);
+			g_hash_table_destroy(options);
+		}
+
+		if (selected("input", "csv")) {
+			options = options_new();
+			snprintf(fmt, sizeof(fmt), "x%u", unitsizes[u] * 8);
+			option_set(options, "column_formats",
+				g_variant_new_string(fmt));
+			option_set(options, "header", g_variant_new_boolean(FALSE));
+			text = csv_text_new(unitsizes[u]);
+			bench_input("input", "csv", variant, options, text, NULL);
+			g_string_free(text, TRUE);
+			g_hash_table_destroy(options);
+		}
+
+		if (selected("input", "vcd")) {
+			text = vcd_text_new(unitsizes[u]);
+			bench_input("input", "vcd", variant, NULL, text, NULL);
+			g_string_free(text, TRUE);
+		}
+	}
+
+	if (selected("input", "csv")) {
+		options = options_new();
+		option_set(options, "column_formats",
+			g_variant_new_string("t,8l"));
+		option_set(options, "header", g_variant_new_boolean(FALSE));
+		option_set(options, "samplerate",
+			g_variant_new_uint64(SR_MHZ(1)));
+		text = csv_columns_text_new();
+		bench_input("input", "csv", "columns-t8l", options, text, NULL);
+		g_string_free(text, TRUE);
+		g_hash_table_destroy(options);
+	}
+
+	if (selected("input", "raw_analog")) {
+		options = options_new();
+		option_set(options, "format", g_variant_new_string(
+			G_BYTE_ORDER == G_BIG_ENDIAN ? "FLOAT_BE" : "FLOAT_LE"));
+		option_set(options, "numchannels", g_variant_new_int32(1));
+		text = raw_analog_text_new();
+		bench_input("input", "raw_analog", "analog-f32", options, text, NULL);
+		bench_input_file("input", "raw_analog", "analog-f32-mapped",
+			options, text);
+		g_string_free(text, TRUE);
+		g_hash_table_destroy(options);
+	}
+}
+
+/* Chains of transforms, which the session fuses into a single pass. */
+static const char *transform_chains[] = {
+	"invert+mask+invert",
+	"invert+scale+nop",
+};
+
+static void bench_transform(const char *id)
+{
+	GHashTable *options;
+	GString *text;
+	char variant[32];
+	unsigned int u;
+
+	if (!selected("transform", id))
+		return;
+
+	for (u = 0; u < G_N_ELEMENTS(unitsizes); u++) {
+		snprintf(variant, sizeof(variant), "logic-u%u", unitsizes[u]);
+		options = options_new();
+		option_set(options, "numchannels",
+			g_variant_new_int32(unitsizes[u] * 8));
+		text = binary_text_new(unitsizes[u]);
+		bench_input("transform", "binary", variant, options,
+			text, id);
+		g_string_free(text, TRUE);
+		g_hash_table_destroy(options);
+	}
+
+	options = options_new();
+	option_set(options, "format", g_variant_new_string(
+		G_BYTE_ORDER == G_BIG_ENDIAN ? "FLOAT_BE" : "FLOAT_LE"));
+	option_set(options, "numchannels", g_variant_new_int32(1));
+	text = raw_analog_text_new();
+	bench_input("transform", "raw_analog", "analog-f32", options,
+		text, id);
+	g_string_free(text, TRUE);
+	g_hash_table_destroy(options);
+}
+
+static void bench_transforms(void)
+{
+	const struct sr_transform_module **tmods;
+	unsigned int i;
+
+	tmods = sr_transform_list();
+	for (i = 0; tmods[i]; i++)
+		bench_transform(sr_transform_id_get(tmods[i]));
+	for (i = 0; i < G_N_ELEMENTS(transform_chains); i++)
+		bench_transform(transform_chains[i]);
+}
+
+static struct sr_dev_driver *demo_driver(void)
+{
+	static struct sr_dev_driver *driver;
+	struct sr_dev_driver **drivers;
+	int i;
+
+	if (driver)
+		return driver;
+
+	drivers = sr_driver_list(ctx);
+	for (i = 0; drivers && drivers[i]; i++) {
+		if (strcmp(drivers[i]->name, "demo"))
+			continue;
+		if (sr_driver_init(ctx, drivers[i]) == SR_OK)
+			driver = drivers[i];
+		break;
+	}
+
+	return driver;
+}
+
+static struct sr_dev_inst *demo_dev_new(unsigned int num_logic)
+{
+	struct sr_dev_driver *driver;
+	struct sr_config src[2];
+	GSList *options, *devices;
+	struct sr_dev_inst *sdi;
+
+	if (!(driver = demo_driver()))
+		return NULL;
+
+	src[0].key = SR_CONF_NUM_LOGIC_CHANNELS;
+	src[0].data = g_variant_new_int32(num_logic);
+	src[1].key = SR_CONF_NUM_ANALOG_CHANNELS;
+	src[1].data = g_variant_new_int32(0);
+	options = g_slist_append(g_slist_append(NULL, &src[0]), &src[1]);
+	devices = sr_driver_scan(driver, options);
+	g_slist_free(options);
+	g_variant_unref(src[0].data);
+	g_variant_unref(src[1].data);
+	if (!devices)
+		return NULL;
+	sdi = devices->data;
+	g_slist_free(devices);
+
+	return sdi;
+}
+
+static void bench_demo(void)
+{
+	struct sr_session *session;
+	struct sr_dev_inst *sdi;
+	struct feed_stats stats;
+	char variant[32];
+	gint64 start, elapsed, best;
+	unsigned int u;
+	int r;
+
+	if (!selected("session", "demo"))
+		return;
+
+	for (u = 0; u < G_N_ELEMENTS(unitsizes); u++) {
+		if (!(sdi = demo_dev_new(unitsizes[u] * 8)))
+			return;
+		if (sr_dev_open(sdi) != SR_OK)
+			return;
+		sr_config_set(sdi, NULL, SR_CONF_SAMPLERATE,
+			g_variant_new_uint64(SR_GHZ(1)));
+		sr_config_set(sdi, NULL, SR_CONF_LIMIT_SAMPLES,
+			g_variant_new_uint64(num_samples));
+
+		best = G_MAXINT64;
+		for (r = 0; r < num_rounds; r++) {
+			sr_session_new(ctx, &session);
+			sr_session_dev_add(session, sdi);
+			memset(&stats, 0, sizeof(stats));
+			sr_session_datafeed_callback_add(session,
+				datafeed_count, &stats);
+			start = g_get_monotonic_time();
+			if (sr_session_start(session) == SR_OK)
+				sr_session_run(session);
+			elapsed = g_get_monotonic_time() - start;
+			sr_session_destroy(session);
+			best = MIN(best, elapsed);
+		}
+		sr_dev_close(sdi);
+
+		snprintf(variant, sizeof(variant), "logic-u%u", unitsizes[u]);
+		report("session", "demo", variant, stats.samples,
+			stats.bytes, best);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	GOptionContext *context;
+	GError *error;
+
+	context = g_option_context_new(NULL);
+	g_option_context_set_summary(context,
+		"Measure the throughput of libsigrok's datafeed pipeline.");
+	g_option_context_add_main_entries(context, entries, NULL);
+	error = NULL;
+	if (!g_option_context_parse(context, &argc, &argv, &error)) {
+		fprintf(stderr, "%s\n", error->message);
+		g_error_free(error);
+		g_option_context_free(context);
+		return EXIT_FAILURE;
+	}
+	g_option_context_free(context);
+	if (num_samples < 1 || num_rounds < 1) {
+		fprintf(stderr, "Samples and rounds must be positive.\n");
+		return EXIT_FAILURE;
+	}
+
+	if (sr_init(&ctx) != SR_OK)
+		return EXIT_FAILURE;
+	sr_log_loglevel_set(SR_LOG_ERR);
+
+	printf("# category\tmodule\tvariant\tsamples\tbytes\tseconds"
+		"\tMB/s\tMsamples/s\n");
+	bench_outputs();
+	bench_analog_to_float();
+	bench_a2l();
+	bench_transpose();
+	bench_float_list();
+	bench_inputs();
+	bench_transforms();
+	bench_demo();
+
+	sr_exit(ctx);
+	g_strfreev(filters);
+
+	return EXIT_SUCCESS;
+}
@@ -211,6 +211,353 @@ START_TEST(test_endian_write_inc)
 }
 END_TEST
 
+/* Set up a single channel analog packet of 16bit signed samples. */
+static void a2l_test_setup(struct sr_datafeed_analog *analog,
+		struct sr_analog_encoding *encoding,
+		struct sr_analog_meaning *meaning, struct sr_channel *ch,
+		const int16_t *data, unsigned int count)
+{
+	memset(analog, 0, sizeof(*analog));
+	memset(encoding, 0, sizeof(*encoding));
+	memset(meaning, 0, sizeof(*meaning));
+	encoding->unitsize = sizeof(int16_t);
+	encoding->is_signed = TRUE;
+#ifdef WORDS_BIGENDIAN
+	encoding->is_bigendian = TRUE;
+#endif
+	encoding->scale.p = 5;
+	encoding->scale.q = 1024;
+	encoding->offset.p = -1;
+	encoding->offset.q = 4;
+	meaning->channels = g_slist_append(NULL, ch);
+	analog->encoding = encoding;
+	analog->meaning = meaning;
+	analog->data = (void *)data;
+	analog->num_samples = count;
+}
+
+/* Check that thresholds on raw samples match those on float values. */
+START_TEST(test_a2l_threshold)
+{
+	const float thresholds[] = { -80.0, -0.25, 0.0, 3.3, 1e9 };
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_channel ch;
+	int16_t data[1000];
+	float values[1000];
+	uint8_t output[1000];
+	unsigned int i, t, count;
+	int ret;
+
+	for (i = 0; i < ARRAY_SIZE(data); i++)
+		data[i] = (i * 7919) & 0xffff;
+
+	for (t = 0; t < ARRAY_SIZE(thresholds); t++) {
+		for (count = 0; count < 1000; count = count * 2 + 1) {
+			a2l_test_setup(&analog, &encoding, &meaning, &ch,
+				data, count);
+			sr_analog_to_float(&analog, values);
+			ret = sr_a2l_threshold(&analog, thresholds[t],
+				output, count);
+			fail_unless(ret == SR_OK, "sr_a2l_threshold() failed: %d.", ret);
+			for (i = 0; i < count; i++)
+				fail_unless(output[i] == (values[i] >= thresholds[t]),
+					"Sample %u (%f) vs. %f: %u.", i, values[i],
+					thresholds[t], output[i]);
+			g_slist_free(meaning.channels);
+		}
+	}
+}
+END_TEST
+
+/* Check the Schmitt-trigger, with the state carried across calls. */
+START_TEST(test_a2l_schmitt_trigger)
+{
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_channel ch;
+	int16_t data[1000];
+	float values[1000];
+	uint8_t output[1000], state, expected;
+	unsigned int i, split;
+
+	for (i = 0; i < ARRAY_SIZE(data); i++)
+		data[i] = (i * 7919) & 0xffff;
+	a2l_test_setup(&analog, &encoding, &meaning, &ch, data, 1000);
+	sr_analog_to_float(&analog, values);
+
+	for (split = 0; split < 1000; split += 131) {
+		state = 1;
+		analog.data = data;
+		analog.num_samples = split;
+		sr_a2l_schmitt_trigger(&analog, -20.0, 30.0, &state,
+			output, split);
+		analog.data = data + split;
+		analog.num_samples = 1000 - split;
+		sr_a2l_schmitt_trigger(&analog, -20.0, 30.0, &state,
+			output + split, 1000 - split);
+
+		expected = 1;
+		for (i = 0; i < 1000; i++) {
+			if (values[i] < -20.0)
+				expected = 0;
+			else if (values[i] > 30.0)
+				expected = 1;
+			fail_unless(output[i] == expected,
+				"Sample %u: %u, expected %u.", i, output[i], expected);
+		}
+		fail_unless(state == expected);
+	}
+	g_slist_free(meaning.channels);
+}
+END_TEST
+
+/* Check that channels end up in the respective bits of logic samples. */
+START_TEST(test_a2l_threshold_logic)
+{
+	struct sr_datafeed_analog analog[11];
+	const struct sr_datafeed_analog *channels[11];
+	struct sr_analog_encoding encoding[11];
+	struct sr_analog_meaning meaning[11];
+	struct sr_channel ch;
+	struct sr_datafeed_logic logic;
+	int16_t data[11][300];
+	float thresholds[11];
+	uint8_t output[300], samples[3 * 300];
+	unsigned int c, i;
+	int ret;
+
+	for (c = 0; c < ARRAY_SIZE(analog); c++) {
+		for (i = 0; i < 300; i++)
+			data[c][i] = ((c + 1) * i * 7919) & 0xffff;
+		a2l_test_setup(&analog[c], &encoding[c], &meaning[c], &ch,
+			data[c], 300);
+		channels[c] = &analog[c];
+		thresholds[c] = c * 10.0 - 50.0;
+	}
+
+	memset(samples, 0xff, sizeof(samples));
+	logic.data = samples;
+	logic.unitsize = 3;
+	ret = sr_a2l_threshold_logic(channels, thresholds, 11, &logic);
+	fail_unless(ret == SR_OK, "sr_a2l_threshold_logic() failed: %d.", ret);
+	fail_unless(logic.length == sizeof(samples));
+
+	for (c = 0; c < ARRAY_SIZE(analog); c++) {
+		sr_a2l_threshold(&analog[c], thresholds[c], output, 300);
+		for (i = 0; i < 300; i++)
+			fail_unless(((read_u24le(&samples[3 * i]) >> c) & 1) == output[i],
+				"Channel %u, sample %u.", c, i);
+	}
+	for (i = 0; i < 300; i++)
+		fail_unless((read_u24le(&samples[3 * i]) >> 11) == 0);
+
+	logic.unitsize = 1;
+	ret = sr_a2l_threshold_logic(channels, thresholds, 11, &logic);
+	fail_unless(ret == SR_ERR_ARG);
+
+	for (c = 0; c < ARRAY_SIZE(analog); c++)
+		g_slist_free(meaning[c].channels);
+}
+END_TEST
+
+/* Bit c of row r in matrix k, for rows of n bits. */
+static unsigned int transpose_test_bit(const void *m, unsigned int n,
+		size_t k, unsigned int r, unsigned int c)
+{
+	uint64_t row;
+
+	switch (n) {
+	case 8:
+		row = ((const uint8_t *)m)[8 * k + r];
+		break;
+	case 16:
+		row = ((const uint16_t *)m)[16 * k + r];
+		break;
+	case 32:
+		row = ((const uint32_t *)m)[32 * k + r];
+		break;
+	default:
+		row = ((const uint64_t *)m)[64 * k + r];
+		break;
+	}
+
+	return (row >> c) & 1;
+}
+
+/* Check the bit matrix transposes against a bit by bit one. */
+START_TEST(test_transpose)
+{
+	uint64_t in[64 * 5], out[64 * 5 + 1];
+	uint32_t x;
+	unsigned int n, r, c;
+	size_t i, k, count;
+
+	x = 1;
+	for (i = 0; i < ARRAY_SIZE(in); i++) {
+		x = x * 1103515245 + 12345;
+		in[i] = ((uint64_t)x << 32) ^ (x >> 7) ^ i;
+	}
+
+	for (n = 8; n <= 64; n *= 2) {
+		for (count = 1; count <= 5; count++) {
+			memset(out, 0xa5, sizeof(out));
+			if (n == 8)
+				sr_transpose_8x8((void *)in, (void *)out, count);
+			else if (n == 16)
+				sr_transpose_16x16((void *)in, (void *)out, count);
+			else if (n == 32)
+				sr_transpose_32x32((void *)in, (void *)out, count);
+			else
+				sr_transpose_64x64(in, out, count);
+			for (k = 0; k < count; k++) {
+				for (r = 0; r < n; r++) {
+					for (c = 0; c < n; c++) {
+						fail_unless(transpose_test_bit(out, n, k, r, c)
+							== transpose_test_bit(in, n, k, c, r),
+							"%ux%u matrix %zu: bit %u of row %u is wrong.",
+							n, n, k, c, r);
+					}
+				}
+			}
+			fail_unless(((uint8_t *)out)[count * n * n / 8] == 0xa5,
+				"%ux%u wrote past %zu matrices.", n, n, count);
+		}
+	}
+}
+END_TEST
+
+/*
+ * Check planar logic data against a sample by sample conversion, as the
+ * Logic16 (16bit words, MSB first), Logic Pro (32bit, MSB first) and
+ * DSLogic (64bit, LSB first) drivers used to do.
+ */
+START_TEST(test_transpose_planar)
+{
+	const uint16_t masks[] = { 0xffff, 0x0001, 0x00ff, 0x8421, 0xfffe };
+	const unsigned int widths[] = { 16, 32, 64 };
+	uint8_t planar[16 * 8 * 100], logic[2 * 64 * 100];
+	uint16_t expected;
+	uint64_t word;
+	uint32_t x;
+	unsigned int m, w, bits, c, ch, num_channels, s, bit;
+	size_t i, b, num_blocks, block_size;
+	gboolean msb_first;
+	int ret;
+
+	x = 1;
+	for (i = 0; i < sizeof(planar); i++) {
+		x = x * 1103515245 + 12345;
+		planar[i] = x >> 16;
+	}
+
+	for (m = 0; m < ARRAY_SIZE(masks); m++) {
+		for (w = 0; w < ARRAY_SIZE(widths); w++) {
+			bits = widths[w];
+			msb_first = bits != 64;
+			num_channels = 0;
+			for (c = 0; c < 16; c++)
+				num_channels += (masks[m] >> c) & 1;
+			block_size = num_channels * bits / 8;
+			num_blocks = sizeof(planar) / 16 / 8;
+			ret = sr_logic_from_planar(planar, num_blocks, bits,
+				msb_first, masks[m], logic);
+			fail_unless(ret == SR_OK);
+			for (b = 0; b < num_blocks; b++) {
+				for (s = 0; s < bits; s++) {
+					bit = msb_first ? bits - 1 - s : s;
+					expected = 0;
+					ch = 0;
+					for (c = 0; c < 16; c++) {
+						if (!(masks[m] & (1 << c)))
+							continue;
+						word = RL64(&planar[b * block_size
+							+ ch++ * bits / 8]);
+						if ((word >> bit) & 1)
+							expected |= 1 << c;
+					}
+					fail_unless(RL16(&logic[2 * (b * bits + s)]) == expected,
+						"Mask 0x%04x, %u bits: sample %zu wrong.",
+						masks[m], bits, b * bits + s);
+				}
+			}
+		}
+	}
+
+	ret = sr_logic_from_planar(planar, 1, 8, FALSE, 0xffff, logic);
+	fail_unless(ret == SR_ERR_ARG);
+	ret = sr_logic_from_planar(planar, 1, 16, FALSE, 0, logic);
+	fail_unless(ret == SR_ERR_ARG);
+}
+END_TEST
+
+/* Allowed SIMD extensions, from all the CPU has down to none. */
+static const unsigned int simd_limits[] = {
+	~0U, ~SR_SIMD_AVX2, 0,
+};
+
+/*
+ * Check the split of interleaved logic and analog samples at each SIMD
+ * level, for lengths which leave tails of any size to the portable code,
+ * and for unaligned input.
+ */
+START_TEST(test_split_logic_analog)
+{
+	const size_t sizes[][2] = { { 1, 1 }, { 2, 1 }, { 1, 2 }, { 2, 2 } };
+	uint8_t data[4 * 300 + 1], logic[2 * 300 + 1], analog[2 * 300 + 1];
+	size_t i, b, num, offset, logic_size, analog_size, stride;
+	unsigned int l, z;
+	uint32_t x;
+
+	x = 1;
+	for (i = 0; i < sizeof(data); i++) {
+		x = x * 1103515245 + 12345;
+		data[i] = x >> 16;
+	}
+
+	for (l = 0; l < ARRAY_SIZE(simd_limits); l++) {
+		sr_simd_features_limit(simd_limits[l]);
+		for (z = 0; z < ARRAY_SIZE(sizes); z++) {
+			logic_size = sizes[z][0];
+			analog_size = sizes[z][1];
+			stride = logic_size + analog_size;
+			for (num = 0; num <= 300; num += (num < 70) ? 1 : 23) {
+				for (offset = 0; offset < 2; offset++) {
+					memset(logic, 0xa5, sizeof(logic));
+					memset(analog, 0xa5, sizeof(analog));
+					sr_split_logic_analog(data + offset, num,
+						logic_size, analog_size, logic, analog);
+					for (i = 0; i < num; i++) {
+						for (b = 0; b < logic_size; b++)
+							fail_unless(logic[i * logic_size + b] ==
+								data[offset + i * stride + b],
+								"SIMD 0x%x, %zu+%zu bytes: logic "
+								"sample %zu of %zu wrong.",
+								simd_limits[l], logic_size,
+								analog_size, i, num);
+						for (b = 0; b < analog_size; b++)
+							fail_unless(analog[i * analog_size + b] ==
+								data[offset + i * stride +
+								logic_size + b],
+								"SIMD 0x%x, %zu+%zu bytes: analog "
+								"sample %zu of %zu wrong.",
+								simd_limits[l], logic_size,
+								analog_size, i, num);
+					}
+					fail_unless(logic[num * logic_size] == 0xa5 &&
+						analog[num * analog_size] == 0xa5,
+						"SIMD 0x%x: wrote past %zu samples.",
+						simd_limits[l], num);
+				}
+			}
+		}
+	}
+	sr_simd_features_limit(~0U);
+}
+END_TEST
+
 Suite *suite_conv(void)
 {
 	Suite *s;
@@ -226,5 +573,20 @@ Suite *suite_conv(void)
 	tcase_add_test(tc, test_endian_write_inc);
 	suite_add_tcase(s, tc);
 
+	tc = tcase_create("a2l");
+	tcase_add_test(tc, test_a2l_threshold);
+	tcase_add_test(tc, test_a2l_schmitt_trigger);
+	tcase_add_test(tc, test_a2l_threshold_logic);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("transpose");
+	tcase_add_test(tc, test_transpose);
+	tcase_add_test(tc, test_transpose_planar);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("split");
+	tcase_add_test(tc, test_split_logic_analog);
+	suite_add_tcase(s, tc);
+
 	return s;
 }
@@ -18,6 +18,8 @@
  */
 
 #include <config.h>
+#include <math.h>
+#include <unistd.h>
 #include <check.h>
 #include <glib/gstdio.h>
 #include <libsigrok/libsigrok.h>
@@ -308,6 +310,244 @@ START_TEST(test_input_binary_hello_world)
 }
 END_TEST
 
+/* Larger than the chunks which get buffered before the device is ready. */
+#define FILESIZE (5 * 1000 * 1000)
+
+START_TEST(test_input_binary_load_file)
+{
+	const struct sr_input_module *imod;
+	const struct sr_input *in;
+	struct sr_session *session;
+	struct sr_dev_inst *sdi;
+	uint8_t *buf;
+	char *filename;
+	int fd;
+
+	buf = g_malloc(FILESIZE);
+	memset(buf, 0xff, FILESIZE);
+	fd = g_file_open_tmp("sigrok-test-XXXXXX", &filename, NULL);
+	fail_unless(fd >= 0, "Failed to create temporary file.");
+	close(fd);
+	fail_unless(g_file_set_contents(filename, (const gchar *)buf,
+		FILESIZE, NULL), "Failed to write temporary file.");
+
+	df_packet_counter = sample_counter = 0;
+	have_seen_df_end = FALSE;
+	logic_channellist = NULL;
+	check_to_perform = CHECK_ALL_HIGH;
+	expected_samples = FILESIZE;
+	expected_samplerate = NULL;
+
+	imod = sr_input_find("binary");
+	fail_unless(imod != NULL, "Failed to find input module.");
+	in = sr_input_new(imod, NULL);
+	fail_unless(in != NULL, "Failed to create input instance.");
+
+	sr_session_new(srtest_ctx, &session);
+	sr_session_datafeed_callback_add(session, datafeed_in, NULL);
+
+	/* The first call returns once the device is ready. */
+	fail_unless(sr_input_load_file(in, filename) == SR_OK);
+	sdi = sr_input_dev_inst_get(in);
+	fail_unless(sdi != NULL, "Device not ready after loading.");
+	fail_unless(sample_counter == 0, "Samples sent before device was ready.");
+	sr_session_dev_add(session, sdi);
+	fail_unless(sr_input_load_file(in, filename) == SR_OK);
+	fail_unless(sr_input_load_file(in, filename) == SR_OK);
+	fail_unless(sr_input_end(in) == SR_OK);
+	fail_unless(have_seen_df_end, "No SR_DF_END packet seen.");
+
+	sr_input_free(in);
+	sr_session_destroy(session);
+	g_unlink(filename);
+	g_free(filename);
+	g_free(buf);
+}
+END_TEST
+
+/* Collect the planes into dense samples, to compare with the input. */
+static void datafeed_planar(const struct sr_dev_inst *sdi,
+	const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	struct sr_datafeed_logic logic;
+	GString *samples;
+
+	(void)sdi;
+
+	samples = cb_data;
+	if (packet->type == SR_DF_LOGIC)
+		fail("Expected SR_DF_LOGIC_PLANAR packets.");
+	if (packet->type != SR_DF_LOGIC_PLANAR)
+		return;
+	fail_unless(sr_logic_planar_densify(packet->payload, &logic) == SR_OK);
+	g_string_append_len(samples, logic.data, logic.length);
+	g_free(logic.data);
+}
+
+START_TEST(test_input_binary_threads)
+{
+	const struct sr_input_module *imod;
+	const struct sr_input *in;
+	struct sr_session *session;
+	GHashTable *options;
+	GString *buf, *samples;
+	unsigned int i;
+
+	/* 12 channels, in blocks which aren't a multiple of eight samples. */
+	buf = g_string_sized_new(BUFSIZE);
+	for (i = 0; i < BUFSIZE / 2; i++) {
+		g_string_append_c(buf, i * 7);
+		g_string_append_c(buf, (i / 3) & 0x0f);
+	}
+	options = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+			(GDestroyNotify)g_variant_unref);
+	g_hash_table_insert(options, g_strdup("numchannels"),
+			g_variant_ref_sink(g_variant_new_int32(12)));
+	g_hash_table_insert(options, g_strdup("threads"),
+			g_variant_ref_sink(g_variant_new_int32(3)));
+	g_hash_table_insert(options, g_strdup("blocksize"),
+			g_variant_ref_sink(g_variant_new_uint64(1001)));
+
+	imod = sr_input_find("binary");
+	fail_unless(imod != NULL, "Failed to find input module.");
+	in = sr_input_new(imod, options);
+	fail_unless(in != NULL, "Failed to create input instance.");
+
+	samples = g_string_new(NULL);
+	sr_session_new(srtest_ctx, &session);
+	sr_session_datafeed_planar_callback_add(session, datafeed_planar,
+		samples);
+
+	fail_unless(sr_input_send(in, buf) == SR_OK);
+	sr_session_dev_add(session, sr_input_dev_inst_get(in));
+	fail_unless(sr_input_send(in, buf) == SR_OK);
+	fail_unless(sr_input_end(in) == SR_OK);
+
+	/* The first buffer gets sent once the device is in the session. */
+	fail_unless(samples->len == 2 * buf->len,
+		"Expected %zu bytes of samples, got %zu.",
+		2 * buf->len, samples->len);
+	fail_unless(!memcmp(samples->str, buf->str, buf->len));
+	fail_unless(!memcmp(samples->str + buf->len, buf->str, buf->len));
+
+	sr_input_free(in);
+	sr_session_destroy(session);
+	g_hash_table_destroy(options);
+	g_string_free(samples, TRUE);
+	g_string_free(buf, TRUE);
+}
+END_TEST
+
+/* Collect the floats of analog packets, which must come converted. */
+static void datafeed_float(const struct sr_dev_inst *sdi,
+	const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	const struct sr_datafeed_analog *analog;
+	GArray *values;
+
+	(void)sdi;
+
+	values = cb_data;
+	if (packet->type != SR_DF_ANALOG)
+		return;
+	analog = packet->payload;
+	fail_unless(analog->encoding->is_float &&
+		analog->encoding->unitsize == sizeof(float),
+		"Expected float samples.");
+	g_array_append_vals(values, analog->data,
+		analog->num_samples * g_slist_length(analog->meaning->channels));
+}
+
+/* Check that raw_analog converts to the same floats on its workers. */
+START_TEST(test_input_raw_analog_threads)
+{
+	const struct sr_input_module *imod;
+	const struct sr_input *in;
+	struct sr_session *session;
+	struct sr_channel ch;
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
+	GHashTable *options;
+	GString *buf, *part;
+	GArray *values;
+	float *expected;
+	unsigned int i, count;
+
+	/* Two S16_LE channels, the second send completes a sample. */
+	buf = g_string_sized_new(BUFSIZE);
+	for (i = 0; i < BUFSIZE; i++)
+		g_string_append_c(buf, i * 7 + i / 251);
+	count = BUFSIZE / 2;
+	options = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+			(GDestroyNotify)g_variant_unref);
+	g_hash_table_insert(options, g_strdup("numchannels"),
+			g_variant_ref_sink(g_variant_new_int32(2)));
+	g_hash_table_insert(options, g_strdup("format"),
+			g_variant_ref_sink(g_variant_new_string("S16_LE (-1..1)")));
+	g_hash_table_insert(options, g_strdup("threads"),
+			g_variant_ref_sink(g_variant_new_int32(3)));
+	g_hash_table_insert(options, g_strdup("blocksize"),
+			g_variant_ref_sink(g_variant_new_uint64(1001)));
+
+	imod = sr_input_find("raw_analog");
+	fail_unless(imod != NULL, "Failed to find input module.");
+	in = sr_input_new(imod, options);
+	fail_unless(in != NULL, "Failed to create input instance.");
+
+	values = g_array_new(FALSE, FALSE, sizeof(float));
+	sr_session_new(srtest_ctx, &session);
+	sr_session_datafeed_callback_add(session, datafeed_float, values);
+
+	part = g_string_new_len(buf->str, 3001);
+	fail_unless(sr_input_send(in, part) == SR_OK);
+	sr_session_dev_add(session, sr_input_dev_inst_get(in));
+	g_string_assign(part, "");
+	g_string_append_len(part, buf->str + 3001, buf->len - 3001);
+	fail_unless(sr_input_send(in, part) == SR_OK);
+	fail_unless(sr_input_end(in) == SR_OK);
+
+	/* The same samples as one channel, converted in one go. */
+	encoding.unitsize = 2;
+	encoding.is_signed = TRUE;
+	encoding.is_float = FALSE;
+	encoding.is_bigendian = FALSE;
+	encoding.digits = 15;
+	encoding.is_digits_decimal = FALSE;
+	sr_rational_set(&encoding.scale, 1, 32768);
+	sr_rational_set(&encoding.offset, 0, 1);
+	memset(&meaning, 0, sizeof(meaning));
+	meaning.channels = g_slist_append(NULL, &ch);
+	spec.spec_digits = 0;
+	analog.data = buf->str;
+	analog.num_samples = count;
+	analog.encoding = &encoding;
+	analog.meaning = &meaning;
+	analog.spec = &spec;
+	expected = g_malloc(count * sizeof(float));
+	fail_unless(sr_analog_to_float(&analog, expected) == SR_OK);
+
+	fail_unless(values->len == count, "Expected %u values, got %u.",
+		count, values->len);
+	for (i = 0; i < count; i++) {
+		fail_unless(fabsf(g_array_index(values, float, i) -
+			expected[i]) <= 1e-6,
+			"Value %u: %f != %f", i,
+			g_array_index(values, float, i), expected[i]);
+	}
+
+	g_slist_free(meaning.channels);
+	g_free(expected);
+	sr_input_free(in);
+	sr_session_destroy(session);
+	g_hash_table_destroy(options);
+	g_array_free(values, TRUE);
+	g_string_free(part, TRUE);
+	g_string_free(buf, TRUE);
+}
+END_TEST
+
 Suite *suite_input_binary(void)
 {
 	Suite *s;
@@ -321,6 +561,9 @@ Suite *suite_input_binary(void)
 	tcase_add_test(tc, test_input_binary_all_high);
 	tcase_add_loop_test(tc, test_input_binary_all_high_loop, 1, 10);
 	tcase_add_test(tc, test_input_binary_hello_world);
+	tcase_add_test(tc, test_input_binary_load_file);
+	tcase_add_test(tc, test_input_binary_threads);
+	tcase_add_test(tc, test_input_raw_analog_threads);
 	suite_add_tcase(s, tc);
 
 	return s;
@@ -0,0 +1,255 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2026 The sigrok developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <string.h>
+#include <check.h>
+#include <libsigrok/libsigrok.h>
+#include "lib.h"
+
+/* Options which differ from the CSV input module's defaults. */
+struct csv_test_opts {
+	const char *column_separator;
+	uint32_t start_line;
+	gboolean no_header;
+};
+
+static const struct csv_test_opts csv_defaults;
+
+/* Samples of three logic columns, the first one in bit 0. */
+static const uint8_t csv_samples[] = { 0x05, 0x06, 0x03 };
+
+static void datafeed_collect(const struct sr_dev_inst *sdi,
+	const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	const struct sr_datafeed_logic *logic;
+
+	(void)sdi;
+
+	if (packet->type != SR_DF_LOGIC)
+		return;
+	logic = packet->payload;
+	fail_unless(logic->unitsize == 1, "Unexpected unit size %u.",
+		logic->unitsize);
+	g_byte_array_append(cb_data, logic->data, logic->length);
+}
+
+/*
+ * Feed CSV text to the input module in chunks of the given size, and
+ * get the samples as well as the channel names (space separated).
+ * Returns the first error of the input module, or SR_OK.
+ */
+static int csv_test_run(const char *text, size_t chunk_size,
+		const struct csv_test_opts *opts, GByteArray *samples,
+		char **names)
+{
+	const struct sr_input *in;
+	struct sr_session *session;
+	struct sr_dev_inst *sdi;
+	struct sr_channel *ch;
+	GHashTable *options;
+	GString *chunk, *channel_names;
+	size_t offset, len;
+	GSList *channels, *l;
+	int ret;
+
+	options = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+		(GDestroyNotify)g_variant_unref);
+	if (opts->column_separator)
+		g_hash_table_insert(options, g_strdup("column_separator"),
+			g_variant_ref_sink(g_variant_new_string(
+			opts->column_separator)));
+	if (opts->start_line)
+		g_hash_table_insert(options, g_strdup("start_line"),
+			g_variant_ref_sink(g_variant_new_uint32(
+			opts->start_line)));
+	if (opts->no_header)
+		g_hash_table_insert(options, g_strdup("header"),
+			g_variant_ref_sink(g_variant_new_boolean(FALSE)));
+	in = sr_input_new(sr_input_find("csv"), options);
+	g_hash_table_destroy(options);
+	fail_unless(in != NULL, "Failed to create CSV input.");
+	sr_session_new(srtest_ctx, &session);
+	sr_session_datafeed_callback_add(session, datafeed_collect, samples);
+
+	ret = SR_OK;
+	sdi = NULL;
+	chunk = g_string_new(NULL);
+	for (offset = 0; ret == SR_OK && offset < strlen(text); offset += len) {
+		len = MIN(chunk_size, strlen(text) - offset);
+		g_string_assign(chunk, "");
+		g_string_append_len(chunk, text + offset, len);
+		ret = sr_input_send(in, chunk);
+		if (!sdi && (sdi = sr_input_dev_inst_get(in)))
+			sr_session_dev_add(session, sdi);
+	}
+	if (ret == SR_OK)
+		ret = sr_input_end(in);
+	g_string_free(chunk, TRUE);
+
+	channel_names = g_string_new(NULL);
+	channels = sdi ? sr_dev_inst_channels_get(sdi) : NULL;
+	for (l = channels; l; l = l->next) {
+		ch = l->data;
+		g_string_append_printf(channel_names, "%s%s",
+			l == channels ? "" : " ", ch->name);
+	}
+	*names = g_string_free(channel_names, FALSE);
+
+	sr_session_dev_remove_all(session);
+	sr_input_free(in);
+	sr_session_destroy(session);
+
+	return ret;
+}
+
+/*
+ * Check the samples and channel names (NULL to skip) for all chunk
+ * sizes up to the text's length, so that every line and terminator
+ * gets split somewhere.
+ */
+static void csv_test_check(const char *text, const struct csv_test_opts *opts,
+		const char *names, const uint8_t *expected, size_t num_samples)
+{
+	GByteArray *samples;
+	char *channel_names;
+	size_t chunk_size;
+	int ret;
+
+	for (chunk_size = 1; chunk_size <= strlen(text) + 1; chunk_size++) {
+		samples = g_byte_array_new();
+		ret = csv_test_run(text, chunk_size, opts, samples,
+			&channel_names);
+		fail_unless(ret == SR_OK, "Chunks of %zu: error %d.",
+			chunk_size, ret);
+		fail_unless(!names || !strcmp(channel_names, names),
+			"Chunks of %zu: channel names %s.", chunk_size,
+			channel_names);
+		fail_unless(samples->len == num_samples &&
+			!memcmp(samples->data, expected, num_samples),
+			"Chunks of %zu: wrong samples (%u).", chunk_size,
+			samples->len);
+		g_free(channel_names);
+		g_byte_array_free(samples, TRUE);
+	}
+}
+
+START_TEST(test_csv_lf)
+{
+	csv_test_check("a,b,c\n1,0,1\n0,1,1\n1,1,0\n", &csv_defaults,
+		"a b c", csv_samples, 3);
+}
+END_TEST
+
+START_TEST(test_csv_crlf)
+{
+	csv_test_check("a,b,c\r\n1,0,1\r\n0,1,1\r\n1,1,0\r\n", &csv_defaults,
+		"a b c", csv_samples, 3);
+	csv_test_check("a,b,c\r1,0,1\r0,1,1\r1,1,0\r", &csv_defaults,
+		"a b c", csv_samples, 3);
+}
+END_TEST
+
+/* The last line is taken at the end of input, also without terminator. */
+START_TEST(test_csv_unterminated)
+{
+	csv_test_check("a,b,c\n1,0,1\n0,1,1\n1,1,0", &csv_defaults,
+		"a b c", csv_samples, 3);
+	csv_test_check("a,b,c\r\n1,0,1\r\n0,1,1\r\n1,1,0", &csv_defaults,
+		"a b c", csv_samples, 3);
+}
+END_TEST
+
+START_TEST(test_csv_comments)
+{
+	csv_test_check("; leading comment\n"
+		"a,b,c ; captions\n"
+		"1,0,1 ; first\n"
+		";\n"
+		"\n"
+		"0,1,1;second\n"
+		"1,1,0\n", &csv_defaults, "a b c", csv_samples, 3);
+}
+END_TEST
+
+START_TEST(test_csv_start_line)
+{
+	const struct csv_test_opts opts = { .start_line = 3 };
+	const struct csv_test_opts no_header = { .no_header = TRUE };
+
+	csv_test_check("junk,x\nmore junk\na,b,c\n1,0,1\n0,1,1\n1,1,0\n",
+		&opts, "a b c", csv_samples, 3);
+	csv_test_check("1,0,1\n0,1,1\n1,1,0\n", &no_header, NULL,
+		csv_samples, 3);
+}
+END_TEST
+
+START_TEST(test_csv_separator)
+{
+	const struct csv_test_opts opts = { .column_separator = "::" };
+	const struct csv_test_opts tab = { .column_separator = "\t" };
+
+	csv_test_check("a::b::c\n1::0::1\n0::1::1\n1::1::0\n", &opts,
+		"a b c", csv_samples, 3);
+	csv_test_check("a\tb\tc\r\n1\t0\t1\r\n0\t1\t1\r\n1\t1\t0", &tab,
+		"a b c", csv_samples, 3);
+}
+END_TEST
+
+/* A line with fewer columns than the first one is an error. */
+START_TEST(test_csv_short_line)
+{
+	static const char *text = "a,b,c\n1,0,1\n1,0\n0,1,1\n";
+	GByteArray *samples;
+	char *names;
+	size_t chunk_size;
+	int ret;
+
+	for (chunk_size = 1; chunk_size <= strlen(text) + 1; chunk_size++) {
+		samples = g_byte_array_new();
+		ret = csv_test_run(text, chunk_size, &csv_defaults, samples,
+			&names);
+		fail_unless(ret != SR_OK, "Chunks of %zu: short line accepted.",
+			chunk_size);
+		g_free(names);
+		g_byte_array_free(samples, TRUE);
+	}
+}
+END_TEST
+
+Suite *suite_input_csv(void)
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("input-csv");
+
+	tc = tcase_create("basic");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_test(tc, test_csv_lf);
+	tcase_add_test(tc, test_csv_crlf);
+	tcase_add_test(tc, test_csv_unterminated);
+	tcase_add_test(tc, test_csv_comments);
+	tcase_add_test(tc, test_csv_start_line);
+	tcase_add_test(tc, test_csv_separator);
+	tcase_add_test(tc, test_csv_short_line);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
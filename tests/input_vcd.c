@@ -0,0 +1,207 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2026 The sigrok developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <string.h>
+#include <check.h>
+#include <libsigrok/libsigrok.h>
+#include "lib.h"
+
+static void datafeed_collect(const struct sr_dev_inst *sdi,
+	const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	const struct sr_datafeed_logic *logic;
+
+	(void)sdi;
+
+	if (packet->type != SR_DF_LOGIC)
+		return;
+	logic = packet->payload;
+	fail_unless(logic->unitsize == 1, "Unexpected unit size %u.",
+		logic->unitsize);
+	g_byte_array_append(cb_data, logic->data, logic->length);
+}
+
+/*
+ * Feed VCD text to the input module in chunks of the given size, and
+ * return the samples as well as the channel names (space separated).
+ */
+static GByteArray *vcd_test_run(const char *text, size_t chunk_size,
+		char **names)
+{
+	const struct sr_input *in;
+	struct sr_session *session;
+	struct sr_dev_inst *sdi;
+	struct sr_channel *ch;
+	GByteArray *samples;
+	GString *chunk, *channel_names;
+	size_t offset, len;
+	GSList *channels, *l;
+
+	in = sr_input_new(sr_input_find("vcd"), NULL);
+	fail_unless(in != NULL, "Failed to create VCD input.");
+	sr_session_new(srtest_ctx, &session);
+	samples = g_byte_array_new();
+	sr_session_datafeed_callback_add(session, datafeed_collect, samples);
+
+	sdi = NULL;
+	chunk = g_string_new(NULL);
+	for (offset = 0; offset < strlen(text); offset += len) {
+		len = MIN(chunk_size, strlen(text) - offset);
+		g_string_assign(chunk, "");
+		g_string_append_len(chunk, text + offset, len);
+		fail_unless(sr_input_send(in, chunk) == SR_OK);
+		if (!sdi && (sdi = sr_input_dev_inst_get(in)))
+			sr_session_dev_add(session, sdi);
+	}
+	fail_unless(sr_input_end(in) == SR_OK);
+	fail_unless(sdi != NULL, "No VCD header found.");
+	g_string_free(chunk, TRUE);
+
+	channel_names = g_string_new(NULL);
+	channels = sr_dev_inst_channels_get(sdi);
+	for (l = channels; l; l = l->next) {
+		ch = l->data;
+		g_string_append_printf(channel_names, "%s%s",
+			l == channels ? "" : " ", ch->name);
+	}
+	*names = g_string_free(channel_names, FALSE);
+
+	sr_session_dev_remove_all(session);
+	sr_input_free(in);
+	sr_session_destroy(session);
+
+	return samples;
+}
+
+static void vcd_test_check(const char *text, size_t chunk_size,
+		const char *names, const uint8_t *expected, size_t num_samples)
+{
+	GByteArray *samples;
+	char *channel_names;
+	size_t i;
+
+	samples = vcd_test_run(text, chunk_size, &channel_names);
+	fail_unless(!strcmp(channel_names, names),
+		"Unexpected channel names: %s", channel_names);
+	fail_unless(samples->len == num_samples,
+		"Expected %zu samples, got %u.", num_samples, samples->len);
+	for (i = 0; i < num_samples; i++)
+		fail_unless(samples->data[i] == expected[i],
+			"Sample %zu is 0x%02x, expected 0x%02x.", i,
+			samples->data[i], expected[i]);
+	g_free(channel_names);
+	g_byte_array_free(samples, TRUE);
+}
+
+static const char *vector_text =
+	"$timescale 1 us $end\n"
+	"$scope module test $end\n"
+	"$var wire 4 # bus [3:0] $end\n"
+	"$var wire 1 ! clk $end\n"
+	"$var reg 1 % en $end\n"
+	"$upscope $end\n"
+	"$enddefinitions $end\n"
+	"#0 b0101 # 0! b1 %\n"
+	"#2 b11 # 1!\n"
+	"#3 b1x1z # b0 %\n"
+	"#5\n";
+
+static const uint8_t vector_samples[] = { 0x02, 0x02, 0x03, 0x01, 0x01 };
+
+/*
+ * Check that vectors get skipped without disturbing other variables, and
+ * that scalars take 'b' values.
+ */
+START_TEST(test_vcd_vector)
+{
+	vcd_test_check(vector_text, 4096, "clk en",
+		vector_samples, sizeof(vector_samples));
+}
+END_TEST
+
+/* Check that results don't depend on how the text gets chunked. */
+START_TEST(test_vcd_chunks)
+{
+	size_t chunk_size;
+
+	for (chunk_size = 1; chunk_size < 16; chunk_size++)
+		vcd_test_check(vector_text, chunk_size, "clk en",
+			vector_samples, sizeof(vector_samples));
+}
+END_TEST
+
+/* Check identifiers shared by several variables, and skipped sections. */
+START_TEST(test_vcd_alias)
+{
+	const char *text =
+		"$timescale 1 us $end\n"
+		"$var wire 1 ! a $end\n"
+		"$var wire 1 ! b $end\n"
+		"$var wire 1 \" c $end\n"
+		"$enddefinitions $end\n"
+		"$comment not a value 1\" $end #0 1! 0\"\n"
+		"#1 0!\n"
+		"#2\n";
+	const uint8_t expected[] = { 0x03, 0x00 };
+
+	vcd_test_check(text, 4096, "a b c", expected, sizeof(expected));
+}
+END_TEST
+
+/* Check that data after a timestamp going backwards is ignored until $end. */
+START_TEST(test_vcd_invalid_timestamp)
+{
+	const char *text =
+		"$timescale 1 us $end\n"
+		"$var wire 1 ! a $end\n"
+		"$enddefinitions $end\n"
+		"#0 1!\n"
+		"#2 0!\n"
+		"#1 1!\n"
+		"#3 1! $comment resync $end\n"
+		"#5 1!\n"
+		"#6\n";
+	const uint8_t expected[] = { 0x01, 0x01, 0x00, 0x00, 0x00, 0x01 };
+	size_t chunk_size;
+
+	for (chunk_size = 1; chunk_size < 16; chunk_size++)
+		vcd_test_check(text, chunk_size, "a", expected,
+			sizeof(expected));
+	vcd_test_check(text, 4096, "a", expected, sizeof(expected));
+}
+END_TEST
+
+Suite *suite_input_vcd(void)
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("input-vcd");
+
+	tc = tcase_create("basic");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_test(tc, test_vcd_vector);
+	tcase_add_test(tc, test_vcd_chunks);
+	tcase_add_test(tc, test_vcd_alias);
+	tcase_add_test(tc, test_vcd_invalid_timestamp);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
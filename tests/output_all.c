@@ -18,7 +18,14 @@
  */
 
 #include <config.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#ifndef _WIN32
+#include <signal.h>
+#include <unistd.h>
+#include <sys/time.h>
+#endif
 #include <check.h>
 #include <libsigrok/libsigrok.h>
 #include "lib.h"
@@ -96,6 +103,221 @@ START_TEST(test_output_options)
 }
 END_TEST
 
+/*
+ * Sink tests use the "binary" output, which writes the logic data as is.
+ * A small packet gets collected, a large one is written along with it
+ * as a separate chunk, and the last one is left for sr_output_flush().
+ */
+static const size_t sink_test_lengths[] = { 1000, 300 * 1024, 10 };
+
+static uint8_t *sink_test_data(size_t *len)
+{
+	uint8_t *data;
+	size_t i;
+
+	*len = 0;
+	for (i = 0; i < G_N_ELEMENTS(sink_test_lengths); i++)
+		*len += sink_test_lengths[i];
+	data = g_malloc(*len);
+	for (i = 0; i < *len; i++)
+		data[i] = i * 7 + i / 251;
+
+	return data;
+}
+
+static const struct sr_output *sink_test_output(void)
+{
+	const struct sr_output *o;
+	struct sr_dev_inst *sdi;
+
+	sdi = sr_dev_inst_user_new("Vendor", "Model", "Version");
+	sr_dev_inst_channel_add(sdi, 0, SR_CHANNEL_LOGIC, "D0");
+	o = sr_output_new(sr_output_find("binary"), NULL, sdi, NULL);
+	fail_unless(o != NULL, "Failed to create binary output.");
+
+	return o;
+}
+
+static void sink_test_run(const struct sr_output *o, const uint8_t *data)
+{
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_logic logic;
+	unsigned int i;
+
+	logic.unitsize = 1;
+	packet.type = SR_DF_LOGIC;
+	packet.payload = &logic;
+	for (i = 0; i < G_N_ELEMENTS(sink_test_lengths); i++) {
+		logic.length = sink_test_lengths[i];
+		logic.data = (void *)data;
+		fail_unless(sr_output_write(o, &packet) == SR_OK);
+		data += sink_test_lengths[i];
+	}
+	fail_unless(sr_output_flush(o) == SR_OK);
+	packet.type = SR_DF_END;
+	packet.payload = NULL;
+	fail_unless(sr_output_write(o, &packet) == SR_OK);
+	fail_unless(sr_output_free(o) == SR_OK);
+}
+
+static int sink_test_cb(const struct sr_output_chunk *chunks,
+		unsigned int num_chunks, void *cb_data)
+{
+	GPtrArray *batches;
+	GString *batch;
+	unsigned int i;
+
+	batches = cb_data;
+	batch = g_string_new(NULL);
+	for (i = 0; i < num_chunks; i++) {
+		g_string_append_printf(batch, "%zu ", chunks[i].len);
+		g_string_append_len(g_ptr_array_index(batches, 0),
+			chunks[i].data, chunks[i].len);
+	}
+	g_ptr_array_add(batches, g_string_free(batch, FALSE));
+
+	return SR_OK;
+}
+
+/* Check that a large piece gets passed on without being collected. */
+START_TEST(test_output_sink_large)
+{
+	const struct sr_output *o;
+	GPtrArray *batches;
+	GString *body;
+	uint8_t *data;
+	size_t len;
+
+	data = sink_test_data(&len);
+	/* The output so far, then the chunk lengths of each batch. */
+	batches = g_ptr_array_new();
+	g_ptr_array_add(batches, g_string_new(NULL));
+	o = sink_test_output();
+	fail_unless(sr_output_sink_callback_set(o, sink_test_cb,
+		batches) == SR_OK);
+	sink_test_run(o, data);
+
+	body = g_ptr_array_index(batches, 0);
+	fail_unless(body->len == len && !memcmp(body->str, data, len),
+		"Unexpected output.");
+	fail_unless(batches->len == 3, "%u batches written.",
+		batches->len - 1);
+	fail_unless(!strcmp(g_ptr_array_index(batches, 1), "1000 307200 "),
+		"Unexpected batch: %s", (char *)g_ptr_array_index(batches, 1));
+	fail_unless(!strcmp(g_ptr_array_index(batches, 2), "10 "),
+		"Unexpected batch: %s", (char *)g_ptr_array_index(batches, 2));
+	g_string_free(body, TRUE);
+	g_free(g_ptr_array_index(batches, 1));
+	g_free(g_ptr_array_index(batches, 2));
+	g_ptr_array_free(batches, TRUE);
+	g_free(data);
+}
+END_TEST
+
+/* Check output written to a stdio stream. */
+START_TEST(test_output_sink_file)
+{
+	const struct sr_output *o;
+	FILE *file;
+	uint8_t *data, *body;
+	size_t len;
+
+	data = sink_test_data(&len);
+	file = tmpfile();
+	fail_unless(file != NULL, "Failed to create a temporary file.");
+	o = sink_test_output();
+	fail_unless(sr_output_sink_file_set(o, file) == SR_OK);
+	sink_test_run(o, data);
+
+	body = g_malloc(len + 1);
+	rewind(file);
+	fail_unless(fread(body, 1, len + 1, file) == len,
+		"Unexpected output length.");
+	fail_unless(!memcmp(body, data, len), "Unexpected output.");
+	fclose(file);
+	g_free(body);
+	g_free(data);
+}
+END_TEST
+
+#ifndef _WIN32
+struct sink_test_reader {
+	int fd;
+	GString *body;
+};
+
+static void sink_test_alarm(int sig)
+{
+	(void)sig;
+}
+
+static gpointer sink_test_read(gpointer data)
+{
+	struct sink_test_reader *reader;
+	char buf[4096];
+	ssize_t len;
+
+	reader = data;
+	/* Leave the pipe full until the writer got interrupted. */
+	g_usleep(200 * 1000);
+	while ((len = read(reader->fd, buf, sizeof(buf))) > 0)
+		g_string_append_len(reader->body, buf, len);
+
+	return NULL;
+}
+
+/*
+ * Check output written to a file descriptor. A timer interrupts the
+ * write while the pipe is full, so the sink resumes after a partial
+ * write, in the middle of the large chunk.
+ */
+START_TEST(test_output_sink_fd)
+{
+	const struct sr_output *o;
+	struct sink_test_reader reader;
+	struct sigaction sa, old_sa;
+	struct itimerval timer;
+	sigset_t set, old_set;
+	GThread *thread;
+	uint8_t *data;
+	size_t len;
+	int fds[2];
+
+	data = sink_test_data(&len);
+	fail_unless(pipe(fds) == 0, "Failed to create a pipe.");
+	reader.fd = fds[0];
+	reader.body = g_string_new(NULL);
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = sink_test_alarm;
+	sigemptyset(&sa.sa_mask);
+	sigaction(SIGALRM, &sa, &old_sa);
+	/* Only this thread gets the signal. */
+	sigemptyset(&set);
+	sigaddset(&set, SIGALRM);
+	sigprocmask(SIG_BLOCK, &set, &old_set);
+	thread = g_thread_new("sink-reader", sink_test_read, &reader);
+	sigprocmask(SIG_SETMASK, &old_set, NULL);
+	memset(&timer, 0, sizeof(timer));
+	timer.it_value.tv_usec = 50 * 1000;
+	setitimer(ITIMER_REAL, &timer, NULL);
+
+	o = sink_test_output();
+	fail_unless(sr_output_sink_fd_set(o, fds[1]) == SR_OK);
+	sink_test_run(o, data);
+	close(fds[1]);
+	g_thread_join(thread);
+	close(fds[0]);
+	sigaction(SIGALRM, &old_sa, NULL);
+
+	fail_unless(reader.body->len == len &&
+		!memcmp(reader.body->str, data, len), "Unexpected output.");
+	g_string_free(reader.body, TRUE);
+	g_free(data);
+}
+END_TEST
+#endif
+
 Suite *suite_output_all(void)
 {
 	Suite *s;
@@ -112,5 +334,14 @@ Suite *suite_output_all(void)
 	tcase_add_test(tc, test_output_options);
 	suite_add_tcase(s, tc);
 
+	tc = tcase_create("sink");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_test(tc, test_output_sink_large);
+	tcase_add_test(tc, test_output_sink_file);
+#ifndef _WIN32
+	tcase_add_test(tc, test_output_sink_fd);
+#endif
+	suite_add_tcase(s, tc);
+
 	return s;
 }
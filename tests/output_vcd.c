@@ -0,0 +1,333 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2026 The sigrok developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <check.h>
+#include <libsigrok/libsigrok.h>
+#include "lib.h"
+
+static struct sr_dev_inst *vcd_test_dev(unsigned int num_channels)
+{
+	struct sr_dev_inst *sdi;
+	unsigned int i;
+	char name[8];
+
+	sdi = sr_dev_inst_user_new("Vendor", "Model", "Version");
+	for (i = 0; i < num_channels; i++) {
+		snprintf(name, sizeof(name), "D%u", i);
+		sr_dev_inst_channel_add(sdi, i, SR_CHANNEL_LOGIC, name);
+	}
+
+	return sdi;
+}
+
+static const struct sr_output *vcd_test_start(const struct sr_dev_inst *sdi,
+		uint64_t samplerate)
+{
+	const struct sr_output *o;
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_meta meta;
+	struct sr_config src;
+	GString *out;
+
+	o = sr_output_new(sr_output_find("vcd"), NULL, sdi, NULL);
+	fail_unless(o != NULL, "Failed to create VCD output.");
+
+	src.key = SR_CONF_SAMPLERATE;
+	src.data = g_variant_new_uint64(samplerate);
+	meta.config = g_slist_append(NULL, &src);
+	packet.type = SR_DF_META;
+	packet.payload = &meta;
+	fail_unless(sr_output_send(o, &packet, &out) == SR_OK);
+	if (out)
+		g_string_free(out, TRUE);
+	g_slist_free(meta.config);
+	g_variant_unref(src.data);
+
+	return o;
+}
+
+static void vcd_test_send(const struct sr_output *o, GString *body,
+		const uint8_t *data, uint64_t length, uint16_t unitsize)
+{
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_logic logic;
+	GString *out;
+
+	logic.length = length;
+	logic.unitsize = unitsize;
+	logic.data = (void *)data;
+	packet.type = length ? SR_DF_LOGIC : SR_DF_END;
+	packet.payload = length ? &logic : NULL;
+	fail_unless(sr_output_send(o, &packet, &out) == SR_OK);
+	if (out) {
+		g_string_append_len(body, out->str, out->len);
+		g_string_free(out, TRUE);
+	}
+}
+
+/*
+ * Run samples through the VCD output in two packets, and return the
+ * value changes after the header.
+ */
+static char *vcd_test_run(unsigned int num_channels, uint64_t samplerate,
+		const uint8_t *data, uint64_t num_samples, uint16_t unitsize,
+		uint64_t split)
+{
+	const struct sr_output *o;
+	GString *body;
+	const char *defs_end;
+	char *changes;
+
+	o = vcd_test_start(vcd_test_dev(num_channels), samplerate);
+	body = g_string_new(NULL);
+	vcd_test_send(o, body, data, split * unitsize, unitsize);
+	vcd_test_send(o, body, data + split * unitsize,
+		(num_samples - split) * unitsize, unitsize);
+	vcd_test_send(o, body, NULL, 0, unitsize);
+	sr_output_free(o);
+
+	defs_end = strstr(body->str, "$enddefinitions $end\n");
+	fail_unless(defs_end != NULL, "No VCD header found.");
+	changes = g_strdup(defs_end + strlen("$enddefinitions $end\n"));
+	g_string_free(body, TRUE);
+
+	return changes;
+}
+
+/*
+ * Check that output (with the header) has the same value changes as
+ * the samples run through vcd_test_run() with two channels. Frees the
+ * output.
+ */
+static void vcd_test_check(GString *body, const uint8_t *data,
+		uint64_t num_samples)
+{
+	const char *changes;
+	char *dense;
+
+	dense = vcd_test_run(2, SR_KHZ(1), data, num_samples, 1, 4);
+	changes = strstr(body->str, "$enddefinitions $end\n");
+	fail_unless(changes != NULL, "No VCD header found.");
+	changes += strlen("$enddefinitions $end\n");
+	fail_unless(!strcmp(changes, dense),
+		"Unexpected VCD data: %s", changes);
+	g_string_free(body, TRUE);
+	g_free(dense);
+}
+
+/* Check that only changes get written, with all signals initially. */
+START_TEST(test_vcd_changes)
+{
+	const uint8_t data[] = { 0x0, 0x0, 0x1, 0x1, 0x3, 0x2, 0x2, 0xf };
+	char *changes;
+
+	changes = vcd_test_run(4, SR_KHZ(1), data, sizeof(data), 1, 3);
+	fail_unless(!strcmp(changes,
+		"#0 0! 0\" 0# 0$\n#2 1!\n#4 1\"\n#5 0!\n#7 1! 1# 1$\n#8\n"),
+		"Unexpected VCD data: %s", changes);
+	g_free(changes);
+}
+END_TEST
+
+/* Check channels in the second byte of wide samples. */
+START_TEST(test_vcd_changes_wide)
+{
+	const uint8_t data[] = { 0x00, 0x00, 0x00, 0x00, 0x01, 0x80, 0x01, 0x00 };
+	char *changes;
+
+	changes = vcd_test_run(16, SR_MHZ(1), data, sizeof(data) / 2, 2, 1);
+	fail_unless(!strcmp(changes,
+		"#0 0! 0\" 0# 0$ 0% 0& 0' 0( 0) 0* 0+ 0, 0- 0. 0/ 00\n"
+		"#2 1! 10\n#3 00\n#4\n"),
+		"Unexpected VCD data: %s", changes);
+	g_free(changes);
+}
+END_TEST
+
+/* Check timestamps for a samplerate which isn't a decade. */
+START_TEST(test_vcd_timescale)
+{
+	const uint8_t data[] = { 0x0, 0x1, 0x0, 0x0, 0x1 };
+	char *changes;
+
+	/* 400MHz gets written with a 10GHz timescale. */
+	changes = vcd_test_run(1, SR_MHZ(400), data, sizeof(data), 1, 2);
+	fail_unless(!strcmp(changes, "#0 0!\n#25 1!\n#50 0!\n#100 1!\n#125\n"),
+		"Unexpected VCD data: %s", changes);
+	g_free(changes);
+}
+END_TEST
+
+/* Check that runs produce the same output as the equivalent samples. */
+START_TEST(test_vcd_rle)
+{
+	const uint8_t data[] = { 0x0, 0x0, 0x1, 0x1, 0x1, 0x3, 0x3, 0x2 };
+	uint8_t values[] = { 0x0, 0x1, 0x1, 0x3, 0x2 };
+	uint64_t lengths[] = { 2, 1, 2, 2, 1 };
+	const struct sr_output *o;
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_logic_rle rle;
+	GString *body, *out;
+
+	o = vcd_test_start(vcd_test_dev(2), SR_KHZ(1));
+	body = g_string_new(NULL);
+	rle.unitsize = 1;
+	rle.values = values;
+	rle.lengths = lengths;
+	packet.type = SR_DF_LOGIC_RLE;
+	packet.payload = &rle;
+	/* Split the runs across two packets. */
+	rle.num_runs = 2;
+	fail_unless(sr_output_send(o, &packet, &out) == SR_OK);
+	g_string_append_len(body, out->str, out->len);
+	g_string_free(out, TRUE);
+	rle.values = values + 2;
+	rle.lengths = lengths + 2;
+	rle.num_runs = 3;
+	fail_unless(sr_output_send(o, &packet, &out) == SR_OK);
+	g_string_append_len(body, out->str, out->len);
+	g_string_free(out, TRUE);
+	vcd_test_send(o, body, NULL, 0, 1);
+	sr_output_free(o);
+
+	vcd_test_check(body, data, sizeof(data));
+}
+END_TEST
+
+/* Check that planes produce the same output as the equivalent samples. */
+START_TEST(test_vcd_planar)
+{
+	const uint8_t data[] = { 0x0, 0x0, 0x1, 0x1, 0x1, 0x3, 0x3, 0x2 };
+	/* Channel 1 first, the mapping puts it in place. */
+	uint8_t planes[] = { 0xe0, 0x00, 0x7c, 0x00 };
+	uint32_t channels[] = { 1, 0 };
+	const struct sr_output *o;
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_logic_planar planar;
+	GString *body, *out;
+
+	o = vcd_test_start(vcd_test_dev(2), SR_KHZ(1));
+	body = g_string_new(NULL);
+	planar.num_samples = sizeof(data);
+	planar.unitsize = 1;
+	planar.num_planes = G_N_ELEMENTS(channels);
+	planar.channels = channels;
+	planar.stride = 2;
+	planar.data = planes;
+	packet.type = SR_DF_LOGIC_PLANAR;
+	packet.payload = &planar;
+	fail_unless(sr_output_send(o, &packet, &out) == SR_OK);
+	g_string_append_len(body, out->str, out->len);
+	g_string_free(out, TRUE);
+	vcd_test_send(o, body, NULL, 0, 1);
+	sr_output_free(o);
+
+	vcd_test_check(body, data, sizeof(data));
+}
+END_TEST
+
+static int vcd_test_sink_cb(const struct sr_output_chunk *chunks,
+		unsigned int num_chunks, void *cb_data)
+{
+	unsigned int i;
+
+	for (i = 0; i < num_chunks; i++)
+		g_string_append_len(cb_data, chunks[i].data, chunks[i].len);
+
+	return SR_OK;
+}
+
+/* Check that packets which don't change any signal give no output. */
+START_TEST(test_vcd_no_output)
+{
+	const uint8_t data[] = { 0x1, 0x1 };
+	const struct sr_output *o;
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_logic logic;
+	GString *out;
+
+	o = vcd_test_start(vcd_test_dev(2), SR_KHZ(1));
+	logic.length = sizeof(data);
+	logic.unitsize = 1;
+	logic.data = (void *)data;
+	packet.type = SR_DF_LOGIC;
+	packet.payload = &logic;
+	fail_unless(sr_output_send(o, &packet, &out) == SR_OK);
+	fail_unless(out != NULL && out->len > 0, "No header.");
+	g_string_free(out, TRUE);
+	fail_unless(sr_output_send(o, &packet, &out) == SR_OK);
+	fail_unless(out == NULL, "Output without changes: %s", out->str);
+	sr_output_free(o);
+}
+END_TEST
+
+/* Check that a sink receives the same output as sr_output_send(). */
+START_TEST(test_vcd_sink)
+{
+	const uint8_t data[] = { 0x0, 0x0, 0x1, 0x1, 0x1, 0x3, 0x3, 0x2 };
+	const struct sr_output *o;
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_logic logic;
+	GString *body;
+
+	o = vcd_test_start(vcd_test_dev(2), SR_KHZ(1));
+	body = g_string_new(NULL);
+	fail_unless(sr_output_sink_callback_set(o,
+		vcd_test_sink_cb, body) == SR_OK);
+	logic.length = sizeof(data);
+	logic.unitsize = 1;
+	logic.data = (void *)data;
+	packet.type = SR_DF_LOGIC;
+	packet.payload = &logic;
+	fail_unless(sr_output_write(o, &packet) == SR_OK);
+	fail_unless(sr_output_flush(o) == SR_OK);
+	fail_unless(body->len > 0, "Nothing written on flush.");
+	packet.type = SR_DF_END;
+	packet.payload = NULL;
+	fail_unless(sr_output_write(o, &packet) == SR_OK);
+	sr_output_free(o);
+
+	vcd_test_check(body, data, sizeof(data));
+}
+END_TEST
+
+Suite *suite_output_vcd(void)
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("output-vcd");
+
+	tc = tcase_create("basic");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_test(tc, test_vcd_changes);
+	tcase_add_test(tc, test_vcd_changes_wide);
+	tcase_add_test(tc, test_vcd_timescale);
+	tcase_add_test(tc, test_vcd_rle);
+	tcase_add_test(tc, test_vcd_planar);
+	tcase_add_test(tc, test_vcd_no_output);
+	tcase_add_test(tc, test_vcd_sink);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
@@ -0,0 +1,473 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2026 The sigrok developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <string.h>
+#include <check.h>
+#include <libsigrok/libsigrok.h>
+#include "lib.h"
+#include "libsigrok-internal.h"
+#include "scpi.h"
+
+/*
+ * A fake transport which replays a response. Reads return at most
+ * max_read bytes, and once stall_at bytes were read, nothing arrives
+ * anymore, like from a device which went quiet.
+ */
+struct fake_scpi {
+	const char *data;
+	size_t len;
+	size_t pos;
+	size_t max_read;
+	size_t stall_at;
+	int reads;
+	char *command;
+};
+
+static int fake_send(void *priv, const char *command)
+{
+	struct fake_scpi *fake;
+
+	fake = priv;
+	g_free(fake->command);
+	fake->command = g_strdup(command);
+
+	return SR_OK;
+}
+
+static int fake_read_begin(void *priv)
+{
+	(void)priv;
+
+	return SR_OK;
+}
+
+static int fake_read_data(void *priv, char *buf, int maxlen)
+{
+	struct fake_scpi *fake;
+	size_t len;
+
+	fake = priv;
+	fake->reads++;
+	len = MIN(fake->stall_at, fake->len) - fake->pos;
+	len = MIN(len, fake->max_read);
+	len = MIN(len, (size_t)maxlen);
+	memcpy(buf, fake->data + fake->pos, len);
+	fake->pos += len;
+
+	return len;
+}
+
+static int fake_wait_data(void *priv, int timeout_ms)
+{
+	struct fake_scpi *fake;
+
+	(void)timeout_ms;
+
+	fake = priv;
+	if (fake->pos >= MIN(fake->stall_at, fake->len))
+		return SR_ERR_TIMEOUT;
+
+	return SR_OK;
+}
+
+static int fake_read_complete(void *priv)
+{
+	struct fake_scpi *fake;
+
+	fake = priv;
+
+	return fake->pos == fake->len;
+}
+
+static void fake_init(struct sr_scpi_dev_inst *scpi, struct fake_scpi *fake,
+		const char *data, size_t len, size_t max_read)
+{
+	memset(fake, 0, sizeof(*fake));
+	fake->data = data;
+	fake->len = len;
+	fake->max_read = max_read;
+	fake->stall_at = len;
+
+	memset(scpi, 0, sizeof(*scpi));
+	scpi->name = "fake";
+	scpi->send = fake_send;
+	scpi->read_begin = fake_read_begin;
+	scpi->read_data = fake_read_data;
+	scpi->wait_data = fake_wait_data;
+	scpi->read_complete = fake_read_complete;
+	scpi->read_timeout_us = 1000 * 1000;
+	scpi->priv = fake;
+	g_mutex_init(&scpi->scpi_mutex);
+}
+
+static void fake_cleanup(struct sr_scpi_dev_inst *scpi, struct fake_scpi *fake)
+{
+	g_mutex_clear(&scpi->scpi_mutex);
+	g_free(fake->command);
+}
+
+/* Short reads of this many bytes, and a read which fits all. */
+static const size_t read_sizes[] = { 1, 3, 7, 4096 };
+
+#define BLOCK(r, d) { r, sizeof(r) - 1, d, sizeof(d) - 1 }
+
+static const struct {
+	const char *response;
+	size_t len;
+	const char *data;
+	size_t datalen;
+} blocks[] = {
+	BLOCK("#15HELLO\n", "HELLO"),
+	BLOCK("#212HELLO,WORLD!\r\n", "HELLO,WORLD!"),
+	BLOCK("#900000000212\n", "12"),
+	BLOCK("#13\n\0\n\n", "\n\0\n"),
+	/* A device which doesn't terminate the block. */
+	BLOCK("#14abcd", "abcd"),
+};
+
+/* Check "#<n><len>" headers and that the terminator gets drained. */
+START_TEST(test_scpi_get_block)
+{
+	struct sr_scpi_dev_inst scpi;
+	struct fake_scpi fake;
+	GByteArray *block;
+	const char *resp;
+	unsigned int i, r;
+	int ret;
+
+	for (i = 0; i < G_N_ELEMENTS(blocks); i++) {
+		resp = blocks[i].response;
+		for (r = 0; r < G_N_ELEMENTS(read_sizes); r++) {
+			fake_init(&scpi, &fake, resp, blocks[i].len,
+				read_sizes[r]);
+			ret = sr_scpi_get_block(&scpi, ":WAV:DATA?", &block);
+			fail_unless(ret == SR_OK, "%s: ret %d.", resp, ret);
+			fail_unless(!strcmp(fake.command, ":WAV:DATA?\n"));
+			fail_unless(block && block->len == blocks[i].datalen &&
+				!memcmp(block->data, blocks[i].data,
+				blocks[i].datalen), "%s: wrong data.", resp);
+			fail_unless(fake.pos == fake.len,
+				"%s: %zu bytes left.", resp, fake.len - fake.pos);
+			g_byte_array_free(block, TRUE);
+			fake_cleanup(&scpi, &fake);
+		}
+	}
+}
+END_TEST
+
+/* Check that bad headers, including "#0", are rejected. */
+START_TEST(test_scpi_get_block_header_bad)
+{
+	static const char *const bad[] = {
+		"#0HELLO\n", "15HELLO\n", "#X5HELLO\n", "#25HELLO\n",
+	};
+	struct sr_scpi_dev_inst scpi;
+	struct fake_scpi fake;
+	GByteArray *block;
+	unsigned int i;
+	int ret;
+
+	for (i = 0; i < G_N_ELEMENTS(bad); i++) {
+		fake_init(&scpi, &fake, bad[i], strlen(bad[i]), 4096);
+		block = (void *)&block;
+		ret = sr_scpi_get_block(&scpi, NULL, &block);
+		fail_unless(ret < 0, "%s: accepted.", bad[i]);
+		fail_unless(!block, "%s: returned a block.", bad[i]);
+		fake_cleanup(&scpi, &fake);
+	}
+
+	fake_init(&scpi, &fake, bad[0], strlen(bad[0]), 4096);
+	fail_unless(sr_scpi_get_block(&scpi, NULL, &block) == SR_ERR_DATA);
+	fake_cleanup(&scpi, &fake);
+}
+END_TEST
+
+/* Check that a device going quiet truncates the block, but not the header. */
+START_TEST(test_scpi_get_block_timeout)
+{
+	static const char resp[] = "#210ABCDEFGHIJ\n";
+	struct sr_scpi_dev_inst scpi;
+	struct fake_scpi fake;
+	GByteArray *block;
+	unsigned int r;
+	int ret;
+
+	for (r = 0; r < G_N_ELEMENTS(read_sizes); r++) {
+		fake_init(&scpi, &fake, resp, strlen(resp), read_sizes[r]);
+		fake.stall_at = 8;
+		ret = sr_scpi_get_block(&scpi, NULL, &block);
+		fail_unless(ret == SR_OK, "Truncated block failed: %d.", ret);
+		fail_unless(block && block->len == 4 &&
+			!memcmp(block->data, "ABCD", 4), "Wrong partial data.");
+		g_byte_array_free(block, TRUE);
+		fake_cleanup(&scpi, &fake);
+
+		fake_init(&scpi, &fake, resp, strlen(resp), read_sizes[r]);
+		fake.stall_at = 3;
+		ret = sr_scpi_get_block(&scpi, NULL, &block);
+		fail_unless(ret == SR_ERR_TIMEOUT, "Truncated header: %d.", ret);
+		fail_unless(!block);
+		fake_cleanup(&scpi, &fake);
+	}
+}
+END_TEST
+
+/* Check float blocks in both byte orders, and the terminator drain. */
+START_TEST(test_scpi_get_block_floatv)
+{
+	static const char resp_be[] = "#18\x3f\x80\x00\x00\xc0\x20\x00\x00\n";
+	static const char resp_le[] = "#18\x00\x00\x80\x3f\x00\x00\x20\xc0\n";
+	struct sr_scpi_dev_inst scpi;
+	struct fake_scpi fake;
+	GArray *values;
+	unsigned int r;
+	int ret;
+
+	for (r = 0; r < G_N_ELEMENTS(read_sizes); r++) {
+		fake_init(&scpi, &fake, resp_be, sizeof(resp_be) - 1,
+			read_sizes[r]);
+		ret = sr_scpi_get_block_floatv(&scpi, NULL, TRUE, &values);
+		fail_unless(ret == SR_OK && values && values->len == 2);
+		fail_unless(g_array_index(values, float, 0) == 1.0f);
+		fail_unless(g_array_index(values, float, 1) == -2.5f);
+		fail_unless(fake.pos == fake.len, "Terminator not drained.");
+		g_array_free(values, TRUE);
+		fake_cleanup(&scpi, &fake);
+
+		fake_init(&scpi, &fake, resp_le, sizeof(resp_le) - 1,
+			read_sizes[r]);
+		ret = sr_scpi_get_block_floatv(&scpi, NULL, FALSE, &values);
+		fail_unless(ret == SR_OK && values && values->len == 2);
+		fail_unless(g_array_index(values, float, 0) == 1.0f);
+		fail_unless(g_array_index(values, float, 1) == -2.5f);
+		fail_unless(fake.pos == fake.len, "Terminator not drained.");
+		g_array_free(values, TRUE);
+		fake_cleanup(&scpi, &fake);
+	}
+}
+END_TEST
+
+/* Check that exact reads collect short reads, and fail on timeouts. */
+START_TEST(test_scpi_read_exact)
+{
+	static const char data[] = "0123456789abcdef";
+	struct sr_scpi_dev_inst scpi;
+	struct fake_scpi fake;
+	char buf[16];
+	unsigned int r;
+	int ret;
+
+	for (r = 0; r < G_N_ELEMENTS(read_sizes); r++) {
+		fake_init(&scpi, &fake, data, 16, read_sizes[r]);
+		ret = sr_scpi_read_exact(&scpi, buf, 10);
+		fail_unless(ret == 10 && !memcmp(buf, data, 10),
+			"First read: %d.", ret);
+		fail_unless(fake.pos == 10, "Read %zu bytes.", fake.pos);
+		if (read_sizes[r] < 10)
+			fail_unless(fake.reads >= (int)(10 / read_sizes[r]));
+		ret = sr_scpi_read_exact(&scpi, buf, 6);
+		fail_unless(ret == 6 && !memcmp(buf, data + 10, 6),
+			"Second read: %d.", ret);
+		fail_unless(sr_scpi_read_exact(&scpi, buf, 0) == 0);
+		fail_unless(sr_scpi_read_exact(&scpi, buf, 1) ==
+			SR_ERR_TIMEOUT);
+		fail_unless(sr_scpi_read_exact(&scpi, buf, -1) == SR_ERR_ARG);
+		fake_cleanup(&scpi, &fake);
+
+		fake_init(&scpi, &fake, data, 16, read_sizes[r]);
+		fake.stall_at = 5;
+		ret = sr_scpi_read_exact(&scpi, buf, 10);
+		fail_unless(ret == SR_ERR_TIMEOUT, "Stalled read: %d.", ret);
+		fake_cleanup(&scpi, &fake);
+	}
+}
+END_TEST
+
+#define PIPELINE_BLOCKS 20
+
+struct pipeline_test {
+	GThread *caller;
+	gint threaded;
+	int pushed;
+	int delivered;
+	int frame_ends;
+};
+
+/* Blocks get index + 1 bytes of the index, to be converted to floats. */
+static GByteArray *pipeline_raw(int index)
+{
+	GByteArray *raw;
+
+	raw = g_byte_array_sized_new(index + 1);
+	g_byte_array_set_size(raw, index + 1);
+	memset(raw->data, index, raw->len);
+
+	return raw;
+}
+
+static void pipeline_convert(struct sr_scpi_block *block, void *cb_data)
+{
+	struct pipeline_test *pt;
+	size_t i;
+
+	pt = cb_data;
+	/* Vary the conversion time, so later blocks may be quicker. */
+	g_usleep((PIPELINE_BLOCKS - GPOINTER_TO_INT(block->priv)) % 4 * 500);
+	if (g_thread_self() != pt->caller)
+		g_atomic_int_set(&pt->threaded, TRUE);
+	block->num_samples = block->raw->len;
+	block->data = g_malloc(block->num_samples * sizeof(float));
+	for (i = 0; i < block->num_samples; i++)
+		block->data[i] = block->raw->data[i];
+}
+
+static void pipeline_done(struct sr_scpi_block *block, void *cb_data)
+{
+	struct pipeline_test *pt;
+	int index;
+
+	pt = cb_data;
+	index = GPOINTER_TO_INT(block->priv);
+	fail_unless(g_thread_self() == pt->caller, "Done on the worker.");
+	fail_unless(index == pt->delivered, "Block %d delivered as %d.",
+		index, pt->delivered);
+	fail_unless(block->num_samples == (size_t)index + 1 &&
+		block->data[index] == index, "Block %d not converted.", index);
+	pt->delivered++;
+}
+
+static void pipeline_feed(const struct sr_dev_inst *sdi,
+	const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	struct pipeline_test *pt;
+
+	(void)sdi;
+
+	pt = cb_data;
+	if (packet->type != SR_DF_FRAME_END)
+		return;
+	fail_unless(pt->delivered == pt->pushed,
+		"Frame end before %d blocks.", pt->pushed - pt->delivered);
+	pt->frame_ends++;
+}
+
+static void pipeline_push(struct sr_scpi_pipeline *pl,
+		struct pipeline_test *pt, unsigned int depth)
+{
+	sr_scpi_pipeline_push(pl, pipeline_raw(pt->pushed),
+		GINT_TO_POINTER(pt->pushed));
+	pt->pushed++;
+	fail_unless(pt->pushed - pt->delivered <= (int)depth,
+		"%d blocks in flight.", pt->pushed - pt->delivered);
+}
+
+static void pipeline_test_run(unsigned int depth, gboolean use_thread)
+{
+	struct sr_dev_inst *sdi;
+	struct sr_session *session;
+	struct sr_scpi_pipeline *pl;
+	struct pipeline_test pt;
+	int i;
+
+	memset(&pt, 0, sizeof(pt));
+	pt.caller = g_thread_self();
+	sdi = sr_dev_inst_user_new("Vendor", "Model", "Version");
+	sr_session_new(srtest_ctx, &session);
+	sr_session_dev_add(session, sdi);
+	sr_session_datafeed_callback_add(session, pipeline_feed, &pt);
+
+	sr_scpi_pipeline_no_thread(!use_thread);
+	pl = sr_scpi_pipeline_new(pipeline_convert, pipeline_done, &pt, depth);
+
+	/* Deliver what's ready, until all of the first half went out. */
+	for (i = 0; i < PIPELINE_BLOCKS / 2; i++)
+		pipeline_push(pl, &pt, depth);
+	for (i = 0; i < 10 * 1000 && pt.delivered < pt.pushed; i++) {
+		sr_scpi_pipeline_flush(pl, FALSE);
+		g_usleep(100);
+	}
+	fail_unless(pt.delivered == pt.pushed, "Flush left %d blocks.",
+		pt.pushed - pt.delivered);
+
+	/* The frame end must wait for all blocks. */
+	for (i = 0; i < PIPELINE_BLOCKS / 2; i++)
+		pipeline_push(pl, &pt, depth);
+	sr_scpi_pipeline_frame_end(pl, sdi);
+	fail_unless(pt.frame_ends == 1, "No frame end sent.");
+
+	sr_scpi_pipeline_free(pl);
+	sr_scpi_pipeline_no_thread(FALSE);
+	fail_unless(pt.delivered == PIPELINE_BLOCKS);
+	fail_unless(pt.threaded == use_thread, "Converted %s.",
+		pt.threaded ? "on a thread" : "inline");
+
+	sr_session_dev_remove_all(session);
+	sr_session_destroy(session);
+	sr_dev_inst_free(sdi);
+}
+
+static const unsigned int pipeline_depths[] = { 1, 2, 4, PIPELINE_BLOCKS };
+
+/* Check that blocks get converted on the worker, delivered in order. */
+START_TEST(test_scpi_pipeline)
+{
+	unsigned int i;
+
+	for (i = 0; i < G_N_ELEMENTS(pipeline_depths); i++)
+		pipeline_test_run(pipeline_depths[i], TRUE);
+}
+END_TEST
+
+/* Check that the fallback without a worker behaves the same. */
+START_TEST(test_scpi_pipeline_inline)
+{
+	unsigned int i;
+
+	for (i = 0; i < G_N_ELEMENTS(pipeline_depths); i++)
+		pipeline_test_run(pipeline_depths[i], FALSE);
+}
+END_TEST
+
+Suite *suite_scpi(void)
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("scpi");
+
+	tc = tcase_create("block");
+	tcase_add_test(tc, test_scpi_get_block);
+	tcase_add_test(tc, test_scpi_get_block_header_bad);
+	tcase_add_test(tc, test_scpi_get_block_timeout);
+	tcase_add_test(tc, test_scpi_get_block_floatv);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("read");
+	tcase_add_test(tc, test_scpi_read_exact);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("pipeline");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_test(tc, test_scpi_pipeline);
+	tcase_add_test(tc, test_scpi_pipeline_inline);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
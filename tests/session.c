@@ -18,10 +18,19 @@
  */
 
 #include <config.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#ifndef _WIN32
+#include <signal.h>
+#include <sys/resource.h>
+#endif
+#include <glib/gstdio.h>
 #include <check.h>
 #include <libsigrok/libsigrok.h>
 #include "lib.h"
+#include "libsigrok-internal.h"
 
 /*
  * Check whether sr_session_new() works.
@@ -185,6 +194,837 @@ START_TEST(test_session_trigger_get_null)
 }
 END_TEST
 
+/* Check configuration of asynchronous datafeed dispatch. */
+START_TEST(test_session_dispatch_set)
+{
+	int ret;
+	struct sr_session *sess;
+	unsigned int high_water;
+	uint64_t dropped;
+
+	sr_session_new(srtest_ctx, &sess);
+	ret = sr_session_dispatch_set(sess, 32, SR_DISPATCH_DROP);
+	fail_unless(ret == SR_OK, "sr_session_dispatch_set() failed: %d.", ret);
+	ret = sr_session_dispatch_set(sess, 0, SR_DISPATCH_BLOCK);
+	fail_unless(ret == SR_OK, "sr_session_dispatch_set() failed: %d.", ret);
+	ret = sr_session_dispatch_set(sess, 32, 0);
+	fail_unless(ret == SR_ERR_ARG, "Invalid policy was accepted.");
+	ret = sr_session_dispatch_set(NULL, 32, SR_DISPATCH_BLOCK);
+	fail_unless(ret == SR_ERR_ARG, "NULL session was accepted.");
+
+	high_water = 1;
+	dropped = 1;
+	ret = sr_session_dispatch_stats_get(sess, &high_water, &dropped);
+	fail_unless(ret == SR_OK);
+	fail_unless(high_water == 0 && dropped == 0);
+	fail_unless(sr_session_dispatch_stats_get(sess, NULL, NULL) == SR_OK);
+	fail_unless(sr_session_dispatch_stats_get(NULL, NULL, NULL) == SR_ERR_ARG);
+	sr_session_destroy(sess);
+}
+END_TEST
+
+/* Check reference counting and accessors of sr_buffer. */
+START_TEST(test_buffer_ref_unref)
+{
+	struct sr_buffer *buf;
+
+	buf = sr_buffer_new(128);
+	fail_unless(buf != NULL, "sr_buffer_new() failed.");
+	fail_unless(sr_buffer_data(buf) != NULL);
+	fail_unless(sr_buffer_size(buf) == 128);
+	fail_unless(sr_buffer_ref(buf) == buf);
+	memset(sr_buffer_data(buf), 0x5a, 128);
+	sr_buffer_unref(buf);
+	fail_unless(((uint8_t *)sr_buffer_data(buf))[127] == 0x5a);
+	sr_buffer_unref(buf);
+
+	/* NULL buffer, must not segfault. */
+	sr_buffer_unref(NULL);
+}
+END_TEST
+
+/* Check that sr_packet_copy() and sr_packet_retain() copy logic data. */
+START_TEST(test_packet_copy_logic)
+{
+	struct sr_datafeed_packet packet, *copy, *retained;
+	struct sr_datafeed_logic logic, *logic_copy;
+	uint8_t data[] = { 0x01, 0x02, 0x03, 0x04, 0x05, 0x06 };
+
+	logic.length = sizeof(data);
+	logic.unitsize = 2;
+	logic.data = data;
+	packet.type = SR_DF_LOGIC;
+	packet.payload = &logic;
+
+	fail_unless(sr_packet_copy(&packet, &copy) == SR_OK);
+	logic_copy = (struct sr_datafeed_logic *)copy->payload;
+	fail_unless(copy->type == SR_DF_LOGIC);
+	fail_unless(logic_copy->length == sizeof(data));
+	fail_unless(logic_copy->unitsize == 2);
+	fail_unless(logic_copy->data != data);
+	fail_unless(!memcmp(logic_copy->data, data, sizeof(data)));
+	sr_packet_free(copy);
+
+	/* Without a backing buffer, retaining has to copy the data. */
+	fail_unless(sr_packet_retain(&packet, &retained) == SR_OK);
+	logic_copy = (struct sr_datafeed_logic *)retained->payload;
+	fail_unless(logic_copy->data != data);
+	fail_unless(!memcmp(logic_copy->data, data, sizeof(data)));
+	sr_packet_free(retained);
+
+	fail_unless(sr_packet_retain(NULL, &retained) == SR_ERR_ARG);
+}
+END_TEST
+
+START_TEST(test_logic_rle_densify)
+{
+	struct sr_datafeed_packet packet, *copy;
+	struct sr_datafeed_logic_rle rle, *rle_copy;
+	struct sr_datafeed_logic logic;
+	uint8_t values[] = { 0x01, 0x80, 0x00, 0x00, 0xff, 0x7f };
+	uint64_t lengths[] = { 2, 0, 3 };
+	const uint8_t expected[] = {
+		0x01, 0x80, 0x01, 0x80, 0xff, 0x7f, 0xff, 0x7f, 0xff, 0x7f,
+	};
+
+	rle.num_runs = G_N_ELEMENTS(lengths);
+	rle.unitsize = 2;
+	rle.values = values;
+	rle.lengths = lengths;
+	fail_unless(sr_logic_rle_num_samples(&rle) == 5);
+
+	fail_unless(sr_logic_rle_densify(&rle, &logic) == SR_OK);
+	fail_unless(logic.unitsize == 2);
+	fail_unless(logic.length == sizeof(expected));
+	fail_unless(!memcmp(logic.data, expected, sizeof(expected)));
+	g_free(logic.data);
+
+	packet.type = SR_DF_LOGIC_RLE;
+	packet.payload = &rle;
+	fail_unless(sr_packet_copy(&packet, &copy) == SR_OK);
+	rle_copy = (struct sr_datafeed_logic_rle *)copy->payload;
+	fail_unless(rle_copy->num_runs == rle.num_runs);
+	fail_unless(rle_copy->unitsize == rle.unitsize);
+	fail_unless(rle_copy->values != rle.values);
+	fail_unless(!memcmp(rle_copy->values, values, sizeof(values)));
+	fail_unless(!memcmp(rle_copy->lengths, lengths, sizeof(lengths)));
+	sr_packet_free(copy);
+
+	fail_unless(sr_logic_rle_densify(NULL, &logic) == SR_ERR_ARG);
+}
+END_TEST
+
+START_TEST(test_logic_planar)
+{
+	struct sr_datafeed_packet packet, *copy;
+	struct sr_datafeed_logic_planar planar, *planar_copy;
+	struct sr_datafeed_logic logic, dense;
+	uint8_t data[2 * 10];
+	uint32_t channels[] = { 9, 0, 3 };
+	uint32_t bad_channels[] = { 16 };
+	const uint8_t *plane;
+	unsigned int i, c, s;
+
+	for (i = 0; i < sizeof(data); i++)
+		data[i] = i * 37 + 5;
+	logic.length = sizeof(data);
+	logic.unitsize = 2;
+	logic.data = data;
+
+	fail_unless(sr_logic_planar_split(&logic, channels,
+		G_N_ELEMENTS(channels), &planar) == SR_OK);
+	fail_unless(planar.num_samples == 10);
+	fail_unless(planar.unitsize == 2);
+	fail_unless(planar.num_planes == G_N_ELEMENTS(channels));
+	fail_unless(planar.stride == 2);
+	for (c = 0; c < 16; c++) {
+		plane = sr_logic_planar_channel(&planar, c);
+		fail_unless(!plane == (c != 9 && c != 0 && c != 3));
+		for (s = 0; plane && s < 10; s++)
+			fail_unless(!(plane[s / 8] & (1 << (s % 8))) ==
+				!(data[s * 2 + c / 8] & (1 << (c % 8))));
+	}
+
+	/* Channels without a plane read as low. */
+	fail_unless(sr_logic_planar_densify(&planar, &dense) == SR_OK);
+	fail_unless(dense.unitsize == 2);
+	fail_unless(dense.length == sizeof(data));
+	for (s = 0; s < 10; s++) {
+		fail_unless(((uint8_t *)dense.data)[s * 2] ==
+			(data[s * 2] & 0x09));
+		fail_unless(((uint8_t *)dense.data)[s * 2 + 1] ==
+			(data[s * 2 + 1] & 0x02));
+	}
+	g_free(dense.data);
+
+	packet.type = SR_DF_LOGIC_PLANAR;
+	packet.payload = &planar;
+	fail_unless(sr_packet_copy(&packet, &copy) == SR_OK);
+	planar_copy = (struct sr_datafeed_logic_planar *)copy->payload;
+	fail_unless(planar_copy->num_samples == planar.num_samples);
+	fail_unless(planar_copy->num_planes == planar.num_planes);
+	fail_unless(planar_copy->channels != planar.channels);
+	fail_unless(!memcmp(planar_copy->channels, channels, sizeof(channels)));
+	fail_unless(planar_copy->data != planar.data);
+	fail_unless(!memcmp(planar_copy->data, planar.data,
+		planar.num_planes * planar.stride));
+	sr_packet_free(copy);
+	g_free(planar.data);
+
+	fail_unless(sr_logic_planar_split(&logic, bad_channels, 1,
+		&planar) == SR_ERR_ARG);
+	fail_unless(sr_logic_planar_split(NULL, channels, 1,
+		&planar) == SR_ERR_ARG);
+	fail_unless(sr_logic_planar_densify(NULL, &dense) == SR_ERR_ARG);
+}
+END_TEST
+
+static void window_test_cb(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	const struct sr_datafeed_logic *logic;
+
+	(void)sdi;
+
+	if (packet->type != SR_DF_LOGIC)
+		return;
+	logic = packet->payload;
+	g_byte_array_append(cb_data, logic->data, logic->length);
+}
+
+/* Write a session file with 8 logic channels in small chunks. */
+static char *session_file_new(const uint8_t *data, size_t len)
+{
+	const struct sr_output *o;
+	struct sr_dev_inst *sdi;
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_logic logic;
+	struct sr_datafeed_meta meta;
+	struct sr_config src;
+	GHashTable *opts;
+	GString *out;
+	char *filename, name[8];
+	unsigned int i;
+	int fd;
+
+	fd = g_file_open_tmp("libsigrok-test-XXXXXX.sr", &filename, NULL);
+	fail_unless(fd >= 0, "Failed to create temporary file.");
+	close(fd);
+
+	sdi = sr_dev_inst_user_new("Vendor", "Model", "Version");
+	for (i = 0; i < 8; i++) {
+		snprintf(name, sizeof(name), "D%u", i);
+		sr_dev_inst_channel_add(sdi, i, SR_CHANNEL_LOGIC, name);
+	}
+	opts = g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
+		(GDestroyNotify)g_variant_unref);
+	g_hash_table_insert(opts, "chunksize",
+		g_variant_ref_sink(g_variant_new_uint32(64)));
+	o = sr_output_new(sr_output_find("srzip"), opts, sdi, filename);
+	g_hash_table_destroy(opts);
+	fail_unless(o != NULL, "Failed to create srzip output.");
+
+	src.key = SR_CONF_SAMPLERATE;
+	src.data = g_variant_new_uint64(SR_MHZ(1));
+	meta.config = g_slist_append(NULL, &src);
+	packet.type = SR_DF_META;
+	packet.payload = &meta;
+	fail_unless(sr_output_send(o, &packet, &out) == SR_OK);
+	g_slist_free(meta.config);
+	g_variant_unref(src.data);
+	logic.length = len;
+	logic.unitsize = 1;
+	logic.data = (void *)data;
+	packet.type = SR_DF_LOGIC;
+	packet.payload = &logic;
+	fail_unless(sr_output_send(o, &packet, &out) == SR_OK);
+	packet.type = SR_DF_END;
+	packet.payload = NULL;
+	fail_unless(sr_output_send(o, &packet, &out) == SR_OK);
+	sr_output_free(o);
+
+	return filename;
+}
+
+/* Write a session file in small chunks and replay part of it. */
+START_TEST(test_session_load_window)
+{
+	struct sr_session *session;
+	GSList *devs;
+	GByteArray *received;
+	uint8_t data[1000];
+	char *filename;
+	unsigned int i;
+
+	for (i = 0; i < sizeof(data); i++)
+		data[i] = i * 7;
+
+	filename = session_file_new(data, sizeof(data));
+
+	fail_unless(sr_session_load(srtest_ctx, filename, &session) == SR_OK);
+	fail_unless(sr_session_dev_list(session, &devs) == SR_OK);
+	fail_unless(devs != NULL, "No device in session file.");
+	fail_unless(sr_config_set(devs->data, NULL, SR_CONF_SAMPLE_OFFSET,
+		g_variant_new_uint64(100)) == SR_OK);
+	fail_unless(sr_config_set(devs->data, NULL, SR_CONF_LIMIT_SAMPLES,
+		g_variant_new_uint64(300)) == SR_OK);
+	g_slist_free(devs);
+
+	received = g_byte_array_new();
+	sr_session_datafeed_callback_add(session, window_test_cb, received);
+	fail_unless(sr_session_start(session) == SR_OK);
+	fail_unless(sr_session_run(session) == SR_OK);
+	sr_session_destroy(session);
+	g_unlink(filename);
+	g_free(filename);
+
+	fail_unless(received->len == 300, "Received %u samples.",
+		received->len);
+	fail_unless(!memcmp(received->data, data + 100, 300));
+	g_byte_array_free(received, TRUE);
+}
+END_TEST
+
+struct dispatch_test {
+	const struct sr_dev_inst *sdi;
+	GThread *main_thread;
+	int types[8];
+	unsigned int num_types;
+	uint64_t samplerate;
+	GByteArray *received;
+	gboolean other_thread;
+};
+
+static void dispatch_test_cb(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	struct dispatch_test *dt;
+	const struct sr_datafeed_meta *meta;
+	const struct sr_datafeed_logic *logic;
+	const struct sr_config *src;
+	GSList *l;
+
+	dt = cb_data;
+	if (sdi != dt->sdi)
+		return;
+	if (g_thread_self() != dt->main_thread)
+		dt->other_thread = TRUE;
+	if (dt->num_types < G_N_ELEMENTS(dt->types))
+		dt->types[dt->num_types++] = packet->type;
+
+	switch (packet->type) {
+	case SR_DF_META:
+		meta = packet->payload;
+		for (l = meta->config; l; l = l->next) {
+			src = l->data;
+			if (src->key == SR_CONF_SAMPLERATE)
+				dt->samplerate = g_variant_get_uint64(src->data);
+		}
+		break;
+	case SR_DF_LOGIC:
+		logic = packet->payload;
+		g_byte_array_append(dt->received, logic->data, logic->length);
+		break;
+	}
+}
+
+/*
+ * Feed an input module's packets into a running session with the
+ * dispatch thread enabled, and check they arrive complete and in order.
+ * The input device is added after starting, since it has no driver to
+ * commit settings to.
+ */
+START_TEST(test_session_dispatch_packets)
+{
+	const int expected[] = {
+		SR_DF_HEADER, SR_DF_META, SR_DF_LOGIC, SR_DF_END,
+	};
+	const struct sr_input *in;
+	struct sr_session *session;
+	struct dispatch_test dt;
+	GHashTable *options;
+	GString *buf;
+	uint8_t data[1000];
+	char *filename;
+	unsigned int i;
+
+	for (i = 0; i < sizeof(data); i++)
+		data[i] = i * 3;
+	filename = session_file_new(data, sizeof(data));
+
+	options = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+		(GDestroyNotify)g_variant_unref);
+	g_hash_table_insert(options, g_strdup("samplerate"),
+		g_variant_ref_sink(g_variant_new_uint64(SR_KHZ(125))));
+	in = sr_input_new(sr_input_find("binary"), options);
+	g_hash_table_destroy(options);
+	fail_unless(in != NULL, "Failed to create input instance.");
+
+	memset(&dt, 0, sizeof(dt));
+	dt.sdi = sr_input_dev_inst_get(in);
+	dt.main_thread = g_thread_self();
+	dt.received = g_byte_array_new();
+
+	fail_unless(sr_session_load(srtest_ctx, filename, &session) == SR_OK);
+	fail_unless(sr_session_dispatch_set(session, 2,
+		SR_DISPATCH_BLOCK) == SR_OK);
+	sr_session_datafeed_callback_add(session, dispatch_test_cb, &dt);
+	fail_unless(sr_session_start(session) == SR_OK);
+	fail_unless(sr_session_dev_add(session,
+		(struct sr_dev_inst *)dt.sdi) == SR_OK);
+
+	buf = g_string_new_len((const gchar *)data, sizeof(data));
+	fail_unless(sr_input_send(in, buf) == SR_OK);
+	fail_unless(sr_input_end(in) == SR_OK);
+	g_string_free(buf, TRUE);
+
+	/* Stopping the session drains the dispatch queue. */
+	fail_unless(sr_session_run(session) == SR_OK);
+	sr_session_destroy(session);
+	sr_input_free(in);
+	g_unlink(filename);
+	g_free(filename);
+
+	fail_unless(dt.other_thread, "Callbacks ran in the main thread.");
+	fail_unless(dt.num_types == G_N_ELEMENTS(expected),
+		"Received %u packets.", dt.num_types);
+	for (i = 0; i < G_N_ELEMENTS(expected); i++)
+		fail_unless(dt.types[i] == expected[i],
+			"Packet %u has type %d.", i, dt.types[i]);
+	fail_unless(dt.samplerate == SR_KHZ(125),
+		"META samplerate was %" PRIu64 ".", dt.samplerate);
+	fail_unless(dt.received->len == sizeof(data));
+	fail_unless(!memcmp(dt.received->data, data, sizeof(data)));
+	g_byte_array_free(dt.received, TRUE);
+}
+END_TEST
+
+/* What an srzip file replays as, with two analog channels at most. */
+struct srzip_test {
+	GByteArray *logic;
+	GByteArray *analog[2];
+};
+
+/*
+ * Create an srzip output for a device with the given channels, and
+ * send it the samplerate.
+ */
+static const struct sr_output *srzip_test_new(unsigned int num_logic,
+		unsigned int num_analog, uint32_t chunksize,
+		struct sr_dev_inst **sdi, char **filename)
+{
+	const struct sr_output *o;
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_meta meta;
+	struct sr_config src;
+	GHashTable *opts;
+	GString *out;
+	char name[8];
+	unsigned int i;
+	int fd;
+
+	fd = g_file_open_tmp("libsigrok-test-XXXXXX.sr", filename, NULL);
+	fail_unless(fd >= 0, "Failed to create temporary file.");
+	close(fd);
+
+	*sdi = sr_dev_inst_user_new("Vendor", "Model", "Version");
+	for (i = 0; i < num_logic; i++) {
+		snprintf(name, sizeof(name), "D%u", i);
+		sr_dev_inst_channel_add(*sdi, i, SR_CHANNEL_LOGIC, name);
+	}
+	for (i = 0; i < num_analog; i++) {
+		snprintf(name, sizeof(name), "A%u", i);
+		sr_dev_inst_channel_add(*sdi, num_logic + i,
+			SR_CHANNEL_ANALOG, name);
+	}
+	opts = g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
+		(GDestroyNotify)g_variant_unref);
+	g_hash_table_insert(opts, "chunksize",
+		g_variant_ref_sink(g_variant_new_uint32(chunksize)));
+	o = sr_output_new(sr_output_find("srzip"), opts, *sdi, *filename);
+	g_hash_table_destroy(opts);
+	fail_unless(o != NULL, "Failed to create srzip output.");
+
+	src.key = SR_CONF_SAMPLERATE;
+	src.data = g_variant_new_uint64(SR_MHZ(1));
+	meta.config = g_slist_append(NULL, &src);
+	packet.type = SR_DF_META;
+	packet.payload = &meta;
+	fail_unless(sr_output_send(o, &packet, &out) == SR_OK);
+	g_slist_free(meta.config);
+	g_variant_unref(src.data);
+
+	return o;
+}
+
+static int srzip_test_send(const struct sr_output *o, int type,
+		const void *payload)
+{
+	struct sr_datafeed_packet packet;
+	GString *out;
+
+	packet.type = type;
+	packet.payload = payload;
+
+	return sr_output_send(o, &packet, &out);
+}
+
+static int srzip_test_send_analog(const struct sr_output *o,
+		struct sr_channel *ch, const float *data, size_t num_samples)
+{
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
+	int ret;
+
+	sr_analog_init(&analog, &encoding, &meaning, &spec, 3);
+	meaning.channels = g_slist_append(NULL, ch);
+	meaning.mq = SR_MQ_VOLTAGE;
+	meaning.unit = SR_UNIT_VOLT;
+	analog.num_samples = num_samples;
+	analog.data = (void *)data;
+	ret = srzip_test_send(o, SR_DF_ANALOG, &analog);
+	g_slist_free(meaning.channels);
+
+	return ret;
+}
+
+static void srzip_test_cb(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	struct srzip_test *st;
+	const struct sr_datafeed_logic *logic;
+	const struct sr_datafeed_analog *analog;
+	const struct sr_channel *ch;
+	float *values;
+
+	(void)sdi;
+
+	st = cb_data;
+	switch (packet->type) {
+	case SR_DF_LOGIC:
+		logic = packet->payload;
+		g_byte_array_append(st->logic, logic->data, logic->length);
+		break;
+	case SR_DF_ANALOG:
+		analog = packet->payload;
+		ch = analog->meaning->channels->data;
+		values = g_malloc(analog->num_samples * sizeof(float));
+		fail_unless(sr_analog_to_float(analog, values) == SR_OK);
+		g_byte_array_append(st->analog[!strcmp(ch->name, "A1")],
+			(const guint8 *)values,
+			analog->num_samples * sizeof(float));
+		g_free(values);
+		break;
+	}
+}
+
+/* Replay a session file, and collect its samples. */
+static void srzip_test_load(const char *filename, struct srzip_test *st)
+{
+	struct sr_session *session;
+
+	st->logic = g_byte_array_new();
+	st->analog[0] = g_byte_array_new();
+	st->analog[1] = g_byte_array_new();
+
+	fail_unless(sr_session_load(srtest_ctx, filename, &session) == SR_OK,
+		"Failed to load '%s'.", filename);
+	sr_session_datafeed_callback_add(session, srzip_test_cb, st);
+	fail_unless(sr_session_start(session) == SR_OK);
+	fail_unless(sr_session_run(session) == SR_OK);
+	sr_session_destroy(session);
+}
+
+static void srzip_test_free(struct srzip_test *st, struct sr_dev_inst *sdi,
+		char *filename)
+{
+	g_byte_array_free(st->logic, TRUE);
+	g_byte_array_free(st->analog[0], TRUE);
+	g_byte_array_free(st->analog[1], TRUE);
+	sr_dev_inst_free(sdi);
+	g_unlink(filename);
+	g_free(filename);
+}
+
+/*
+ * Get the compression method of an archive member from its local
+ * header, or -1 if there is no such member. The writer puts all
+ * members back to back, without data descriptors.
+ */
+static int srzip_test_method(const char *filename, const char *member)
+{
+	gchar *contents;
+	gsize len, pos, namelen;
+	int method;
+
+	fail_unless(g_file_get_contents(filename, &contents, &len, NULL));
+	method = -1;
+	for (pos = 0; pos + 30 <= len && RL32(contents + pos) == 0x04034b50;
+			pos += 30 + namelen + RL16(contents + pos + 28) +
+			RL32(contents + pos + 18)) {
+		namelen = RL16(contents + pos + 26);
+		if (namelen == strlen(member) &&
+				!memcmp(contents + pos + 30, member, namelen)) {
+			method = RL16(contents + pos + 8);
+			break;
+		}
+	}
+	g_free(contents);
+
+	return method;
+}
+
+/* Bytes which deflate doesn't shrink. */
+static void srzip_test_noise(uint8_t *data, size_t len)
+{
+	uint32_t x;
+	size_t i;
+
+	x = 1;
+	for (i = 0; i < len; i++) {
+		x = x * 1103515245 + 12345;
+		data[i] = x >> 16;
+	}
+}
+
+/* Write logic and two analog channels in small members, and replay them. */
+START_TEST(test_srzip_analog)
+{
+	const struct sr_output *o;
+	struct sr_dev_inst *sdi;
+	struct srzip_test st;
+	GSList *channels;
+	uint8_t logic_data[1000];
+	struct sr_datafeed_logic logic;
+	float analog_data[2][300];
+	char *filename;
+	unsigned int i, c;
+
+	for (i = 0; i < G_N_ELEMENTS(logic_data); i++)
+		logic_data[i] = i / 10;
+	for (i = 0; i < G_N_ELEMENTS(analog_data[0]); i++) {
+		analog_data[0][i] = i * 0.5;
+		analog_data[1][i] = i * -0.25;
+	}
+
+	/* Members of 64 values, which packets of 100 don't line up with. */
+	o = srzip_test_new(4, 2, 256, &sdi, &filename);
+	channels = sr_dev_inst_channels_get(sdi);
+	logic.length = sizeof(logic_data);
+	logic.unitsize = 1;
+	logic.data = logic_data;
+	fail_unless(srzip_test_send(o, SR_DF_LOGIC, &logic) == SR_OK);
+	for (i = 0; i < G_N_ELEMENTS(analog_data[0]); i += 100)
+		for (c = 0; c < 2; c++)
+			fail_unless(srzip_test_send_analog(o,
+				g_slist_nth_data(channels, 4 + c),
+				&analog_data[c][i], 100) == SR_OK);
+	fail_unless(srzip_test_send(o, SR_DF_END, NULL) == SR_OK);
+	sr_output_free(o);
+
+	fail_unless(srzip_test_method(filename, "analog-1-5-1") >= 0,
+		"No analog member for the first analog channel.");
+	fail_unless(srzip_test_method(filename, "analog-1-6-5") >= 0,
+		"No fifth member for the second analog channel.");
+
+	srzip_test_load(filename, &st);
+	fail_unless(st.logic->len == sizeof(logic_data) &&
+		!memcmp(st.logic->data, logic_data, sizeof(logic_data)),
+		"Logic data differs.");
+	for (c = 0; c < 2; c++)
+		fail_unless(st.analog[c]->len == sizeof(analog_data[c]) &&
+			!memcmp(st.analog[c]->data, analog_data[c],
+			sizeof(analog_data[c])), "Analog channel %u differs.", c);
+	srzip_test_free(&st, sdi, filename);
+}
+END_TEST
+
+/* Write runs which cross member boundaries, and replay them expanded. */
+START_TEST(test_srzip_rle)
+{
+	const struct sr_output *o;
+	struct sr_dev_inst *sdi;
+	struct srzip_test st;
+	struct sr_datafeed_logic_rle rle;
+	struct sr_datafeed_logic expected;
+	uint8_t values[] = {
+		0x01, 0x80, 0x02, 0x00, 0x55, 0xaa, 0xff, 0xff, 0x00, 0x00,
+		0x12, 0x34,
+	};
+	uint64_t lengths[] = { 1, 50, 0, 200, 7, 1000 };
+	char *filename;
+
+	rle.num_runs = G_N_ELEMENTS(lengths);
+	rle.unitsize = 2;
+	rle.values = values;
+	rle.lengths = lengths;
+	fail_unless(sr_logic_rle_densify(&rle, &expected) == SR_OK);
+
+	o = srzip_test_new(16, 0, 100, &sdi, &filename);
+	fail_unless(srzip_test_send(o, SR_DF_LOGIC_RLE, &rle) == SR_OK);
+	fail_unless(srzip_test_send(o, SR_DF_LOGIC, &expected) == SR_OK);
+	fail_unless(srzip_test_send(o, SR_DF_LOGIC_RLE, &rle) == SR_OK);
+	fail_unless(srzip_test_send(o, SR_DF_END, NULL) == SR_OK);
+	sr_output_free(o);
+
+	srzip_test_load(filename, &st);
+	fail_unless(st.logic->len == 3 * expected.length,
+		"Replayed %u bytes.", st.logic->len);
+	fail_unless(!memcmp(st.logic->data, expected.data, expected.length));
+	fail_unless(!memcmp(st.logic->data + expected.length, expected.data,
+		expected.length));
+	fail_unless(!memcmp(st.logic->data + 2 * expected.length,
+		expected.data, expected.length));
+	g_free(expected.data);
+	srzip_test_free(&st, sdi, filename);
+}
+END_TEST
+
+/* Check that members which don't compress get stored, and read back. */
+START_TEST(test_srzip_stored)
+{
+	const struct sr_output *o;
+	struct sr_dev_inst *sdi;
+	struct srzip_test st;
+	struct sr_datafeed_logic logic;
+	uint8_t data[4096];
+	char *filename;
+	unsigned int i;
+
+	srzip_test_noise(data, 2048);
+	for (i = 2048; i < sizeof(data); i++)
+		data[i] = i / 64;
+
+	o = srzip_test_new(8, 0, 1024, &sdi, &filename);
+	logic.length = sizeof(data);
+	logic.unitsize = 1;
+	logic.data = data;
+	fail_unless(srzip_test_send(o, SR_DF_LOGIC, &logic) == SR_OK);
+	fail_unless(srzip_test_send(o, SR_DF_END, NULL) == SR_OK);
+	sr_output_free(o);
+
+	fail_unless(srzip_test_method(filename, "logic-1-1") == 0,
+		"Noise wasn't stored.");
+	fail_unless(srzip_test_method(filename, "logic-1-2") == 0,
+		"Noise wasn't stored.");
+	fail_unless(srzip_test_method(filename, "logic-1-3") == 8,
+		"Runs weren't deflated.");
+
+	srzip_test_load(filename, &st);
+	fail_unless(st.logic->len == sizeof(data) &&
+		!memcmp(st.logic->data, data, sizeof(data)),
+		"Logic data differs.");
+	srzip_test_free(&st, sdi, filename);
+}
+END_TEST
+
+/* Write more members than the classic end record can count. */
+START_TEST(test_srzip_zip64)
+{
+	const struct sr_output *o;
+	struct sr_dev_inst *sdi;
+	struct srzip_test st;
+	struct sr_datafeed_logic logic;
+	gchar *contents;
+	gsize len;
+	const char *end;
+	uint8_t *data;
+	char *filename;
+	size_t size, i;
+
+	/* Members of four samples, with "version" and "metadata". */
+	size = 0xffff * 4;
+	data = g_malloc(size);
+	for (i = 0; i < size; i++)
+		data[i] = i * 7;
+
+	o = srzip_test_new(8, 0, 4, &sdi, &filename);
+	logic.length = size;
+	logic.unitsize = 1;
+	logic.data = data;
+	fail_unless(srzip_test_send(o, SR_DF_LOGIC, &logic) == SR_OK);
+	fail_unless(srzip_test_send(o, SR_DF_END, NULL) == SR_OK);
+	sr_output_free(o);
+
+	/* The end record defers to the Zip64 one, via the locator. */
+	fail_unless(g_file_get_contents(filename, &contents, &len, NULL));
+	end = contents + len - 22;
+	fail_unless(RL32(end) == 0x06054b50, "No end record.");
+	fail_unless(RL16(end + 10) == 0xffff, "Classic member count.");
+	fail_unless(RL32(end - 20) == 0x07064b50, "No Zip64 locator.");
+	fail_unless(RL64(end - 12) < len - 56 &&
+		RL32(contents + RL64(end - 12)) == 0x06064b50,
+		"No Zip64 end record.");
+	fail_unless(RL64(contents + RL64(end - 12) + 32) == 0xffff + 2,
+		"Zip64 end record counts %" PRIu64 " members.",
+		RL64(contents + RL64(end - 12) + 32));
+	g_free(contents);
+
+	srzip_test_load(filename, &st);
+	fail_unless(st.logic->len == size && !memcmp(st.logic->data, data, size),
+		"Logic data differs.");
+	g_free(data);
+	srzip_test_free(&st, sdi, filename);
+}
+END_TEST
+
+#ifndef _WIN32
+/*
+ * Have a member fail to write when the file size limit is hit, and
+ * check that it gets cut off, leaving a readable archive with the
+ * members written before it.
+ */
+START_TEST(test_srzip_write_failure)
+{
+	const struct sr_output *o;
+	struct sr_dev_inst *sdi;
+	struct srzip_test st;
+	struct sr_datafeed_logic logic;
+	struct rlimit limit, old_limit;
+	void (*old_handler)(int);
+	uint8_t *data;
+	char *filename;
+	size_t size;
+
+	/* Three members of noise fit the limit, the fourth one doesn't. */
+	size = 4 * 64 * 1024;
+	data = g_malloc(size);
+	srzip_test_noise(data, size);
+
+	o = srzip_test_new(8, 0, 64 * 1024, &sdi, &filename);
+	fail_unless(getrlimit(RLIMIT_FSIZE, &old_limit) == 0);
+	limit = old_limit;
+	limit.rlim_cur = 200 * 1000;
+	old_handler = signal(SIGXFSZ, SIG_IGN);
+	fail_unless(setrlimit(RLIMIT_FSIZE, &limit) == 0);
+
+	logic.length = size;
+	logic.unitsize = 1;
+	logic.data = data;
+	fail_unless(srzip_test_send(o, SR_DF_LOGIC, &logic) == SR_ERR_IO,
+		"Write beyond the file size limit succeeded.");
+	fail_unless(srzip_test_send(o, SR_DF_END, NULL) == SR_OK,
+		"Failed to complete the archive.");
+	sr_output_free(o);
+
+	setrlimit(RLIMIT_FSIZE, &old_limit);
+	signal(SIGXFSZ, old_handler);
+
+	fail_unless(srzip_test_method(filename, "logic-1-3") == 0);
+	fail_unless(srzip_test_method(filename, "logic-1-4") == -1,
+		"The failed member was kept.");
+	srzip_test_load(filename, &st);
+	fail_unless(st.logic->len == 3 * 64 * 1024 &&
+		!memcmp(st.logic->data, data, st.logic->len),
+		"Replayed %u bytes.", st.logic->len);
+	g_free(data);
+	srzip_test_free(&st, sdi, filename);
+}
+END_TEST
+#endif
+
 Suite *suite_session(void)
 {
 	Suite *s;
@@ -199,6 +1039,7 @@ Suite *suite_session(void)
 	tcase_add_test(tc, test_session_new_multiple);
 	tcase_add_test(tc, test_session_destroy);
 	tcase_add_test(tc, test_session_destroy_bogus);
+	tcase_add_test(tc, test_session_dispatch_set);
 	suite_add_tcase(s, tc);
 
 	tc = tcase_create("trigger");
@@ -209,5 +1050,31 @@ Suite *suite_session(void)
 	tcase_add_test(tc, test_session_trigger_get_null);
 	suite_add_tcase(s, tc);
 
+	tc = tcase_create("packet");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_test(tc, test_buffer_ref_unref);
+	tcase_add_test(tc, test_packet_copy_logic);
+	tcase_add_test(tc, test_logic_rle_densify);
+	tcase_add_test(tc, test_logic_planar);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("load");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_test(tc, test_session_load_window);
+	tcase_add_test(tc, test_session_dispatch_packets);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("srzip");
+	tcase_set_timeout(tc, 0);
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_test(tc, test_srzip_analog);
+	tcase_add_test(tc, test_srzip_rle);
+	tcase_add_test(tc, test_srzip_stored);
+	tcase_add_test(tc, test_srzip_zip64);
+#ifndef _WIN32
+	tcase_add_test(tc, test_srzip_write_failure);
+#endif
+	suite_add_tcase(s, tc);
+
 	return s;
 }
@@ -430,6 +430,63 @@ START_TEST(test_exponent)
 }
 END_TEST
 
+START_TEST(test_float_list)
+{
+	const float expected[] = {
+		1, 2.5, -3e-3, 425, 9.9e37, 1.234e-6, -0.5, 5, 0.1,
+	};
+	float values[16];
+	size_t count, i;
+	int ret;
+
+	ret = sr_parse_float_list("1,2.5,-3e-3, 4.25E+02 ,+9.9E+37,"
+		"0.000001234,-.5,5.,0.100000000000000000001",
+		values, ARRAY_SIZE(values), &count);
+	fail_unless(ret == SR_OK, "Unexpected rc %d.", ret);
+	fail_unless(count == ARRAY_SIZE(expected), "Got %zu values.", count);
+	for (i = 0; i < count; i++)
+		fail_unless(values[i] == expected[i],
+			"Value %zu is %g, expected %g.", i, values[i],
+			expected[i]);
+
+	/* Invalid values get skipped, the others still stored. */
+	ret = sr_parse_float_list("1,abc,,2V,3", values, 16, &count);
+	fail_unless(ret == SR_ERR_DATA, "Unexpected rc %d.", ret);
+	fail_unless(count == 2 && values[0] == 1 && values[1] == 3);
+
+	/* Values beyond the array's size only get counted. */
+	ret = sr_parse_float_list("1,2,3", values, 2, &count);
+	fail_unless(ret == SR_OK && count == 3 && values[1] == 2);
+	ret = sr_parse_float_list("1,2,3", NULL, 0, &count);
+	fail_unless(ret == SR_OK && count == 3);
+
+	/* An empty string is an empty list, a trailing comma isn't. */
+	ret = sr_parse_float_list("", values, 16, &count);
+	fail_unless(ret == SR_OK && count == 0);
+	ret = sr_parse_float_list("1,", values, 16, &count);
+	fail_unless(ret == SR_ERR_DATA && count == 1);
+}
+END_TEST
+
+START_TEST(test_float_list_locale)
+{
+	char *saved_locale;
+	float value;
+	size_t count;
+
+	saved_locale = g_strdup(setlocale(LC_NUMERIC, NULL));
+	setlocale(LC_NUMERIC, "de_DE.UTF-8");
+	/* The slow path (long mantissa) must ignore the locale as well. */
+	fail_unless(sr_parse_float_list("0.25", &value, 1, &count) == SR_OK);
+	fail_unless(count == 1 && value == 0.25f);
+	fail_unless(sr_parse_float_list("0.2500000000000000000", &value, 1,
+		&count) == SR_OK);
+	fail_unless(count == 1 && value == 0.25f);
+	setlocale(LC_NUMERIC, saved_locale);
+	g_free(saved_locale);
+}
+END_TEST
+
 Suite *suite_strutil(void)
 {
 	Suite *s;
@@ -452,5 +509,11 @@ Suite *suite_strutil(void)
 	tcase_add_test(tc, test_exponent);
 	suite_add_tcase(s, tc);
 
+	tc = tcase_create("sr_parse_float_list");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_test(tc, test_float_list);
+	tcase_add_test(tc, test_float_list_locale);
+	suite_add_tcase(s, tc);
+
 	return s;
 }
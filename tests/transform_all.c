@@ -96,6 +96,77 @@ START_TEST(test_transform_options)
 }
 END_TEST
 
+static void datafeed_collect(const struct sr_dev_inst *sdi,
+	const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	const struct sr_datafeed_logic *logic;
+
+	(void)sdi;
+
+	if (packet->type != SR_DF_LOGIC)
+		return;
+	logic = packet->payload;
+	g_byte_array_append(cb_data, logic->data, logic->length);
+}
+
+/* Check that a chain of transforms gives the same as applying each. */
+START_TEST(test_transform_chain)
+{
+	struct sr_input *in;
+	struct sr_session *session;
+	struct sr_dev_inst *sdi;
+	const struct sr_transform *t[4];
+	GHashTable *options;
+	GByteArray *samples;
+	GString *buf;
+	unsigned int i;
+	uint8_t b;
+
+	buf = g_string_new(NULL);
+	for (i = 0; i < 1000; i++)
+		g_string_append_c(buf, (char)(i * 7));
+
+	in = sr_input_new(sr_input_find("binary"), NULL);
+	fail_unless(in != NULL, "Failed to create input instance.");
+	sdi = sr_input_dev_inst_get(in);
+	sr_session_new(srtest_ctx, &session);
+	samples = g_byte_array_new();
+	sr_session_datafeed_callback_add(session, datafeed_collect, samples);
+	sr_session_dev_add(session, sdi);
+
+	options = g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
+		(GDestroyNotify)g_variant_unref);
+	g_hash_table_insert(options, "channels",
+		g_variant_ref_sink(g_variant_new_uint64(0x3c)));
+	t[0] = sr_transform_new(sr_transform_find("invert"), NULL, sdi);
+	t[1] = sr_transform_new(sr_transform_find("mask"), options, sdi);
+	t[2] = sr_transform_new(sr_transform_find("nop"), NULL, sdi);
+	t[3] = sr_transform_new(sr_transform_find("invert"), NULL, sdi);
+	g_hash_table_destroy(options);
+	for (i = 0; i < 4; i++)
+		fail_unless(t[i] != NULL, "Failed to create transform %u.", i);
+
+	fail_unless(sr_input_send(in, buf) == SR_OK);
+	fail_unless(sr_input_end(in) == SR_OK);
+	fail_unless(samples->len == buf->len, "Expected %zu samples, got %u.",
+		buf->len, samples->len);
+	for (i = 0; i < samples->len; i++) {
+		b = ~((~(uint8_t)buf->str[i]) & 0x3c);
+		fail_unless(samples->data[i] == b,
+			"Sample %u is 0x%02x, expected 0x%02x.", i,
+			samples->data[i], b);
+	}
+
+	sr_session_dev_remove_all(session);
+	sr_input_free(in);
+	sr_session_destroy(session);
+	for (i = 0; i < 4; i++)
+		sr_transform_free(t[i]);
+	g_byte_array_free(samples, TRUE);
+	g_string_free(buf, TRUE);
+}
+END_TEST
+
 Suite *suite_transform_all(void)
 {
 	Suite *s;
@@ -112,5 +183,10 @@ Suite *suite_transform_all(void)
 	tcase_add_test(tc, test_transform_options);
 	suite_add_tcase(s, tc);
 
+	tc = tcase_create("chain");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_test(tc, test_transform_chain);
+	suite_add_tcase(s, tc);
+
 	return s;
 }
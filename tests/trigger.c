@@ -20,8 +20,10 @@
 #include <config.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <check.h>
 #include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
 #include "lib.h"
 
 /* Test lots of triggers/stages/matches/channels */
@@ -249,6 +251,237 @@ START_TEST(test_trigger_match_add_bogus)
 }
 END_TEST
 
+/* Soft trigger tests run over this many samples, fed in chunks. */
+#define SOFT_NUM_SAMPLES 4096
+/* Stands for the last channel, which is in the last byte of a sample. */
+#define SOFT_LAST -2
+
+struct soft_match {
+	int stage;
+	int channel;
+	int match;
+};
+
+struct soft_case {
+	const char *name;
+	/* Channel, and samples [start, end) where it is high. */
+	struct { int channel, start, end; } high[6];
+	struct soft_match matches[4];
+	int expected;
+};
+
+/* Ends both lists: no stage, and no channel. */
+#define SOFT_END { -1, 0, 0 }
+
+static const struct soft_case soft_cases[] = {
+	{ "level",
+		{ { SOFT_LAST, 1500, 1600 }, { 1, 1400, 1550 }, SOFT_END },
+		{ { 0, SOFT_LAST, SR_TRIGGER_ONE }, { 0, 1, SR_TRIGGER_ZERO },
+		  SOFT_END }, 1550 },
+	{ "rising",
+		{ { SOFT_LAST, 0, 100 }, { SOFT_LAST, 1024, 2000 }, SOFT_END },
+		{ { 0, SOFT_LAST, SR_TRIGGER_RISING }, SOFT_END }, 1024 },
+	{ "falling",
+		{ { SOFT_LAST, 0, 100 }, { SOFT_LAST, 1024, 2000 }, SOFT_END },
+		{ { 0, SOFT_LAST, SR_TRIGGER_FALLING }, SOFT_END }, 100 },
+	{ "edge",
+		{ { SOFT_LAST, 0, 100 }, { SOFT_LAST, 1024, 2000 }, SOFT_END },
+		{ { 0, SOFT_LAST, SR_TRIGGER_EDGE }, SOFT_END }, 100 },
+	{ "rising-level",
+		{ { SOFT_LAST, 1024, 2000 }, { SOFT_LAST, 3000, 3100 },
+		  { 1, 1900, SOFT_NUM_SAMPLES }, SOFT_END },
+		{ { 0, SOFT_LAST, SR_TRIGGER_RISING }, { 0, 1, SR_TRIGGER_ONE },
+		  SOFT_END }, 3000 },
+	/* A partial match, then one across the 1024 sample boundary. */
+	{ "stages",
+		{ { SOFT_LAST, 500, 501 }, { SOFT_LAST, 1023, 1024 },
+		  { SOFT_LAST, 1025, 1026 }, SOFT_END },
+		{ { 0, SOFT_LAST, SR_TRIGGER_ONE }, { 1, SOFT_LAST, SR_TRIGGER_ZERO },
+		  { 2, SOFT_LAST, SR_TRIGGER_ONE }, SOFT_END }, 1025 },
+	/* A failed second stage, where the match starts one sample later. */
+	{ "stages-restart",
+		{ { SOFT_LAST, 700, 702 }, { SOFT_LAST, 703, 704 },
+		  { SOFT_LAST, 1023, 1024 }, { SOFT_LAST, 1025, 1026 }, SOFT_END },
+		{ { 0, SOFT_LAST, SR_TRIGGER_ONE }, { 1, SOFT_LAST, SR_TRIGGER_ZERO },
+		  { 2, SOFT_LAST, SR_TRIGGER_ONE }, SOFT_END }, 703 },
+	{ "stages-edges",
+		{ { SOFT_LAST, 0, 100 }, { SOFT_LAST, 1024, 1025 }, SOFT_END },
+		{ { 0, SOFT_LAST, SR_TRIGGER_RISING },
+		  { 1, SOFT_LAST, SR_TRIGGER_FALLING }, SOFT_END }, 1025 },
+	{ "never",
+		{ { SOFT_LAST, 0, SOFT_NUM_SAMPLES }, SOFT_END },
+		{ { 0, SOFT_LAST, SR_TRIGGER_ONE }, { 0, SOFT_LAST, SR_TRIGGER_ZERO },
+		  SOFT_END }, -1 },
+};
+
+static const unsigned int soft_unitsizes[] = { 1, 2, 4, 9 };
+static const int soft_chunks[] = { 1, 7, 1024, SOFT_NUM_SAMPLES };
+static const int soft_pre_samples[] = { 0, 64, 2000 };
+
+struct soft_feed {
+	GString *pre;
+	int triggers;
+};
+
+static void soft_test_feed(const struct sr_dev_inst *sdi,
+	const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	struct soft_feed *feed;
+	const struct sr_datafeed_logic *logic;
+
+	(void)sdi;
+
+	feed = cb_data;
+	if (packet->type == SR_DF_TRIGGER)
+		feed->triggers++;
+	if (packet->type != SR_DF_LOGIC)
+		return;
+	fail_unless(feed->triggers == 0, "Pre-trigger data after trigger.");
+	logic = packet->payload;
+	g_string_append_len(feed->pre, logic->data, logic->length);
+}
+
+static uint8_t *soft_test_data(const struct soft_case *c,
+		unsigned int unitsize)
+{
+	uint8_t *data;
+	int i, h, channel;
+
+	data = g_malloc0(SOFT_NUM_SAMPLES * unitsize);
+	/* Channel 0 toggles all the time, without triggering anything. */
+	for (i = 1; i < SOFT_NUM_SAMPLES; i += 2)
+		data[i * unitsize] |= 1;
+	for (h = 0; c->high[h].channel >= 0 ||
+			c->high[h].channel == SOFT_LAST; h++) {
+		channel = c->high[h].channel;
+		if (channel == SOFT_LAST)
+			channel = unitsize * 8 - 1;
+		for (i = c->high[h].start; i < c->high[h].end; i++)
+			data[i * unitsize + channel / 8] |= 1 << (channel % 8);
+	}
+
+	return data;
+}
+
+/*
+ * Feed the data to a soft trigger in chunks, check the pre-trigger data
+ * it sends, and return the sample it fired on, or -1.
+ */
+static int soft_test_run(const struct soft_case *c, unsigned int unitsize,
+		const uint8_t *data, int chunk, int pre_samples)
+{
+	struct sr_dev_inst *sdi;
+	struct sr_session *session;
+	struct sr_trigger *trigger;
+	struct sr_trigger_stage *stage;
+	struct soft_trigger_logic *stl;
+	const struct soft_match *m;
+	struct soft_feed feed;
+	GSList *channels;
+	char name[8];
+	int i, pos, len, offset, fired, pre, expected_pre;
+
+	sdi = sr_dev_inst_user_new("Vendor", "Model", "Version");
+	for (i = 0; i < (int)unitsize * 8; i++) {
+		snprintf(name, sizeof(name), "D%d", i);
+		sr_dev_inst_channel_add(sdi, i, SR_CHANNEL_LOGIC, name);
+	}
+	sr_session_new(srtest_ctx, &session);
+	sr_session_dev_add(session, sdi);
+	feed.pre = g_string_new(NULL);
+	feed.triggers = 0;
+	sr_session_datafeed_callback_add(session, soft_test_feed, &feed);
+
+	trigger = sr_trigger_new(NULL);
+	channels = sr_dev_inst_channels_get(sdi);
+	for (m = c->matches; m->stage >= 0; m++) {
+		while ((int)g_slist_length(trigger->stages) <= m->stage)
+			sr_trigger_stage_add(trigger);
+		stage = g_slist_nth_data(trigger->stages, m->stage);
+		fail_unless(sr_trigger_match_add(stage, g_slist_nth_data(channels,
+			m->channel == SOFT_LAST ? (int)unitsize * 8 - 1 : m->channel),
+			m->match, 0) == SR_OK);
+	}
+	stl = soft_trigger_logic_new(sdi, trigger, pre_samples);
+	fail_unless(stl != NULL, "Failed to create soft trigger.");
+
+	fired = -1;
+	pre = -1;
+	for (pos = 0; pos < SOFT_NUM_SAMPLES && fired < 0; pos += len) {
+		len = MIN(chunk, SOFT_NUM_SAMPLES - pos);
+		offset = soft_trigger_logic_check(stl,
+			(uint8_t *)data + pos * unitsize, len * unitsize, &pre);
+		if (offset >= 0)
+			fired = pos + offset;
+	}
+
+	if (fired >= 0) {
+		expected_pre = MIN(fired, pre_samples);
+		fail_unless(pre == expected_pre, "%s: %d pre-trigger samples, "
+			"expected %d.", c->name, pre, expected_pre);
+		fail_unless(feed.triggers == 1, "%s: No trigger sent.", c->name);
+		fail_unless(feed.pre->len == (gsize)expected_pre * unitsize &&
+			!memcmp(feed.pre->str, data + (fired - expected_pre) * unitsize,
+			feed.pre->len), "%s: Wrong pre-trigger data.", c->name);
+	} else {
+		fail_unless(feed.triggers == 0 && feed.pre->len == 0,
+			"%s: Data sent without trigger.", c->name);
+	}
+
+	soft_trigger_logic_free(stl);
+	sr_trigger_free(trigger);
+	sr_session_dev_remove_all(session);
+	sr_session_destroy(session);
+	sr_dev_inst_free(sdi);
+	g_string_free(feed.pre, TRUE);
+
+	return fired;
+}
+
+static void soft_test_all(void)
+{
+	const struct soft_case *c;
+	unsigned int i, u, ch, p;
+	uint8_t *data;
+	int fired;
+
+	for (i = 0; i < G_N_ELEMENTS(soft_cases); i++) {
+		c = &soft_cases[i];
+		for (u = 0; u < G_N_ELEMENTS(soft_unitsizes); u++) {
+			data = soft_test_data(c, soft_unitsizes[u]);
+			for (ch = 0; ch < G_N_ELEMENTS(soft_chunks); ch++) {
+				for (p = 0; p < G_N_ELEMENTS(soft_pre_samples); p++) {
+					fired = soft_test_run(c, soft_unitsizes[u],
+						data, soft_chunks[ch],
+						soft_pre_samples[p]);
+					fail_unless(fired == c->expected,
+						"%s, unitsize %u, chunks of %d: "
+						"fired at %d, expected %d.", c->name,
+						soft_unitsizes[u], soft_chunks[ch],
+						fired, c->expected);
+				}
+			}
+			g_free(data);
+		}
+	}
+}
+
+/* Check soft triggers against known offsets, vectorized if possible. */
+START_TEST(test_soft_trigger)
+{
+	soft_test_all();
+}
+END_TEST
+
+/* Check that the portable code finds the same offsets. */
+START_TEST(test_soft_trigger_portable)
+{
+	sr_simd_features_limit(0);
+	soft_test_all();
+	sr_simd_features_limit(~0U);
+}
+END_TEST
+
 Suite *suite_trigger(void)
 {
 	Suite *s;
@@ -276,5 +509,12 @@ Suite *suite_trigger(void)
 	tcase_add_test(tc, test_trigger_match_add_bogus);
 	suite_add_tcase(s, tc);
 
+	tc = tcase_create("soft");
+	tcase_set_timeout(tc, 0);
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_test(tc, test_soft_trigger);
+	tcase_add_test(tc, test_soft_trigger_portable);
+	suite_add_tcase(s, tc);
+
 	return s;
 }
@@ -0,0 +1,266 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2026 The sigrok developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <check.h>
+#include <libsigrok/libsigrok.h>
+#include "lib.h"
+#include "libsigrok-internal.h"
+
+static gboolean ring_test_push(struct usb_ring *r, int *items,
+		gboolean use_reserve, int value)
+{
+	guint slot;
+
+	if (!usb_ring_push_slot(r, use_reserve, &slot))
+		return FALSE;
+	fail_unless(slot <= r->mask, "Slot %u out of range.", slot);
+	items[slot] = value;
+	usb_ring_push_done(r);
+
+	return TRUE;
+}
+
+static int ring_test_pop(struct usb_ring *r, const int *items)
+{
+	guint slot;
+	int value;
+
+	fail_unless(usb_ring_pop_slot(r, &slot), "Ring is empty.");
+	value = items[slot];
+	usb_ring_pop_done(r);
+
+	return value;
+}
+
+/* Check the ring size, and that a new ring is empty. */
+START_TEST(test_usb_ring_init)
+{
+	struct usb_ring r;
+	guint slot;
+
+	fail_unless(usb_ring_init(&r, 4, 0) == 4);
+	fail_unless(usb_ring_init(&r, 5, 3) == 8);
+	fail_unless(usb_ring_init(&r, 0, 0) == 1, "Depth must be at least 1.");
+	fail_unless(usb_ring_fill(&r) == 0);
+	fail_unless(!usb_ring_pop_slot(&r, &slot));
+}
+END_TEST
+
+/* Check the order of items while the indices and slots wrap around. */
+START_TEST(test_usb_ring_wraparound)
+{
+	struct usb_ring r;
+	int items[4], i, next;
+
+	usb_ring_init(&r, 3, 0);
+	/* Start just before the free running indices overflow. */
+	r.head = r.tail = -5;
+	next = 0;
+	for (i = 0; i < 20; i++) {
+		fail_unless(ring_test_push(&r, items, FALSE, 2 * i));
+		fail_unless(ring_test_push(&r, items, FALSE, 2 * i + 1));
+		fail_unless(usb_ring_fill(&r) == 2, "Fill %u after %d rounds.",
+			usb_ring_fill(&r), i);
+		fail_unless(ring_test_pop(&r, items) == next++);
+		fail_unless(ring_test_pop(&r, items) == next++);
+	}
+	fail_unless(usb_ring_fill(&r) == 0);
+}
+END_TEST
+
+/* Check that plain items are limited to the depth. */
+START_TEST(test_usb_ring_full)
+{
+	struct usb_ring r;
+	int items[4], i;
+
+	usb_ring_init(&r, 3, 0);
+	for (i = 0; i < 3; i++)
+		fail_unless(ring_test_push(&r, items, FALSE, i));
+	fail_unless(!ring_test_push(&r, items, FALSE, 3), "Pushed past depth.");
+	fail_unless(!ring_test_push(&r, items, TRUE, 3), "Pushed past reserve.");
+	fail_unless(usb_ring_fill(&r) == 3);
+
+	fail_unless(ring_test_pop(&r, items) == 0);
+	fail_unless(ring_test_push(&r, items, FALSE, 3));
+	for (i = 1; i < 4; i++)
+		fail_unless(ring_test_pop(&r, items) == i);
+}
+END_TEST
+
+/* Check that only items which may use it get into the reserve. */
+START_TEST(test_usb_ring_reserve)
+{
+	struct usb_ring r;
+	int items[8], i;
+
+	usb_ring_init(&r, 2, 3);
+	fail_unless(ring_test_push(&r, items, FALSE, 0));
+	fail_unless(ring_test_push(&r, items, FALSE, 1));
+	fail_unless(!ring_test_push(&r, items, FALSE, 2), "Pushed past depth.");
+	for (i = 2; i < 5; i++)
+		fail_unless(ring_test_push(&r, items, TRUE, i));
+	fail_unless(!ring_test_push(&r, items, TRUE, 5), "Pushed past reserve.");
+	fail_unless(usb_ring_fill(&r) == 5);
+
+	/* Above the depth, freed room is for the reserve only. */
+	fail_unless(ring_test_pop(&r, items) == 0);
+	fail_unless(!ring_test_push(&r, items, FALSE, 5));
+	fail_unless(ring_test_push(&r, items, TRUE, 5));
+	for (i = 1; i < 6; i++)
+		fail_unless(ring_test_pop(&r, items) == i);
+	fail_unless(ring_test_push(&r, items, FALSE, 6));
+	fail_unless(ring_test_pop(&r, items) == 6);
+}
+END_TEST
+
+#ifdef HAVE_LIBUSB_1_0
+/* Check transfer sizes, counts and timeouts over a range of rates. */
+START_TEST(test_usb_stream_init)
+{
+	const uint64_t rates[] = { 0, 100, 999, 1000000, 3500000, 48000000 };
+	struct usb_stream s;
+	uint64_t bytes_per_ms, n;
+	unsigned int i;
+
+	usb_stream_init(&s, 1000000, 512, 10, 500, 16, 32);
+	fail_unless(s.buffer_size == 10240, "Buffer size %zu.", s.buffer_size);
+	fail_unless(s.num_transfers == 16, "%u transfers.", s.num_transfers);
+	fail_unless(s.max_transfers == 32);
+	fail_unless(s.buffer_us == 10240);
+	fail_unless(s.timeout == 204, "Timeout %u ms.", s.timeout);
+
+	usb_stream_init(&s, 1000000, 512, 10, 20, 16, 32);
+	fail_unless(s.num_transfers == 2, "%u transfers.", s.num_transfers);
+	usb_stream_init(&s, 1000000, 512, 10, 500, 16, 0);
+	fail_unless(s.max_transfers == 1 && s.num_transfers == 1);
+
+	for (i = 0; i < G_N_ELEMENTS(rates); i++) {
+		usb_stream_init(&s, rates[i], 3 * 512, 10, 100, 16, 32);
+		bytes_per_ms = MAX(rates[i] / 1000, 1);
+		n = (100 * bytes_per_ms + s.buffer_size - 1) / s.buffer_size;
+		fail_unless(s.buffer_size % (3 * 512) == 0 &&
+			s.buffer_size >= 10 * bytes_per_ms &&
+			s.buffer_size < 10 * bytes_per_ms + 3 * 512,
+			"%" PRIu64 " B/s: buffer size %zu.", rates[i],
+			s.buffer_size);
+		fail_unless(s.num_transfers == CLAMP(n, 1, 16),
+			"%" PRIu64 " B/s: %u transfers.", rates[i],
+			s.num_transfers);
+		fail_unless(s.buffer_us > 0 &&
+			s.timeout > s.num_transfers * s.buffer_us / 1000,
+			"%" PRIu64 " B/s: timeout %u ms.", rates[i], s.timeout);
+		fail_unless(!s.in_flight && !s.completions &&
+			!s.last_completion_us);
+	}
+}
+END_TEST
+
+/* Complete a transfer, the previous one completed gap_us ago. */
+static unsigned int stream_test_complete(struct usb_stream *s,
+		struct libusb_transfer *transfer, int64_t gap_us)
+{
+	s->in_flight++;
+	s->last_completion_us = g_get_monotonic_time() - gap_us;
+
+	return usb_stream_completed(s, transfer);
+}
+
+/* Check that late completions grow the pool, up to its maximum. */
+START_TEST(test_usb_stream_completed)
+{
+	struct usb_stream s;
+	struct libusb_transfer transfer;
+	unsigned int timeout;
+
+	memset(&transfer, 0, sizeof(transfer));
+	transfer.status = LIBUSB_TRANSFER_COMPLETED;
+	transfer.actual_length = 512;
+	usb_stream_init(&s, 1000000, 512, 10, 40, 4, 8);
+	fail_unless(s.num_transfers == 4 && s.buffer_us == 10240);
+	timeout = s.timeout;
+
+	/* The first completion has nothing to compare against. */
+	s.in_flight = 1;
+	fail_unless(usb_stream_completed(&s, &transfer) == 0);
+	fail_unless(s.in_flight == 0 && s.completions == 1);
+	fail_unless(s.last_completion_us != 0);
+
+	/* On time, and just within half of the pool's data. */
+	fail_unless(stream_test_complete(&s, &transfer, 0) == 0);
+	fail_unless(stream_test_complete(&s, &transfer, 20000) == 0);
+	fail_unless(s.late_completions == 0 && s.num_transfers == 4);
+
+	/* Late: grow by a quarter, at least one, up to the maximum. */
+	fail_unless(stream_test_complete(&s, &transfer, 1000000) == 1);
+	fail_unless(s.num_transfers == 5 && s.late_completions == 1);
+	fail_unless(s.timeout > timeout, "Timeout didn't grow.");
+	fail_unless(stream_test_complete(&s, &transfer, 1000000) == 1);
+	fail_unless(stream_test_complete(&s, &transfer, 1000000) == 1);
+	fail_unless(stream_test_complete(&s, &transfer, 1000000) == 1);
+	fail_unless(s.num_transfers == 8);
+	fail_unless(stream_test_complete(&s, &transfer, 1000000) == 0);
+	fail_unless(s.num_transfers == 8 && s.late_completions == 5);
+
+	/* Cancelled, empty and failed transfers never grow the pool. */
+	transfer.status = LIBUSB_TRANSFER_CANCELLED;
+	fail_unless(stream_test_complete(&s, &transfer, 1000000) == 0);
+	fail_unless(s.completions == 8 && s.in_flight == 0);
+	transfer.status = LIBUSB_TRANSFER_ERROR;
+	fail_unless(stream_test_complete(&s, &transfer, 1000000) == 0);
+	transfer.status = LIBUSB_TRANSFER_COMPLETED;
+	transfer.actual_length = 0;
+	fail_unless(stream_test_complete(&s, &transfer, 1000000) == 0);
+	fail_unless(s.completions == 10 && s.empty_transfers == 2);
+	fail_unless(s.late_completions == 5);
+
+	/* Timeouts may carry data, and count as completions. */
+	usb_stream_init(&s, 1000000, 512, 10, 40, 4, 8);
+	transfer.status = LIBUSB_TRANSFER_TIMED_OUT;
+	transfer.actual_length = 512;
+	fail_unless(stream_test_complete(&s, &transfer, 1000000) == 1);
+	fail_unless(s.empty_transfers == 0 && s.num_transfers == 5);
+}
+END_TEST
+#endif
+
+Suite *suite_usb(void)
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("usb");
+
+	tc = tcase_create("ring");
+	tcase_add_test(tc, test_usb_ring_init);
+	tcase_add_test(tc, test_usb_ring_wraparound);
+	tcase_add_test(tc, test_usb_ring_full);
+	tcase_add_test(tc, test_usb_ring_reserve);
+	suite_add_tcase(s, tc);
+
+#ifdef HAVE_LIBUSB_1_0
+	tc = tcase_create("stream");
+	tcase_add_test(tc, test_usb_stream_init);
+	tcase_add_test(tc, test_usb_stream_completed);
+	suite_add_tcase(s, tc);
+#endif
+
+	return s;
+}